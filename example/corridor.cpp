@@ -182,6 +182,9 @@ int main(int argc, char** argv)
     corridormap::Footprint_Normals normals = corridormap::allocate_foorprint_normals(&mem, obstacles.num_polys, obstacles.num_verts);
     corridormap::build_footprint_normals(obstacles, obstacle_bounds, normals);
 
+    corridormap::Footprint_Edge_Tree edge_tree = corridormap::allocate_footprint_edge_tree(&mem, obstacles.num_polys, corridormap::footprint_edge_tree_nodes(obstacles));
+    corridormap::build_footprint_edge_tree(obstacles, edge_tree);
+
     corridormap::Distance_Mesh mesh = corridormap::allocate_distance_mesh(&mem, obstacles.num_polys, max_distance_mesh_verts(obstacles, max_dist, max_error));
     corridormap::build_distance_mesh(obstacles, obstacle_bounds, max_dist, max_error, mesh);
 
@@ -278,7 +281,7 @@ int main(int argc, char** argv)
         corridormap::CSR_Grid edge_csr = corridormap::allocate_csr_grid(&mem, render_target_height, render_target_width, features.num_edge_points);
         corridormap::build_csr(features.edges, edge_csr);
 
-        traced_edges = corridormap::allocate_voronoi_traced_edges(&mem, features.num_vert_points, obstacles.num_verts);
+        traced_edges = corridormap::allocate_voronoi_traced_edges(&mem, features.num_vert_points, features.num_edge_points);
 
         corridormap::trace_edges(&mem, vert_csr, edge_csr, edge_spans, features, traced_edges);
         printf("edge_count=%d\n", traced_edges.num_edges);
@@ -288,6 +291,7 @@ int main(int argc, char** argv)
         params.bounds = obstacle_bounds;
         params.obstacles = &obstacles;
         params.obstacle_normals = &normals;
+        params.obstacle_edge_tree = &edge_tree;
         params.features = &features;
         params.traced_edges = &traced_edges;
         params.spans = &edge_spans;
@@ -299,22 +303,24 @@ int main(int argc, char** argv)
     }
 
     {
-        int path_verts[] = { 0, 2, 4, 8, 9, 13, 17, 21, 18, 26 };
-        const int vert_path_size = sizeof(path_verts)/sizeof(path_verts[0]);
-        corridormap::Vertex* vert_path[vert_path_size];
+        const float agent_clearance = 30.f;
+        corridormap::Vec2 start = space.vertices.items[0].pos;
+        corridormap::Vec2 goal = space.vertices.items[26].pos;
+
+        corridormap::Path_Search search = corridormap::create_path_search(&mem, space.vertices.max_items);
+        corridormap::Half_Edge* edge_path[256];
+        int edge_path_size = corridormap::find_path(space, search, start, goal, agent_clearance, edge_path, sizeof(edge_path)/sizeof(edge_path[0]));
+        corridormap::destroy(&mem, search);
 
-        for (int i = 0; i < vert_path_size; ++i)
+        if (edge_path_size < 0)
         {
-            vert_path[i] = space.vertices.items + path_verts[i];
+            edge_path_size = 0;
         }
 
-        corridormap::Half_Edge* edge_path[sizeof(path_verts)/sizeof(path_verts[0]) - 1];
-        vertex_to_edge_path(space, vert_path, vert_path_size, edge_path);
-        int edge_path_size = vert_path_size-1;
         int num_disks = corridormap::num_path_discs(space, edge_path, edge_path_size);
         corridor = create_corridor(&mem, num_disks, 5*num_disks);
         corridormap::extract(space, edge_path, edge_path_size, corridor, 3.5f);
-        corridormap::shrink(corridor, 30.f);
+        corridormap::shrink(corridor, agent_clearance);
         corridormap::triangulate(corridor, 8.f);
     }
 
@@ -216,8 +216,8 @@ int main()
 
         render_iface.acquire_shared(cl_runtime.queue, voronoi_image);
         error_code = corridormap::mark_voronoi_features(cl_runtime, voronoi_image);
-        error_code = corridormap::debug_voronoi_features(cl_runtime, voronoi_image, cl_runtime.voronoi_edges_img, 0xff000000, 0);
-        error_code = corridormap::debug_voronoi_features(cl_runtime, voronoi_image, cl_runtime.voronoi_vertices_img, 0xffffffff, 4);
+        error_code = corridormap::debug_voronoi_features(cl_runtime, voronoi_image, corridormap::voronoi_mark_edge, 0xff000000, 0);
+        error_code = corridormap::debug_voronoi_features(cl_runtime, voronoi_image, corridormap::voronoi_mark_vertex, 0xffffffff, 4);
         error_code = corridormap::compact_voronoi_features(cl_runtime);
         error_code = corridormap::store_obstacle_ids(cl_runtime, voronoi_image);
         render_iface.release_shared(cl_runtime.queue, voronoi_image);
@@ -22,11 +22,13 @@
 #ifndef CORRIDORMAP_BUILD_H_
 #define CORRIDORMAP_BUILD_H_
 
+#include <stddef.h> // size_t
 #include "corridormap/build_types.h"
 #include "corridormap/runtime_types.h"
 
 namespace corridormap { class Memory; }
 namespace corridormap { class Renderer; }
+namespace corridormap { class Scheduler; }
 
 namespace corridormap {
 
@@ -42,32 +44,93 @@ float max_distance(Bbox2 bounds);
 // computes required number of triangles to represent a distance mesh for point (cone).
 int distance_mesh_tris_for_point(float max_dist, float max_error);
 
-// computes an upper bound on number of vertices required for distance mesh.
-int max_distance_mesh_verts(const Footprint& f, float max_dist, float max_error);
+// computes an upper bound on number of vertices required for distance mesh, with optional per segment radii.
+int max_distance_mesh_verts(const Footprint& f, float max_dist, float max_error, const float* radii=0);
+
+// computes conservative radii of the distance mesh segments (polygons, then bottom, right, top and left border sides)
+// from a coarse width x height nearest obstacle image, such that every point in bounds is still covered by its closest segment.
+// radii are at most max_dist, a smaller mesh needs fewer cone triangles and less fill rate.
+void build_distance_mesh_radii(Scheduler* scheduler, Memory* scratch, const Footprint& obstacles, Bbox2 bounds,
+                               float max_dist, float max_error, int width, int height, float* radii);
 
 // build distance mesh for the input footprint. polygon vertex becomes a cone sector, edge - a "tent".
-void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, float max_error, Distance_Mesh& out);
+// segment i extends to radii[i] if radii is set, otherwise all segments extend to max_dist.
+void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, float max_error, Distance_Mesh& out, const float* radii=0);
+
+// number of triangles per turn of the cone template, enough for the largest segment radius.
+int distance_mesh_cone_tris(const Footprint& f, float max_dist, float max_error, const float* radii=0);
+
+// build indexed distance mesh, out is allocated with allocate_distance_mesh_indexed for the footprint and distance_mesh_cone_tris.
+// obstacle vertices are shared by caps and tents, each vertex gets a cone template instance covering its sector.
+void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, Distance_Mesh_Indexed& out, const float* radii=0);
 
 // renders distance mesh using the specified render interface.
 void render_distance_mesh(Renderer* render_iface, const Distance_Mesh& mesh);
 
+// renders indexed distance mesh in one batch using the specified render interface.
+void render_distance_mesh(Renderer* render_iface, const Distance_Mesh_Indexed& mesh);
+
 // debug: sets color of a segment to colors[segment_index % ncolors].
 void set_segment_colors(Distance_Mesh& mesh, unsigned int* colors, int ncolors);
+void set_segment_colors(Distance_Mesh_Indexed& mesh, unsigned int* colors, int ncolors);
+
+// alternative to rendering the distance mesh: approximates the image of closest segment indices on cpu (feature transform).
+// distances are measured to the centres of rasterized boundary pixels, so a few feature points can move by a pixel
+// compared to the rendered image. pixels is width*height*4 bytes, in the same layout as Renderer::read_pixels output.
+// scheduler can be null.
+void build_obstacle_id_image(Scheduler* scheduler, Memory* scratch, const Footprint& obstacles, Bbox2 bounds, int width, int height, unsigned char* pixels);
+
+// window of the image of closest segment indices (pixels, computed for old_obstacles) which can change after changed_polys moved
+// to their positions in obstacles. tolerance is the error of the image distances, e.g. twice the max error of the rendered distance mesh.
+// the window is grown from the changed polygons, the rest of the image isn't visited. the number of polygons must be the same,
+// as border segment indices follow the polygons.
+Grid_Window obstacle_id_update_window(Memory* scratch, const Footprint& old_obstacles, const Footprint& obstacles, const int* changed_polys, int num_changed,
+                                      Bbox2 bounds, int width, int height, const unsigned char* pixels, float tolerance);
+
+// updates the image of closest segment indices after changed_polys moved from their positions in old_obstacles to obstacles.
+// the dirty window is recomputed with the same transform as build_obstacle_id_image, seeded from the band around it which
+// can hold the nearest segments, so the result matches a full build. the number of polygons must be the same.
+// returns the window containing modified pixels and cells of the changed polygons. scheduler can be null.
+Grid_Window update_obstacle_id_image(Scheduler* scheduler, Memory* scratch, const Footprint& old_obstacles, const Footprint& obstacles,
+                                     const int* changed_polys, int num_changed, Bbox2 bounds, int width, int height, unsigned char* pixels);
 
 // CPU version of feature detection: reads the contents of frame buffer from video memory.
-Voronoi_Features detect_voronoi_features(Memory* memory, Memory* scratch, Renderer* render_iface);
+Voronoi_Features detect_voronoi_features(Memory* memory, Memory* scratch, Renderer* render_iface, Scheduler* scheduler=0);
+
+// streaming version of feature detection: reads rows_per_read rows at a time with Renderer::read_rows,
+// scratch memory is O(width*rows_per_read) instead of the full image copy.
+// falls back to a full image copy with Renderer::read_pixels if the renderer doesn't implement read_rows.
+Voronoi_Features stream_voronoi_features(Memory* memory, Memory* scratch, Renderer* render_iface, int rows_per_read=16);
+
+// starts incremental feature detection of width x height image. features and the last row are allocated from memory.
+Voronoi_Feature_Stream begin_detect_voronoi_features(Memory* memory, int width, int height);
+// detects features in the next num_rows rows of the image (num_rows*width*4 bytes), only the last row is kept between calls.
+void detect_voronoi_features(Voronoi_Feature_Stream& stream, const unsigned char* rows, int num_rows);
+// returns features detected in the consumed rows and releases the stream, features are owned by stream memory.
+Voronoi_Features end_detect_voronoi_features(Voronoi_Feature_Stream& stream);
+
+// CPU version of feature detection on the image of closest segment indices (width*height*4 bytes).
+// single vectorized pass over the image, split into row bands processed by the scheduler (can be null).
+Voronoi_Features detect_voronoi_features(Memory* memory, Memory* scratch, const unsigned char* pixels, int width, int height, Scheduler* scheduler=0);
 
-// go over all edges in the input footprint and compute normals for each.
+// go over all edges in the input footprint and compute normals for each, and the bisectors of normals at each vertex.
 void build_footprint_normals(const Footprint& in, Bbox2 bounds, Footprint_Normals& out);
 
+// number of edge tree nodes for the footprint.
+int footprint_edge_tree_nodes(const Footprint& f);
+
+// groups edges of each large footprint polygon into a bounding volume hierarchy.
+void build_footprint_edge_tree(const Footprint& in, Footprint_Edge_Tree& out);
+
 // if edge point lies in vector space spanned by two consecutive normals assign first normal's index. otherwise keep zero.
+// edge points are split between scheduler threads, scheduler can be null.
 void build_edge_spans(const Voronoi_Features& features, const Footprint& obstacles,
-                      const Footprint_Normals& normals, Bbox2 bounds, Voronoi_Edge_Spans& out);
+                      const Footprint_Normals& normals, Bbox2 bounds, Voronoi_Edge_Spans& out, Scheduler* scheduler=0);
 
 // build CSR (Compressed Sparse Row) grid representation from row-major list of non-zero element coordinates.
 void build_csr(const unsigned int* nz_coords, CSR_Grid& out);
 
-// index in array of non-zero cells or grid.num_nz if the cell is zero.
+// index in array of non-zero cells or grid.num_nz if the cell is zero. O(1) rank query on occupancy bitmap.
 int nz(const CSR_Grid& grid, int row, int col);
 
 // index in array of non-zero cells or grid.num_nz if the cell is zero. linear_index = row * num_cols + col.
@@ -82,12 +145,62 @@ CSR_Grid_Neis cell_neis(const CSR_Grid& grid, int linear_index);
 // go over pixels to find edges between voronoi vertices and event points on those egdes (the edge points where closest obstacles change).
 // also arrange edge obstacle ids in edge_normal_indices and Voronoi_Features such that if two edge points a and b are on the same edge,
 // side_1[a] == side_1[b] and side_2[a] == side_2[b].
+// edges are walked from every vertex, each edge point belongs to the walk from the earliest vertex in Voronoi_Features::verts
+// passing it, and an edge is kept if its walk owns all of its points. edges are ordered by their start vertex.
 void trace_edges(Memory* scratch, const CSR_Grid& vertices, const CSR_Grid& edges,
                  Voronoi_Edge_Spans& edge_normal_indices, Voronoi_Features& features, Voronoi_Traced_Edges& out);
 
+// multithreaded version of trace_edges: vertices are walked in parallel, the output is the same as the serial version
+// for any number of threads. scheduler can be null.
+void trace_edges(Memory* scratch, Scheduler* scheduler, const CSR_Grid& vertices, const CSR_Grid& edges,
+                 Voronoi_Edge_Spans& edge_normal_indices, Voronoi_Features& features, Voronoi_Traced_Edges& out);
+
+// trace_edges which also keeps walk ownership in state for update_traced_edges.
+void trace_edges(Memory* scratch, Scheduler* scheduler, const CSR_Grid& vertices, const CSR_Grid& edges,
+                 Voronoi_Edge_Spans& edge_normal_indices, Voronoi_Features& features, Voronoi_Traced_Edges& out,
+                 Voronoi_Trace_State& state);
+
+// retraces only walks which start or pass near in.feature_window, the rest is copied from the previous trace in in.
+// the result is the same as trace_edges on the new grids. returns false if a point of an unchanged walk is claimed
+// by a changed one and the owners can't be resolved locally, trace_edges has to be used then.
+bool update_traced_edges(Memory* scratch, Scheduler* scheduler, const Trace_Update_Params& in,
+                         const CSR_Grid& vertices, const CSR_Grid& edges, Voronoi_Edge_Spans& edge_normal_indices,
+                         Voronoi_Features& features, Voronoi_Traced_Edges& out, Voronoi_Trace_State& state);
+
 // the final step: assembles the medial axis graph annotated with closest obstacle information (i.e. Explicit Corridor Map).
 void build_walkable_space(const Walkable_Space_Build_Params& in, Walkable_Space& out);
 
+// walkable space items of the traced edges and vertices after build_walkable_space.
+void walkable_space_items(Memory* scratch, const Walkable_Space_Build_Params& in, Walkable_Space_Items& items);
+
+// updates out built from the previous trace in old: edges with a source in state.edge_sources which are pruned the same way
+// keep their items, the rest is released and created again. returns false without modifying out if its pools are too small.
+bool update_walkable_space(Memory* scratch, const Walkable_Space_Build_Params& in, const Voronoi_Trace_State& state,
+                           const Trace_Update_Params& old, const Walkable_Space_Items& old_items, Walkable_Space& out, Walkable_Space_Items& items);
+
+// creates build context. memory is taken from mem in blocks of block_size bytes and reused by subsequent builds.
+Build_Context create_build_context(Memory* mem, size_t block_size=1 << 20);
+// destroy build context.
+void destroy(Build_Context& ctx);
+
+// runs all build stages for the footprint. out must be zero-initialized or produced by a previous call with the same context,
+// it's reallocated only if its capacity is insufficient. rebuilding a map of the same size doesn't allocate.
+void build_corridor_map(Build_Context& ctx, const Footprint& footprint, const Build_Params& params, Walkable_Space& out);
+
+// updates the corridor map after the polygons listed in changed_polys were moved or reshaped.
+// requires a previous build with the same context and params, map bounds are kept. adding or removing polygons
+// shifts the indices of the border segments in the whole image, the map is rebuilt with build_corridor_map then.
+// only the dirty window of the obstacle id image is recomputed and re-detected, and only walks passing near it are retraced.
+// edges and vertices of out which didn't change keep their indices, the rest is deallocated and allocated again in the pools,
+// which grow if needed. if a retraced walk takes points of an unchanged one, all edges are retraced and matched by position.
+void update_corridor_map(Build_Context& ctx, const Footprint& footprint, const int* changed_polys, int num_changed,
+                         const Build_Params& params, Walkable_Space& out);
+
+// builds the corridor map of a large world tile by tile, tiles are independent and built in parallel when scheduler is set.
+// each tile graph is clipped to the tile, edges crossing a seam are split by a vertex on the seam shared by both tiles.
+// the result is allocated from memory, release with destroy(memory, space).
+Walkable_Space build_tiled_corridor_map(Memory* memory, const Footprint& footprint, const Tiled_Build_Params& params);
+
 }
 
 #endif
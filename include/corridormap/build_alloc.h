@@ -31,18 +31,26 @@ namespace corridormap { class Memory; }
 namespace corridormap {
 
 Distance_Mesh allocate_distance_mesh(Memory* mem, int num_obstacle_polys, int max_verts);
+Distance_Mesh_Indexed allocate_distance_mesh_indexed(Memory* mem, int num_obstacle_polys, int num_obstacle_verts, int num_cone_tris);
 Voronoi_Features allocate_voronoi_features(Memory* mem, int grid_width, int grid_height, int num_vert_points, int num_edge_points);
 Footprint_Normals allocate_foorprint_normals(Memory* mem, int num_polygons, int num_poly_verts);
+Footprint_Edge_Tree allocate_footprint_edge_tree(Memory* mem, int num_polygons, int num_nodes);
 Voronoi_Edge_Spans allocate_voronoi_edge_spans(Memory* mem, int num_edge_points);
 CSR_Grid allocate_csr_grid(Memory* mem, int num_rows, int num_cols, int num_non_zero);
-Voronoi_Traced_Edges allocate_voronoi_traced_edges(Memory* mem, int num_voronoi_verts, int num_footprint_verts);
+Voronoi_Traced_Edges allocate_voronoi_traced_edges(Memory* mem, int num_voronoi_verts, int num_edge_points);
+Voronoi_Trace_State allocate_voronoi_trace_state(Memory* mem, int num_voronoi_verts, int num_edge_points);
+Walkable_Space_Items allocate_walkable_space_items(Memory* mem, int num_voronoi_verts);
 
 void deallocate(Memory* mem, Distance_Mesh& mesh);
+void deallocate(Memory* mem, Distance_Mesh_Indexed& mesh);
 void deallocate(Memory* mem, Voronoi_Features& features);
 void deallocate(Memory* mem, Footprint_Normals& normals);
+void deallocate(Memory* mem, Footprint_Edge_Tree& tree);
 void deallocate(Memory* mem, Voronoi_Edge_Spans& spans);
 void deallocate(Memory* mem, CSR_Grid& grid);
 void deallocate(Memory* mem, Voronoi_Traced_Edges& edges);
+void deallocate(Memory* mem, Voronoi_Trace_State& state);
+void deallocate(Memory* mem, Walkable_Space_Items& items);
 
 }
 
@@ -33,6 +33,10 @@ namespace corridormap {
 // inits library's opencl runtime from render interface shared context, creates opencl command queue.
 Opencl_Runtime init_opencl_runtime(const Renderer::Opencl_Shared& shared);
 
+// inits library's opencl runtime on its own context without renderer sharing, e.g. on a cpu device of pocl.
+// uses the first device of device_type found on any platform. runtime.queue is null on failure.
+Opencl_Runtime init_opencl_runtime(cl_device_type device_type=CL_DEVICE_TYPE_ALL);
+
 // releases opencl objects.
 void term_opencl_runtime(Opencl_Runtime& runtime);
 
@@ -42,17 +46,33 @@ const char* get_kernel_source(Kernel_Id id);
 // creates and compiles library's opencl kernels.
 Compilation_Status build_kernels(Opencl_Runtime& runtime);
 
-// marks voronoi vertices and egdes in runtime.voronoi_vertices_img and voronoi_edges_img from voronoi_image.
+// same as above, but loads program binaries from cache_dir when they match device, driver and kernel source,
+// otherwise compiles from source and saves binaries there. cache_dir must exist, scratch holds binaries while loading.
+Compilation_Status build_kernels(Opencl_Runtime& runtime, Memory* scratch, const char* cache_dir);
+
+// marks voronoi vertices and egdes in runtime.voronoi_marks_buf from voronoi_image.
+// feature images and buffers are kept in runtime and recreated only when the image size changes.
+// mark, compact and store are enqueued asynchronously as a chain of events ending in runtime.features_event.
 cl_int mark_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image);
-// draw marks back to original voronoi image.
-cl_int debug_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image, cl_mem marks_image, unsigned int color, unsigned int border);
+// draw marks with Voronoi_Mark bit mark back to original voronoi image.
+cl_int debug_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image, unsigned int mark, unsigned int color, unsigned int border);
 // compact voronoi features on gpu, storing results in runtime.voronoi_vertices_compacted_buf and runtime.voronoi_edges_compacted_buf buffers.
+// both kinds of marks are compacted by a single pass scan in one dispatch, counts stay on device for store_obstacle_ids.
 cl_int compact_voronoi_features(Opencl_Runtime& runtime);
 // store obstacle ids (colors) for vertices and edge points in compact arrays.
 cl_int store_obstacle_ids(Opencl_Runtime& runtime, cl_mem voronoi_image);
+// waits for the enqueued feature chain. runtime.voronoi_vertex_mark_count and voronoi_edge_mark_count are valid after it.
+cl_int wait_voronoi_features(Opencl_Runtime& runtime);
 // copy computed data from opencl device memory.
 cl_int transfer_voronoi_features(Opencl_Runtime& runtime, Voronoi_Features& features);
 
+// uploads host image of closest segment indices (width*height*4 bytes, e.g. from a cpu renderer or build_obstacle_id_image)
+// to an opencl image in the same format as a shared render target. release with clReleaseMemObject.
+cl_mem create_voronoi_image(Opencl_Runtime& runtime, const unsigned char* pixels, int width, int height, cl_int* error_code);
+
+// runs the feature kernels on the host image and transfers the result to features allocated from memory.
+cl_int detect_voronoi_features(Opencl_Runtime& runtime, Memory* memory, const unsigned char* pixels, int width, int height, Voronoi_Features& out);
+
 }
 
 #endif
@@ -34,6 +34,13 @@ enum Kernel_Id
     kernel_id_count,
 };
 
+// Bits of voronoi_marks_buf elements.
+enum Voronoi_Mark
+{
+    voronoi_mark_vertex = 1,
+    voronoi_mark_edge   = 2,
+};
+
 // Holds opencl api objects used by the library.
 struct Opencl_Runtime
 {
@@ -43,19 +50,19 @@ struct Opencl_Runtime
     cl_command_queue queue;
     // opencl device.
     cl_device_id device;
+    // context is created by the runtime (not shared with a renderer) and released by term_opencl_runtime.
+    bool owns_context;
     // array of kernel objects used by the library.
     cl_kernel kernels[kernel_id_count];
     // array of kernel programs.
     cl_program programs[kernel_id_count];
 
-    // 2d image with voronoi vertices marked.
-    cl_mem voronoi_vertices_img;
-    // 2d image with voronoi edges marked.
-    cl_mem voronoi_edges_img;
+    // one byte per pixel of voronoi image with Voronoi_Mark bits set.
+    cl_mem voronoi_marks_buf;
 
-    // compactly stores indices of non-zero elements in voronoi_vertices_img.
+    // compactly stores indices of voronoi_marks_buf elements marked as vertices.
     cl_mem voronoi_vertices_compacted_buf;
-    // compactly indices of non-zero elements in voronoi_edges_img.
+    // compactly stores indices of voronoi_marks_buf elements marked as edges.
     cl_mem voronoi_edges_compacted_buf;
 
     // stores one side obstacle id (color) for each edge point from voronoi_edges_compacted_buf.
@@ -63,10 +70,19 @@ struct Opencl_Runtime
     // stores one side obstacle id (color) for each edge point from voronoi_edges_compacted_buf.
     cl_mem voronoi_edge_ids_2;
 
-    // temp buffer.
-    cl_mem compaction_sums_buf;
-    // temp buffer.
-    cl_mem compaction_offsets_buf;
+    // tile states of the single pass compaction, two sets used in turns by consecutive builds.
+    cl_mem compaction_state_buf;
+    // vertex and edge counts written by compaction.
+    cl_mem compaction_counts_buf;
+    // selects the set of compaction_state_buf used by the next compaction.
+    cl_uint compaction_parity;
+
+    // size of feature images, compacted and id buffers hold width*height elements and are reused across builds.
+    size_t features_width;
+    size_t features_height;
+
+    // last event of the enqueued mark -> compact -> store chain, each stage waits on it.
+    cl_event features_event;
 
     // number of voronoi vertices.
     cl_uint voronoi_vertex_mark_count;
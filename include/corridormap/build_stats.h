@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// optional instrumentation of the build stages.
+// define CORRIDORMAP_CONFIG_BUILD_STATS to enable, otherwise scope and counter macros compile to nothing.
+
+#ifndef CORRIDORMAP_BUILD_STATS_H_
+#define CORRIDORMAP_BUILD_STATS_H_
+
+#include <stddef.h> // size_t
+#include "corridormap/memory.h"
+
+namespace corridormap {
+
+// Instrumented build stages.
+enum Build_Stage
+{
+    build_stage_distance_mesh = 0,
+    build_stage_render_distance_mesh,
+    build_stage_obstacle_id_image,
+    build_stage_detect_features,
+    build_stage_opencl_kernels,
+    build_stage_edge_spans,
+    build_stage_csr,
+    build_stage_trace_edges,
+    build_stage_walkable_space,
+    build_stage_stitch_tiles,
+    num_build_stages,
+};
+
+// called when the stage scope is entered.
+typedef void (*Build_Scope_Begin)(void* user_data, Build_Stage stage, const char* name);
+// called when the stage scope is left, seconds is the wall time spent in the scope.
+typedef void (*Build_Scope_End)(void* user_data, Build_Stage stage, const char* name, double seconds);
+
+// Statistics accumulated by build stages running on the thread the stats are set for.
+struct Build_Stats
+{
+    // wall time spent in each stage, seconds.
+    double stage_time[num_build_stages];
+    // number of times each stage was run.
+    int stage_calls[num_build_stages];
+    // peak of current_bytes while the stage was running.
+    size_t stage_peak_bytes[num_build_stages];
+    // distance mesh vertices.
+    int num_mesh_verts;
+    // detected voronoi vertex points.
+    int num_vert_points;
+    // detected voronoi edge points.
+    int num_edge_points;
+    // traced voronoi edges.
+    int num_traced_edges;
+    // traced edge events.
+    int num_events;
+    // vertices, edges and events removed from the walkable space by pruning.
+    int num_pruned_verts;
+    int num_pruned_edges;
+    int num_pruned_events;
+    // tiled build: vertices created where edges cross tile seams, and those left without a pair in the neighbour tile.
+    int num_seam_verts;
+    int num_unmatched_seam_verts;
+    // bytes currently allocated through Memory_Tracking.
+    size_t current_bytes;
+    // peak of current_bytes.
+    size_t peak_bytes;
+    // peak of current_bytes within the innermost active scope.
+    size_t scope_peak_bytes;
+    // optional callbacks, e.g. to forward stage scopes to an external profiler.
+    Build_Scope_Begin scope_begin;
+    Build_Scope_End scope_end;
+    void* user_data;
+};
+
+// clears statistics, callbacks are kept.
+void reset(Build_Stats& stats);
+// sets stats filled by the build stages running on the calling thread, null disables collection.
+void set_build_stats(Build_Stats* stats);
+// stats set for the calling thread.
+Build_Stats* get_build_stats();
+// name of the stage.
+const char* stage_name(Build_Stage stage);
+
+// Forwards allocations to the parent memory and tracks allocated bytes in Build_Stats. not thread safe.
+class Memory_Tracking : public Memory
+{
+public:
+    Memory_Tracking(Memory* parent, Build_Stats* stats);
+
+    virtual void* allocate(size_t size, size_t align);
+    virtual void  deallocate(void* ptr);
+
+private:
+    Memory* _parent;
+    Build_Stats* _stats;
+};
+
+// Times the enclosing scope and reports it to the stats of the calling thread.
+class Build_Scope
+{
+public:
+    explicit Build_Scope(Build_Stage stage);
+    ~Build_Scope();
+
+private:
+    Build_Stats* _stats;
+    Build_Stage _stage;
+    double _start;
+    size_t _outer_peak_bytes;
+};
+
+}
+
+#ifdef CORRIDORMAP_CONFIG_BUILD_STATS
+    #define CORRIDORMAP_BUILD_STATS_CONCAT_(a, b) a##b
+    #define CORRIDORMAP_BUILD_STATS_CONCAT(a, b) CORRIDORMAP_BUILD_STATS_CONCAT_(a, b)
+    // times the rest of the enclosing scope as the specified stage.
+    #define corridormap_build_scope(stage) corridormap::Build_Scope CORRIDORMAP_BUILD_STATS_CONCAT(build_scope_, __LINE__)(stage)
+    // adds value to the counter field of the calling thread stats.
+    #define corridormap_build_count(field, value) do { if (corridormap::Build_Stats* s = corridormap::get_build_stats()) { s->field += (value); } } while ((void)(__LINE__==-1), false)
+#else
+    #define corridormap_build_scope(stage) do { (void)sizeof(stage); } while ((void)(__LINE__==-1), false)
+    #define corridormap_build_count(field, value) do { (void)sizeof(value); } while ((void)(__LINE__==-1), false)
+#endif
+
+#endif
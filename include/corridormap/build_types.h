@@ -26,6 +26,12 @@
 // Types used during construction of the corridor map.
 //
 
+namespace corridormap { class Memory; }
+namespace corridormap { class Memory_Arena; }
+namespace corridormap { class Memory_Stack; }
+namespace corridormap { class Renderer; }
+namespace corridormap { class Scheduler; }
+
 namespace corridormap {
 
 // Obstacles represented as a set of 2d convex polygons. Polys are expected to be in CCW order.
@@ -50,6 +56,15 @@ struct Bbox2
     float max[2];
 };
 
+// Inclusive rectangle of grid cells, empty if min > max.
+struct Grid_Window
+{
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+};
+
 // 3d vertex used for distance_mesh.
 struct Render_Vertex
 {
@@ -78,6 +93,49 @@ struct Distance_Mesh
     unsigned int* segment_colors;
 };
 
+// Instance of the unit cone template placed at an obstacle vertex.
+struct Cone_Instance
+{
+    // apex position.
+    float x;
+    float y;
+    // template is scaled by radius in all three dimensions.
+    float radius;
+    // template triangles [first_tri, first_tri + num_tris) cover the cone sector.
+    int first_tri;
+    int num_tris;
+};
+
+// Distance mesh with shared vertices: polygon caps and tents are indexed triangles, cones are instances of the unit cone template.
+struct Distance_Mesh_Indexed
+{
+    // the number of segments.
+    int num_segments;
+    // the total number of vertices.
+    int num_verts;
+    // the total number of indices.
+    int num_indices;
+    // the total number of cone instances.
+    int num_instances;
+    // vertex array indexed in [0..num_verts) range.
+    Render_Vertex* verts;
+    // triangle list of vertex indices, triangles of a segment are consecutive. [0..num_indices).
+    unsigned int* indices;
+    // the number of indices per segment. indexed in [0..num_segments) range.
+    int* num_segment_indices;
+    // cone instances, instances of a segment are consecutive. [0..num_instances).
+    Cone_Instance* instances;
+    // the number of cone instances per segment. indexed in [0..num_segments) range.
+    int* num_segment_instances;
+    // segment colors. indexed in [0..num_segments) range.
+    unsigned int* segment_colors;
+    // the number of triangles in a full turn of the cone template.
+    int num_cone_tris;
+    // cone template triangle list, apex is at origin, rim is the unit circle at z = 1. triangle k spans angles [k, k + 1]*2pi/num_cone_tris.
+    // the turn is stored twice (num_cone_tris*2*3 vertices), so instance triangle ranges don't wrap.
+    Render_Vertex* cone_verts;
+};
+
 // Voronoi diagram vertices and edges detected from the distance mesh render.
 struct Voronoi_Features
 {
@@ -99,6 +157,21 @@ struct Voronoi_Features
     unsigned int* edge_obstacle_ids_2;
 };
 
+// State of incremental feature detection, image rows are consumed from the bottom (row 0) up.
+struct Voronoi_Feature_Stream
+{
+    // memory of the features and the last row.
+    Memory* memory;
+    // the number of rows consumed so far.
+    int num_rows;
+    // copy of the last consumed row, grid_width pixels.
+    unsigned int* last_row;
+    // features detected so far, arrays grow as needed.
+    Voronoi_Features features;
+    int vert_capacity;
+    int edge_capacity;
+};
+
 // Obstacle polygon edge normals.
 struct Footprint_Normals
 {
@@ -114,6 +187,28 @@ struct Footprint_Normals
     int* num_obstacle_normals;
     // offsets in x, y arrays for each poly, indexed in [0..num_obstacles) range.
     int* obstacle_normal_offsets;
+    // bisector of the normals of two edges incident to each polygon vertex, indexed like footprint vertices.
+    float* bisector_x;
+    float* bisector_y;
+    // c*|c|, where c is the cosine between the bisector and the edge normals.
+    // point p is in the span of vertex v if d*|d| >= threshold*|p - v|^2, where d = dot(p - v, bisector).
+    float* bisector_threshold;
+};
+
+// Bounding volume hierarchy over the edges of each footprint polygon, accelerates closest point queries on large polygons.
+// leaves group consecutive edges in polygon order, each level above halves the number of nodes.
+struct Footprint_Edge_Tree
+{
+    // the number of polygons.
+    int num_polys;
+    // total number of nodes.
+    int num_nodes;
+    // first node of each polygon, indexed in [0..num_polys) range.
+    int* poly_node_offsets;
+    // number of leaves of each polygon, 0 if the polygon is small enough to be queried by brute force.
+    int* poly_num_leaves;
+    // node bounds: min x, min y, max x, max y. leaves of a polygon go first, then the nodes of each level up to the root.
+    float* node_bounds;
 };
 
 // For each edge point and each side stores vertex_index+1 if the edge point is in the space spanned
@@ -130,8 +225,12 @@ struct Voronoi_Edge_Spans
     int* indices_2;
 };
 
+// number of cells per word of CSR_Grid occupancy bitmap.
+enum { csr_occupancy_word_bits = 32 };
+
 // Compressed-Sparse-Row format for boolean grid,
 // used as a fast lookup of voronoi features during tracing.
+// occupancy bitmap with per-word rank gives O(1) lookup of non-zero cell index.
 struct CSR_Grid
 {
     // number of rows in the grid.
@@ -144,6 +243,12 @@ struct CSR_Grid
     int* column;
     // columns of the row R: row_offset[R] .. row_offset[R+1]. indexed in [0 .. num_rows + 1).
     int* row_offset;
+    // bit per cell (linear index y*num_cols + x), set for non-zero cells. indexed in [0 .. num_occupancy_words).
+    unsigned int* occupancy;
+    // number of non-zero cells before each occupancy word. indexed in [0 .. num_occupancy_words).
+    int* occupancy_rank;
+    // (num_rows*num_cols + csr_occupancy_word_bits - 1) / csr_occupancy_word_bits.
+    int num_occupancy_words;
 };
 
 // Rendered distance mesh is a 4-connected grid.
@@ -187,12 +292,56 @@ struct Voronoi_Traced_Edges
     int* events;
 };
 
+// Walks and edge point owners of the last trace, let update_traced_edges retrace only the walks near a changed window.
+// walk index is vertex*max_grid_neis + i, the walk starts at the i-th edge neighbour of Voronoi_Features::verts[vertex].
+struct Voronoi_Trace_State
+{
+    // number of walks (num_vert_points*max_grid_neis).
+    int num_walks;
+    // number of edge points.
+    int num_points;
+    // index of the traced edge, -1 if the walk didn't produce one. [0 .. num_walks).
+    int* walk_edges;
+    // number of points passed by the walk if it reached a vertex, 0 otherwise. [0 .. num_walks).
+    int* walk_points;
+    // bounding window of the walk path. [0 .. num_walks).
+    Grid_Window* walk_windows;
+    // walk*2 + side swap bit of the smallest walk passing the point among walks which reached a vertex, -1 if none. [0 .. num_points).
+    int* point_owners;
+    // number of passes of walks which reached a vertex. [0 .. num_points).
+    int* point_visits;
+    // index of the same edge in the previous trace, -1 if the edge is new. [0 .. num_edges).
+    int* edge_sources;
+};
+
+// Input of update_traced_edges: the last trace and the window of features detected since.
+struct Trace_Update_Params
+{
+    // window of re-detected features.
+    Grid_Window feature_window;
+    // 1 for ids of changed obstacles, edges along them are never the same as before. [0 .. num_polys + num_border_segments + 1).
+    const unsigned char* changed_ids;
+    // grids, features and spans of the last trace, sides arranged by it.
+    CSR_Grid* vertex_grid;
+    CSR_Grid* edge_grid;
+    Voronoi_Features* features;
+    Voronoi_Edge_Spans* spans;
+    Voronoi_Traced_Edges* traced_edges;
+    Voronoi_Trace_State* state;
+    // last vertex index -> index of the new vertex in the same cell, -1 if there is none.
+    const int* vertex_map;
+    // last edge point index -> new edge point index, -1 if the point is inside feature_window.
+    const int* point_map;
+};
+
 // Helper struct to pass input data to the final assembly of the walkable space structure.
 struct Walkable_Space_Build_Params
 {
     Bbox2 bounds;
     Footprint* obstacles;
     Footprint_Normals* obstacle_normals;
+    // optional, closest points on obstacles are found by testing all edges if null.
+    Footprint_Edge_Tree* obstacle_edge_tree;
     Voronoi_Features* features;
     Voronoi_Traced_Edges* traced_edges;
     Voronoi_Edge_Spans* spans;
@@ -200,6 +349,91 @@ struct Walkable_Space_Build_Params
     CSR_Grid* vertex_grid;
 };
 
+// Maps the traced graph to the items of the walkable space, lets update_walkable_space splice only the changed edges.
+struct Walkable_Space_Items
+{
+    // how pruning of dead ends changed the traced edge, 0 if it didn't. [0 .. num_edges).
+    unsigned char* edge_prune;
+    // walkable space edge index*2 + 1 if the edge is reversed there, -1 if it was pruned. [0 .. num_edges).
+    int* edges;
+    // walkable space vertex index, -1 if it was pruned. [0 .. num_vert_points).
+    int* vertices;
+};
+
+// Parameters of the build_corridor_map driver.
+struct Build_Params
+{
+    // rasterization grid width.
+    int grid_width;
+    // rasterization grid height.
+    int grid_height;
+    // border added around the obstacle bounds (when renderer is null).
+    float border;
+    // max distance mesh error (when renderer is not null).
+    float max_error;
+    // if non-zero, distance mesh radii are bounded with build_distance_mesh_radii on a grid of this many cells
+    // along the larger side (when renderer is not null). otherwise every segment extends to max_distance.
+    int mesh_radius_cells;
+    // optional renderer initialized with the grid size and map bounds.
+    // if null, nearest obstacle image is computed on cpu with build_obstacle_id_image.
+    Renderer* renderer;
+    // optional scheduler for the multithreaded stages.
+    Scheduler* scheduler;
+    // optional map bounds (when renderer is null), by default obstacle bounds plus border fitted to the grid aspect.
+    const Bbox2* bounds;
+};
+
+// Parameters of build_tiled_corridor_map.
+struct Tiled_Build_Params
+{
+    // world bounds, split into square tiles starting at bounds.min.
+    Bbox2 bounds;
+    // side of a tile.
+    float tile_size;
+    // tile is built with obstacles up to overlap outside of it. medial axis is exact where clearance is less than overlap.
+    // must be greater than 4*cell_size (seam matching tolerance). tiles with edges which don't match across a seam
+    // are rebuilt with a doubled overlap, so a value above the typical clearance along the seams saves rebuilds.
+    float overlap;
+    // size of a rasterization grid cell, the same for all tiles.
+    float cell_size;
+    // optional scheduler, tiles are built in parallel.
+    Scheduler* scheduler;
+};
+
+// Buffers kept across build_corridor_map and update_corridor_map calls. intermediates are valid until the next build.
+struct Build_Context
+{
+    // memory the context and the output walkable space are allocated from.
+    Memory* memory;
+    // two sets of intermediate buffers released in bulk. an update reads the intermediates of the previous build
+    // from the current frame and writes the new ones to the other frame.
+    Memory_Arena* frames[2];
+    // index of the frame holding the intermediates of the last build.
+    int frame;
+    // temporary allocations of the build stages.
+    Memory_Stack* scratch;
+    // rasterization grid size of the last build.
+    int grid_width;
+    int grid_height;
+    // map bounds of the last build.
+    Bbox2 bounds;
+    // nearest obstacle id image of the last build (grid_width*grid_height*4 bytes), updated in place.
+    unsigned char* pixels;
+    // copy of the footprint of the last build.
+    Footprint footprint;
+    // intermediates of the last build.
+    Footprint_Normals normals;
+    Footprint_Edge_Tree edge_tree;
+    Distance_Mesh_Indexed mesh;
+    Voronoi_Features features;
+    Voronoi_Edge_Spans spans;
+    CSR_Grid vertex_grid;
+    CSR_Grid edge_grid;
+    Voronoi_Traced_Edges traced_edges;
+    Voronoi_Trace_State trace_state;
+    Walkable_Space_Items space_items;
+};
+
 }
 
 #endif
@@ -21,7 +21,5 @@
 
 CORRIDORMAP_KERNEL_ID(mark_features)
 CORRIDORMAP_KERNEL_ID(mark_features_debug)
-CORRIDORMAP_KERNEL_ID(compaction_reduce)
-CORRIDORMAP_KERNEL_ID(compaction_scan_partials)
-CORRIDORMAP_KERNEL_ID(compaction_output)
+CORRIDORMAP_KERNEL_ID(compaction_fused)
 CORRIDORMAP_KERNEL_ID(store_edge_obstacle_ids)
@@ -43,6 +43,63 @@ public:
     virtual void  deallocate(void* ptr);
 };
 
+struct Memory_Block;
+
+// bump allocator over blocks taken from the parent memory. deallocate is a no-op, memory is released in bulk by reset.
+// blocks are kept across resets, so steady state usage doesn't touch the parent. not thread safe.
+class Memory_Arena : public Memory
+{
+public:
+    Memory_Arena(Memory* parent, size_t block_size);
+    virtual ~Memory_Arena();
+
+    virtual void* allocate(size_t size, size_t align);
+    virtual void  deallocate(void* ptr);
+
+    // release all allocations.
+    void reset();
+
+private:
+    Memory* _parent;
+    size_t _block_size;
+    Memory_Block* _first;
+    Memory_Block* _current;
+};
+
+// stack allocator over blocks taken from the parent memory. not thread safe.
+// memory of the top allocation is reclaimed on deallocate, allocations freed out of order are reclaimed once they reach the top.
+class Memory_Stack : public Memory
+{
+public:
+    // stack state at some point, allocations made after it are released by rewind.
+    struct Marker
+    {
+        void* top;
+        Memory_Block* block;
+        size_t used;
+    };
+
+    Memory_Stack(Memory* parent, size_t block_size);
+    virtual ~Memory_Stack();
+
+    virtual void* allocate(size_t size, size_t align);
+    virtual void  deallocate(void* ptr);
+
+    // current stack state.
+    Marker marker() const;
+    // release all allocations made after the marker.
+    void rewind(const Marker& marker);
+    // release all allocations.
+    void reset();
+
+private:
+    Memory* _parent;
+    size_t _block_size;
+    Memory_Block* _first;
+    Memory_Block* _current;
+    void* _top;
+};
+
 template <typename T>
 T* allocate(Memory* mem, size_t count, size_t align=sizeof(void*))
 {
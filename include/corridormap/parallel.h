@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CORRIDORMAP_PARALLEL_H_
+#define CORRIDORMAP_PARALLEL_H_
+
+namespace corridormap { class Memory; }
+
+namespace corridormap {
+
+// abstract job scheduler used to split build stages across threads.
+class Scheduler
+{
+public:
+    // processes work item with the specified index.
+    typedef void (*Job)(void* context, int index);
+
+    virtual ~Scheduler() {}
+
+    // number of threads (including the calling one) running jobs concurrently.
+    virtual int num_threads() = 0;
+    // calls job(context, i) for every i in [0..count), returns when all calls are finished.
+    // calls could run concurrently on different threads and in any order. not reentrant.
+    virtual void run(Job job, void* context, int count) = 0;
+};
+
+// runs all jobs on the calling thread.
+class Scheduler_Serial : public Scheduler
+{
+public:
+    virtual int num_threads();
+    virtual void run(Job job, void* context, int count);
+};
+
+// fixed pool of worker threads. work items are claimed one at a time, so uneven items are balanced between threads.
+class Scheduler_Threads : public Scheduler
+{
+public:
+    // num_threads=0 picks the number of hardware threads.
+    Scheduler_Threads(Memory* mem, int num_threads=0);
+    virtual ~Scheduler_Threads();
+
+    virtual int num_threads();
+    virtual void run(Job job, void* context, int count);
+
+private:
+    Scheduler_Threads(const Scheduler_Threads&);
+    Scheduler_Threads& operator=(const Scheduler_Threads&);
+
+    struct State;
+
+    Memory* _mem;
+    State* _state;
+};
+
+// runs job on the scheduler, or on the calling thread if scheduler is null.
+void parallel_for(Scheduler* scheduler, Scheduler::Job job, void* context, int count);
+
+// number of threads of the scheduler, 1 if scheduler is null.
+int num_threads(Scheduler* scheduler);
+
+}
+
+#endif
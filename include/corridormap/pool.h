@@ -37,15 +37,17 @@ void init(Pool<T>& lst)
     for (int i = 0; i < lst.max_items - 1; ++i)
     {
         lst.items[i].link = i + 1;
+        lst.prev[i] = null_idx;
     }
 
     lst.items[lst.max_items - 1].link = null_idx;
+    lst.prev[lst.max_items - 1] = null_idx;
 }
 
 template <typename T>
 T* allocate(Pool<T>& lst)
 {
-    if (lst.head_free == null_idx)
+    if (lst.head_free == int(null_idx))
     {
         return 0;
     }
@@ -55,15 +57,17 @@ T* allocate(Pool<T>& lst)
 
     lst.head_free = lst.items[lst.head_free].link;
 
-    if (lst.head == null_idx)
+    if (lst.head == int(null_idx))
     {
         lst.head = result_index;
         lst.tail = result_index;
         lst.items[result_index].link = null_idx;
+        lst.prev[result_index] = null_idx;
     }
     else
     {
         lst.items[lst.tail].link = result_index;
+        lst.prev[result_index] = lst.tail;
         lst.tail = result_index;
         lst.items[result_index].link = null_idx;
     }
@@ -77,35 +81,29 @@ template <typename T>
 void deallocate(Pool<T>& lst, T* item)
 {
     int idx = int(item - lst.items);
+    int prev_idx = lst.prev[idx];
+    int next_idx = item->link;
 
-    if (lst.head == idx)
+    if (prev_idx == int(null_idx))
     {
-        lst.head = item->link;
+        lst.head = next_idx;
+    }
+    else
+    {
+        lst.items[prev_idx].link = next_idx;
+    }
 
-        if (lst.tail == idx)
-        {
-            lst.tail = null_idx;
-        }
+    if (next_idx == int(null_idx))
+    {
+        lst.tail = prev_idx;
     }
     else
     {
-        for (int i = 0; i < lst.max_items; ++i)
-        {
-            if (lst.items[i].link == idx)
-            {
-                lst.items[i].link = item->link;
-
-                if (lst.tail == idx)
-                {
-                    lst.tail = i;
-                }
-
-                break;
-            }
-        }
+        lst.prev[next_idx] = prev_idx;
     }
 
     item->link = lst.head_free;
+    lst.prev[idx] = null_idx;
     lst.head_free = idx;
 
     lst.num_items--;
@@ -55,6 +55,35 @@ static const char* fragment_shader =
 "    out_color = const_color;                       \n"
 "}                                                  \n";
 
+// cone template instances: triangles outside of the instance sector are collapsed to the apex.
+static const char* cone_vertex_shader =
+"#version 330                                                                               \n"
+"uniform mat4 wvp;                                                                          \n"
+"layout(location = 0) in vec3 position;                                                     \n"
+"layout(location = 1) in vec3 instance_position;                                            \n"
+"layout(location = 2) in ivec2 instance_tris;                                               \n"
+"layout(location = 3) in uint instance_color;                                               \n"
+"flat out vec4 color;                                                                       \n"
+"                                                                                           \n"
+"void main()                                                                                \n"
+"{                                                                                          \n"
+"    int tri = gl_VertexID / 3;                                                             \n"
+"    bool inside = tri >= instance_tris.x && tri < instance_tris.x + instance_tris.y;      \n"
+"    vec3 p = inside ? position * instance_position.z : vec3(0.0);                          \n"
+"    gl_Position = wvp * vec4(instance_position.xy + p.xy, p.z, 1.0);                       \n"
+"    color = vec4((uvec4(instance_color) >> uvec4(24u, 16u, 8u, 0u)) & uvec4(255u)) / 255.0; \n"
+"}                                                                                          \n";
+
+static const char* cone_fragment_shader =
+"#version 330                                       \n"
+"flat in vec4 color;                                \n"
+"out vec4 out_color;                                \n"
+"                                                   \n"
+"void main()                                        \n"
+"{                                                  \n"
+"    out_color = color;                             \n"
+"}                                                  \n";
+
 static const char* debug_quad_vertex_shader =
 "#version 330                                       \n"
 "in vec3 position;                                  \n"
@@ -177,15 +206,27 @@ public:
         , _depth_buffer_texture(0)
         , _vertex_array(0)
         , _vertex_buffer(0)
+        , _index_buffer(0)
+        , _cone_vertex_array(0)
+        , _cone_buffer(0)
+        , _instance_buffer(0)
+        , _instance_color_buffer(0)
     {
         memset(&_draw_shader, 0, sizeof(shader));
+        memset(&_cone_shader, 0, sizeof(shader));
         memset(&_debug_quad_shader, 0, sizeof(shader));
     }
 
     virtual ~Renderer_GL()
     {
         destroy_shader(_draw_shader);
+        destroy_shader(_cone_shader);
         destroy_shader(_debug_quad_shader);
+        glDeleteBuffers(1, &_instance_color_buffer);
+        glDeleteBuffers(1, &_instance_buffer);
+        glDeleteBuffers(1, &_cone_buffer);
+        glDeleteVertexArrays(1, &_cone_vertex_array);
+        glDeleteBuffers(1, &_index_buffer);
         glDeleteBuffers(1, &_vertex_buffer);
         glDeleteVertexArrays(1, &_vertex_array);
         glDeleteTextures(1, &_depth_buffer_texture);
@@ -251,12 +292,21 @@ public:
 
         glGenVertexArrays(1, &_vertex_array);
         glGenBuffers(1, &_vertex_buffer);
+        glGenBuffers(1, &_index_buffer);
+
+        glGenVertexArrays(1, &_cone_vertex_array);
+        glGenBuffers(1, &_cone_buffer);
+        glGenBuffers(1, &_instance_buffer);
+        glGenBuffers(1, &_instance_color_buffer);
 
         // initialize shaders and shader parameters.
         _draw_shader = create_shader(vertex_shader, fragment_shader);
         _wvp_location = glGetUniformLocation(_draw_shader.program, "wvp");
         _color_location = glGetUniformLocation(_draw_shader.program, "const_color");
 
+        _cone_shader = create_shader(cone_vertex_shader, cone_fragment_shader);
+        _cone_wvp_location = glGetUniformLocation(_cone_shader.program, "wvp");
+
         // setup orthographic projection. projection is left-haded, camera is in zero looking in +z direction.
         {
             float l = params.min[0];
@@ -315,6 +365,93 @@ public:
     }
 
     virtual void draw(const Render_Vertex* vertices, unsigned tri_count, unsigned color)
+    {
+        set_color(color);
+        draw_array(vertices, tri_count);
+    }
+
+    virtual void draw_mesh(const Distance_Mesh_Indexed& mesh)
+    {
+        // vertices and indices are uploaded once, segments are drawn from the same buffers with their colors.
+        glBindVertexArray(_vertex_array);
+        glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh.num_verts*sizeof(Render_Vertex), mesh.verts, GL_STREAM_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _index_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.num_indices*sizeof(unsigned int), mesh.indices, GL_STREAM_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Render_Vertex), 0);
+
+        size_t index_offset = 0;
+
+        for (int i = 0; i < mesh.num_segments; ++i)
+        {
+            set_color(mesh.segment_colors[i]);
+            glDrawElements(GL_TRIANGLES, mesh.num_segment_indices[i], GL_UNSIGNED_INT, reinterpret_cast<const void*>(index_offset*sizeof(unsigned int)));
+            index_offset += mesh.num_segment_indices[i];
+        }
+
+        glDisableVertexAttribArray(0);
+
+        if (mesh.num_instances > 0)
+        {
+            draw_cones(mesh);
+        }
+
+        glBindVertexArray(0);
+    }
+
+    // all cone instances in one instanced draw, segment colors are expanded to per instance attribute.
+    void draw_cones(const Distance_Mesh_Indexed& mesh)
+    {
+        unsigned int* instance_colors = allocate<unsigned int>(_scratch_memory, mesh.num_instances);
+
+        for (int i = 0, k = 0; i < mesh.num_segments; ++i)
+        {
+            for (int j = 0; j < mesh.num_segment_instances[i]; ++j)
+            {
+                instance_colors[k++] = mesh.segment_colors[i];
+            }
+        }
+
+        glBindVertexArray(_cone_vertex_array);
+
+        glBindBuffer(GL_ARRAY_BUFFER, _cone_buffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh.num_cone_tris*2*3*sizeof(Render_Vertex), mesh.cone_verts, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Render_Vertex), 0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh.num_instances*sizeof(Cone_Instance), mesh.instances, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Cone_Instance), 0);
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribIPointer(2, 2, GL_INT, sizeof(Cone_Instance), reinterpret_cast<const void*>(3*sizeof(float)));
+        glVertexAttribDivisor(2, 1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, _instance_color_buffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh.num_instances*sizeof(unsigned int), instance_colors, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(unsigned int), 0);
+        glVertexAttribDivisor(3, 1);
+
+        glUseProgram(_cone_shader.program);
+        glUniformMatrix4fv(_cone_wvp_location, 1, GL_FALSE, _projection);
+
+        glDrawArraysInstanced(GL_TRIANGLES, 0, mesh.num_cone_tris*2*3, mesh.num_instances);
+
+        // cleanup.
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+        glDisableVertexAttribArray(2);
+        glDisableVertexAttribArray(3);
+        glUseProgram(_draw_shader.program);
+
+        _scratch_memory->deallocate(instance_colors);
+    }
+
+    void set_color(unsigned color)
     {
         // set color for fragment shader.
         glUniform4f(
@@ -323,8 +460,6 @@ public:
             ((color & 0x00ff0000) >> 16)/255.f,
             ((color & 0x0000ff00) >>  8)/255.f,
             ((color & 0x000000ff) >>  0)/255.f);
-
-        draw_array(vertices, tri_count);
     }
 
     void draw_array(const Render_Vertex* vertices, unsigned tri_count)
@@ -358,6 +493,16 @@ public:
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
+    virtual bool read_rows(int first_row, int num_rows, unsigned char* destination)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, _frame_buffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, first_row, params.render_target_width, num_rows, GL_RGBA, GL_UNSIGNED_BYTE, destination);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        return true;
+    }
+
     void blit_frame_buffer(int width, int height)
     {
         // enable back-buffer.
@@ -498,11 +643,21 @@ private:
 
     GLuint _vertex_array;
     GLuint _vertex_buffer;
+    GLuint _index_buffer;
+
+    // cone template and per instance buffers.
+    GLuint _cone_vertex_array;
+    GLuint _cone_buffer;
+    GLuint _instance_buffer;
+    GLuint _instance_color_buffer;
 
     shader _draw_shader;
     GLint  _wvp_location;
     GLint  _color_location;
 
+    shader _cone_shader;
+    GLint  _cone_wvp_location;
+
     shader _debug_quad_shader;
 
     GLfloat _projection[4*4];
@@ -25,6 +25,7 @@
 #include <CL/opencl.h>
 
 namespace corridormap { struct Render_Vertex; }
+namespace corridormap { struct Distance_Mesh_Indexed; }
 namespace corridormap { class Memory; }
 
 namespace corridormap {
@@ -67,11 +68,17 @@ public:
     virtual void begin() = 0;
     // draw mesh with uniform color. length of vertices array is tri_count*3.
     virtual void draw(const Render_Vertex* vertices, unsigned tri_count, unsigned color) = 0;
+    // draw all segments of indexed distance mesh and its cone instances, segment i with mesh.segment_colors[i].
+    // by default triangles are expanded and drawn with draw, backends can override it to draw the indexed mesh directly.
+    virtual void draw_mesh(const Distance_Mesh_Indexed& mesh);
     // end scene. must be called after all calls to draw.
     virtual void end() = 0;
 
     // copy render target from video memory (only used when features are detected on cpu).
     virtual void read_pixels(unsigned char* destination) = 0;
+    // copy rows [first_row, first_row + num_rows) of render target, num_rows*width*4 bytes.
+    // optional: returns false if the backend can't read a part of render target, read_pixels is used then.
+    virtual bool read_rows(int /*first_row*/, int /*num_rows*/, unsigned char* /*destination*/) { return false; }
 
     // creates shared opencl context.
     virtual Opencl_Shared create_opencl_shared() = 0;
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// software (cpu) implementation of the render interface. doesn't require gpu or graphics context.
+
+#ifndef CORRIDORMAP_RENDER_SOFT_H_
+#define CORRIDORMAP_RENDER_SOFT_H_
+
+#include "corridormap/render_interface.h"
+
+namespace corridormap { class Scheduler; }
+
+namespace corridormap {
+
+// Rasterizes into in-memory RGBA8 color and float depth buffers.
+// render target is split into tiles, tiles are rasterized in parallel using the specified scheduler.
+// output matches Renderer_GL: row 0 is params.min[1], cleared to white, depth test is 'less', CW triangles are culled.
+class Renderer_Soft : public Renderer
+{
+public:
+    // scheduler can be null, then everything runs on the calling thread.
+    explicit Renderer_Soft(Scheduler* scheduler=0);
+    virtual ~Renderer_Soft();
+
+    // memory is used for color, depth and triangle setup buffers, which are kept until destruction.
+    virtual bool initialize(Parameters params, Memory* memory);
+
+    virtual void begin();
+    virtual void draw(const Render_Vertex* vertices, unsigned tri_count, unsigned color);
+    // expands indexed triangles and cone instances into batches of triangles with per triangle colors.
+    virtual void draw_mesh(const Distance_Mesh_Indexed& mesh);
+    virtual void end();
+
+    // copies color buffer, no conversion is required.
+    virtual void read_pixels(unsigned char* destination);
+    virtual bool read_rows(int first_row, int num_rows, unsigned char* destination);
+
+    // opencl sharing is not supported: returns zeroed context.
+    virtual Opencl_Shared create_opencl_shared();
+    // opencl sharing is not supported: returns null object.
+    virtual cl_mem share_pixels(cl_context shared_context, cl_mem_flags flags, cl_int* error_code);
+    virtual cl_int acquire_shared(cl_command_queue queue, cl_mem object);
+    virtual cl_int release_shared(cl_command_queue queue, cl_mem object);
+
+    // triangle setup data.
+    struct Triangle;
+
+private:
+    Renderer_Soft(const Renderer_Soft&);
+    Renderer_Soft& operator=(const Renderer_Soft&);
+
+    void release();
+    // sets up and rasterizes triangles, colors are per triangle pixel words or null to use color for all.
+    void rasterize(const Render_Vertex* vertices, const unsigned int* colors, unsigned tri_count, unsigned int color);
+
+    Scheduler* _scheduler;
+    Memory* _memory;
+
+    // row stride in pixels, padded to the multiple of vector width.
+    int _stride;
+    // RGBA8 pixels, stored as 32 bit words.
+    unsigned int* _color;
+    // depth normalized to [0, 1] range.
+    float* _depth;
+
+    int _num_tiles_x;
+    int _num_tiles_y;
+    // conservative max depth per tile, used to reject occluded triangles.
+    float* _tile_depth;
+
+    // setup data for the batch of triangles being rasterized.
+    Triangle* _triangles;
+    // draw_mesh triangles expanded for rasterization.
+    Render_Vertex* _batch_vertices;
+    unsigned int* _batch_colors;
+};
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 #ifndef CORRIDORMAP_RUNTIME_H_
 #define CORRIDORMAP_RUNTIME_H_
 
+#include <stddef.h> // size_t
 #include "corridormap/runtime_types.h"
 #include "corridormap/pool.h"
 
@@ -80,6 +81,62 @@ Vertex* target(const Walkable_Space& space, const Edge* e);
 // source vertex in the default direction of this edge (i.e. first half-edge).
 Vertex* source(const Walkable_Space& space, const Edge* e);
 
+/// Baked_Space
+
+// creates compacted immutable copy of the walkable space. vertex indices follow the order of first/next iteration over space.vertices.
+Baked_Space bake(Memory* mem, Memory* scratch, const Walkable_Space& space);
+// destroy baked space. views created by load_view are only cleared.
+void destroy(Memory* mem, Baked_Space& space);
+
+// size in bytes of the serialized baked space.
+size_t serialized_size(const Baked_Space& space);
+// writes baked space to the buffer in the binary format (versioned, little-endian, offsets instead of pointers).
+// returns number of bytes written or 0 if the buffer is too small.
+size_t serialize(const Baked_Space& space, void* buffer, size_t buffer_size);
+// bakes walkable space and writes it to the memory block allocated from mem. returns the block, size is set to its size in bytes.
+void* serialize(Memory* mem, Memory* scratch, const Walkable_Space& space, size_t& size);
+// creates read-only view of the serialized baked space (e.g. memory mapped file), data must be at least 4-byte aligned.
+// no copying or allocation is done, data must outlive the view. all indices are checked in a single pass over the arrays,
+// returns false if the header or the topology is not valid.
+bool load_view(const void* data, size_t size, Baked_Space& out);
+
+// number of edges incident to the vertex.
+int degree(const Baked_Space& space, int vertex);
+// the opposite direction half-edge.
+int opposite(const Baked_Space& space, int half_edge);
+// target vertex of the half-edge.
+int target(const Baked_Space& space, int half_edge);
+// source vertex of the half-edge.
+int source(const Baked_Space& space, int half_edge);
+// next half-edge in CCW order around source vertex of the half-edge.
+int next(const Baked_Space& space, int half_edge);
+
+/// Space_Index
+
+// build grid index over the edges of the walkable space. index has to be rebuilt when the space changes.
+Space_Index create_space_index(Memory* mem, Memory* scratch, const Walkable_Space& space);
+// destroy space index.
+void destroy(Memory* mem, Space_Index& index);
+// finds the closest edge to the point, searching grid cells in rings around the point's cell.
+Edge_Location locate(const Space_Index& index, Vec2 point);
+
+/// Path_Search
+
+// allocate search storage for spaces with up to max_vertices vertices.
+Path_Search create_path_search(Memory* mem, int max_vertices);
+// destroy search storage.
+void destroy(Memory* mem, Path_Search& search);
+
+// returns the vertex closest to the point with clearance of at least agent_radius, or null if there is none.
+Vertex* find_closest_vertex(const Walkable_Space& space, Vec2 point, float agent_radius);
+// minimum distance to obstacles along the half-edge (vertices and events).
+float clearance(const Walkable_Space& space, const Half_Edge* e);
+// finds shortest half-edge path between the vertices closest to start and goal, skipping edges with clearance below agent_radius.
+// returns path size, 0 if start and goal are at the same vertex, or -1 if there is no path or it doesn't fit into max_path_size.
+int find_path(const Walkable_Space& space, Path_Search& search, Vec2 start, Vec2 goal, float agent_radius, Half_Edge** path, int max_path_size);
+// same as above, but start and goal are snapped to the end points of their closest edges using the index.
+int find_path(const Walkable_Space& space, const Space_Index& index, Path_Search& search, Vec2 start, Vec2 goal, float agent_radius, Half_Edge** path, int max_path_size);
+
 /// Corridor
 
 // convert vertex path to half-edge path.
@@ -87,6 +144,11 @@ void vertex_to_edge_path(const Walkable_Space& space, Vertex** path, int path_si
 // returns number of event points and vertices along the half-edge path.
 int num_path_discs(const Walkable_Space& space, Half_Edge** path, int path_size);
 
+// convert vertex path to half-edge path in baked space.
+void vertex_to_edge_path(const Baked_Space& space, const int* path, int path_size, int* out);
+// returns number of event points and vertices along the half-edge path in baked space.
+int num_path_discs(const Baked_Space& space, const int* path, int path_size);
+
 // allocate corridor.
 Corridor create_corridor(Memory* mem, int max_disks, int max_portals);
 // destroy corridor.
@@ -94,6 +156,8 @@ void destroy(Memory* mem, Corridor& corridor);
 
 // extract corridor from half-edge path. epsilon is used to test equality of border points.
 void extract(const Walkable_Space& space, Half_Edge** path, int path_size, Corridor& out, float epsilon);
+// extract corridor from half-edge path in baked space.
+void extract(const Baked_Space& space, const int* path, int path_size, Corridor& out, float epsilon);
 // shrink corridor to the new clearance value.
 void shrink(Corridor& corridor, float clearance);
 // triangulate corridor (stores portal edges).
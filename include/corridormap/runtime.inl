@@ -113,6 +113,35 @@ inline Vertex* source(const Walkable_Space& space, const Edge* e)
     return space.vertices.items + e->dir[1].target;
 }
 
+/// baked space
+
+inline int degree(const Baked_Space& space, int vertex)
+{
+    return space.vertex_half_edges[vertex + 1] - space.vertex_half_edges[vertex];
+}
+
+inline int opposite(const Baked_Space& space, int half_edge)
+{
+    return space.opposite[half_edge];
+}
+
+inline int target(const Baked_Space& space, int half_edge)
+{
+    return space.target[half_edge];
+}
+
+inline int source(const Baked_Space& space, int half_edge)
+{
+    return space.target[space.opposite[half_edge]];
+}
+
+inline int next(const Baked_Space& space, int half_edge)
+{
+    int vertex = source(space, half_edge);
+    int next_half_edge = half_edge + 1;
+    return (next_half_edge < space.vertex_half_edges[vertex + 1]) ? next_half_edge : space.vertex_half_edges[vertex];
+}
+
 /// corridor
 
 inline Curve left_border_curve(const Corridor& corridor, int disk_index)
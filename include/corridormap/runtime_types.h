@@ -94,6 +94,8 @@ struct Pool
     int max_items;
     // array of items of size max_items.
     T* items;
+    // previous allocated object for each item (or null_idx), allows O(1) removal. array of size max_items.
+    int* prev;
 };
 
 // Medial axis graph with edges and vertices annotated with closest obstacle information.
@@ -107,6 +109,104 @@ struct Walkable_Space
     Pool<Event> events;
 };
 
+// Immutable medial axis graph without holes, produced from Walkable_Space by bake().
+// vertices, half-edges and events are stored in separate arrays (SoA), all references are indices.
+// half-edges are grouped by source vertex in CCW order, events of each half-edge direction are contiguous.
+struct Baked_Space
+{
+    // number of vertices.
+    int num_vertices;
+    // number of half-edges (two per edge).
+    int num_half_edges;
+    // number of event records. every edge event is stored once per half-edge direction.
+    int num_events;
+    // vertex positions. [0..num_vertices).
+    const Vec2* vertex_pos;
+    // outgoing half-edges of vertex v are [vertex_half_edges[v] .. vertex_half_edges[v+1]). [0..num_vertices].
+    const int* vertex_half_edges;
+    // target vertex of half-edge. [0..num_half_edges).
+    const int* target;
+    // opposite direction half-edge. [0..num_half_edges).
+    const int* opposite;
+    // closest points on left and right obstacles at the target vertex along half-edge direction. [0..num_half_edges).
+    const Vec2* side_l;
+    const Vec2* side_r;
+    // events along half-edge h are [half_edge_events[h] .. half_edge_events[h+1]). [0..num_half_edges].
+    const int* half_edge_events;
+    // event position. [0..num_events).
+    const Vec2* event_pos;
+    // closest points on left and right obstacles at the event along half-edge direction. [0..num_events).
+    const Vec2* event_l;
+    const Vec2* event_r;
+    // memory block holding all arrays, null if arrays are not owned (i.e. view of external memory).
+    void* data;
+};
+
+// Uniform grid over the edge polyline segments (vertex-event-...-vertex) of the walkable space.
+struct Space_Index
+{
+    // position of the grid corner.
+    Vec2 origin;
+    // cell side length.
+    float cell_size;
+    // number of grid columns.
+    int num_cols;
+    // number of grid rows.
+    int num_rows;
+    // number of edge segments.
+    int num_segments;
+    // segments overlapping cell c are cell_segments[cell_offsets[c] .. cell_offsets[c+1]). [0..num_cols*num_rows].
+    int* cell_offsets;
+    // segment indices grouped by cell.
+    int* cell_segments;
+    // segment end points. [0..num_segments).
+    Vec2* segment_a;
+    Vec2* segment_b;
+    // pool index of the edge owning segment. [0..num_segments).
+    int* segment_edge;
+    // edge polyline parameter at the segment end points (arc length fraction in the default edge direction). [0..num_segments).
+    float* segment_t0;
+    float* segment_t1;
+};
+
+// Result of the point location query.
+struct Edge_Location
+{
+    // pool index of the closest edge, or null_idx if the index is empty.
+    int edge;
+    // parameter of the closest point along the edge in the default direction [0..1].
+    float t;
+    // closest point on the edge.
+    Vec2 point;
+    // distance from the query point to the edge.
+    float distance;
+    // grid cell containing (clamped) query point.
+    int cell;
+};
+
+// Reusable storage for A* search over the walkable space vertices.
+struct Path_Search
+{
+    // max number of vertices (size of the arrays below).
+    int max_vertices;
+    // number of vertices in the open list.
+    int num_open;
+    // current query number, per-vertex state is valid only if stamp matches.
+    unsigned int query;
+    // query number when the vertex state was last initialized. [0..max_vertices).
+    unsigned int* stamp;
+    // cost of the best known path from the start vertex. [0..max_vertices).
+    float* cost;
+    // cost plus heuristic estimate to the goal vertex. [0..max_vertices).
+    float* estimate;
+    // arriving half-edge on the best known path (edge_index*2 + dir), or null_idx for the start vertex. [0..max_vertices).
+    int* parent;
+    // position in the open list heap, or null_idx if the vertex is closed. [0..max_vertices).
+    int* heap_index;
+    // open list, binary min-heap of vertex indices ordered by estimate. [0..num_open).
+    int* open;
+};
+
 // Curve types for corridor borders.
 enum Curve
 {
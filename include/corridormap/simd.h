@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// compile-time selection of the vector instruction set used by cpu build stages.
+// define CORRIDORMAP_CONFIG_NO_SIMD to force scalar code paths.
+
+#ifndef CORRIDORMAP_SIMD_H_
+#define CORRIDORMAP_SIMD_H_
+
+#if !defined CORRIDORMAP_CONFIG_NO_SIMD
+    #if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+        #define CORRIDORMAP_SSE2 1
+    #endif
+
+    #if defined __AVX2__
+        #define CORRIDORMAP_AVX2 1
+    #endif
+#endif
+
+#if CORRIDORMAP_SSE2
+    #include <emmintrin.h>
+#endif
+
+#if CORRIDORMAP_AVX2
+    #include <immintrin.h>
+#endif
+
+#endif
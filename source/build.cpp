@@ -20,16 +20,22 @@
 // SOFTWARE.
 
 #include <algorithm>
+#include <atomic>
+#include <new>
 #include <float.h>
+#include <limits.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 #include "corridormap/assert.h"
 #include "corridormap/memory.h"
+#include "corridormap/simd.h"
+#include "corridormap/parallel.h"
 #include "corridormap/render_interface.h"
 #include "corridormap/vec2.h"
 #include "corridormap/runtime.h"
 #include "corridormap/build_alloc.h"
+#include "corridormap/build_stats.h"
 #include "corridormap/build.h"
 
 namespace corridormap {
@@ -104,11 +110,24 @@ int distance_mesh_tris_for_point(float max_dist, float max_error)
     return unsigned(ceil(CORRIDORMAP_PI/cone_half_angle));
 }
 
-int max_distance_mesh_verts(const Footprint& f, float max_dist, float max_error)
+int max_distance_mesh_verts(const Footprint& f, float max_dist, float max_error, const float* radii)
 {
-    int point_tris = distance_mesh_tris_for_point(max_dist, max_error);
+    int cone_verts = 0;
+
+    if (radii)
+    {
+        for (int i = 0; i < f.num_polys; ++i)
+        {
+            cone_verts += distance_mesh_tris_for_point(radii[i], max_error)*f.num_poly_verts[i]*3;
+        }
+    }
+    else
+    {
+        cone_verts = distance_mesh_tris_for_point(max_dist, max_error)*f.num_verts*3;
+    }
+
     // point_tris triangles per vertex, 2 triangles per edge, four border planes, obstacle polygons.
-    return point_tris*f.num_verts*3 + f.num_verts*2*3 + (f.num_verts - f.num_polys*2)*3 + 6*4;
+    return cone_verts + f.num_verts*2*3 + (f.num_verts - f.num_polys*2)*3 + 6*4;
 }
 
 namespace
@@ -174,13 +193,11 @@ namespace
     }
 }
 
-void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, float max_error, Distance_Mesh& out)
+void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, float max_error, Distance_Mesh& out, const float* radii)
 {
-    corridormap_assert(max_dist > max_error);
+    corridormap_build_scope(build_stage_distance_mesh);
 
-    const float cone_half_angle = acos((max_dist-max_error) / max_dist);
-    const int cone_triangle_count = unsigned(ceil(CORRIDORMAP_PI/cone_half_angle));
-    const float cone_angle = 2.f*CORRIDORMAP_PI/cone_triangle_count;
+    corridormap_assert(max_dist > max_error);
 
     const int* num_poly_verts = in.num_poly_verts;
     const int num_polys = in.num_polys;
@@ -218,6 +235,13 @@ void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, floa
         int npverts = num_poly_verts[i];
         int nsegverts = 0;
 
+        const float radius = radii ? radii[i] : max_dist;
+        corridormap_assert(radius > max_error);
+
+        const float cone_half_angle = acos((radius-max_error) / radius);
+        const int cone_triangle_count = unsigned(ceil(CORRIDORMAP_PI/cone_half_angle));
+        const float cone_angle = 2.f*CORRIDORMAP_PI/cone_triangle_count;
+
         int prev_idx = npverts - 2;
         int curr_idx = npverts - 1;
         int next_idx = 0;
@@ -242,10 +266,10 @@ void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, floa
             float angle_start = atan2(e0.y, e0.x);
 
             // 2. generate cone sector for the current vertex.
-            nsegverts += build_cone_sector(verts, curr, angle_cone_sector_steps, angle_cone_sector_step, angle_start, max_dist);
+            nsegverts += build_cone_sector(verts, curr, angle_cone_sector_steps, angle_cone_sector_step, angle_start, radius);
 
             // 3. generate tent for (curr, next) edge.
-            nsegverts += build_tent_side(verts, next, curr, len_e1, max_dist);
+            nsegverts += build_tent_side(verts, next, curr, len_e1, radius);
         }
 
         poly_x += npverts;
@@ -264,10 +288,12 @@ void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, floa
 
         Vec2 len = rt - lb;
 
-        *num_segment_verts++ = build_tent_side(verts, lb, rb, len.x, max_dist);
-        *num_segment_verts++ = build_tent_side(verts, rb, rt, len.y, max_dist);
-        *num_segment_verts++ = build_tent_side(verts, rt, lt, len.x, max_dist);
-        *num_segment_verts++ = build_tent_side(verts, lt, lb, len.y, max_dist);
+        const float* border_radii = radii ? radii + num_polys : 0;
+
+        *num_segment_verts++ = build_tent_side(verts, lb, rb, len.x, border_radii ? border_radii[0] : max_dist);
+        *num_segment_verts++ = build_tent_side(verts, rb, rt, len.y, border_radii ? border_radii[1] : max_dist);
+        *num_segment_verts++ = build_tent_side(verts, rt, lt, len.x, border_radii ? border_radii[2] : max_dist);
+        *num_segment_verts++ = build_tent_side(verts, lt, lb, len.y, border_radii ? border_radii[3] : max_dist);
 
         for (int i = 0; i < num_border_segments; ++i)
         {
@@ -277,994 +303,3041 @@ void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, floa
 
     out.num_segments = 1 + num_border_segments + in.num_polys;
     out.num_verts = int(verts - out.verts);
+
+    corridormap_build_count(num_mesh_verts, out.num_verts);
 }
 
-void render_distance_mesh(Renderer* render_iface, const Distance_Mesh& mesh)
+int distance_mesh_cone_tris(const Footprint& f, float max_dist, float max_error, const float* radii)
 {
-    render_iface->begin();
-
-    int vertices_offset = 0;
+    float max_radius = max_dist;
 
-    for (int i = 0; i < mesh.num_segments; ++i)
+    if (radii)
     {
-        int num_verts = mesh.num_segment_verts[i];
-        unsigned color = mesh.segment_colors[i];
-        const Render_Vertex* vertices = mesh.verts + vertices_offset;
-        render_iface->draw(vertices, num_verts/3, color);
-        vertices_offset += num_verts;
-    }
-
-    render_iface->end();
-}
+        max_radius = 0.f;
 
-void set_segment_colors(Distance_Mesh& mesh, unsigned int* colors, int ncolors)
-{
-    for (int i = 0; i < mesh.num_segments; ++i)
-    {
-        mesh.segment_colors[i] = colors[i % ncolors];
+        for (int i = 0; i < f.num_polys; ++i)
+        {
+            max_radius = std::max(max_radius, radii[i]);
+        }
     }
+
+    return distance_mesh_tris_for_point(std::max(max_radius, 2.f*max_error), max_error);
 }
 
 namespace
 {
-    unsigned int pack_color(unsigned char* v)
+    // tent over the edge between vertices ia and ib, the two raised vertices are appended at num_verts.
+    inline void build_tent_side(Render_Vertex* verts, int& num_verts, unsigned int*& indices, int ia, int ib, float size)
     {
-        return (unsigned int)(v[0]) << 24 |
-               (unsigned int)(v[1]) << 16 |
-               (unsigned int)(v[2]) << 8  |
-               (unsigned int)(v[3]) << 0  ;
-    }
+        Vec2 a = { verts[ia].x, verts[ia].y };
+        Vec2 b = { verts[ib].x, verts[ib].y };
+        Vec2 e = b - a;
+        Vec2 n = make_vec2(-e.y, e.x)/mag(e);
 
-    unsigned int get_pixel(unsigned char* data, int width, int x, int y)
-    {
-        return pack_color(data + (y*width*4 + x*4));
+        Render_Vertex p2 = { a.x + size*n.x, a.y + size*n.y, size };
+        Render_Vertex p3 = { b.x + size*n.x, b.y + size*n.y, size };
+
+        int i2 = num_verts++;
+        int i3 = num_verts++;
+        verts[i2] = p2;
+        verts[i3] = p3;
+
+        *indices++ = ia; *indices++ = ib; *indices++ = i2;
+        *indices++ = i2; *indices++ = ib; *indices++ = i3;
     }
 }
 
-Voronoi_Features detect_voronoi_features(Memory* memory, Memory* scratch, Renderer* render_iface)
+void build_distance_mesh(const Footprint& in, Bbox2 bounds, float max_dist, Distance_Mesh_Indexed& out, const float* radii)
 {
-    int width = render_iface->params.render_target_width;
-    int height = render_iface->params.render_target_height;
+    corridormap_build_scope(build_stage_distance_mesh);
 
-    Alloc_Scope<unsigned char> colors(scratch, width*height*4);
-    Alloc_Scope<unsigned char> output(scratch, width*height*1);
-    corridormap_assert(colors.data);
-    corridormap_assert(output.data);
-    zero_mem(colors);
-    zero_mem(output);
+    const int num_cone_tris = out.num_cone_tris;
+    const float cone_angle = 2.f*CORRIDORMAP_PI/num_cone_tris;
 
-    render_iface->read_pixels(colors);
+    corridormap_assert(num_cone_tris >= 3);
 
-    int num_verts = 0;
-    int num_edges = 0;
+    const int* num_poly_verts = in.num_poly_verts;
+    const int num_polys = in.num_polys;
 
-    for (int y = 1; y < height; ++y)
+    // 1. cone template, the turn is repeated to keep sector ranges contiguous.
     {
-        for (int x = 1; x < width; ++x)
-        {
-            unsigned int a = get_pixel(colors, width, x - 1, y - 1);
-            unsigned int b = get_pixel(colors, width, x + 0, y - 1);
-            unsigned int c = get_pixel(colors, width, x - 1, y + 0);
-            unsigned int d = get_pixel(colors, width, x + 0, y + 0);
-
-            int diff = 1;
-            if (b != a) { diff++; }
-            if (c != a && c != b) { diff++; }
-            if (d != a && d != b && d != c) { diff++; }
-
-            int num_zero = 0;
-            if (a == 0) { num_zero++; }
-            if (b == 0) { num_zero++; }
-            if (c == 0) { num_zero++; }
-            if (d == 0) { num_zero++; }
+        Render_Vertex* verts = out.cone_verts;
 
-            unsigned char m = 0;
-
-            if (diff > 2)
-            {
-                m |= 0x0f;
-                num_verts++;
-            }
+        for (int i = 0; i < num_cone_tris*2; ++i)
+        {
+            float a0 = float((i + 0) % num_cone_tris)*cone_angle;
+            float a1 = float((i + 1) % num_cone_tris)*cone_angle;
 
-            if (diff - num_zero == 2)
-            {
-                m |= 0xf0;
-                num_edges++;
-            }
+            Render_Vertex apex = { 0.f, 0.f, 0.f };
+            Render_Vertex b = { cosf(a0), sinf(a0), 1.f };
+            Render_Vertex c = { cosf(a1), sinf(a1), 1.f };
 
-            output[y*width + x] = m;
+            *verts++ = apex;
+            *verts++ = b;
+            *verts++ = c;
         }
     }
 
-    Voronoi_Features features = allocate_voronoi_features(memory, width, height, num_verts, num_edges);
-    memset(features.verts, 0, num_verts*sizeof(features.verts[0]));
-    memset(features.edges, 0, num_edges*sizeof(features.edges[0]));
+    // output
+    Render_Vertex* verts = out.verts;
+    unsigned int* indices = out.indices;
+    Cone_Instance* instances = out.instances;
+    unsigned int* segment_colors = out.segment_colors;
+    int* num_segment_indices = out.num_segment_indices;
+    int* num_segment_instances = out.num_segment_instances;
 
-    int vert_top = 0;
-    int edge_top = 0;
+    int num_verts = 0;
+    int next_seg_color = 0;
 
-    for (int y = 1; y < height; ++y)
+    // obstacle vertices are shared by polygon caps, tents and cone instances.
+    for (; num_verts < in.num_verts; ++num_verts)
     {
-        for (int x = 1; x < width; ++x)
-        {
-            unsigned int a = get_pixel(colors, width, x - 1, y - 1);
-            unsigned int b = get_pixel(colors, width, x + 0, y - 1);
-            unsigned int c = get_pixel(colors, width, x - 1, y + 0);
-            unsigned int d = get_pixel(colors, width, x + 0, y + 0);
+        Render_Vertex v = { in.x[num_verts], in.y[num_verts], 0.f };
+        verts[num_verts] = v;
+    }
 
-            int lin_idx = y*width + x;
-            unsigned char m = output[lin_idx];
+    // 2. segment 0 is area inside obstacles.
+    {
+        const unsigned int* first_index = indices;
 
-            // vertex
-            if ((m & 0x0f) != 0)
-            {
-                features.verts[vert_top++] = lin_idx;
-            }
+        for (int i = 0, offset = 0; i < num_polys; offset += num_poly_verts[i++])
+        {
+            corridormap_assert(num_poly_verts[i] >= 3);
 
-            // edge
-            if ((m & 0xf0) != 0)
+            for (int j = 2; j < num_poly_verts[i]; ++j)
             {
-                features.edges[edge_top] = lin_idx;
-                features.edge_obstacle_ids_1[edge_top] = a;
-                features.edge_obstacle_ids_2[edge_top] = (a != b) ? b : ((a != c) ? c : d);
-                edge_top++;
+                *indices++ = offset;
+                *indices++ = offset + j - 1;
+                *indices++ = offset + j;
             }
         }
-    }
 
-    return features;
-}
+        *segment_colors++ = next_seg_color++;
+        *num_segment_indices++ = int(indices - first_index);
+        *num_segment_instances++ = 0;
+    }
 
-namespace
-{
-    inline void store_edge_normal(Vec2 u, Vec2 v, float*& out_x, float*& out_y)
+    for (int i = 0, offset = 0; i < num_polys; offset += num_poly_verts[i++])
     {
-        Vec2 dir = normalized(v - u);
-        *out_x++ = +dir.y;
-        *out_y++ = -dir.x;
-    }
-}
+        const int npverts = num_poly_verts[i];
+        const float radius = radii ? radii[i] : max_dist;
+        const unsigned int* first_index = indices;
+        const Cone_Instance* first_instance = instances;
 
-void build_footprint_normals(const Footprint& in, Bbox2 bounds, Footprint_Normals& out)
-{
-    const float* poly_x = in.x;
-    const float* poly_y = in.y;
-    const int* num_poly_verts = in.num_poly_verts;
-    const int num_polys = in.num_polys;
+        int prev_idx = npverts - 2;
+        int curr_idx = npverts - 1;
+        int next_idx = 0;
 
-    float* normal_x = out.x;
-    float* normal_y = out.y;
-    int* num_obstacle_normals = out.num_obstacle_normals;
-    int* obstacle_normal_offsets = out.obstacle_normal_offsets;
+        for (; next_idx < npverts; prev_idx = curr_idx, curr_idx = next_idx++)
+        {
+            Vec2 prev = { in.x[offset + prev_idx], in.y[offset + prev_idx] };
+            Vec2 curr = { in.x[offset + curr_idx], in.y[offset + curr_idx] };
+            Vec2 next = { in.x[offset + next_idx], in.y[offset + next_idx] };
 
-    int num_normals = 0;
+            Vec2 e0 = normalized(prev - curr);
+            Vec2 e1 = normalized(next - curr);
 
-    for (int i = 0; i < num_polys; ++i)
-    {
-        *obstacle_normal_offsets++ = num_normals;
+            float angle_inner = acos(dot(e0, e1));
+            float angle_cone_sector = 2.f * CORRIDORMAP_PI - angle_inner;
+            float angle_start = atan2(e0.y, e0.x);
 
-        int nverts = num_poly_verts[i];
+            if (angle_start < 0.f)
+            {
+                angle_start += 2.f*CORRIDORMAP_PI;
+            }
 
-        int curr_idx = nverts - 1;
-        int next_idx = 0;
+            // 3. cone instance covering the sector with whole template triangles.
+            int first_tri = std::min(int(angle_start/cone_angle), num_cone_tris - 1);
+            int last_tri = int(ceilf((angle_start + angle_cone_sector)/cone_angle));
 
-        for (; next_idx < nverts; curr_idx = next_idx++, ++num_normals)
-        {
-            Vec2 curr = { poly_x[curr_idx], poly_y[curr_idx] };
-            Vec2 next = { poly_x[next_idx], poly_y[next_idx] };
-            store_edge_normal(curr, next, normal_x, normal_y);
-        }
+            Cone_Instance cone = { curr.x, curr.y, radius, first_tri, std::min(last_tri - first_tri, num_cone_tris) };
+            *instances++ = cone;
 
-        poly_x += nverts;
-        poly_y += nverts;
+            // 4. tent for (curr, next) edge.
+            build_tent_side(verts, num_verts, indices, offset + next_idx, offset + curr_idx, radius);
+        }
 
-        *num_obstacle_normals++ = nverts;
+        *segment_colors++ = next_seg_color++;
+        *num_segment_indices++ = int(indices - first_index);
+        *num_segment_instances++ = int(instances - first_instance);
     }
 
+    // 5. generate borders.
     {
-        Vec2 lt = { bounds.min[0], bounds.max[1] };
-        Vec2 lb = { bounds.min[0], bounds.min[1] };
-        Vec2 rt = { bounds.max[0], bounds.max[1] };
-        Vec2 rb = { bounds.max[0], bounds.min[1] };
+        const int lb = num_verts++;
+        const int rb = num_verts++;
+        const int rt = num_verts++;
+        const int lt = num_verts++;
 
-        store_edge_normal(lb, rb, normal_x, normal_y);
-        store_edge_normal(rb, rt, normal_x, normal_y);
-        store_edge_normal(rt, lt, normal_x, normal_y);
-        store_edge_normal(lt, lb, normal_x, normal_y);
+        Render_Vertex corners[] =
+        {
+            { bounds.min[0], bounds.min[1], 0.f },
+            { bounds.max[0], bounds.min[1], 0.f },
+            { bounds.max[0], bounds.max[1], 0.f },
+            { bounds.min[0], bounds.max[1], 0.f },
+        };
+
+        memcpy(verts + lb, corners, sizeof(corners));
+
+        const int sides[][2] = { { lb, rb }, { rb, rt }, { rt, lt }, { lt, lb } };
 
         for (int i = 0; i < num_border_segments; ++i)
         {
-            *obstacle_normal_offsets++ = num_normals + i;
-            *num_obstacle_normals++ = 1;
+            build_tent_side(verts, num_verts, indices, sides[i][0], sides[i][1], radii ? radii[num_polys + i] : max_dist);
+
+            *segment_colors++ = next_seg_color++;
+            *num_segment_indices++ = 6;
+            *num_segment_instances++ = 0;
         }
     }
-}
 
-namespace
-{
-    int find_normal_index(
-        const float* vertex_x,
-        const float* vertex_y,
-        const float* normal_x,
-        const float* normal_y,
-        const int* num_obstacle_normals,
-        const int* obstacle_normal_offsets,
-        const int obstacle_id,
-        const Vec2 edge_point)
-    {
-        int oid = obstacle_id - 1;
+    out.num_segments = 1 + num_border_segments + num_polys;
+    out.num_verts = num_verts;
+    out.num_indices = int(indices - out.indices);
+    out.num_instances = int(instances - out.instances);
 
-        if (oid < 0)
-        {
-            return 0;
-        }
+    corridormap_build_count(num_mesh_verts, out.num_verts);
+}
 
-        int num_normals = num_obstacle_normals[oid];
+void render_distance_mesh(Renderer* render_iface, const Distance_Mesh& mesh)
+{
+    corridormap_build_scope(build_stage_render_distance_mesh);
 
-        int first_normal_idx = obstacle_normal_offsets[oid];
-        int last_normal_idx = first_normal_idx + num_normals - 1;
+    render_iface->begin();
 
-        int curr_idx = last_normal_idx;
-        int next_idx = first_normal_idx;
+    int vertices_offset = 0;
 
-        for (; next_idx <= last_normal_idx; curr_idx = next_idx++)
-        {
-            Vec2 vertex = { vertex_x[curr_idx], vertex_y[curr_idx] };
-            Vec2 normal_curr = { normal_x[curr_idx], normal_y[curr_idx] };
-            Vec2 normal_next = { normal_x[next_idx], normal_y[next_idx] };
+    for (int i = 0; i < mesh.num_segments; ++i)
+    {
+        int num_verts = mesh.num_segment_verts[i];
+        unsigned color = mesh.segment_colors[i];
+        const Render_Vertex* vertices = mesh.verts + vertices_offset;
+        render_iface->draw(vertices, num_verts/3, color);
+        vertices_offset += num_verts;
+    }
 
-            Vec2 mid = normalized((normal_curr + normal_next)*0.5f);
-            Vec2 dir = normalized(edge_point - vertex);
+    render_iface->end();
+}
 
-            float dot_n = dot(normal_curr, mid);
-            float dot_d = dot(dir, mid);
+void render_distance_mesh(Renderer* render_iface, const Distance_Mesh_Indexed& mesh)
+{
+    corridormap_build_scope(build_stage_render_distance_mesh);
 
-            if (dot_d >= dot_n)
-            {
-                return curr_idx + 1;
-            }
-        }
+    render_iface->begin();
+    render_iface->draw_mesh(mesh);
+    render_iface->end();
+}
 
-        return 0;
+void set_segment_colors(Distance_Mesh& mesh, unsigned int* colors, int ncolors)
+{
+    for (int i = 0; i < mesh.num_segments; ++i)
+    {
+        mesh.segment_colors[i] = colors[i % ncolors];
     }
 }
 
-void build_edge_spans(const Voronoi_Features& features, const Footprint& obstacles, const Footprint_Normals& normals, Bbox2 bounds, Voronoi_Edge_Spans& out)
+void set_segment_colors(Distance_Mesh_Indexed& mesh, unsigned int* colors, int ncolors)
 {
-    const int grid_width = features.grid_width;
-    const int grid_height = features.grid_height;
-    const int num_edge_points = features.num_edge_points;
-    const unsigned int* edges = features.edges;
-    const unsigned int* obstacle_ids_1 = features.edge_obstacle_ids_1;
-    const unsigned int* obstacle_ids_2 = features.edge_obstacle_ids_2;
+    for (int i = 0; i < mesh.num_segments; ++i)
+    {
+        mesh.segment_colors[i] = colors[i % ncolors];
+    }
+}
 
-    const float* vertex_x = obstacles.x;
-    const float* vertex_y = obstacles.y;
+namespace
+{
+    unsigned int pack_color(const unsigned char* v)
+    {
+        return (unsigned int)(v[0]) << 24 |
+               (unsigned int)(v[1]) << 16 |
+               (unsigned int)(v[2]) << 8  |
+               (unsigned int)(v[3]) << 0  ;
+    }
 
-    const float* normal_x = normals.x;
-    const float* normal_y = normals.y;
-    const int* num_obstacle_normals = normals.num_obstacle_normals;
-    const int* obstacle_normal_offsets = normals.obstacle_normal_offsets;
+    // number of row bands per scheduler thread.
+    enum { detect_bands_per_thread = 4 };
 
-    int* normal_indices_1 = out.indices_1;
-    int* normal_indices_2 = out.indices_2;
+    // features found in the band of rows [row_begin, row_end).
+    struct Feature_Band
+    {
+        int row_begin;
+        int row_end;
+        // first row which is not processed yet (output buffers were full).
+        int resume_row;
+
+        unsigned int* verts;
+        int num_verts;
+        int vert_capacity;
+
+        unsigned int* edges;
+        unsigned int* edge_ids_1;
+        unsigned int* edge_ids_2;
+        int num_edges;
+        int edge_capacity;
+    };
 
-    float bounds_width = bounds.max[0] - bounds.min[0];
-    float bounds_height = bounds.max[1] - bounds.min[1];
+    struct Detect_Context
+    {
+        const unsigned char* colors;
+        int width;
+        int height;
+        Feature_Band* bands;
+    };
 
-    for (int i = 0; i < num_edge_points; ++i)
+    // classifies 2x2 pixel block with a in the top-left and d in the bottom-right corner:
+    // vertex if there are more than two distinct colors, edge if there are exactly two non-zero (not obstacle interior) colors.
+    inline void classify(unsigned int a, unsigned int b, unsigned int c, unsigned int d, bool& is_vert, bool& is_edge)
     {
-        unsigned int edge_point_idx = edges[i];
-        unsigned int obstacle_1 = obstacle_ids_1[i];
-        unsigned int obstacle_2 = obstacle_ids_2[i];
+        int diff = 1;
+        if (b != a) { diff++; }
+        if (c != a && c != b) { diff++; }
+        if (d != a && d != b && d != c) { diff++; }
+
+        int num_zero = 0;
+        if (a == 0) { num_zero++; }
+        if (b == 0) { num_zero++; }
+        if (c == 0) { num_zero++; }
+        if (d == 0) { num_zero++; }
+
+        is_vert = diff > 2;
+        is_edge = diff - num_zero == 2;
+    }
 
-        int edge_point_x = edge_point_idx%grid_width;
-        int edge_point_y = edge_point_idx/grid_width;
+#if CORRIDORMAP_AVX2
+    enum { detect_lanes = 8 };
 
-        Vec2 edge_point = { bounds.min[0] + float(edge_point_x)/grid_width * bounds_width, bounds.min[1] + float(edge_point_y)/grid_height * bounds_height};
+    // returns bit mask of blocks [x, x + lanes) which contain vertex or edge.
+    inline unsigned feature_mask(const unsigned int* prev, const unsigned int* curr, int x)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + x - 1));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + x));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(curr + x - 1));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(curr + x));
 
-        normal_indices_1[i] = find_normal_index(vertex_x, vertex_y, normal_x, normal_y, num_obstacle_normals, obstacle_normal_offsets, obstacle_1, edge_point);
-        normal_indices_2[i] = find_normal_index(vertex_x, vertex_y, normal_x, normal_y, num_obstacle_normals, obstacle_normal_offsets, obstacle_2, edge_point);
-    }
-}
+        __m256i ones = _mm256_set1_epi32(-1);
+        __m256i zero = _mm256_setzero_si256();
 
-void build_csr(const unsigned int* nz_coords, CSR_Grid& out)
-{
-    int* column = out.column;
-    int* row_offset = out.row_offset;
+        // each compare yields -1 for true.
+        __m256i new_b = _mm256_xor_si256(_mm256_cmpeq_epi32(b, a), ones);
+        __m256i new_c = _mm256_xor_si256(_mm256_or_si256(_mm256_cmpeq_epi32(c, a), _mm256_cmpeq_epi32(c, b)), ones);
+        __m256i new_d = _mm256_xor_si256(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(d, a), _mm256_cmpeq_epi32(d, b)), _mm256_cmpeq_epi32(d, c)), ones);
 
-    const int num_cols = out.num_cols;
-    const int num_rows = out.num_rows;
-    const int num_nz = out.num_nz;
+        // s = 1 - diff, z = -num_zero.
+        __m256i s = _mm256_add_epi32(_mm256_add_epi32(new_b, new_c), new_d);
+        __m256i z = _mm256_add_epi32(_mm256_add_epi32(_mm256_cmpeq_epi32(a, zero), _mm256_cmpeq_epi32(b, zero)),
+                                     _mm256_add_epi32(_mm256_cmpeq_epi32(c, zero), _mm256_cmpeq_epi32(d, zero)));
 
-    int next_row = 0;
+        __m256i vert = _mm256_cmpgt_epi32(ones, s);
+        __m256i edge = _mm256_cmpeq_epi32(_mm256_sub_epi32(z, s), _mm256_set1_epi32(1));
 
-    for (int i = 0; i < num_nz; ++i)
+        return unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(vert, edge))));
+    }
+#elif CORRIDORMAP_SSE2
+    enum { detect_lanes = 4 };
+
+    // returns bit mask of blocks [x, x + lanes) which contain vertex or edge.
+    inline unsigned feature_mask(const unsigned int* prev, const unsigned int* curr, int x)
     {
-        unsigned int coord = nz_coords[i];
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x - 1));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + x - 1));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + x));
 
-        column[i] = coord % num_cols;
-        int curr_row = coord / num_cols;
+        __m128i ones = _mm_set1_epi32(-1);
+        __m128i zero = _mm_setzero_si128();
 
-        for (int j = next_row; j <= curr_row; ++j)
-        {
-            row_offset[j] = i;
-        }
+        // each compare yields -1 for true.
+        __m128i new_b = _mm_xor_si128(_mm_cmpeq_epi32(b, a), ones);
+        __m128i new_c = _mm_xor_si128(_mm_or_si128(_mm_cmpeq_epi32(c, a), _mm_cmpeq_epi32(c, b)), ones);
+        __m128i new_d = _mm_xor_si128(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(d, a), _mm_cmpeq_epi32(d, b)), _mm_cmpeq_epi32(d, c)), ones);
 
-        next_row = curr_row + 1;
+        // s = 1 - diff, z = -num_zero.
+        __m128i s = _mm_add_epi32(_mm_add_epi32(new_b, new_c), new_d);
+        __m128i z = _mm_add_epi32(_mm_add_epi32(_mm_cmpeq_epi32(a, zero), _mm_cmpeq_epi32(b, zero)),
+                                  _mm_add_epi32(_mm_cmpeq_epi32(c, zero), _mm_cmpeq_epi32(d, zero)));
+
+        __m128i vert = _mm_cmplt_epi32(s, ones);
+        __m128i edge = _mm_cmpeq_epi32(_mm_sub_epi32(z, s), _mm_set1_epi32(1));
+
+        return unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(vert, edge))));
     }
+#else
+    enum { detect_lanes = 1 };
 
-    for (int j = next_row; j < num_rows + 1; ++j)
+    inline unsigned feature_mask(const unsigned int* prev, const unsigned int* curr, int x)
     {
-        row_offset[j] = num_nz;
+        bool is_vert;
+        bool is_edge;
+        classify(prev[x - 1], prev[x], curr[x - 1], curr[x], is_vert, is_edge);
+        return (is_vert || is_edge) ? 1u : 0u;
     }
-}
+#endif
 
-int nz(const CSR_Grid& grid, int row, int col)
-{
-    const int* column = grid.column;
-    int row_b = grid.row_offset[row + 0];
-    int row_e = grid.row_offset[row + 1];
-
-    for (int i = row_b; i < row_e; ++i)
+    // emits features of the block at column x. returns false if band buffers are full.
+    inline bool emit_features(const unsigned int* prev, const unsigned int* curr, int x, int lin_idx, Feature_Band& band)
     {
-        if (column[i] == col)
+        bool is_vert;
+        bool is_edge;
+        classify(prev[x - 1], prev[x], curr[x - 1], curr[x], is_vert, is_edge);
+
+        if ((is_vert && band.num_verts == band.vert_capacity) || (is_edge && band.num_edges == band.edge_capacity))
         {
-            return i;
+            return false;
         }
-    }
 
-    return grid.num_nz;
-}
+        if (is_vert)
+        {
+            band.verts[band.num_verts++] = lin_idx;
+        }
 
-int nz(const CSR_Grid& grid, int linear_index)
-{
-    return nz(grid, linear_index / grid.num_cols, linear_index % grid.num_cols);
-}
+        if (is_edge)
+        {
+            const unsigned char* a = reinterpret_cast<const unsigned char*>(prev + x - 1);
+            const unsigned char* b = reinterpret_cast<const unsigned char*>(prev + x);
+            const unsigned char* c = reinterpret_cast<const unsigned char*>(curr + x - 1);
+            const unsigned char* d = reinterpret_cast<const unsigned char*>(curr + x);
+
+            // only emitted colors are converted to segment indices, comparisons work on raw pixels.
+            band.edges[band.num_edges] = lin_idx;
+            band.edge_ids_1[band.num_edges] = pack_color(a);
+            band.edge_ids_2[band.num_edges] = pack_color((prev[x - 1] != prev[x]) ? b : ((prev[x - 1] != curr[x - 1]) ? c : d));
+            band.num_edges++;
+        }
 
-namespace
-{
-    int nei_offset_row[] = { +0, -1, +1, +0 };
-    int nei_offset_col[] = { -1, +0, +0, +1 };
-}
+        return true;
+    }
 
-CSR_Grid_Neis cell_neis(const CSR_Grid& grid, int row, int col)
-{
-    int num_rows = grid.num_rows;
-    int num_cols = grid.num_cols;
+    // emits features of the blocks between rows y - 1 and y. returns false and drops partial row if band buffers are full.
+    bool detect_row(const unsigned int* prev, const unsigned int* curr, int y, int width, Feature_Band& band)
+    {
+        const int row_num_verts = band.num_verts;
+        const int row_num_edges = band.num_edges;
 
-    CSR_Grid_Neis neis;
-    neis.num = 0;
-
-    for (int i = 0; i < sizeof(nei_offset_row)/sizeof(nei_offset_row[0]); ++i)
-    {
-        int n_r = row + nei_offset_row[i];
-        int n_c = col + nei_offset_col[i];
+        int x = 1;
 
-        if (n_r < 0 || n_r >= num_rows)
+        for (; x + detect_lanes <= width; x += detect_lanes)
         {
-            continue;
+            for (unsigned mask = feature_mask(prev, curr, x); mask != 0; mask &= mask - 1)
+            {
+                int lane = 0;
+                for (; (mask & (1u << lane)) == 0; ++lane) {}
+
+                if (!emit_features(prev, curr, x + lane, y*width + x + lane, band))
+                {
+                    band.num_verts = row_num_verts;
+                    band.num_edges = row_num_edges;
+                    return false;
+                }
+            }
         }
 
-        if (n_c < 0 || n_c >= num_cols)
+        for (; x < width; ++x)
         {
-            continue;
+            if (!emit_features(prev, curr, x, y*width + x, band))
+            {
+                band.num_verts = row_num_verts;
+                band.num_edges = row_num_edges;
+                return false;
+            }
         }
 
-        int nz_idx = nz(grid, n_r, n_c);
+        return true;
+    }
 
-        if (nz_idx < grid.num_nz)
+    void detect_band(void* context, int band_index)
+    {
+        const Detect_Context* ctx = static_cast<const Detect_Context*>(context);
+        Feature_Band& band = ctx->bands[band_index];
+
+        const int width = ctx->width;
+        const unsigned int* pixels = reinterpret_cast<const unsigned int*>(ctx->colors);
+
+        for (int y = band.resume_row; y < band.row_end; ++y)
         {
-            neis.row[neis.num] = n_r;
-            neis.col[neis.num] = n_c;
-            neis.nz_idx[neis.num] = nz_idx;
-            neis.lin_idx[neis.num] = n_r*num_cols + n_c;
-            neis.num++;
+            // partial row is processed again after the buffers grow.
+            if (!detect_row(pixels + (y - 1)*width, pixels + y*width, y, width, band))
+            {
+                band.resume_row = y;
+                return;
+            }
         }
+
+        band.resume_row = band.row_end;
     }
 
-    return neis;
+    template <typename T>
+    void grow(Memory* mem, T*& data, int count, int new_capacity)
+    {
+        T* new_data = allocate<T>(mem, new_capacity);
+        corridormap_assert(new_data);
+        memcpy(new_data, data, count*sizeof(T));
+        mem->deallocate(data);
+        data = new_data;
+    }
 }
 
-CSR_Grid_Neis cell_neis(const CSR_Grid& grid, int linear_index)
+Voronoi_Features detect_voronoi_features(Memory* memory, Memory* scratch, Renderer* render_iface, Scheduler* scheduler)
 {
-    return cell_neis(grid, linear_index / grid.num_cols, linear_index % grid.num_cols);
+    int width = render_iface->params.render_target_width;
+    int height = render_iface->params.render_target_height;
+
+    Alloc_Scope<unsigned char> colors(scratch, width*height*4);
+    corridormap_assert(colors.data);
+
+    render_iface->read_pixels(colors);
+
+    return detect_voronoi_features(memory, scratch, colors, width, height, scheduler);
 }
 
-namespace
+Voronoi_Features detect_voronoi_features(Memory* memory, Memory* scratch, const unsigned char* colors, int width, int height, Scheduler* scheduler)
 {
-    int get_next_point(const CSR_Grid& edges, const Voronoi_Features& features, int current_point, int previous_point)
-    {
-        unsigned int side_1 = features.edge_obstacle_ids_1[nz(edges, current_point)];
-        unsigned int side_2 = features.edge_obstacle_ids_2[nz(edges, current_point)];
+    corridormap_build_scope(build_stage_detect_features);
 
-        CSR_Grid_Neis neis = cell_neis(edges, current_point);
+    corridormap_assert((size_t(colors) & (sizeof(unsigned int) - 1)) == 0);
 
-        for (int i = 0; i < neis.num; ++i)
-        {
-            if (neis.lin_idx[i] == previous_point)
-            {
-                continue;
-            }
+    // first row and column have no features.
+    int num_rows = height - 1;
+    int num_bands = num_threads(scheduler)*detect_bands_per_thread;
+    num_bands = (num_bands < num_rows) ? num_bands : num_rows;
+    num_bands = (num_bands > 0) ? num_bands : 0;
 
-            unsigned int nei_side_1 = features.edge_obstacle_ids_1[neis.nz_idx[i]];
-            unsigned int nei_side_2 = features.edge_obstacle_ids_2[neis.nz_idx[i]];
+    Alloc_Scope<Feature_Band> bands(scratch, num_bands);
 
-            if (nei_side_1 == side_1 && nei_side_2 == side_2 ||
-                nei_side_1 == side_2 && nei_side_2 == side_1)
-            {
-                return neis.lin_idx[i];
-            }
-        }
+    // initial guess: features are sparse, about one vertex and a few edge points per row.
+    int rows_per_band = (num_bands > 0) ? (num_rows + num_bands - 1)/num_bands : 0;
+    int initial_vert_capacity = rows_per_band + 16;
+    int initial_edge_capacity = rows_per_band*8 + 16;
 
-        return -1;
+    for (int i = 0; i < num_bands; ++i)
+    {
+        Feature_Band& band = bands[i];
+        band.row_begin = 1 + i*rows_per_band;
+        band.row_end = std::min(band.row_begin + rows_per_band, height);
+        band.resume_row = band.row_begin;
+        band.num_verts = 0;
+        band.num_edges = 0;
+        band.vert_capacity = initial_vert_capacity;
+        band.edge_capacity = initial_edge_capacity;
+        band.verts = allocate<unsigned int>(scratch, band.vert_capacity);
+        band.edges = allocate<unsigned int>(scratch, band.edge_capacity);
+        band.edge_ids_1 = allocate<unsigned int>(scratch, band.edge_capacity);
+        band.edge_ids_2 = allocate<unsigned int>(scratch, band.edge_capacity);
     }
 
-    int get_neigbour_vertex(const CSR_Grid& vertices, int cell_linear_index, int start_vert)
+    Detect_Context ctx;
+    ctx.colors = colors;
+    ctx.width = width;
+    ctx.height = height;
+    ctx.bands = bands;
+
+    // single pass over the image. bands which ran out of space grow and continue from the row they stopped at.
+    for (;;)
     {
-        CSR_Grid_Neis neis = cell_neis(vertices, cell_linear_index);
+        parallel_for(scheduler, detect_band, &ctx, num_bands);
 
-        for (int i = 0; i < neis.num; ++i)
+        bool done = true;
+
+        for (int i = 0; i < num_bands; ++i)
         {
-            if (neis.lin_idx[i] != start_vert)
+            Feature_Band& band = bands[i];
+
+            if (band.resume_row < band.row_end)
             {
-                return neis.lin_idx[i];
+                done = false;
+
+                // a single row can't have more than width features.
+                int vert_capacity = std::max(band.vert_capacity*2, band.num_verts + width);
+                int edge_capacity = std::max(band.edge_capacity*2, band.num_edges + width);
+                grow(scratch, band.verts, band.num_verts, vert_capacity);
+                grow(scratch, band.edges, band.num_edges, edge_capacity);
+                grow(scratch, band.edge_ids_1, band.num_edges, edge_capacity);
+                grow(scratch, band.edge_ids_2, band.num_edges, edge_capacity);
+                band.vert_capacity = vert_capacity;
+                band.edge_capacity = edge_capacity;
             }
         }
 
-        return -1;
+        if (done)
+        {
+            break;
+        }
     }
 
-    void fix_sides(Voronoi_Features& features, Voronoi_Edge_Spans& spans, int prev_point_nz, int curr_point_nz)
+    int num_verts = 0;
+    int num_edges = 0;
+
+    for (int i = 0; i < num_bands; ++i)
     {
-        unsigned int ps1 = features.edge_obstacle_ids_1[prev_point_nz];
+        num_verts += bands[i].num_verts;
+        num_edges += bands[i].num_edges;
+    }
 
-        unsigned int cs1 = features.edge_obstacle_ids_1[curr_point_nz];
-        unsigned int cs2 = features.edge_obstacle_ids_2[curr_point_nz];
+    Voronoi_Features features = allocate_voronoi_features(memory, width, height, num_verts, num_edges);
 
-        int ncs1 = spans.indices_1[curr_point_nz];
-        int ncs2 = spans.indices_2[curr_point_nz];
+    // bands are concatenated in row order, so output is row-major as before.
+    int vert_top = 0;
+    int edge_top = 0;
 
-        if (ps1 != cs1)
-        {
-            std::swap(cs1, cs2);
-            std::swap(ncs1, ncs2);
-        }
+    for (int i = 0; i < num_bands; ++i)
+    {
+        Feature_Band& band = bands[i];
 
-        features.edge_obstacle_ids_1[curr_point_nz] = cs1;
-        features.edge_obstacle_ids_2[curr_point_nz] = cs2;
+        memcpy(features.verts + vert_top, band.verts, band.num_verts*sizeof(features.verts[0]));
+        memcpy(features.edges + edge_top, band.edges, band.num_edges*sizeof(features.edges[0]));
+        memcpy(features.edge_obstacle_ids_1 + edge_top, band.edge_ids_1, band.num_edges*sizeof(features.edge_obstacle_ids_1[0]));
+        memcpy(features.edge_obstacle_ids_2 + edge_top, band.edge_ids_2, band.num_edges*sizeof(features.edge_obstacle_ids_2[0]));
 
-        spans.indices_1[curr_point_nz] = ncs1;
-        spans.indices_2[curr_point_nz] = ncs2;
+        vert_top += band.num_verts;
+        edge_top += band.num_edges;
     }
 
-    struct Traced_Incident_Edge
+    corridormap_build_count(num_vert_points, num_verts);
+    corridormap_build_count(num_edge_points, num_edges);
+
+    for (int i = num_bands - 1; i >= 0; --i)
     {
-        int vert;
-        unsigned int color1;
-        unsigned int color2;
-    };
+        scratch->deallocate(bands[i].edge_ids_2);
+        scratch->deallocate(bands[i].edge_ids_1);
+        scratch->deallocate(bands[i].edges);
+        scratch->deallocate(bands[i].verts);
+    }
+
+    return features;
+}
 
-    Traced_Incident_Edge trace_incident_edge(const CSR_Grid& vertices, const CSR_Grid& edges, Voronoi_Features& features, Voronoi_Edge_Spans& spans,
-                                             char* visited_edges, int start_vert, int edge_point)
+Voronoi_Feature_Stream begin_detect_voronoi_features(Memory* memory, int width, int height)
+{
+    Voronoi_Feature_Stream result;
+    memset(&result, 0, sizeof(result));
+
+    result.memory = memory;
+    result.num_rows = 0;
+    result.last_row = allocate<unsigned int>(memory, width);
+    // initial guess: features are sparse, about one vertex and a few edge points per row.
+    result.vert_capacity = height + 16;
+    result.edge_capacity = height*8 + 16;
+    result.features = allocate_voronoi_features(memory, width, height, result.vert_capacity, result.edge_capacity);
+    result.features.num_vert_points = 0;
+    result.features.num_edge_points = 0;
+
+    return result;
+}
+
+void detect_voronoi_features(Voronoi_Feature_Stream& stream, const unsigned char* rows, int num_rows)
+{
+    corridormap_build_scope(build_stage_detect_features);
+
+    corridormap_assert((size_t(rows) & (sizeof(unsigned int) - 1)) == 0);
+    corridormap_assert(stream.num_rows + num_rows <= stream.features.grid_height);
+
+    Voronoi_Features& features = stream.features;
+    const int width = features.grid_width;
+    const unsigned int* pixels = reinterpret_cast<const unsigned int*>(rows);
+
+    Feature_Band band;
+    band.verts = features.verts;
+    band.num_verts = features.num_vert_points;
+    band.vert_capacity = stream.vert_capacity;
+    band.edges = features.edges;
+    band.edge_ids_1 = features.edge_obstacle_ids_1;
+    band.edge_ids_2 = features.edge_obstacle_ids_2;
+    band.num_edges = features.num_edge_points;
+    band.edge_capacity = stream.edge_capacity;
+
+    for (int i = 0; i < num_rows; ++i)
     {
-        Traced_Incident_Edge result;
-        result.vert = -1;
-        result.color1 = 0;
-        result.color2 = 0;
+        const int y = stream.num_rows + i;
+
+        // first row has no features.
+        if (y == 0)
+        {
+            continue;
+        }
 
-        int prev = edge_point;
+        const unsigned int* prev = (i == 0) ? stream.last_row : pixels + (i - 1)*width;
+        const unsigned int* curr = pixels + i*width;
 
-        for (int curr = edge_point; curr >= 0;)
+        while (!detect_row(prev, curr, y, width, band))
         {
-            int prev_nz = nz(edges, prev);
-            int curr_nz = nz(edges, curr);
+            // a single row can't have more than width features.
+            int vert_capacity = std::max(band.vert_capacity*2, band.num_verts + width);
+            int edge_capacity = std::max(band.edge_capacity*2, band.num_edges + width);
+            grow(stream.memory, band.verts, band.num_verts, vert_capacity);
+            grow(stream.memory, band.edges, band.num_edges, edge_capacity);
+            grow(stream.memory, band.edge_ids_1, band.num_edges, edge_capacity);
+            grow(stream.memory, band.edge_ids_2, band.num_edges, edge_capacity);
+            band.vert_capacity = vert_capacity;
+            band.edge_capacity = edge_capacity;
+        }
+    }
 
-            if (visited_edges[curr_nz])
-            {
-                return result;
-            }
+    if (num_rows > 0)
+    {
+        memcpy(stream.last_row, pixels + (num_rows - 1)*width, width*sizeof(stream.last_row[0]));
+    }
 
-            visited_edges[curr_nz] = 1;
+    corridormap_build_count(num_vert_points, band.num_verts - features.num_vert_points);
+    corridormap_build_count(num_edge_points, band.num_edges - features.num_edge_points);
+
+    stream.num_rows += num_rows;
+    stream.vert_capacity = band.vert_capacity;
+    stream.edge_capacity = band.edge_capacity;
+    features.verts = band.verts;
+    features.num_vert_points = band.num_verts;
+    features.edges = band.edges;
+    features.edge_obstacle_ids_1 = band.edge_ids_1;
+    features.edge_obstacle_ids_2 = band.edge_ids_2;
+    features.num_edge_points = band.num_edges;
+}
 
-            fix_sides(features, spans, prev_nz, curr_nz);
+Voronoi_Features end_detect_voronoi_features(Voronoi_Feature_Stream& stream)
+{
+    Voronoi_Features result = stream.features;
+    stream.memory->deallocate(stream.last_row);
+    memset(&stream, 0, sizeof(stream));
+    return result;
+}
 
-            int vert = get_neigbour_vertex(vertices, curr, start_vert);
+Voronoi_Features stream_voronoi_features(Memory* memory, Memory* scratch, Renderer* render_iface, int rows_per_read)
+{
+    int width = render_iface->params.render_target_width;
+    int height = render_iface->params.render_target_height;
 
-            if (vert >= 0)
-            {
-                result.vert = vert;
-                result.color1 = features.edge_obstacle_ids_1[curr_nz];
-                result.color2 = features.edge_obstacle_ids_2[curr_nz];
-                return result;
-            }
+    corridormap_assert(rows_per_read > 0);
+    rows_per_read = std::min(rows_per_read, height);
 
-            int next = get_next_point(edges, features, curr, prev);
-            prev = curr;
-            curr = next;
-        }
+    Alloc_Scope<unsigned char> rows(scratch, width*rows_per_read*4);
+    corridormap_assert(rows.data);
 
-        return result;
-    }
+    Voronoi_Feature_Stream stream = begin_detect_voronoi_features(memory, width, height);
 
-    int trace_event_points(const CSR_Grid& vertices, const CSR_Grid& edges, const Voronoi_Features& features, const Voronoi_Edge_Spans& spans,
-                           int start_vert, int edge_point, int* events)
+    if (render_iface->read_rows(0, rows_per_read, rows))
     {
-        int num_events = 0;
-        int prev = edge_point;
-
-        for (int curr = edge_point; curr >= 0;)
+        for (int y = 0; y < height; y += rows_per_read)
         {
-            if (get_neigbour_vertex(vertices, curr, start_vert) >= 0)
-            {
-                break;
-            }
-
-            int p_n1 = spans.indices_1[nz(edges, prev)];
-            int p_n2 = spans.indices_2[nz(edges, prev)];
-            int c_n1 = spans.indices_1[nz(edges, curr)];
-            int c_n2 = spans.indices_2[nz(edges, curr)];
+            int num_rows = std::min(rows_per_read, height - y);
 
-            // side 1 event.
-            if (p_n1 != c_n1)
+            if (y > 0)
             {
-                events[num_events++] = c_n1 > 0 ? curr : prev;
-            }
-            // side 2 event.
-            else if (p_n2 != c_n2)
-            {
-                events[num_events++] = c_n2 > 0 ? -curr : -prev;
+                render_iface->read_rows(y, num_rows, rows);
             }
 
-            int next = get_next_point(edges, features, curr, prev);
-            prev = curr;
-            curr = next;
+            detect_voronoi_features(stream, rows, num_rows);
         }
+    }
+    else
+    {
+        // backend can't read rows: the whole render target is read once and streamed from the copy.
+        Alloc_Scope<unsigned char> pixels(scratch, width*height*4);
+        render_iface->read_pixels(pixels);
 
-        return num_events;
+        for (int y = 0; y < height; y += rows_per_read)
+        {
+            detect_voronoi_features(stream, pixels + y*width*4, std::min(rows_per_read, height - y));
+        }
     }
+
+    return end_detect_voronoi_features(stream);
 }
 
-void trace_edges(Memory* scratch, const CSR_Grid& vertices, const CSR_Grid& edges,
-                 Voronoi_Edge_Spans& spans, Voronoi_Features& features, Voronoi_Traced_Edges& out)
+namespace
 {
-    Dequeue<int> queue_vert(scratch, vertices.num_nz);
-    Alloc_Scope<char> visited_vert(scratch, vertices.num_nz);
-    Alloc_Scope<char> visited_edge(scratch, edges.num_nz);
-    zero_mem(visited_vert);
-    zero_mem(visited_edge);
-
-    int start_vert = features.verts[0];
+    inline void store_edge_normal(Vec2 u, Vec2 v, float*& out_x, float*& out_y)
+    {
+        Vec2 dir = normalized(v - u);
+        *out_x++ = +dir.y;
+        *out_y++ = -dir.x;
+    }
+}
 
-    push_back(queue_vert, start_vert);
-    visited_vert[nz(vertices, start_vert)] = 1;
+void build_footprint_normals(const Footprint& in, Bbox2 bounds, Footprint_Normals& out)
+{
+    const float* poly_x = in.x;
+    const float* poly_y = in.y;
+    const int* num_poly_verts = in.num_poly_verts;
+    const int num_polys = in.num_polys;
 
-    int* out_u = out.u;
-    int* out_v = out.v;
-    unsigned int* out_obstacle_ids_1 = out.obstacle_ids_1;
-    unsigned int* out_obstacle_ids_2 = out.obstacle_ids_2;
-    int* out_events = out.events;
-    int* out_event_offsets = out.edge_event_offset;
-    int* out_num_events = out.edge_num_events;
+    float* normal_x = out.x;
+    float* normal_y = out.y;
+    int* num_obstacle_normals = out.num_obstacle_normals;
+    int* obstacle_normal_offsets = out.obstacle_normal_offsets;
 
-    int num_edges = 0;
-    int num_events = 0;
+    int num_normals = 0;
 
-    while (size(queue_vert) > 0)
+    for (int i = 0; i < num_polys; ++i)
     {
-        int u = pop_front(queue_vert);
-        visited_vert[nz(vertices, u)] = 1;
+        *obstacle_normal_offsets++ = num_normals;
 
-        CSR_Grid_Neis neis = cell_neis(edges, u);
+        int nverts = num_poly_verts[i];
 
-        for (int i = 0; i < neis.num; ++i)
+        int curr_idx = nverts - 1;
+        int next_idx = 0;
+
+        for (; next_idx < nverts; curr_idx = next_idx++, ++num_normals)
         {
-            Traced_Incident_Edge e = trace_incident_edge(vertices, edges, features, spans, visited_edge, u, neis.lin_idx[i]);
+            Vec2 curr = { poly_x[curr_idx], poly_y[curr_idx] };
+            Vec2 next = { poly_x[next_idx], poly_y[next_idx] };
+            store_edge_normal(curr, next, normal_x, normal_y);
+        }
 
-            if (e.vert < 0)
-            {
-                continue;
-            }
+        poly_x += nverts;
+        poly_y += nverts;
 
-            int v = e.vert;
-            int num_edge_events = trace_event_points(vertices, edges, features, spans, u, neis.lin_idx[i], out_events + num_events);
+        *num_obstacle_normals++ = nverts;
+    }
+
+    // bisectors at vertices: vertex k is shared by edges with normals k and k+1.
+    for (int i = 0; i < num_polys; ++i)
+    {
+        int first_idx = out.obstacle_normal_offsets[i];
+        int last_idx = first_idx + out.num_obstacle_normals[i] - 1;
 
-            out_u[num_edges] = u;
-            out_v[num_edges] = v;
-            out_obstacle_ids_1[num_edges] = e.color1;
-            out_obstacle_ids_2[num_edges] = e.color2;
-            out_event_offsets[num_edges] = num_events;
-            out_num_events[num_edges] = num_edge_events;
+        for (int curr_idx = first_idx; curr_idx <= last_idx; ++curr_idx)
+        {
+            int next_idx = (curr_idx < last_idx) ? curr_idx + 1 : first_idx;
 
-            num_edges++;
-            num_events += num_edge_events;
+            Vec2 normal_curr = { out.x[curr_idx], out.y[curr_idx] };
+            Vec2 normal_next = { out.x[next_idx], out.y[next_idx] };
+            Vec2 mid = normalized((normal_curr + normal_next)*0.5f);
+            float c = dot(normal_curr, mid);
 
-            if (visited_vert[nz(vertices, v)] != 1)
-            {
-                push_back(queue_vert, v);
-            }
+            out.bisector_x[curr_idx] = mid.x;
+            out.bisector_y[curr_idx] = mid.y;
+            out.bisector_threshold[curr_idx] = c*fabsf(c);
         }
     }
 
-    out.num_edges = num_edges;
-    out.num_events = num_events;
+    {
+        Vec2 lt = { bounds.min[0], bounds.max[1] };
+        Vec2 lb = { bounds.min[0], bounds.min[1] };
+        Vec2 rt = { bounds.max[0], bounds.max[1] };
+        Vec2 rb = { bounds.max[0], bounds.min[1] };
+
+        store_edge_normal(lb, rb, normal_x, normal_y);
+        store_edge_normal(rb, rt, normal_x, normal_y);
+        store_edge_normal(rt, lt, normal_x, normal_y);
+        store_edge_normal(lt, lb, normal_x, normal_y);
+
+        for (int i = 0; i < num_border_segments; ++i)
+        {
+            *obstacle_normal_offsets++ = num_normals + i;
+            *num_obstacle_normals++ = 1;
+        }
+    }
 }
 
 namespace
 {
-    struct Segement_Closest_Point
+    // consecutive polygon edges per leaf of the edge tree.
+    enum { edge_tree_leaf_edges = 8 };
+    // polygons with fewer edges are queried by brute force.
+    enum { edge_tree_min_edges = 32 };
+    // deep enough for 2^31 leaves.
+    enum { edge_tree_max_levels = 32 };
+
+    int edge_tree_num_leaves(int num_edges)
     {
-        Vec2 closest;
-        float dist;
-    };
+        return (num_edges < edge_tree_min_edges) ? 0 : (num_edges + edge_tree_leaf_edges - 1)/edge_tree_leaf_edges;
+    }
 
-    Segement_Closest_Point closest_to_segment(const Vec2& point, const Vec2& p0, const Vec2& p1)
+    // fills offsets and sizes of tree levels from leaves to the root, returns the number of levels.
+    int edge_tree_levels(int num_leaves, int* level_offsets, int* level_sizes)
     {
-        Segement_Closest_Point result;
+        int num_levels = 0;
 
-        Vec2 seg = p1 - p0;
-        Vec2 dir = normalized(seg);
-        float seg_len = mag(seg);
+        for (int size = num_leaves, offset = 0; size > 0; size = (size + 1)/2)
+        {
+            level_offsets[num_levels] = offset;
+            level_sizes[num_levels] = size;
+            ++num_levels;
+            offset += size;
 
-        float proj = dot(point - p0, dir);
+            if (size == 1)
+            {
+                break;
+            }
+        }
 
-        Vec2 seg_closest = p0 + dir*clamp(proj, 0.f, seg_len);
+        return num_levels;
+    }
 
-        Vec2 seg_closest_dir = seg_closest - point;
-        float seg_closest_dist = dot(seg_closest_dir, seg_closest_dir);
+    inline void include(float* box, Vec2 p)
+    {
+        box[0] = std::min(box[0], p.x);
+        box[1] = std::min(box[1], p.y);
+        box[2] = std::max(box[2], p.x);
+        box[3] = std::max(box[3], p.y);
+    }
+}
 
-        result.closest = seg_closest;
-        result.dist = seg_closest_dist;
+int footprint_edge_tree_nodes(const Footprint& f)
+{
+    int result = 0;
 
-        return result;
+    for (int i = 0; i < f.num_polys; ++i)
+    {
+        int level_offsets[edge_tree_max_levels];
+        int level_sizes[edge_tree_max_levels];
+        int num_levels = edge_tree_levels(edge_tree_num_leaves(f.num_poly_verts[i]), level_offsets, level_sizes);
+        result += (num_levels > 0) ? level_offsets[num_levels - 1] + 1 : 0;
     }
 
-    Vec2 compute_closest_point(const Footprint& obstacles, const Bbox2& bounds, const int* obstacle_offsets, unsigned int obstacle_id, const Vec2& point)
+    return result;
+}
+
+void build_footprint_edge_tree(const Footprint& in, Footprint_Edge_Tree& out)
+{
+    int num_nodes = 0;
+
+    for (int i = 0, first_vertex = 0; i < in.num_polys; first_vertex += in.num_poly_verts[i++])
     {
-        int oid = obstacle_id - 1;
+        const int num_edges = in.num_poly_verts[i];
+        const int num_leaves = edge_tree_num_leaves(num_edges);
 
-        if (oid < 0)
-        {
-            return point;
-        }
+        out.poly_node_offsets[i] = num_nodes;
+        out.poly_num_leaves[i] = num_leaves;
 
-        if (oid >= obstacles.num_polys)
+        int level_offsets[edge_tree_max_levels];
+        int level_sizes[edge_tree_max_levels];
+        int num_levels = edge_tree_levels(num_leaves, level_offsets, level_sizes);
+
+        float* nodes = out.node_bounds + num_nodes*4;
+
+        // edge k goes from vertex k-1 to vertex k, as polygon normals.
+        for (int leaf = 0; leaf < num_leaves; ++leaf)
+        {
+            float* box = nodes + leaf*4;
+            int last_vertex = first_vertex + std::min((leaf + 1)*edge_tree_leaf_edges, num_edges) - 1;
+            int curr_vertex = first_vertex + ((leaf == 0) ? num_edges - 1 : leaf*edge_tree_leaf_edges - 1);
+
+            box[0] = box[2] = in.x[curr_vertex];
+            box[1] = box[3] = in.y[curr_vertex];
+
+            for (int k = first_vertex + leaf*edge_tree_leaf_edges; k <= last_vertex; ++k)
+            {
+                Vec2 p = { in.x[k], in.y[k] };
+                include(box, p);
+            }
+        }
+
+        for (int level = 1; level < num_levels; ++level)
+        {
+            for (int node = 0; node < level_sizes[level]; ++node)
+            {
+                float* box = nodes + (level_offsets[level] + node)*4;
+                const float* child = nodes + (level_offsets[level - 1] + node*2)*4;
+                memcpy(box, child, 4*sizeof(float));
+
+                if (node*2 + 1 < level_sizes[level - 1])
+                {
+                    box[0] = std::min(box[0], child[4]);
+                    box[1] = std::min(box[1], child[5]);
+                    box[2] = std::max(box[2], child[6]);
+                    box[3] = std::max(box[3], child[7]);
+                }
+            }
+        }
+
+        num_nodes += (num_levels > 0) ? level_offsets[num_levels - 1] + 1 : 0;
+    }
+
+    corridormap_assert(num_nodes <= out.num_nodes);
+}
+
+namespace
+{
+    enum { spans_points_per_job = 4096 };
+
+    // dot(normalized(p - v), bisector) >= cosine without the square root and division:
+    // both sides are multiplied by |p - v| and squared keeping the sign.
+    inline bool in_span(float dx, float dy, float bisector_x, float bisector_y, float threshold)
+    {
+        float d = dx*bisector_x + dy*bisector_y;
+        float len_sq = dx*dx + dy*dy;
+        return len_sq > 0.f && d*fabsf(d) >= threshold*len_sq;
+    }
+
+#if CORRIDORMAP_SSE2
+    enum { spans_lanes = 4 };
+
+    // returns bit mask of vertices [k, k + lanes) whose span contains the point.
+    inline unsigned span_mask(const float* vertex_x, const float* vertex_y, const float* bisector_x, const float* bisector_y,
+                              const float* threshold, int k, Vec2 point)
+    {
+        __m128 dx = _mm_sub_ps(_mm_set1_ps(point.x), _mm_loadu_ps(vertex_x + k));
+        __m128 dy = _mm_sub_ps(_mm_set1_ps(point.y), _mm_loadu_ps(vertex_y + k));
+        __m128 d = _mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(bisector_x + k)), _mm_mul_ps(dy, _mm_loadu_ps(bisector_y + k)));
+        __m128 len_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 abs_d = _mm_andnot_ps(_mm_set1_ps(-0.f), d);
+
+        __m128 inside = _mm_cmpge_ps(_mm_mul_ps(d, abs_d), _mm_mul_ps(_mm_loadu_ps(threshold + k), len_sq));
+        __m128 nonzero = _mm_cmpgt_ps(len_sq, _mm_setzero_ps());
+
+        return unsigned(_mm_movemask_ps(_mm_and_ps(inside, nonzero)));
+    }
+#else
+    enum { spans_lanes = 1 };
+
+    inline unsigned span_mask(const float* vertex_x, const float* vertex_y, const float* bisector_x, const float* bisector_y,
+                              const float* threshold, int k, Vec2 point)
+    {
+        return in_span(point.x - vertex_x[k], point.y - vertex_y[k], bisector_x[k], bisector_y[k], threshold[k]) ? 1u : 0u;
+    }
+#endif
+
+    // tests vertices in the order: last, first, ..., last - 1. returns index of the first one whose span contains the point plus one, or zero.
+    int find_normal_index(const Footprint& obstacles, const Footprint_Normals& normals, const unsigned int obstacle_id, const Vec2 edge_point)
+    {
+        int oid = int(obstacle_id) - 1;
+
+        // border sides have a single normal and no vertices in the footprint.
+        if (oid < 0 || oid >= obstacles.num_polys)
+        {
+            return 0;
+        }
+
+        const float* vertex_x = obstacles.x;
+        const float* vertex_y = obstacles.y;
+        const float* bisector_x = normals.bisector_x;
+        const float* bisector_y = normals.bisector_y;
+        const float* threshold = normals.bisector_threshold;
+
+        int first_idx = normals.obstacle_normal_offsets[oid];
+        int last_idx = first_idx + normals.num_obstacle_normals[oid] - 1;
+
+        if (in_span(edge_point.x - vertex_x[last_idx], edge_point.y - vertex_y[last_idx], bisector_x[last_idx], bisector_y[last_idx], threshold[last_idx]))
+        {
+            return last_idx + 1;
+        }
+
+        int k = first_idx;
+
+        for (; k + spans_lanes <= last_idx; k += spans_lanes)
+        {
+            unsigned mask = span_mask(vertex_x, vertex_y, bisector_x, bisector_y, threshold, k, edge_point);
+
+            if (mask != 0)
+            {
+                int lane = 0;
+
+                while ((mask & (1u << lane)) == 0)
+                {
+                    ++lane;
+                }
+
+                return k + lane + 1;
+            }
+        }
+
+        for (; k < last_idx; ++k)
+        {
+            if (in_span(edge_point.x - vertex_x[k], edge_point.y - vertex_y[k], bisector_x[k], bisector_y[k], threshold[k]))
+            {
+                return k + 1;
+            }
+        }
+
+        return 0;
+    }
+
+    struct Edge_Spans_Context
+    {
+        const Voronoi_Features* features;
+        const Footprint* obstacles;
+        const Footprint_Normals* normals;
+        Bbox2 bounds;
+        Voronoi_Edge_Spans* out;
+    };
+
+    void build_edge_spans_job(void* context, int job_index)
+    {
+        const Edge_Spans_Context* ctx = static_cast<const Edge_Spans_Context*>(context);
+        const Voronoi_Features& features = *ctx->features;
+        const Bbox2& bounds = ctx->bounds;
+
+        const int grid_width = features.grid_width;
+        const int grid_height = features.grid_height;
+        const float bounds_width = bounds.max[0] - bounds.min[0];
+        const float bounds_height = bounds.max[1] - bounds.min[1];
+
+        const int first = job_index*spans_points_per_job;
+        const int last = std::min(first + spans_points_per_job, features.num_edge_points);
+
+        for (int i = first; i < last; ++i)
+        {
+            unsigned int edge_point_idx = features.edges[i];
+
+            int edge_point_x = edge_point_idx%grid_width;
+            int edge_point_y = edge_point_idx/grid_width;
+
+            Vec2 edge_point = { bounds.min[0] + float(edge_point_x)/grid_width * bounds_width, bounds.min[1] + float(edge_point_y)/grid_height * bounds_height};
+
+            ctx->out->indices_1[i] = find_normal_index(*ctx->obstacles, *ctx->normals, features.edge_obstacle_ids_1[i], edge_point);
+            ctx->out->indices_2[i] = find_normal_index(*ctx->obstacles, *ctx->normals, features.edge_obstacle_ids_2[i], edge_point);
+        }
+    }
+}
+
+void build_edge_spans(const Voronoi_Features& features, const Footprint& obstacles, const Footprint_Normals& normals, Bbox2 bounds, Voronoi_Edge_Spans& out, Scheduler* scheduler)
+{
+    corridormap_build_scope(build_stage_edge_spans);
+
+    Edge_Spans_Context ctx;
+    ctx.features = &features;
+    ctx.obstacles = &obstacles;
+    ctx.normals = &normals;
+    ctx.bounds = bounds;
+    ctx.out = &out;
+
+    parallel_for(scheduler, build_edge_spans_job, &ctx, (features.num_edge_points + spans_points_per_job - 1)/spans_points_per_job);
+}
+
+void build_csr(const unsigned int* nz_coords, CSR_Grid& out)
+{
+    corridormap_build_scope(build_stage_csr);
+
+    int* column = out.column;
+    int* row_offset = out.row_offset;
+    unsigned int* occupancy = out.occupancy;
+    int* occupancy_rank = out.occupancy_rank;
+
+    const int num_cols = out.num_cols;
+    const int num_rows = out.num_rows;
+    const int num_nz = out.num_nz;
+    const int num_words = out.num_occupancy_words;
+
+    memset(occupancy, 0, num_words*sizeof(occupancy[0]));
+
+    int next_row = 0;
+    int next_word = 0;
+
+    for (int i = 0; i < num_nz; ++i)
+    {
+        unsigned int coord = nz_coords[i];
+
+        column[i] = coord % num_cols;
+        int curr_row = coord / num_cols;
+
+        for (int j = next_row; j <= curr_row; ++j)
+        {
+            row_offset[j] = i;
+        }
+
+        next_row = curr_row + 1;
+
+        // coordinates are sorted, so rank of the word is the index of its first non-zero cell.
+        int curr_word = coord / csr_occupancy_word_bits;
+
+        for (int j = next_word; j <= curr_word; ++j)
+        {
+            occupancy_rank[j] = i;
+        }
+
+        next_word = curr_word + 1;
+        occupancy[curr_word] |= 1u << (coord % csr_occupancy_word_bits);
+    }
+
+    for (int j = next_row; j < num_rows + 1; ++j)
+    {
+        row_offset[j] = num_nz;
+    }
+
+    for (int j = next_word; j < num_words; ++j)
+    {
+        occupancy_rank[j] = num_nz;
+    }
+}
+
+namespace
+{
+    inline int popcount(unsigned int v)
+    {
+        v = v - ((v >> 1) & 0x55555555u);
+        v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+        return int((((v + (v >> 4)) & 0x0f0f0f0fu)*0x01010101u) >> 24);
+    }
+}
+
+int nz(const CSR_Grid& grid, int row, int col)
+{
+    return nz(grid, row*grid.num_cols + col);
+}
+
+int nz(const CSR_Grid& grid, int linear_index)
+{
+    unsigned int word_idx = unsigned(linear_index) / csr_occupancy_word_bits;
+    unsigned int bit = 1u << (unsigned(linear_index) % csr_occupancy_word_bits);
+    unsigned int word = grid.occupancy[word_idx];
+
+    if ((word & bit) == 0)
+    {
+        return grid.num_nz;
+    }
+
+    // rank: non-zero cells before the word plus set bits below the cell.
+    return grid.occupancy_rank[word_idx] + popcount(word & (bit - 1));
+}
+
+namespace
+{
+    int nei_offset_row[] = { +0, -1, +1, +0 };
+    int nei_offset_col[] = { -1, +0, +0, +1 };
+}
+
+CSR_Grid_Neis cell_neis(const CSR_Grid& grid, int row, int col)
+{
+    int num_rows = grid.num_rows;
+    int num_cols = grid.num_cols;
+
+    CSR_Grid_Neis neis;
+    neis.num = 0;
+
+    for (int i = 0; i < sizeof(nei_offset_row)/sizeof(nei_offset_row[0]); ++i)
+    {
+        int n_r = row + nei_offset_row[i];
+        int n_c = col + nei_offset_col[i];
+
+        if (n_r < 0 || n_r >= num_rows)
+        {
+            continue;
+        }
+
+        if (n_c < 0 || n_c >= num_cols)
+        {
+            continue;
+        }
+
+        int nz_idx = nz(grid, n_r, n_c);
+
+        if (nz_idx < grid.num_nz)
+        {
+            neis.row[neis.num] = n_r;
+            neis.col[neis.num] = n_c;
+            neis.nz_idx[neis.num] = nz_idx;
+            neis.lin_idx[neis.num] = n_r*num_cols + n_c;
+            neis.num++;
+        }
+    }
+
+    return neis;
+}
+
+CSR_Grid_Neis cell_neis(const CSR_Grid& grid, int linear_index)
+{
+    return cell_neis(grid, linear_index / grid.num_cols, linear_index % grid.num_cols);
+}
+
+namespace
+{
+    int get_next_point(const CSR_Grid& edges, const Voronoi_Features& features, int current_point, int previous_point)
+    {
+        unsigned int side_1 = features.edge_obstacle_ids_1[nz(edges, current_point)];
+        unsigned int side_2 = features.edge_obstacle_ids_2[nz(edges, current_point)];
+
+        CSR_Grid_Neis neis = cell_neis(edges, current_point);
+
+        for (int i = 0; i < neis.num; ++i)
+        {
+            if (neis.lin_idx[i] == previous_point)
+            {
+                continue;
+            }
+
+            unsigned int nei_side_1 = features.edge_obstacle_ids_1[neis.nz_idx[i]];
+            unsigned int nei_side_2 = features.edge_obstacle_ids_2[neis.nz_idx[i]];
+
+            if (nei_side_1 == side_1 && nei_side_2 == side_2 ||
+                nei_side_1 == side_2 && nei_side_2 == side_1)
+            {
+                return neis.lin_idx[i];
+            }
+        }
+
+        return -1;
+    }
+
+    int get_neigbour_vertex(const CSR_Grid& vertices, int cell_linear_index, int start_vert)
+    {
+        CSR_Grid_Neis neis = cell_neis(vertices, cell_linear_index);
+
+        for (int i = 0; i < neis.num; ++i)
+        {
+            if (neis.lin_idx[i] != start_vert)
+            {
+                return neis.lin_idx[i];
+            }
+        }
+
+        return -1;
+    }
+
+    Grid_Window empty_window()
+    {
+        Grid_Window result = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        return result;
+    }
+
+    inline void include(Grid_Window& window, int x, int y)
+    {
+        window.min_x = std::min(window.min_x, x);
+        window.min_y = std::min(window.min_y, y);
+        window.max_x = std::max(window.max_x, x);
+        window.max_y = std::max(window.max_y, y);
+    }
+
+    inline bool contains(const Grid_Window& window, int x, int y)
+    {
+        return x >= window.min_x && x <= window.max_x && y >= window.min_y && y <= window.max_y;
+    }
+
+    inline bool intersect(const Grid_Window& a, const Grid_Window& b)
+    {
+        return a.min_x <= b.max_x && b.min_x <= a.max_x && a.min_y <= b.max_y && b.min_y <= a.max_y;
+    }
+
+    // edge walked from the vertex with index vert in Voronoi_Features::verts, starting at its edge neighbour nei.
+    // the walk is identified by token = vert*max_grid_neis + nei, tokens order the output edges.
+    struct Trace_Record
+    {
+        // end vertex, -1 if the walk didn't reach a vertex.
+        int v;
+        int first;
+        int last;
+        unsigned int color1;
+        unsigned int color2;
+        // number of points walked, a point passed twice is counted twice.
+        int num_points;
+        int num_events;
+        // bounding window of the path.
+        Grid_Window window;
+    };
+
+    struct Trace_Context
+    {
+        const CSR_Grid* vertices;
+        const CSR_Grid* edges;
+        Voronoi_Features* features;
+        Voronoi_Edge_Spans* spans;
+        Voronoi_Traced_Edges* out;
+
+        // per edge point: token*2 + side swap bit of the smallest walk passing the point, -1 if not walked.
+        std::atomic<int>* owners;
+        // optional, per edge point: number of passes of walks which reached a vertex.
+        std::atomic<int>* visits;
+        // per token.
+        Trace_Record* records;
+        // per token: number of points owned by the walk.
+        std::atomic<int>* owned;
+
+        // walked tokens, all tokens [0 .. num_tokens) if null.
+        const int* tokens;
+        int num_tokens;
+
+        // per job: number of output edges and events, then their offsets.
+        int* job_edges;
+        int* job_events;
+
+        // optional, receives walks and point owners.
+        Voronoi_Trace_State* state;
+    };
+
+    enum { trace_tokens_per_job = 256 };
+    enum { trace_points_per_job = 4096 };
+
+    enum Walk_Mode
+    {
+        // find the end vertex, count points and events.
+        walk_probe,
+        // claim points of the walk which reached a vertex.
+        walk_claim,
+        // count passes of points in visits.
+        walk_visit,
+        // write events of the owned edge.
+        walk_write
+    };
+
+    // the point is owned by the walk with the smallest token passing it, the swap bit is from the first pass of that walk.
+    void claim_point(std::atomic<int>& owner, int token, int swap)
+    {
+        const int word = token*2 + swap;
+        int current = owner.load(std::memory_order_relaxed);
+
+        while (current < 0 || (current >> 1) > token)
+        {
+            if (owner.compare_exchange_weak(current, word))
+            {
+                return;
+            }
+        }
+    }
+
+    // walks the edge from start_vert to the next vertex. the path depends only on features, walks don't stop
+    // at points of other walks, so the owners of the points are the same for any order of walks.
+    // features and spans are not modified: side swaps are kept in the point owners and applied after all edges are traced.
+    void walk_edge(const Trace_Context* ctx, int token, int start_vert, Walk_Mode mode, Trace_Record& record, int* events)
+    {
+        const CSR_Grid& vertices = *ctx->vertices;
+        const CSR_Grid& edges = *ctx->edges;
+        const Voronoi_Features& features = *ctx->features;
+        const Voronoi_Edge_Spans& spans = *ctx->spans;
+
+        int num_points = 0;
+        int num_events = 0;
+        int prev = record.first;
+
+        // sides of the previous point, after fix.
+        unsigned int ps1 = 0;
+        int pn1 = 0;
+        int pn2 = 0;
+
+        // brent's cycle detection on the walk state: edge points without vertices can form a loop.
+        int saved_curr = -1;
+        int saved_prev = -1;
+        int power = 1;
+        int length = 0;
+
+        if (mode == walk_probe)
+        {
+            record.window = empty_window();
+        }
+
+        for (int curr = record.first; curr >= 0;)
+        {
+            int curr_nz = nz(edges, curr);
+            int swap;
+
+            if (mode != walk_write)
+            {
+                swap = (curr != prev && ps1 != features.edge_obstacle_ids_1[curr_nz]) ? 1 : 0;
+
+                if (mode == walk_claim)
+                {
+                    claim_point(ctx->owners[curr_nz], token, swap);
+                }
+
+                if (mode == walk_visit || (mode == walk_claim && ctx->visits))
+                {
+                    ctx->visits[curr_nz].fetch_add(1, std::memory_order_relaxed);
+                }
+
+                if (mode == walk_probe)
+                {
+                    include(record.window, curr % edges.num_cols, curr / edges.num_cols);
+                }
+            }
+            else
+            {
+                swap = ctx->owners[curr_nz].load(std::memory_order_relaxed) & 1;
+            }
+
+            num_points++;
+
+            unsigned int cs1 = swap ? features.edge_obstacle_ids_2[curr_nz] : features.edge_obstacle_ids_1[curr_nz];
+            unsigned int cs2 = swap ? features.edge_obstacle_ids_1[curr_nz] : features.edge_obstacle_ids_2[curr_nz];
+            int cn1 = swap ? spans.indices_2[curr_nz] : spans.indices_1[curr_nz];
+            int cn2 = swap ? spans.indices_1[curr_nz] : spans.indices_2[curr_nz];
+
+            int vert = get_neigbour_vertex(vertices, curr, start_vert);
+
+            if (vert >= 0)
+            {
+                if (mode == walk_claim)
+                {
+                    return;
+                }
+
+                record.v = vert;
+                record.last = curr;
+                record.color1 = cs1;
+                record.color2 = cs2;
+                record.num_points = num_points;
+                record.num_events = num_events;
+                return;
+            }
+
+            if (curr != prev)
+            {
+                // side 1 event.
+                if (pn1 != cn1)
+                {
+                    if (mode == walk_write) { events[num_events] = cn1 > 0 ? curr : prev; }
+                    num_events++;
+                }
+                // side 2 event.
+                else if (pn2 != cn2)
+                {
+                    if (mode == walk_write) { events[num_events] = cn2 > 0 ? -curr : -prev; }
+                    num_events++;
+                }
+            }
+
+            ps1 = cs1;
+            pn1 = cn1;
+            pn2 = cn2;
+
+            int next = get_next_point(edges, features, curr, prev);
+            prev = curr;
+            curr = next;
+
+            if (curr == saved_curr && prev == saved_prev)
+            {
+                return;
+            }
+
+            if (++length == power)
+            {
+                saved_curr = curr;
+                saved_prev = prev;
+                power *= 2;
+                length = 0;
+            }
+        }
+    }
+
+    // finds the end of the walk, then claims its points if it reached a vertex.
+    void walk_token(const Trace_Context* ctx, int token)
+    {
+        int u = ctx->features->verts[token/max_grid_neis];
+        CSR_Grid_Neis neis = cell_neis(*ctx->edges, u);
+
+        Trace_Record& record = ctx->records[token];
+        record.v = -1;
+        record.num_points = 0;
+        record.window = empty_window();
+
+        if (token % max_grid_neis < neis.num)
+        {
+            record.first = neis.lin_idx[token % max_grid_neis];
+            walk_edge(ctx, token, u, walk_probe, record, 0);
+
+            // walks ending in a loop or a dead end don't take points from the edges.
+            if (record.v >= 0)
+            {
+                walk_edge(ctx, token, u, walk_claim, record, 0);
+            }
+        }
+    }
+
+    void walk_tokens(void* context, int job_index)
+    {
+        Trace_Context* ctx = static_cast<Trace_Context*>(context);
+
+        int first = job_index*trace_tokens_per_job;
+        int last = std::min(first + trace_tokens_per_job, ctx->num_tokens);
+
+        for (int i = first; i < last; ++i)
+        {
+            walk_token(ctx, ctx->tokens ? ctx->tokens[i] : i);
+        }
+    }
+
+    void count_owned_points(void* context, int job_index)
+    {
+        Trace_Context* ctx = static_cast<Trace_Context*>(context);
+
+        int first = job_index*trace_points_per_job;
+        int last = std::min(first + trace_points_per_job, ctx->edges->num_nz);
+
+        for (int i = first; i < last; ++i)
+        {
+            int owner = ctx->owners[i].load(std::memory_order_relaxed);
+
+            if (owner >= 0)
+            {
+                ctx->owned[owner >> 1].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // an edge is kept if its walk reached a vertex and owns every point it passed, each of them once.
+    // an edge walked from both ends is kept by the walk from the earlier vertex.
+    bool owns_edge(const Trace_Context* ctx, int token)
+    {
+        const Trace_Record& record = ctx->records[token];
+        return record.v >= 0 && ctx->owned[token].load(std::memory_order_relaxed) == record.num_points;
+    }
+
+    void count_job_edges(void* context, int job_index)
+    {
+        Trace_Context* ctx = static_cast<Trace_Context*>(context);
+
+        int first = job_index*trace_tokens_per_job;
+        int last = std::min(first + trace_tokens_per_job, ctx->num_tokens);
+
+        int num_edges = 0;
+        int num_events = 0;
+
+        for (int token = first; token < last; ++token)
+        {
+            if (owns_edge(ctx, token))
+            {
+                num_edges++;
+                num_events += ctx->records[token].num_events;
+            }
+        }
+
+        ctx->job_edges[job_index] = num_edges;
+        ctx->job_events[job_index] = num_events;
+    }
+
+    // writes an owned edge, the swap bits of its points must be final.
+    void write_edge(const Trace_Context* ctx, int token, int edge, int event_offset)
+    {
+        Voronoi_Traced_Edges& out = *ctx->out;
+        Trace_Record& record = ctx->records[token];
+        int u = ctx->features->verts[token/max_grid_neis];
+
+        out.u[edge] = u;
+        out.v[edge] = record.v;
+        out.obstacle_ids_1[edge] = record.color1;
+        out.obstacle_ids_2[edge] = record.color2;
+        out.edge_event_offset[edge] = event_offset;
+        out.edge_num_events[edge] = record.num_events;
+
+        walk_edge(ctx, token, u, walk_write, record, out.events + event_offset);
+    }
+
+    void write_job_edges(void* context, int job_index)
+    {
+        Trace_Context* ctx = static_cast<Trace_Context*>(context);
+        Voronoi_Trace_State* state = ctx->state;
+
+        int first = job_index*trace_tokens_per_job;
+        int last = std::min(first + trace_tokens_per_job, ctx->num_tokens);
+
+        int num_edges = ctx->job_edges[job_index];
+        int num_events = ctx->job_events[job_index];
+
+        for (int token = first; token < last; ++token)
+        {
+            const Trace_Record& record = ctx->records[token];
+            bool owned = owns_edge(ctx, token);
+
+            if (state)
+            {
+                state->walk_edges[token] = owned ? num_edges : -1;
+                state->walk_points[token] = record.v >= 0 ? record.num_points : 0;
+                state->walk_windows[token] = record.window;
+            }
+
+            if (!owned)
+            {
+                continue;
+            }
+
+            if (state)
+            {
+                state->edge_sources[num_edges] = -1;
+            }
+
+            write_edge(ctx, token, num_edges, num_events);
+
+            num_edges++;
+            num_events += record.num_events;
+        }
+    }
+
+    void apply_swap_sides(void* context, int job_index)
+    {
+        Trace_Context* ctx = static_cast<Trace_Context*>(context);
+        Voronoi_Features& features = *ctx->features;
+        Voronoi_Edge_Spans& spans = *ctx->spans;
+        Voronoi_Trace_State* state = ctx->state;
+
+        int first = job_index*trace_points_per_job;
+        int last = std::min(first + trace_points_per_job, ctx->edges->num_nz);
+
+        for (int i = first; i < last; ++i)
+        {
+            int owner = ctx->owners[i].load(std::memory_order_relaxed);
+
+            if (owner >= 0 && (owner & 1))
+            {
+                std::swap(features.edge_obstacle_ids_1[i], features.edge_obstacle_ids_2[i]);
+                std::swap(spans.indices_1[i], spans.indices_2[i]);
+            }
+
+            if (state)
+            {
+                state->point_owners[i] = owner;
+                state->point_visits[i] = ctx->visits[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void trace_all_edges(Memory* scratch, Scheduler* scheduler, const CSR_Grid& vertices, const CSR_Grid& edges,
+                         Voronoi_Edge_Spans& spans, Voronoi_Features& features, Voronoi_Traced_Edges& out, Voronoi_Trace_State* state)
+    {
+        corridormap_build_scope(build_stage_trace_edges);
+
+        const int num_tokens = features.num_vert_points*max_grid_neis;
+        const int num_jobs = (num_tokens + trace_tokens_per_job - 1)/trace_tokens_per_job;
+        const int num_point_jobs = (edges.num_nz + trace_points_per_job - 1)/trace_points_per_job;
+
+        Alloc_Scope<std::atomic<int> > owners(scratch, std::max(edges.num_nz, 1));
+        Alloc_Scope<std::atomic<int> > visits(scratch, state ? std::max(edges.num_nz, 1) : 1);
+        Alloc_Scope<Trace_Record> records(scratch, std::max(num_tokens, 1));
+        Alloc_Scope<std::atomic<int> > owned(scratch, std::max(num_tokens, 1));
+        Alloc_Scope<int> job_edges(scratch, num_jobs + 1);
+        Alloc_Scope<int> job_events(scratch, num_jobs + 1);
+
+        // atomics live in raw scratch memory, construct them in place.
+        for (int i = 0; i < edges.num_nz; ++i)
+        {
+            new (&owners[i]) std::atomic<int>(-1);
+        }
+
+        for (int i = 0; state && i < edges.num_nz; ++i)
+        {
+            new (&visits[i]) std::atomic<int>(0);
+        }
+
+        for (int i = 0; i < num_tokens; ++i)
+        {
+            new (&owned[i]) std::atomic<int>(0);
+        }
+
+        Trace_Context ctx;
+        ctx.vertices = &vertices;
+        ctx.edges = &edges;
+        ctx.features = &features;
+        ctx.spans = &spans;
+        ctx.out = &out;
+        ctx.owners = owners;
+        ctx.visits = state ? visits.data : 0;
+        ctx.records = records;
+        ctx.owned = owned;
+        ctx.tokens = 0;
+        ctx.num_tokens = num_tokens;
+        ctx.job_edges = job_edges;
+        ctx.job_events = job_events;
+        ctx.state = state;
+
+        // 1. walk edges from every vertex, each point ends up owned by the smallest token passing it.
+        parallel_for(scheduler, walk_tokens, &ctx, num_jobs);
+
+        // 2. count points owned by each walk.
+        parallel_for(scheduler, count_owned_points, &ctx, num_point_jobs);
+
+        // 3. count edges owned by the walks of each job, then offset them in token order.
+        parallel_for(scheduler, count_job_edges, &ctx, num_jobs);
+
+        int num_edges = 0;
+        int num_events = 0;
+
+        for (int i = 0; i < num_jobs; ++i)
+        {
+            int job_num_edges = job_edges[i];
+            int job_num_events = job_events[i];
+            job_edges[i] = num_edges;
+            job_events[i] = num_events;
+            num_edges += job_num_edges;
+            num_events += job_num_events;
+        }
+
+        // 4. store edges and events.
+        parallel_for(scheduler, write_job_edges, &ctx, num_jobs);
+
+        // 5. make sides consistent along the edges.
+        parallel_for(scheduler, apply_swap_sides, &ctx, num_point_jobs);
+
+        out.num_edges = num_edges;
+        out.num_events = num_events;
+
+        corridormap_build_count(num_traced_edges, num_edges);
+        corridormap_build_count(num_events, num_events);
+    }
+}
+
+void trace_edges(Memory* scratch, const CSR_Grid& vertices, const CSR_Grid& edges,
+                 Voronoi_Edge_Spans& spans, Voronoi_Features& features, Voronoi_Traced_Edges& out)
+{
+    trace_all_edges(scratch, 0, vertices, edges, spans, features, out, 0);
+}
+
+void trace_edges(Memory* scratch, Scheduler* scheduler, const CSR_Grid& vertices, const CSR_Grid& edges,
+                 Voronoi_Edge_Spans& spans, Voronoi_Features& features, Voronoi_Traced_Edges& out)
+{
+    trace_all_edges(scratch, scheduler, vertices, edges, spans, features, out, 0);
+}
+
+void trace_edges(Memory* scratch, Scheduler* scheduler, const CSR_Grid& vertices, const CSR_Grid& edges,
+                 Voronoi_Edge_Spans& spans, Voronoi_Features& features, Voronoi_Traced_Edges& out, Voronoi_Trace_State& state)
+{
+    trace_all_edges(scratch, scheduler, vertices, edges, spans, features, out, &state);
+}
+
+namespace
+{
+    bool same_traced_edge(const Voronoi_Traced_Edges& a, int edge_a, const Voronoi_Traced_Edges& b, int edge_b)
+    {
+        if (a.u[edge_a] != b.u[edge_b] || a.v[edge_a] != b.v[edge_b] ||
+            a.obstacle_ids_1[edge_a] != b.obstacle_ids_1[edge_b] ||
+            a.obstacle_ids_2[edge_a] != b.obstacle_ids_2[edge_b] ||
+            a.edge_num_events[edge_a] != b.edge_num_events[edge_b])
+        {
+            return false;
+        }
+
+        const int* events_a = a.events + a.edge_event_offset[edge_a];
+        const int* events_b = b.events + b.edge_event_offset[edge_b];
+        return memcmp(events_a, events_b, a.edge_num_events[edge_a]*sizeof(int)) == 0;
+    }
+}
+
+bool update_traced_edges(Memory* scratch, Scheduler* scheduler, const Trace_Update_Params& in,
+                         const CSR_Grid& vertices, const CSR_Grid& edges, Voronoi_Edge_Spans& spans, Voronoi_Features& features,
+                         Voronoi_Traced_Edges& out, Voronoi_Trace_State& state)
+{
+    corridormap_build_scope(build_stage_trace_edges);
+
+    const Voronoi_Features& old_features = *in.features;
+    const Voronoi_Traced_Edges& old_edges = *in.traced_edges;
+    const Voronoi_Trace_State& old_state = *in.state;
+    const int num_old_tokens = old_state.num_walks;
+    const int num_old_points = old_state.num_points;
+    const int num_tokens = features.num_vert_points*max_grid_neis;
+    const int num_points = edges.num_nz;
+    const int width = features.grid_width;
+
+    // a walk path depends on features of its points and their neighbours.
+    Grid_Window touched = in.feature_window;
+    touched.min_x -= 1;
+    touched.min_y -= 1;
+    touched.max_x += 1;
+    touched.max_y += 1;
+
+    // 1. old walks starting or passing near the window are dirty.
+    Alloc_Scope<unsigned char> old_dirty(scratch, std::max(num_old_tokens, 1));
+    Alloc_Scope<int> queue(scratch, std::max(num_old_tokens, 1));
+    int queue_size = 0;
+
+    for (int token = 0; token < num_old_tokens; ++token)
+    {
+        int u = old_features.verts[token/max_grid_neis];
+        old_dirty[token] = contains(touched, u % width, u / width) || intersect(old_state.walk_windows[token], touched);
+
+        if (old_dirty[token] && old_state.walk_points[token] > 0)
+        {
+            queue[queue_size++] = token;
+        }
+    }
+
+    // 2. count passes of the old dirty walks which reached a vertex. walks back from their end vertices are dirty as well,
+    // so the points of an edge crossing the window border keep no clean walks.
+    Alloc_Scope<std::atomic<int> > old_visits(scratch, std::max(num_old_points, 1));
+
+    for (int i = 0; i < num_old_points; ++i)
+    {
+        new (&old_visits[i]) std::atomic<int>(0);
+    }
+
+    Trace_Context old_ctx;
+    memset(&old_ctx, 0, sizeof(old_ctx));
+    old_ctx.vertices = in.vertex_grid;
+    old_ctx.edges = in.edge_grid;
+    old_ctx.features = in.features;
+    old_ctx.spans = in.spans;
+    old_ctx.visits = old_visits;
+
+    for (int i = 0; i < queue_size; ++i)
+    {
+        int token = queue[i];
+        int u = old_features.verts[token/max_grid_neis];
+
+        Trace_Record record;
+        record.v = -1;
+        record.first = cell_neis(*in.edge_grid, u).lin_idx[token % max_grid_neis];
+        walk_edge(&old_ctx, token, u, walk_visit, record, 0);
+        corridormap_assert(record.v >= 0);
+
+        int v = nz(*in.vertex_grid, record.v);
+        CSR_Grid_Neis v_neis = cell_neis(*in.edge_grid, record.v);
+
+        for (int j = 0; j < v_neis.num; ++j)
+        {
+            int reverse = v*max_grid_neis + j;
+
+            if (v_neis.lin_idx[j] == record.last && !old_dirty[reverse])
+            {
+                old_dirty[reverse] = 1;
+
+                if (old_state.walk_points[reverse] > 0)
+                {
+                    queue[queue_size++] = reverse;
+                }
+            }
+        }
+    }
+
+    // 3. the owner of a point stays among the clean walks passing it only if it's clean itself,
+    // otherwise the clean walk which takes over is unknown and everything is retraced.
+    Alloc_Scope<int> vertex_sources(scratch, std::max(features.num_vert_points, 1));
+    Alloc_Scope<int> point_sources(scratch, std::max(num_points, 1));
+    memset(vertex_sources.data, 0xff, vertex_sources.count*sizeof(int));
+    memset(point_sources.data, 0xff, point_sources.count*sizeof(int));
+
+    for (int i = 0; i < old_features.num_vert_points; ++i)
+    {
+        if (in.vertex_map[i] >= 0)
+        {
+            vertex_sources[in.vertex_map[i]] = i;
+        }
+    }
+
+    for (int i = 0; i < num_old_points; ++i)
+    {
+        if (in.point_map[i] >= 0)
+        {
+            point_sources[in.point_map[i]] = i;
+        }
+    }
+
+    Alloc_Scope<int> clean_owners(scratch, std::max(num_points, 1));
+    Alloc_Scope<int> clean_visits(scratch, std::max(num_points, 1));
+
+    for (int i = 0; i < num_points; ++i)
+    {
+        int src = point_sources[i];
+        int owner = -1;
+        int visits = 0;
+
+        if (src >= 0)
+        {
+            visits = old_state.point_visits[src] - old_visits[src].load(std::memory_order_relaxed);
+
+            if (visits > 0)
+            {
+                int old_owner = old_state.point_owners[src];
+                int old_token = old_owner >> 1;
+
+                if (old_dirty[old_token])
+                {
+                    return false;
+                }
+
+                int token = in.vertex_map[old_token/max_grid_neis]*max_grid_neis + old_token % max_grid_neis;
+                owner = token*2 + (old_owner & 1);
+            }
+        }
+
+        clean_owners[i] = owner;
+        clean_visits[i] = visits;
+    }
+
+    // 4. retrace dirty walks: new walks starting near the window and walks dirty before.
+    Alloc_Scope<unsigned char> dirty(scratch, std::max(num_tokens, 1));
+    Alloc_Scope<int> tokens(scratch, std::max(num_tokens, 1));
+    int num_dirty = 0;
+
+    for (int token = 0; token < num_tokens; ++token)
+    {
+        int u = features.verts[token/max_grid_neis];
+        int src = vertex_sources[token/max_grid_neis];
+
+        dirty[token] = contains(touched, u % width, u / width) || src < 0 || old_dirty[src*max_grid_neis + token % max_grid_neis];
+
+        if (dirty[token])
+        {
+            tokens[num_dirty++] = token;
+        }
+    }
+
+    Alloc_Scope<std::atomic<int> > owners(scratch, std::max(num_points, 1));
+    Alloc_Scope<std::atomic<int> > visits(scratch, std::max(num_points, 1));
+    Alloc_Scope<Trace_Record> records(scratch, std::max(num_tokens, 1));
+    Alloc_Scope<std::atomic<int> > owned(scratch, std::max(num_tokens, 1));
+
+    for (int i = 0; i < num_points; ++i)
+    {
+        new (&owners[i]) std::atomic<int>(clean_owners[i]);
+        new (&visits[i]) std::atomic<int>(clean_visits[i]);
+    }
+
+    for (int i = 0; i < num_tokens; ++i)
+    {
+        new (&owned[i]) std::atomic<int>(0);
+    }
+
+    Trace_Context ctx;
+    ctx.vertices = &vertices;
+    ctx.edges = &edges;
+    ctx.features = &features;
+    ctx.spans = &spans;
+    ctx.out = &out;
+    ctx.owners = owners;
+    ctx.visits = visits;
+    ctx.records = records;
+    ctx.owned = owned;
+    ctx.tokens = tokens;
+    ctx.num_tokens = num_dirty;
+    ctx.job_edges = 0;
+    ctx.job_events = 0;
+    ctx.state = &state;
+
+    parallel_for(scheduler, walk_tokens, &ctx, (num_dirty + trace_tokens_per_job - 1)/trace_tokens_per_job);
+
+    // 5. count points owned by dirty walks, clean walks which lost a point to a dirty one lose their edge.
+    Alloc_Scope<unsigned char> lost(scratch, std::max(num_tokens, 1));
+    zero_mem(lost);
+
+    for (int i = 0; i < num_points; ++i)
+    {
+        int owner = owners[i].load(std::memory_order_relaxed);
+
+        if (owner >= 0 && dirty[owner >> 1])
+        {
+            owned[owner >> 1].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (clean_owners[i] >= 0 && owner != clean_owners[i])
+        {
+            lost[clean_owners[i] >> 1] = 1;
+        }
+    }
+
+    // 6. edges in token order: clean walks keep their edges, dirty walks write theirs.
+    int num_edges = 0;
+    int num_events = 0;
+
+    for (int token = 0; token < num_tokens; ++token)
+    {
+        int edge = -1;
+        int src_vert = vertex_sources[token/max_grid_neis];
+        int src_token = src_vert >= 0 ? src_vert*max_grid_neis + token % max_grid_neis : -1;
+
+        if (dirty[token])
+        {
+            const Trace_Record& record = records[token];
+            state.walk_points[token] = record.v >= 0 ? record.num_points : 0;
+            state.walk_windows[token] = record.window;
+
+            if (owns_edge(&ctx, token))
+            {
+                edge = num_edges++;
+                write_edge(&ctx, token, edge, num_events);
+                num_events += record.num_events;
+
+                // an edge retraced unchanged is the same edge unless its obstacles changed.
+                int src_edge = src_token >= 0 ? old_state.walk_edges[src_token] : -1;
+                bool same = src_edge >= 0 && same_traced_edge(old_edges, src_edge, out, edge) &&
+                            !in.changed_ids[out.obstacle_ids_1[edge]] && !in.changed_ids[out.obstacle_ids_2[edge]];
+                state.edge_sources[edge] = same ? src_edge : -1;
+            }
+        }
+        else
+        {
+            int src_edge = old_state.walk_edges[src_token];
+            state.walk_points[token] = old_state.walk_points[src_token];
+            state.walk_windows[token] = old_state.walk_windows[src_token];
+
+            if (src_edge >= 0 && !lost[token])
+            {
+                edge = num_edges++;
+                int src_num_events = old_edges.edge_num_events[src_edge];
+
+                out.u[edge] = old_edges.u[src_edge];
+                out.v[edge] = old_edges.v[src_edge];
+                out.obstacle_ids_1[edge] = old_edges.obstacle_ids_1[src_edge];
+                out.obstacle_ids_2[edge] = old_edges.obstacle_ids_2[src_edge];
+                out.edge_event_offset[edge] = num_events;
+                out.edge_num_events[edge] = src_num_events;
+                memcpy(out.events + num_events, old_edges.events + old_edges.edge_event_offset[src_edge], src_num_events*sizeof(int));
+                num_events += src_num_events;
+
+                state.edge_sources[edge] = src_edge;
+            }
+        }
+
+        state.walk_edges[token] = edge;
+    }
+
+    // 7. make sides consistent along the edges and keep point owners for the next update.
+    parallel_for(scheduler, apply_swap_sides, &ctx, (num_points + trace_points_per_job - 1)/trace_points_per_job);
+
+    out.num_edges = num_edges;
+    out.num_events = num_events;
+
+    corridormap_build_count(num_traced_edges, num_edges);
+    corridormap_build_count(num_events, num_events);
+
+    return true;
+}
+
+namespace
+{
+    struct Segement_Closest_Point
+    {
+        Vec2 closest;
+        float dist;
+    };
+
+    Segement_Closest_Point closest_to_segment(const Vec2& point, const Vec2& p0, const Vec2& p1)
+    {
+        Segement_Closest_Point result;
+
+        Vec2 seg = p1 - p0;
+        Vec2 dir = normalized(seg);
+        float seg_len = mag(seg);
+
+        float proj = dot(point - p0, dir);
+
+        Vec2 seg_closest = p0 + dir*clamp(proj, 0.f, seg_len);
+
+        Vec2 seg_closest_dir = seg_closest - point;
+        float seg_closest_dist = dot(seg_closest_dir, seg_closest_dir);
+
+        result.closest = seg_closest;
+        result.dist = seg_closest_dist;
+
+        return result;
+    }
+
+    inline float distance_sq(const float* box, Vec2 p)
+    {
+        float dx = std::max(std::max(box[0] - p.x, p.x - box[2]), 0.f);
+        float dy = std::max(std::max(box[1] - p.y, p.y - box[3]), 0.f);
+        return dx*dx + dy*dy;
+    }
+
+    // tests edges [first_edge, last_edge) of the polygon starting at first_vertex.
+    inline void closest_on_edges(const Footprint& obstacles, int first_vertex, int num_edges, int first_edge, int last_edge,
+                                 const Vec2& point, Vec2& closest, float& min_dist)
+    {
+        const float* obst_x = obstacles.x;
+        const float* obst_y = obstacles.y;
+
+        int curr_idx = first_vertex + ((first_edge == 0) ? num_edges - 1 : first_edge - 1);
+        int next_idx = first_vertex + first_edge;
+
+        for (; next_idx < first_vertex + last_edge; curr_idx = next_idx++)
+        {
+            Vec2 p0 = { obst_x[curr_idx], obst_y[curr_idx] };
+            Vec2 p1 = { obst_x[next_idx], obst_y[next_idx] };
+
+            Segement_Closest_Point r = closest_to_segment(point, p0, p1);
+
+            if (r.dist < min_dist)
+            {
+                min_dist = r.dist;
+                closest = r.closest;
+            }
+        }
+    }
+
+    // depth first search of the polygon edge tree, the closer child is visited first and nodes farther than the best edge are skipped.
+    void closest_on_edge_tree(const Footprint& obstacles, const Footprint_Edge_Tree& tree, int oid, int first_vertex,
+                              const Vec2& point, Vec2& closest, float& min_dist)
+    {
+        const int num_edges = obstacles.num_poly_verts[oid];
+        const float* nodes = tree.node_bounds + tree.poly_node_offsets[oid]*4;
+
+        int level_offsets[edge_tree_max_levels];
+        int level_sizes[edge_tree_max_levels];
+        int num_levels = edge_tree_levels(tree.poly_num_leaves[oid], level_offsets, level_sizes);
+
+        int stack_level[edge_tree_max_levels*2];
+        int stack_node[edge_tree_max_levels*2];
+        int stack_size = 0;
+
+        stack_level[stack_size] = num_levels - 1;
+        stack_node[stack_size] = 0;
+        ++stack_size;
+
+        while (stack_size > 0)
+        {
+            --stack_size;
+            int level = stack_level[stack_size];
+            int node = stack_node[stack_size];
+
+            if (distance_sq(nodes + (level_offsets[level] + node)*4, point) > min_dist)
+            {
+                continue;
+            }
+
+            if (level == 0)
+            {
+                int first_edge = node*edge_tree_leaf_edges;
+                int last_edge = std::min(first_edge + edge_tree_leaf_edges, num_edges);
+                closest_on_edges(obstacles, first_vertex, num_edges, first_edge, last_edge, point, closest, min_dist);
+                continue;
+            }
+
+            int child = node*2;
+
+            if (child + 1 < level_sizes[level - 1])
+            {
+                float d0 = distance_sq(nodes + (level_offsets[level - 1] + child)*4, point);
+                float d1 = distance_sq(nodes + (level_offsets[level - 1] + child + 1)*4, point);
+                int near_child = (d1 < d0) ? child + 1 : child;
+
+                stack_level[stack_size] = level - 1;
+                stack_node[stack_size] = (near_child == child) ? child + 1 : child;
+                ++stack_size;
+
+                stack_level[stack_size] = level - 1;
+                stack_node[stack_size] = near_child;
+                ++stack_size;
+            }
+            else
+            {
+                stack_level[stack_size] = level - 1;
+                stack_node[stack_size] = child;
+                ++stack_size;
+            }
+        }
+    }
+
+    Vec2 compute_closest_point(const Footprint& obstacles, const Footprint_Edge_Tree* edge_tree, const Bbox2& bounds,
+                               const int* obstacle_offsets, unsigned int obstacle_id, const Vec2& point)
+    {
+        int oid = obstacle_id - 1;
+
+        if (oid < 0)
+        {
+            return point;
+        }
+
+        if (oid >= obstacles.num_polys)
+        {
+            Vec2 lt = { bounds.min[0], bounds.max[1] };
+            Vec2 lb = { bounds.min[0], bounds.min[1] };
+            Vec2 rt = { bounds.max[0], bounds.max[1] };
+            Vec2 rb = { bounds.max[0], bounds.min[1] };
+
+            Vec2 segments_p0[] = { lb, rb, rt, lt };
+            Vec2 segments_p1[] = { rb, rt, lt, lb };
+
+            int offset = oid - obstacles.num_polys;
+            Segement_Closest_Point r = closest_to_segment(point, segments_p0[offset], segments_p1[offset]);
+            return r.closest;
+        }
+
+        Vec2 closest = { FLT_MAX, FLT_MAX };
+        float min_dist = FLT_MAX;
+
+        int first_vertex_idx = obstacle_offsets[oid];
+        int num_edges = obstacles.num_poly_verts[oid];
+
+        if (edge_tree && edge_tree->poly_num_leaves[oid] > 0)
+        {
+            closest_on_edge_tree(obstacles, *edge_tree, oid, first_vertex_idx, point, closest, min_dist);
+        }
+        else
+        {
+            closest_on_edges(obstacles, first_vertex_idx, num_edges, 0, num_edges, point, closest, min_dist);
+        }
+
+        return closest;
+    }
+
+    Vec2 convert_from_image(int lin_idx, int grid_width, int grid_height, Bbox2 bounds)
+    {
+        float bounds_width = bounds.max[0] - bounds.min[0];
+        float bounds_height = bounds.max[1] - bounds.min[1];
+        float vx = float(lin_idx % grid_width);
+        float vy = float(lin_idx / grid_width);
+        vx = vx / grid_width * bounds_width + bounds.min[0];
+        vy = vy / grid_height * bounds_height + bounds.min[1];
+        return make_vec2(vx, vy);
+    }
+
+    bool is_left(Vec2 prev, Vec2 curr, Vec2 side_pos)
+    {
+        Vec2 dir1 = curr - prev;
+        Vec2 dir2 = side_pos - prev;
+        return det(dir1, dir2) > 0.f;
+    }
+
+    struct Event_Closest_Points
+    {
+        Vec2 pos;
+        Vec2 cp1;
+        Vec2 cp2;
+    };
+
+    // correct sampled event position so that the point lies on the corresponding obstacle vertex normal.
+    Event_Closest_Points correct_pos_and_compute_closest(int event, int event_nz_index, Vec2 sampled_pos, Bbox2 bounds,
+                                                         const Footprint* obstacles, const Footprint_Normals* obstacle_normals, const Footprint_Edge_Tree* edge_tree,
+                                                         const Voronoi_Edge_Spans* spans, const Voronoi_Features* features)
+    {
+        Event_Closest_Points result;
+        int* obstacle_offsets = obstacle_normals->obstacle_normal_offsets;
+
+        int vertex_index_1 = spans->indices_1[event_nz_index];
+        int vertex_index_2 = spans->indices_2[event_nz_index];
+        int obstacle_id_1 = features->edge_obstacle_ids_1[event_nz_index];
+        int obstacle_id_2 = features->edge_obstacle_ids_2[event_nz_index];
+
+        int vertex_index = event > 0 ? vertex_index_1 : vertex_index_2;
+        int obstacle_id = event > 0 ? obstacle_id_1 : obstacle_id_2;
+
+        corridormap_assert(vertex_index > 0);
+        vertex_index = vertex_index - 1;
+
+        if (vertex_index >= obstacles->num_verts)
+        {
+            result.pos = sampled_pos;
+            result.cp1 = compute_closest_point(*obstacles, edge_tree, bounds, obstacle_offsets, obstacle_id_1, sampled_pos);
+            result.cp2 = compute_closest_point(*obstacles, edge_tree, bounds, obstacle_offsets, obstacle_id_2, sampled_pos);
+            return result;
+        }
+
+        // get two normals associated with vertex and project event point to the closest normal.
+        int num_normals = obstacle_normals->num_obstacle_normals[obstacle_id - 1];
+        int first_normal_idx = obstacle_normals->obstacle_normal_offsets[obstacle_id - 1];
+        int curr = vertex_index;
+        int next = first_normal_idx + (curr - first_normal_idx + 1) % num_normals;
+        Vec2 v = { obstacles->x[vertex_index], obstacles->y[vertex_index] };
+        Vec2 n1 = { obstacle_normals->x[curr], obstacle_normals->y[curr] };
+        Vec2 n2 = { obstacle_normals->x[next], obstacle_normals->y[next] };
+        Vec2 dir = sampled_pos - v;
+        float p1 = dot(dir, n1);
+        float p2 = dot(dir, n2);
+        result.pos = v + ((p1 > p2) ? n1*p1 : n2*p2);
+
+        if (event > 0)
         {
-            Vec2 lt = { bounds.min[0], bounds.max[1] };
-            Vec2 lb = { bounds.min[0], bounds.min[1] };
-            Vec2 rt = { bounds.max[0], bounds.max[1] };
-            Vec2 rb = { bounds.max[0], bounds.min[1] };
+            result.cp1 = v;
+            result.cp2 = compute_closest_point(*obstacles, edge_tree, bounds, obstacle_offsets, obstacle_id_2, result.pos);
+        }
+        else
+        {
+            result.cp2 = v;
+            result.cp1 = compute_closest_point(*obstacles, edge_tree, bounds, obstacle_offsets, obstacle_id_1, result.pos);
+        }
 
-            Vec2 segments_p0[] = { lb, rb, rt, lt };
-            Vec2 segments_p1[] = { rb, rt, lt, lb };
+        return result;
+    }
+
+    void create_vertices(const Walkable_Space_Build_Params& in, Walkable_Space& out)
+    {
+        for (int i = 0; i < in.features->num_vert_points; ++i)
+        {
+            Vec2 pos = convert_from_image(in.features->verts[i], in.features->grid_width, in.features->grid_height, in.bounds);
+            create_vertex(out, pos);
+        }
+    }
+
+    void create_edges(const Walkable_Space_Build_Params& in, Walkable_Space& out)
+    {
+        for (int i = 0; i < in.traced_edges->num_edges; ++i)
+        {
+            int u_nz = nz(*in.vertex_grid, in.traced_edges->u[i]);
+            int v_nz = nz(*in.vertex_grid, in.traced_edges->v[i]);
+            create_edge(out, u_nz, v_nz);
+        }
+    }
+
+    // creates events of the traced edge on the walkable space edge with index edge_index.
+    void create_edge_events(const Walkable_Space_Build_Params& in, Walkable_Space& out, int traced_edge, int edge_index)
+    {
+        Edge* edge = out.edges.items + edge_index;
+        Vec2 u = source(out, edge)->pos;
+
+        int event_offset = in.traced_edges->edge_event_offset[traced_edge];
+        int num_events = in.traced_edges->edge_num_events[traced_edge];
+
+        Vec2 prev = u;
+
+        for (int j = event_offset; j < event_offset + num_events; ++j)
+        {
+            int evt = in.traced_edges->events[j];
+            int evt_lin_idx = ::abs(evt);
+            int evt_nz_index = nz(*in.edge_grid, evt_lin_idx);
+
+            Vec2 sampled_pos = convert_from_image(evt_lin_idx, in.features->grid_width, in.features->grid_height, in.bounds);
+            Event_Closest_Points r = correct_pos_and_compute_closest(evt, evt_nz_index, sampled_pos, in.bounds,
+                                                                     in.obstacles, in.obstacle_normals, in.obstacle_edge_tree, in.spans, in.features);
+
+            Event* e = create_event(out, r.pos, edge_index);
+
+            if (is_left(prev, r.pos, r.cp1))
+            {
+                e->sides[0] = r.cp1;
+                e->sides[1] = r.cp2;
+            }
+            else
+            {
+                e->sides[0] = r.cp2;
+                e->sides[1] = r.cp1;
+            }
+
+            prev = r.pos;
+        }
+    }
+
+    void create_events(const Walkable_Space_Build_Params& in, Walkable_Space& out)
+    {
+        for (int i = 0; i < in.traced_edges->num_edges; ++i)
+        {
+            create_edge_events(in, out, i, i);
+        }
+    }
+
+    // closest points at the ends of the walkable space edge with index edge_index built from the traced edge.
+    void compute_edge_closest_points(const Walkable_Space_Build_Params& in, Walkable_Space& out, int traced_edge, int edge_index)
+    {
+        int* obstacle_offsets = in.obstacle_normals->obstacle_normal_offsets;
+
+        Edge* edge = out.edges.items + edge_index;
+        Half_Edge* e0 = edge->dir + 0;
+        Half_Edge* e1 = edge->dir + 1;
+
+        Vec2 u = source(out, edge)->pos;
+        Vec2 v = target(out, edge)->pos;
+
+        Vec2 u_prev = v;
+        if (event(out, e0))
+        {
+            u_prev = event(out, e0)->pos;
+        }
+
+        Vec2 v_prev = u;
+        if (event(out, e1))
+        {
+            v_prev = event(out, e1)->pos;
+        }
+
+        unsigned int obstacle_id_1 = in.traced_edges->obstacle_ids_1[traced_edge];
+        unsigned int obstacle_id_2 = in.traced_edges->obstacle_ids_2[traced_edge];
+        Vec2 cp01 = compute_closest_point(*in.obstacles, in.obstacle_edge_tree, in.bounds, obstacle_offsets, obstacle_id_1, target(out, e0)->pos);
+        Vec2 cp02 = compute_closest_point(*in.obstacles, in.obstacle_edge_tree, in.bounds, obstacle_offsets, obstacle_id_2, target(out, e0)->pos);
+        Vec2 cp11 = compute_closest_point(*in.obstacles, in.obstacle_edge_tree, in.bounds, obstacle_offsets, obstacle_id_2, target(out, e1)->pos);
+        Vec2 cp12 = compute_closest_point(*in.obstacles, in.obstacle_edge_tree, in.bounds, obstacle_offsets, obstacle_id_1, target(out, e1)->pos);
+
+        if (is_left(v_prev, v, cp01))
+        {
+            e0->sides[0] = cp01;
+            e0->sides[1] = cp02;
+        }
+        else
+        {
+            e0->sides[0] = cp02;
+            e0->sides[1] = cp01;
+        }
+
+        if (is_left(u_prev, u, cp11))
+        {
+            e1->sides[0] = cp11;
+            e1->sides[1] = cp12;
+        }
+        else
+        {
+            e1->sides[0] = cp12;
+            e1->sides[1] = cp11;
+        }
+    }
+
+    void compute_vertex_closest_points(const Walkable_Space_Build_Params& in, Walkable_Space& out)
+    {
+        for (int i = 0; i < in.traced_edges->num_edges; ++i)
+        {
+            compute_edge_closest_points(in, out, i, i);
+        }
+    }
+
+    // moves the degree one vertex v of the edge e to the first event from its side, uv is the half-edge towards v.
+    void move_dead_end(Walkable_Space& out, Edge* e, Half_Edge* uv, Vertex* v)
+    {
+        // ourgoing half-edge from v (degree one vertex).
+        Half_Edge* vu = opposite(out, uv);
+        Event* evt = event(out, vu);
+        Event* next_evt = next(out, vu, evt);
+        int vu_dir = int(vu - e->dir);
+
+        if (next_evt)
+        {
+            vu->event = int(next_evt - out.events.items);
+            next_evt->next[vu_dir^1] = null_idx;
+        }
+        else
+        {
+            vu->event = null_idx;
+            uv->event = null_idx;
+        }
+
+        v->pos = evt->pos;
+        uv->sides[0] = left_side(out, uv, evt);
+        uv->sides[1] = right_side(out, uv, evt);
+
+        deallocate(out.events, evt);
+    }
+
+    void prune_dead_ends(Walkable_Space& out)
+    {
+        for (Edge* e = first(out.edges); e != 0;)
+        {
+            Edge* next_e = next(out.edges, e);
+
+            Vertex* s = source(out, e);
+            Vertex* t = target(out, e);
+
+            int ds = degree(out, s);
+            int dt = degree(out, t);
+
+            Vertex* v = (ds == 1) ? s : t;
+            Vertex* u = (ds == 1) ? t : s;
+            // half-edge: u->v
+            Half_Edge* uv = (ds == 1) ? e->dir+1 : e->dir+0;
+
+            if (ds == 1 || dt == 1)
+            {
+                // edge ending with degree one vertex, no events -> prune.
+                if (!event(out, e->dir+0))
+                {
+                    deallocate(out.vertices, v);
+
+                    for (Half_Edge* n = next(out, uv); ; n = next(out, n))
+                    {
+                        if (next(out, n) == uv)
+                        {
+                            n->next = uv->next;
+
+                            // both ends had degree one, u is left disconnected.
+                            if (n == uv)
+                            {
+                                u->half_edge = null_idx;
+                            }
+                            else if (half_edge(out, u) == uv)
+                            {
+                                Edge* n_edge = edge(out, n);
+                                u->half_edge = int(n_edge - out.edges.items)*2 + int(n - n_edge->dir);
+                            }
+
+                            break;
+                        }
+                    }
+
+                    deallocate(out.edges, e);
+                }
+                // otherwise move the degree one vertex to the first event on that edge.
+                else
+                {
+                    move_dead_end(out, e, uv, v);
+                }
+            }
+
+            e = next_e;
+        }
+    }
+
+    void prune_disconnected_verts(Walkable_Space& out)
+    {
+        for (Vertex* v = first(out.vertices); v != 0;)
+        {
+            Vertex* next_v = next(out.vertices, v);
+
+            if (!half_edge(out, v))
+            {
+                deallocate(out.vertices, v);
+            }
+
+            v = next_v;
+        }
+    }
+}
+
+void build_walkable_space(const Walkable_Space_Build_Params& in, Walkable_Space& out)
+{
+    corridormap_build_scope(build_stage_walkable_space);
+
+    create_vertices(in, out);
+    create_edges(in, out);
+    create_events(in, out);
+    compute_vertex_closest_points(in, out);
+
+    int num_verts = out.vertices.num_items;
+    int num_edges = out.edges.num_items;
+    int num_events = out.events.num_items;
+
+    prune_dead_ends(out);
+    prune_disconnected_verts(out);
+
+    corridormap_build_count(num_pruned_verts, num_verts - out.vertices.num_items);
+    corridormap_build_count(num_pruned_edges, num_edges - out.edges.num_items);
+    corridormap_build_count(num_pruned_events, num_events - out.events.num_items);
+}
+
+namespace
+{
+    enum Edge_Prune
+    {
+        prune_none = 0,
+        // dead end without events, removed with its degree one vertex.
+        prune_remove_source,
+        prune_remove_target,
+        // degree one vertex moved to the first event.
+        prune_move_source,
+        prune_move_target
+    };
+
+    // replays prune_dead_ends and prune_disconnected_verts on vertex degrees, edges are visited in the order they are created.
+    // vertices with zero degree left are pruned.
+    void simulate_pruning(const Walkable_Space_Build_Params& in, int* degrees, unsigned char* prune)
+    {
+        const Voronoi_Traced_Edges& edges = *in.traced_edges;
+        const CSR_Grid& vertices = *in.vertex_grid;
+
+        memset(degrees, 0, in.features->num_vert_points*sizeof(int));
+
+        for (int i = 0; i < edges.num_edges; ++i)
+        {
+            degrees[nz(vertices, edges.u[i])]++;
+            degrees[nz(vertices, edges.v[i])]++;
+        }
+
+        for (int i = 0; i < edges.num_edges; ++i)
+        {
+            int s = nz(vertices, edges.u[i]);
+            int t = nz(vertices, edges.v[i]);
+
+            prune[i] = prune_none;
+
+            if (degrees[s] == 1 || degrees[t] == 1)
+            {
+                bool source = degrees[s] == 1;
+
+                if (edges.edge_num_events[i] == 0)
+                {
+                    prune[i] = (unsigned char)(source ? prune_remove_source : prune_remove_target);
+                    degrees[source ? s : t] = 0;
+                    degrees[source ? t : s]--;
+                }
+                else
+                {
+                    prune[i] = (unsigned char)(source ? prune_move_source : prune_move_target);
+                }
+            }
+        }
+    }
+
+    inline bool removed(unsigned char prune)
+    {
+        return prune == prune_remove_source || prune == prune_remove_target;
+    }
+
+    // removes the half-edge from the ring of its source vertex.
+    void unlink_half_edge(Walkable_Space& space, Half_Edge* h)
+    {
+        Vertex* vertex = source(space, h);
+        Edge* e = edge(space, h);
+        int index = int(e - space.edges.items)*2 + int(h - e->dir);
+
+        if (h->next == index)
+        {
+            vertex->half_edge = null_idx;
+            return;
+        }
+
+        Half_Edge* prev = h;
+
+        while (next(space, prev) != h)
+        {
+            prev = next(space, prev);
+        }
+
+        prev->next = h->next;
+
+        if (vertex->half_edge == index)
+        {
+            vertex->half_edge = h->next;
+        }
+    }
+
+    inline Vec2 vertex_pos(const Walkable_Space_Build_Params& in, int vertex)
+    {
+        return convert_from_image(in.features->verts[vertex], in.features->grid_width, in.features->grid_height, in.bounds);
+    }
+
+    // links half-edges around the vertex the way build_walkable_space does: create_edge inserts them in traced order around
+    // unpruned positions, then prune_dead_ends unlinks dead ends. incident edges are in traced order.
+    // ring receives traced edge*2 + dir starting from the vertex half-edge, returns the ring size.
+    int simulate_ring(const Walkable_Space_Build_Params& in, const unsigned char* prune, int vertex,
+                      const int* incident, int num_incident, int* ring, Vec2* ring_targets)
+    {
+        const Voronoi_Traced_Edges& traced = *in.traced_edges;
+        const CSR_Grid& vertices = *in.vertex_grid;
+        const Vec2 u = vertex_pos(in, vertex);
+        int size = 0;
+
+        for (int i = 0; i < num_incident; ++i)
+        {
+            int e = incident[i];
+
+            // half-edge 0 goes out of u, half-edge 1 out of v.
+            for (int dir = 0; dir < 2; ++dir)
+            {
+                if (nz(vertices, dir == 0 ? traced.u[e] : traced.v[e]) != vertex)
+                {
+                    continue;
+                }
+
+                Vec2 target = vertex_pos(in, nz(vertices, dir == 0 ? traced.v[e] : traced.u[e]));
+                int insert = 0;
+
+                while (insert < size && det(ring_targets[insert] - u, target - u) > 0.f)
+                {
+                    ++insert;
+                }
+
+                for (int j = size; j > insert; --j)
+                {
+                    ring[j] = ring[j - 1];
+                    ring_targets[j] = ring_targets[j - 1];
+                }
 
-            int offset = oid - obstacles.num_polys;
-            Segement_Closest_Point r = closest_to_segment(point, segments_p0[offset], segments_p1[offset]);
-            return r.closest;
+                ring[insert] = e*2 + dir;
+                ring_targets[insert] = target;
+                size++;
+            }
         }
 
-        const float* obst_x = obstacles.x;
-        const float* obst_y = obstacles.y;
-        const int* num_obst_verts = obstacles.num_poly_verts;
+        for (int i = 0; i < num_incident; ++i)
+        {
+            int e = incident[i];
+            int half_edge = -1;
 
-        Vec2 closest = { FLT_MAX, FLT_MAX };
-        float min_dist = FLT_MAX;
+            if (prune[e] == prune_remove_source && nz(vertices, traced.v[e]) == vertex)
+            {
+                half_edge = e*2 + 1;
+            }
+            else if (prune[e] == prune_remove_target && nz(vertices, traced.u[e]) == vertex)
+            {
+                half_edge = e*2 + 0;
+            }
 
-        int first_vertex_idx = obstacle_offsets[oid];
-        int last_vertex_idx = first_vertex_idx + num_obst_verts[oid] - 1;
+            if (half_edge < 0)
+            {
+                continue;
+            }
 
-        int curr_idx = last_vertex_idx;
-        int next_idx = first_vertex_idx;
+            int index = int(std::find(ring, ring + size, half_edge) - ring);
+            corridormap_assert(index < size);
 
-        for (; next_idx <= last_vertex_idx; curr_idx = next_idx++)
-        {
-            Vec2 p0 = { obst_x[curr_idx], obst_y[curr_idx] };
-            Vec2 p1 = { obst_x[next_idx], obst_y[next_idx] };
+            // the vertex half-edge moves to the predecessor.
+            int head = index == 0 ? ring[size - 1] : ring[0];
 
-            Segement_Closest_Point r = closest_to_segment(point, p0, p1);
+            for (int j = index; j < size - 1; ++j)
+            {
+                ring[j] = ring[j + 1];
+            }
 
-            if (r.dist < min_dist)
+            size--;
+
+            if (index == 0 && size > 0)
             {
-                min_dist = r.dist;
-                closest = r.closest;
+                for (int j = size - 1; j > 0; --j)
+                {
+                    ring[j] = ring[j - 1];
+                }
+
+                ring[0] = head;
             }
         }
 
-        return closest;
+        return size;
     }
+}
 
-    Vec2 convert_from_image(int lin_idx, int grid_width, int grid_height, Bbox2 bounds)
+void walkable_space_items(Memory* scratch, const Walkable_Space_Build_Params& in, Walkable_Space_Items& items)
+{
+    Alloc_Scope<int> degrees(scratch, std::max(in.features->num_vert_points, 1));
+    simulate_pruning(in, degrees, items.edge_prune);
+
+    for (int i = 0; i < in.traced_edges->num_edges; ++i)
     {
-        float bounds_width = bounds.max[0] - bounds.min[0];
-        float bounds_height = bounds.max[1] - bounds.min[1];
-        float vx = float(lin_idx % grid_width);
-        float vy = float(lin_idx / grid_width);
-        vx = vx / grid_width * bounds_width + bounds.min[0];
-        vy = vy / grid_height * bounds_height + bounds.min[1];
-        return make_vec2(vx, vy);
+        items.edges[i] = removed(items.edge_prune[i]) ? -1 : i*2;
     }
 
-    bool is_left(Vec2 prev, Vec2 curr, Vec2 side_pos)
+    for (int i = 0; i < in.features->num_vert_points; ++i)
     {
-        Vec2 dir1 = curr - prev;
-        Vec2 dir2 = side_pos - prev;
-        return det(dir1, dir2) > 0.f;
+        items.vertices[i] = degrees[i] > 0 ? i : -1;
     }
+}
 
-    struct Event_Closest_Points
+bool update_walkable_space(Memory* scratch, const Walkable_Space_Build_Params& in, const Voronoi_Trace_State& state,
+                           const Trace_Update_Params& old, const Walkable_Space_Items& old_items, Walkable_Space& out, Walkable_Space_Items& items)
+{
+    corridormap_build_scope(build_stage_walkable_space);
+
+    const Voronoi_Traced_Edges& traced = *in.traced_edges;
+    const Voronoi_Traced_Edges& old_traced = *old.traced_edges;
+    const CSR_Grid& vertex_grid = *in.vertex_grid;
+    const int num_verts = in.features->num_vert_points;
+    const int num_edges = traced.num_edges;
+    const int num_old_verts = old.features->num_vert_points;
+    const int num_old_edges = old_traced.num_edges;
+
+    Alloc_Scope<int> degrees(scratch, std::max(num_verts, 1));
+    simulate_pruning(in, degrees, items.edge_prune);
+
+    // 1. edges traced and pruned the same way keep their items. vertices of the other edges, old and new, are touched.
+    Alloc_Scope<unsigned char> create(scratch, std::max(num_edges, 1));
+    Alloc_Scope<unsigned char> old_kept(scratch, std::max(num_old_edges, 1));
+    Alloc_Scope<unsigned char> touched(scratch, std::max(num_verts, 1));
+    Alloc_Scope<unsigned char> moved(scratch, std::max(num_verts, 1));
+    zero_mem(create);
+    zero_mem(old_kept);
+    zero_mem(touched);
+    zero_mem(moved);
+
+    int num_created_edges = 0;
+    int num_created_events = 0;
+
+    for (int i = 0; i < num_edges; ++i)
     {
-        Vec2 pos;
-        Vec2 cp1;
-        Vec2 cp2;
-    };
+        int src = state.edge_sources[i];
+        unsigned char prune = items.edge_prune[i];
+        int u = nz(vertex_grid, traced.u[i]);
+        int v = nz(vertex_grid, traced.v[i]);
 
-    // correct sampled event position so that the point lies on the corresponding obstacle vertex normal.
-    Event_Closest_Points correct_pos_and_compute_closest(int event, int event_nz_index, Vec2 sampled_pos, Bbox2 bounds,
-                                                         const Footprint* obstacles, const Footprint_Normals* obstacle_normals,
-                                                         const Voronoi_Edge_Spans* spans, const Voronoi_Features* features)
-    {
-        Event_Closest_Points result;
-        int* obstacle_offsets = obstacle_normals->obstacle_normal_offsets;
+        if (src >= 0 && old_items.edge_prune[src] == prune)
+        {
+            old_kept[src] = 1;
+            items.edges[i] = old_items.edges[src];
 
-        int vertex_index_1 = spans->indices_1[event_nz_index];
-        int vertex_index_2 = spans->indices_2[event_nz_index];
-        int obstacle_id_1 = features->edge_obstacle_ids_1[event_nz_index];
-        int obstacle_id_2 = features->edge_obstacle_ids_2[event_nz_index];
+            if (prune == prune_move_source || prune == prune_move_target)
+            {
+                moved[prune == prune_move_source ? u : v] = 1;
+            }
 
-        int vertex_index = event > 0 ? vertex_index_1 : vertex_index_2;
-        int obstacle_id = event > 0 ? obstacle_id_1 : obstacle_id_2;
+            continue;
+        }
 
-        corridormap_assert(vertex_index > 0);
-        vertex_index = vertex_index - 1;
+        touched[u] = 1;
+        touched[v] = 1;
+        items.edges[i] = -1;
 
-        if (vertex_index >= obstacles->num_verts)
+        if (!removed(prune))
         {
-            result.pos = sampled_pos;
-            result.cp1 = compute_closest_point(*obstacles, bounds, obstacle_offsets, obstacle_id_1, sampled_pos);
-            result.cp2 = compute_closest_point(*obstacles, bounds, obstacle_offsets, obstacle_id_2, sampled_pos);
-            return result;
+            create[i] = 1;
+            num_created_edges++;
+            num_created_events += traced.edge_num_events[i] - (prune != prune_none);
         }
+    }
 
-        // get two normals associated with vertex and project event point to the closest normal.
-        int num_normals = obstacle_normals->num_obstacle_normals[obstacle_id - 1];
-        int first_normal_idx = obstacle_normals->obstacle_normal_offsets[obstacle_id - 1];
-        int curr = vertex_index;
-        int next = first_normal_idx + (curr - first_normal_idx + 1) % num_normals;
-        Vec2 v = { obstacles->x[vertex_index], obstacles->y[vertex_index] };
-        Vec2 n1 = { obstacle_normals->x[curr], obstacle_normals->y[curr] };
-        Vec2 n2 = { obstacle_normals->x[next], obstacle_normals->y[next] };
-        Vec2 dir = sampled_pos - v;
-        float p1 = dot(dir, n1);
-        float p2 = dot(dir, n2);
-        result.pos = v + ((p1 > p2) ? n1*p1 : n2*p2);
+    int num_released_edges = 0;
+    int num_released_events = 0;
 
-        if (event > 0)
-        {
-            result.cp1 = v;
-            result.cp2 = compute_closest_point(*obstacles, bounds, obstacle_offsets, obstacle_id_2, result.pos);
-        }
-        else
+    for (int i = 0; i < num_old_edges; ++i)
+    {
+        if (old_kept[i])
         {
-            result.cp2 = v;
-            result.cp1 = compute_closest_point(*obstacles, bounds, obstacle_offsets, obstacle_id_1, result.pos);
+            continue;
         }
 
-        return result;
-    }
+        int u = old.vertex_map[nz(*old.vertex_grid, old_traced.u[i])];
+        int v = old.vertex_map[nz(*old.vertex_grid, old_traced.v[i])];
 
-    void create_vertices(const Walkable_Space_Build_Params& in, Walkable_Space& out)
-    {
-        for (int i = 0; i < in.features->num_vert_points; ++i)
+        if (u >= 0)
         {
-            Vec2 pos = convert_from_image(in.features->verts[i], in.features->grid_width, in.features->grid_height, in.bounds);
-            create_vertex(out, pos);
+            touched[u] = 1;
         }
-    }
 
-    void create_edges(const Walkable_Space_Build_Params& in, Walkable_Space& out)
-    {
-        for (int i = 0; i < in.traced_edges->num_edges; ++i)
+        if (v >= 0)
         {
-            int u_nz = nz(*in.vertex_grid, in.traced_edges->u[i]);
-            int v_nz = nz(*in.vertex_grid, in.traced_edges->v[i]);
-            create_edge(out, u_nz, v_nz);
+            touched[v] = 1;
         }
-    }
 
-    void create_events(const Walkable_Space_Build_Params& in, Walkable_Space& out)
-    {
-        for (int i = 0; i < in.traced_edges->num_edges; ++i)
+        if (old_items.edges[i] >= 0)
         {
-            Edge* edge = out.edges.items + i;
-            Vec2 u = source(out, edge)->pos;
-
-            int event_offset = in.traced_edges->edge_event_offset[i];
-            int num_events = in.traced_edges->edge_num_events[i];
-
-            Vec2 prev = u;
+            Edge* e = out.edges.items + (old_items.edges[i] >> 1);
+            num_released_edges++;
 
-            for (int j = event_offset; j < event_offset + num_events; ++j)
+            for (Event* evt = event(out, e->dir + 0); evt != 0; evt = next(out, e->dir + 0, evt))
             {
-                int evt = in.traced_edges->events[j];
-                int evt_lin_idx = ::abs(evt);
-                int evt_nz_index = nz(*in.edge_grid, evt_lin_idx);
-
-                Vec2 sampled_pos = convert_from_image(evt_lin_idx, in.features->grid_width, in.features->grid_height, in.bounds);
-                Event_Closest_Points r = correct_pos_and_compute_closest(evt, evt_nz_index, sampled_pos, in.bounds,
-                                                                         in.obstacles, in.obstacle_normals, in.spans, in.features);
-
-                Event* e = create_event(out, r.pos, i);
-
-                if (is_left(prev, r.pos, r.cp1))
-                {
-                    e->sides[0] = r.cp1;
-                    e->sides[1] = r.cp2;
-                }
-                else
-                {
-                    e->sides[0] = r.cp2;
-                    e->sides[1] = r.cp1;
-                }
-
-                prev = r.pos;
+                num_released_events++;
             }
         }
     }
 
-    void compute_vertex_closest_points(const Walkable_Space_Build_Params& in, Walkable_Space& out)
-    {
-        int* obstacle_offsets = in.obstacle_normals->obstacle_normal_offsets;
+    // 2. vertices in the same cell keep their items.
+    Alloc_Scope<int> vertex_sources(scratch, std::max(num_verts, 1));
+    Alloc_Scope<unsigned char> old_vertex_kept(scratch, std::max(num_old_verts, 1));
+    memset(vertex_sources.data, 0xff, vertex_sources.count*sizeof(int));
+    zero_mem(old_vertex_kept);
 
-        for (int i = 0; i < in.traced_edges->num_edges; ++i)
+    for (int i = 0; i < num_old_verts; ++i)
+    {
+        if (old.vertex_map[i] >= 0)
         {
-            Edge* edge = out.edges.items + i;
-            Half_Edge* e0 = edge->dir + 0;
-            Half_Edge* e1 = edge->dir + 1;
-
-            Vec2 u = source(out, edge)->pos;
-            Vec2 v = target(out, edge)->pos;
-
-            Vec2 u_prev = v;
-            if (event(out, e0))
-            {
-                u_prev = event(out, e0)->pos;
-            }
-
-            Vec2 v_prev = u;
-            if (event(out, e1))
-            {
-                v_prev = event(out, e1)->pos;
-            }
+            vertex_sources[old.vertex_map[i]] = i;
+        }
+    }
 
-            unsigned int obstacle_id_1 = in.traced_edges->obstacle_ids_1[i];
-            unsigned int obstacle_id_2 = in.traced_edges->obstacle_ids_2[i];
-            Vec2 cp01 = compute_closest_point(*in.obstacles, in.bounds, obstacle_offsets, obstacle_id_1, target(out, e0)->pos);
-            Vec2 cp02 = compute_closest_point(*in.obstacles, in.bounds, obstacle_offsets, obstacle_id_2, target(out, e0)->pos);
-            Vec2 cp11 = compute_closest_point(*in.obstacles, in.bounds, obstacle_offsets, obstacle_id_2, target(out, e1)->pos);
-            Vec2 cp12 = compute_closest_point(*in.obstacles, in.bounds, obstacle_offsets, obstacle_id_1, target(out, e1)->pos);
+    int num_created_verts = 0;
 
-            if (is_left(v_prev, v, cp01))
-            {
-                e0->sides[0] = cp01;
-                e0->sides[1] = cp02;
-            }
-            else
-            {
-                e0->sides[0] = cp02;
-                e0->sides[1] = cp01;
-            }
+    for (int i = 0; i < num_verts; ++i)
+    {
+        int src = vertex_sources[i];
+        items.vertices[i] = -1;
 
-            if (is_left(u_prev, u, cp11))
+        if (degrees[i] > 0)
+        {
+            if (src >= 0 && old_items.vertices[src] >= 0)
             {
-                e1->sides[0] = cp11;
-                e1->sides[1] = cp12;
+                items.vertices[i] = old_items.vertices[src];
+                old_vertex_kept[src] = 1;
             }
             else
             {
-                e1->sides[0] = cp12;
-                e1->sides[1] = cp11;
+                num_created_verts++;
             }
         }
     }
 
-    void prune_dead_ends(Walkable_Space& out)
+    int num_released_verts = 0;
+
+    for (int i = 0; i < num_old_verts; ++i)
     {
-        for (Edge* e = first(out.edges); e != 0;)
+        num_released_verts += (old_items.vertices[i] >= 0 && !old_vertex_kept[i]);
+    }
+
+    if (out.vertices.num_items - num_released_verts + num_created_verts > out.vertices.max_items ||
+        out.edges.num_items - num_released_edges + num_created_edges > out.edges.max_items ||
+        out.events.num_items - num_released_events + num_created_events > out.events.max_items)
+    {
+        return false;
+    }
+
+    // 3. release what's gone.
+    for (int i = 0; i < num_old_edges; ++i)
+    {
+        if (old_items.edges[i] < 0 || old_kept[i])
         {
-            Edge* next_e = next(out.edges, e);
+            continue;
+        }
 
-            Vertex* s = source(out, e);
-            Vertex* t = target(out, e);
+        Edge* e = out.edges.items + (old_items.edges[i] >> 1);
 
-            int ds = degree(out, s);
-            int dt = degree(out, t);
+        unlink_half_edge(out, e->dir + 0);
+        unlink_half_edge(out, e->dir + 1);
 
-            Vertex* v = (ds == 1) ? s : t;
-            Vertex* u = (ds == 1) ? t : s;
-            // half-edge: u->v
-            Half_Edge* uv = (ds == 1) ? e->dir+1 : e->dir+0;
+        for (Event* evt = event(out, e->dir + 0); evt != 0;)
+        {
+            Event* next_evt = next(out, e->dir + 0, evt);
+            deallocate(out.events, evt);
+            evt = next_evt;
+        }
 
-            if (ds == 1 || dt == 1)
-            {
-                // edge ending with degree one vertex, no events -> prune.
-                if (!event(out, e->dir+0))
-                {
-                    deallocate(out.vertices, v);
+        deallocate(out.edges, e);
+    }
 
-                    for (Half_Edge* n = next(out, uv); ; n = next(out, n))
-                    {
-                        if (next(out, n) == uv)
-                        {
-                            n->next = uv->next;
+    for (int i = 0; i < num_old_verts; ++i)
+    {
+        if (old_items.vertices[i] >= 0 && !old_vertex_kept[i])
+        {
+            Vertex* v = out.vertices.items + old_items.vertices[i];
+            corridormap_assert(v->half_edge == int(null_idx));
+            deallocate(out.vertices, v);
+        }
+    }
 
-                            if (half_edge(out, u) == uv)
-                            {
-                                Edge* n_edge = edge(out, n);
-                                u->half_edge = int(n_edge - out.edges.items) + int(n - n_edge->dir);
-                            }
+    // 4. allocate what's new. touched vertices go back to their cells, unless a kept edge moved them.
+    for (int i = 0; i < num_verts; ++i)
+    {
+        if (degrees[i] > 0 && items.vertices[i] < 0)
+        {
+            items.vertices[i] = int(create_vertex(out, vertex_pos(in, i)) - out.vertices.items);
+        }
+        else if (items.vertices[i] >= 0 && touched[i] && !moved[i])
+        {
+            out.vertices.items[items.vertices[i]].pos = vertex_pos(in, i);
+        }
+    }
 
-                            break;
-                        }
-                    }
+    for (int i = 0; i < num_edges; ++i)
+    {
+        if (create[i])
+        {
+            Edge* e = create_edge(out, items.vertices[nz(vertex_grid, traced.u[i])], items.vertices[nz(vertex_grid, traced.v[i])]);
+            int edge_index = int(e - out.edges.items);
+            items.edges[i] = edge_index*2;
+            create_edge_events(in, out, i, edge_index);
+            compute_edge_closest_points(in, out, i, edge_index);
+        }
+    }
 
-                    deallocate(out.edges, e);
-                }
-                // otherwise move the degree one vertex to the first event on that edge.
-                else
-                {
-                    // ourgoing half-edge from v (degree one vertex).
-                    Half_Edge* vu = opposite(out, uv);
-                    Event* evt = event(out, vu);
-                    Event* next_evt = next(out, vu, evt);
-                    int vu_dir = int(vu - e->dir);
+    // 5. prune new dead ends, removed ones weren't created.
+    for (int i = 0; i < num_edges; ++i)
+    {
+        if (create[i] && items.edge_prune[i] != prune_none)
+        {
+            Edge* e = out.edges.items + (items.edges[i] >> 1);
+            bool source = items.edge_prune[i] == prune_move_source;
+            move_dead_end(out, e, source ? e->dir + 1 : e->dir + 0, out.vertices.items + (source ? e->dir[1].target : e->dir[0].target));
+        }
+    }
 
-                    if (next_evt)
-                    {
-                        vu->event = int(next_evt - out.events.items);
-                        next_evt->next[vu_dir^1] = null_idx;
-                    }
-                    else
-                    {
-                        vu->event = null_idx;
-                        uv->event = null_idx;
-                    }
+    // 6. half-edge order around touched vertices depends on the order edges were linked in, link them as a full build would.
+    Alloc_Scope<int> incident_offsets(scratch, num_verts + 1);
+    zero_mem(incident_offsets);
+
+    for (int i = 0; i < num_edges; ++i)
+    {
+        int u = nz(vertex_grid, traced.u[i]);
+        int v = nz(vertex_grid, traced.v[i]);
+        incident_offsets[u + 1] += touched[u];
+        incident_offsets[v + 1] += touched[v] && v != u;
+    }
 
-                    v->pos = evt->pos;
-                    uv->sides[0] = left_side(out, uv, evt);
-                    uv->sides[1] = right_side(out, uv, evt);
+    for (int i = 0; i < num_verts; ++i)
+    {
+        incident_offsets[i + 1] += incident_offsets[i];
+    }
 
-                    deallocate(out.events, evt);
-                }
-            }
+    const int num_incident = incident_offsets[num_verts];
+    Alloc_Scope<int> incident(scratch, std::max(num_incident, 1));
+    Alloc_Scope<int> ring(scratch, std::max(num_incident*2, 1));
+    Alloc_Scope<Vec2> ring_targets(scratch, std::max(num_incident*2, 1));
 
-            e = next_e;
+    for (int i = 0; i < num_edges; ++i)
+    {
+        int u = nz(vertex_grid, traced.u[i]);
+        int v = nz(vertex_grid, traced.v[i]);
+
+        if (touched[u])
+        {
+            incident[incident_offsets[u]++] = i;
+        }
+
+        if (touched[v] && v != u)
+        {
+            incident[incident_offsets[v]++] = i;
         }
     }
 
-    void prune_disconnected_verts(Walkable_Space& out)
+    for (int i = num_verts; i > 0; --i)
     {
-        for (Vertex* v = first(out.vertices); v != 0;)
+        incident_offsets[i] = incident_offsets[i - 1];
+    }
+
+    incident_offsets[0] = 0;
+
+    for (int i = 0; i < num_verts; ++i)
+    {
+        if (!touched[i] || degrees[i] == 0)
         {
-            Vertex* next_v = next(out.vertices, v);
+            continue;
+        }
 
-            if (!half_edge(out, v))
-            {
-                deallocate(out.vertices, v);
-            }
+        int first = incident_offsets[i];
+        int size = simulate_ring(in, items.edge_prune, i, incident + first, incident_offsets[i + 1] - first, ring, ring_targets);
+        corridormap_assert(size > 0);
 
-            v = next_v;
+        Vertex* vertex = out.vertices.items + items.vertices[i];
+        vertex->half_edge = items.edges[ring[0] >> 1] ^ (ring[0] & 1);
+
+        for (int j = 0; j < size; ++j)
+        {
+            int h = items.edges[ring[j] >> 1] ^ (ring[j] & 1);
+            int h_next = items.edges[ring[(j + 1) % size] >> 1] ^ (ring[(j + 1) % size] & 1);
+            out.edges.items[h >> 1].dir[h & 1].next = h_next;
         }
     }
-}
 
-void build_walkable_space(const Walkable_Space_Build_Params& in, Walkable_Space& out)
-{
-    create_vertices(in, out);
-    create_edges(in, out);
-    create_events(in, out);
-    compute_vertex_closest_points(in, out);
-    prune_dead_ends(out);
-    prune_disconnected_verts(out);
+    return true;
 }
 
 }
@@ -47,6 +47,39 @@ void deallocate(Memory* mem, Distance_Mesh& mesh)
     memset(&mesh, 0, sizeof(mesh));
 }
 
+Distance_Mesh_Indexed allocate_distance_mesh_indexed(Memory* mem, int num_obstacle_polys, int num_obstacle_verts, int num_cone_tris)
+{
+    Distance_Mesh_Indexed result;
+    memset(&result, 0, sizeof(result));
+
+    const int num_segments = 1 + num_border_segments + num_obstacle_polys;
+
+    // obstacle vertices, 2 tent vertices per obstacle edge, 4 corners and 2 tent vertices per border side.
+    result.verts = allocate<Render_Vertex>(mem, num_obstacle_verts*3 + num_border_segments*3);
+    // obstacle polygons, 2 triangles per obstacle edge, four border planes.
+    result.indices = allocate<unsigned int>(mem, (num_obstacle_verts - num_obstacle_polys*2)*3 + num_obstacle_verts*2*3 + num_border_segments*2*3);
+    result.num_segment_indices = allocate<int>(mem, num_segments);
+    // one cone per obstacle vertex.
+    result.instances = allocate<Cone_Instance>(mem, num_obstacle_verts);
+    result.num_segment_instances = allocate<int>(mem, num_segments);
+    result.segment_colors = allocate<unsigned int>(mem, num_segments);
+    result.num_cone_tris = num_cone_tris;
+    result.cone_verts = allocate<Render_Vertex>(mem, num_cone_tris*2*3);
+    return result;
+}
+
+void deallocate(Memory* mem, Distance_Mesh_Indexed& mesh)
+{
+    mem->deallocate(mesh.verts);
+    mem->deallocate(mesh.indices);
+    mem->deallocate(mesh.num_segment_indices);
+    mem->deallocate(mesh.instances);
+    mem->deallocate(mesh.num_segment_instances);
+    mem->deallocate(mesh.segment_colors);
+    mem->deallocate(mesh.cone_verts);
+    memset(&mesh, 0, sizeof(mesh));
+}
+
 Voronoi_Features allocate_voronoi_features(Memory* mem, int grid_width, int grid_height, int num_vert_points, int num_edge_points)
 {
     Voronoi_Features result;
@@ -84,10 +117,35 @@ Footprint_Normals allocate_foorprint_normals(Memory* mem, int num_polygons, int
     result.y = allocate<float>(mem, result.num_normals);
     result.num_obstacle_normals = allocate<int>(mem, result.num_obstacles);
     result.obstacle_normal_offsets = allocate<int>(mem, result.num_obstacles);
+    result.bisector_x = allocate<float>(mem, num_poly_verts);
+    result.bisector_y = allocate<float>(mem, num_poly_verts);
+    result.bisector_threshold = allocate<float>(mem, num_poly_verts);
 
     return result;
 }
 
+Footprint_Edge_Tree allocate_footprint_edge_tree(Memory* mem, int num_polygons, int num_nodes)
+{
+    Footprint_Edge_Tree result;
+    memset(&result, 0, sizeof(result));
+
+    result.num_polys = num_polygons;
+    result.num_nodes = num_nodes;
+    result.poly_node_offsets = allocate<int>(mem, num_polygons);
+    result.poly_num_leaves = allocate<int>(mem, num_polygons);
+    result.node_bounds = allocate<float>(mem, num_nodes*4);
+
+    return result;
+}
+
+void deallocate(Memory* mem, Footprint_Edge_Tree& tree)
+{
+    mem->deallocate(tree.poly_node_offsets);
+    mem->deallocate(tree.poly_num_leaves);
+    mem->deallocate(tree.node_bounds);
+    memset(&tree, 0, sizeof(tree));
+}
+
 // deallocates footprint normals. 'mem' must be the same that was used for allocation.
 void deallocate(Memory* mem, Footprint_Normals& normals)
 {
@@ -95,6 +153,9 @@ void deallocate(Memory* mem, Footprint_Normals& normals)
     mem->deallocate(normals.y);
     mem->deallocate(normals.num_obstacle_normals);
     mem->deallocate(normals.obstacle_normal_offsets);
+    mem->deallocate(normals.bisector_x);
+    mem->deallocate(normals.bisector_y);
+    mem->deallocate(normals.bisector_threshold);
     memset(&normals, 0, sizeof(normals));
 }
 
@@ -124,6 +185,9 @@ CSR_Grid allocate_csr_grid(Memory* mem, int num_rows, int num_cols, int num_non_
     result.num_nz = num_non_zero;
     result.column = allocate<int>(mem, num_non_zero);
     result.row_offset = allocate<int>(mem, num_rows + 1);
+    result.num_occupancy_words = (num_rows*num_cols + csr_occupancy_word_bits - 1)/csr_occupancy_word_bits;
+    result.occupancy = allocate<unsigned int>(mem, result.num_occupancy_words);
+    result.occupancy_rank = allocate<int>(mem, result.num_occupancy_words);
 
     return result;
 }
@@ -132,16 +196,18 @@ void deallocate(Memory* mem, CSR_Grid& grid)
 {
     mem->deallocate(grid.column);
     mem->deallocate(grid.row_offset);
+    mem->deallocate(grid.occupancy);
+    mem->deallocate(grid.occupancy_rank);
     memset(&grid, 0, sizeof(grid));
 }
 
-Voronoi_Traced_Edges allocate_voronoi_traced_edges(Memory* mem, int num_voronoi_verts, int num_footprint_verts)
+Voronoi_Traced_Edges allocate_voronoi_traced_edges(Memory* mem, int num_voronoi_verts, int num_edge_points)
 {
     Voronoi_Traced_Edges result;
     memset(&result, 0, sizeof(result));
 
     int max_edges = num_voronoi_verts*max_grid_neis/2;
-    int max_events = num_footprint_verts*2;
+    int max_events = num_edge_points;
     result.u = allocate<int>(mem, max_edges);
     result.v = allocate<int>(mem, max_edges);
     result.obstacle_ids_1 = allocate<unsigned int>(mem, max_edges);
@@ -160,4 +226,54 @@ void deallocate(Memory* mem, Voronoi_Traced_Edges& edges)
     memset(&edges, 0, sizeof(edges));
 }
 
+Voronoi_Trace_State allocate_voronoi_trace_state(Memory* mem, int num_voronoi_verts, int num_edge_points)
+{
+    Voronoi_Trace_State result;
+    memset(&result, 0, sizeof(result));
+
+    int max_edges = num_voronoi_verts*max_grid_neis/2;
+    result.num_walks = num_voronoi_verts*max_grid_neis;
+    result.num_points = num_edge_points;
+    result.walk_edges = allocate<int>(mem, result.num_walks);
+    result.walk_points = allocate<int>(mem, result.num_walks);
+    result.walk_windows = allocate<Grid_Window>(mem, result.num_walks);
+    result.point_owners = allocate<int>(mem, num_edge_points);
+    result.point_visits = allocate<int>(mem, num_edge_points);
+    result.edge_sources = allocate<int>(mem, max_edges);
+
+    return result;
+}
+
+void deallocate(Memory* mem, Voronoi_Trace_State& state)
+{
+    mem->deallocate(state.walk_edges);
+    mem->deallocate(state.walk_points);
+    mem->deallocate(state.walk_windows);
+    mem->deallocate(state.point_owners);
+    mem->deallocate(state.point_visits);
+    mem->deallocate(state.edge_sources);
+    memset(&state, 0, sizeof(state));
+}
+
+Walkable_Space_Items allocate_walkable_space_items(Memory* mem, int num_voronoi_verts)
+{
+    Walkable_Space_Items result;
+    memset(&result, 0, sizeof(result));
+
+    int max_edges = num_voronoi_verts*max_grid_neis/2;
+    result.edge_prune = allocate<unsigned char>(mem, max_edges);
+    result.edges = allocate<int>(mem, max_edges);
+    result.vertices = allocate<int>(mem, num_voronoi_verts);
+
+    return result;
+}
+
+void deallocate(Memory* mem, Walkable_Space_Items& items)
+{
+    mem->deallocate(items.edge_prune);
+    mem->deallocate(items.edges);
+    mem->deallocate(items.vertices);
+    memset(&items, 0, sizeof(items));
+}
+
 }
@@ -0,0 +1,975 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <new>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include "corridormap/assert.h"
+#include "corridormap/memory.h"
+#include "corridormap/vec2.h"
+#include "corridormap/render_interface.h"
+#include "corridormap/runtime.h"
+#include "corridormap/build_alloc.h"
+#include "corridormap/build_stats.h"
+#include "corridormap/build.h"
+
+namespace corridormap {
+
+Build_Context create_build_context(Memory* mem, size_t block_size)
+{
+    Build_Context result;
+    memset(&result, 0, sizeof(result));
+    result.memory = mem;
+
+    void* frame_0 = mem->allocate(sizeof(Memory_Arena), sizeof(void*));
+    void* frame_1 = mem->allocate(sizeof(Memory_Arena), sizeof(void*));
+    void* scratch = mem->allocate(sizeof(Memory_Stack), sizeof(void*));
+    corridormap_assert(frame_0 && frame_1 && scratch);
+
+    result.frames[0] = new (frame_0) Memory_Arena(mem, block_size);
+    result.frames[1] = new (frame_1) Memory_Arena(mem, block_size);
+    result.scratch = new (scratch) Memory_Stack(mem, block_size);
+    return result;
+}
+
+void destroy(Build_Context& ctx)
+{
+    Memory* mem = ctx.memory;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (ctx.frames[i])
+        {
+            ctx.frames[i]->~Memory_Arena();
+            mem->deallocate(ctx.frames[i]);
+        }
+    }
+
+    if (ctx.scratch)
+    {
+        ctx.scratch->~Memory_Stack();
+        mem->deallocate(ctx.scratch);
+    }
+
+    mem->deallocate(ctx.pixels);
+
+    memset(&ctx, 0, sizeof(ctx));
+}
+
+namespace
+{
+    // reuses the walkable space if it has enough capacity, otherwise reallocates it.
+    void prepare_walkable_space(Memory* mem, Walkable_Space& space, int num_vertices, int num_edges, int num_events)
+    {
+        // pools can't be empty.
+        num_vertices = num_vertices > 0 ? num_vertices : 1;
+        num_edges = num_edges > 0 ? num_edges : 1;
+        num_events = num_events > 0 ? num_events : 1;
+
+        if (space.vertices.max_items < num_vertices || space.edges.max_items < num_edges || space.events.max_items < num_events)
+        {
+            if (space.vertices.items)
+            {
+                destroy(mem, space);
+            }
+
+            space = create_walkable_space(mem, num_vertices, num_edges, num_events);
+            return;
+        }
+
+        init(space.vertices);
+        init(space.edges);
+        init(space.events);
+    }
+
+    // grows the pool if it has less than max_items, items keep their indices.
+    template <typename T>
+    void reserve(Memory* mem, Pool<T>& pool, int max_items)
+    {
+        if (pool.max_items >= max_items)
+        {
+            return;
+        }
+
+        T* items = allocate<T>(mem, max_items);
+        int* prev = allocate<int>(mem, max_items);
+        memcpy(items, pool.items, pool.max_items*sizeof(T));
+        memcpy(prev, pool.prev, pool.max_items*sizeof(int));
+
+        // new items are put in front of the free list.
+        for (int i = pool.max_items; i < max_items; ++i)
+        {
+            items[i].link = (i + 1 < max_items) ? i + 1 : pool.head_free;
+            prev[i] = null_idx;
+        }
+
+        mem->deallocate(pool.items);
+        mem->deallocate(pool.prev);
+
+        pool.head_free = pool.max_items;
+        pool.max_items = max_items;
+        pool.items = items;
+        pool.prev = prev;
+    }
+
+    Footprint copy_footprint(Memory* mem, const Footprint& footprint)
+    {
+        Footprint result;
+        result.num_polys = footprint.num_polys;
+        result.num_verts = footprint.num_verts;
+        result.x = allocate<float>(mem, footprint.num_verts);
+        result.y = allocate<float>(mem, footprint.num_verts);
+        result.num_poly_verts = allocate<int>(mem, footprint.num_polys);
+        memcpy(result.x, footprint.x, footprint.num_verts*sizeof(float));
+        memcpy(result.y, footprint.y, footprint.num_verts*sizeof(float));
+        memcpy(result.num_poly_verts, footprint.num_poly_verts, footprint.num_polys*sizeof(int));
+        return result;
+    }
+
+    // builds the distance mesh of ctx.footprint, with radii bounded on a coarse grid if requested.
+    void build_mesh(Build_Context& ctx, Memory* frame, const Build_Params& params)
+    {
+        const Footprint& footprint = ctx.footprint;
+        const float max_dist = max_distance(ctx.bounds);
+
+        if (params.mesh_radius_cells > 0)
+        {
+            const int cells = params.mesh_radius_cells;
+            const int width = (ctx.grid_width >= ctx.grid_height) ? cells : std::max(cells*ctx.grid_width/ctx.grid_height, 1);
+            const int height = (ctx.grid_width >= ctx.grid_height) ? std::max(cells*ctx.grid_height/ctx.grid_width, 1) : cells;
+
+            Alloc_Scope<float> radii(ctx.scratch, footprint.num_polys + num_border_segments);
+            build_distance_mesh_radii(params.scheduler, ctx.scratch, footprint, ctx.bounds, max_dist, params.max_error, width, height, radii);
+
+            const int num_cone_tris = distance_mesh_cone_tris(footprint, max_dist, params.max_error, radii);
+            ctx.mesh = allocate_distance_mesh_indexed(frame, footprint.num_polys, footprint.num_verts, num_cone_tris);
+            build_distance_mesh(footprint, ctx.bounds, max_dist, ctx.mesh, radii);
+        }
+        else
+        {
+            const int num_cone_tris = distance_mesh_cone_tris(footprint, max_dist, params.max_error);
+            ctx.mesh = allocate_distance_mesh_indexed(frame, footprint.num_polys, footprint.num_verts, num_cone_tris);
+            build_distance_mesh(footprint, ctx.bounds, max_dist, ctx.mesh);
+        }
+    }
+
+    // builds csr grids of ctx.features and allocates the trace output.
+    void prepare_trace(Build_Context& ctx, Memory* frame)
+    {
+        const int width = ctx.grid_width;
+        const int height = ctx.grid_height;
+
+        ctx.vertex_grid = allocate_csr_grid(frame, height, width, ctx.features.num_vert_points);
+        build_csr(ctx.features.verts, ctx.vertex_grid);
+
+        ctx.edge_grid = allocate_csr_grid(frame, height, width, ctx.features.num_edge_points);
+        build_csr(ctx.features.edges, ctx.edge_grid);
+
+        ctx.traced_edges = allocate_voronoi_traced_edges(frame, ctx.features.num_vert_points, ctx.features.num_edge_points);
+        ctx.trace_state = allocate_voronoi_trace_state(frame, ctx.features.num_vert_points, ctx.features.num_edge_points);
+    }
+
+    // traces all edges of ctx.features, the trace state is kept for the next update.
+    void trace(Build_Context& ctx, const Build_Params& params)
+    {
+        trace_edges(ctx.scratch, params.scheduler, ctx.vertex_grid, ctx.edge_grid, ctx.spans, ctx.features, ctx.traced_edges, ctx.trace_state);
+    }
+
+    Walkable_Space_Build_Params walkable_space_params(Build_Context& ctx)
+    {
+        Walkable_Space_Build_Params result;
+        result.bounds = ctx.bounds;
+        result.obstacles = &ctx.footprint;
+        result.obstacle_normals = &ctx.normals;
+        result.obstacle_edge_tree = &ctx.edge_tree;
+        result.features = &ctx.features;
+        result.traced_edges = &ctx.traced_edges;
+        result.spans = &ctx.spans;
+        result.edge_grid = &ctx.edge_grid;
+        result.vertex_grid = &ctx.vertex_grid;
+        return result;
+    }
+}
+
+void build_corridor_map(Build_Context& ctx, const Footprint& footprint, const Build_Params& params, Walkable_Space& out)
+{
+    corridormap_assert(params.grid_width > 0 && params.grid_height > 0);
+
+    Memory* frame = ctx.frames[ctx.frame];
+    Memory* scratch = ctx.scratch;
+    const int width = params.grid_width;
+    const int height = params.grid_height;
+
+    // intermediates of the previous build are released, blocks are reused.
+    ctx.frames[0]->reset();
+    ctx.frames[1]->reset();
+    ctx.scratch->reset();
+    memset(&ctx.mesh, 0, sizeof(ctx.mesh));
+
+    if (!ctx.pixels || ctx.grid_width*ctx.grid_height != width*height)
+    {
+        ctx.memory->deallocate(ctx.pixels);
+        ctx.pixels = allocate<unsigned char>(ctx.memory, width*height*4, 16);
+    }
+
+    ctx.grid_width = width;
+    ctx.grid_height = height;
+
+    if (params.renderer)
+    {
+        const Renderer::Parameters& render_params = params.renderer->params;
+        corridormap_assert(int(render_params.render_target_width) == width && int(render_params.render_target_height) == height);
+        ctx.bounds.min[0] = render_params.min[0];
+        ctx.bounds.min[1] = render_params.min[1];
+        ctx.bounds.max[0] = render_params.max[0];
+        ctx.bounds.max[1] = render_params.max[1];
+    }
+    else if (params.bounds)
+    {
+        ctx.bounds = *params.bounds;
+    }
+    else
+    {
+        ctx.bounds = fit(bounds(footprint, params.border), float(width)/float(height));
+    }
+
+    ctx.footprint = copy_footprint(frame, footprint);
+
+    ctx.normals = allocate_foorprint_normals(frame, footprint.num_polys, footprint.num_verts);
+    build_footprint_normals(footprint, ctx.bounds, ctx.normals);
+
+    ctx.edge_tree = allocate_footprint_edge_tree(frame, footprint.num_polys, footprint_edge_tree_nodes(footprint));
+    build_footprint_edge_tree(footprint, ctx.edge_tree);
+
+    if (params.renderer)
+    {
+        build_mesh(ctx, frame, params);
+        render_distance_mesh(params.renderer, ctx.mesh);
+        params.renderer->read_pixels(ctx.pixels);
+    }
+    else
+    {
+        build_obstacle_id_image(params.scheduler, scratch, footprint, ctx.bounds, width, height, ctx.pixels);
+    }
+
+    ctx.features = detect_voronoi_features(frame, scratch, ctx.pixels, width, height, params.scheduler);
+
+    ctx.spans = allocate_voronoi_edge_spans(frame, ctx.features.num_edge_points);
+    build_edge_spans(ctx.features, footprint, ctx.normals, ctx.bounds, ctx.spans, params.scheduler);
+
+    prepare_trace(ctx, frame);
+    trace(ctx, params);
+
+    prepare_walkable_space(ctx.memory, out, ctx.features.num_vert_points, ctx.traced_edges.num_edges, ctx.traced_edges.num_events);
+
+    Walkable_Space_Build_Params space_params = walkable_space_params(ctx);
+    build_walkable_space(space_params, out);
+
+    ctx.space_items = allocate_walkable_space_items(frame, ctx.features.num_vert_points);
+    walkable_space_items(scratch, space_params, ctx.space_items);
+}
+
+namespace
+{
+    Grid_Window empty_window()
+    {
+        Grid_Window result = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        return result;
+    }
+
+    inline void include(Grid_Window& window, int x, int y)
+    {
+        window.min_x = std::min(window.min_x, x);
+        window.min_y = std::min(window.min_y, y);
+        window.max_x = std::max(window.max_x, x);
+        window.max_y = std::max(window.max_y, y);
+    }
+
+    inline bool contains(const Grid_Window& window, int x, int y)
+    {
+        return x >= window.min_x && x <= window.max_x && y >= window.min_y && y <= window.max_y;
+    }
+
+    // true if the polygon has different vertices in the footprints.
+    bool polygon_changed(const Footprint& a, const Footprint& b, int poly)
+    {
+        int offset_a = 0;
+        int offset_b = 0;
+
+        for (int i = 0; i < poly; ++i)
+        {
+            offset_a += a.num_poly_verts[i];
+            offset_b += b.num_poly_verts[i];
+        }
+
+        const int num_verts = a.num_poly_verts[poly];
+
+        return num_verts != b.num_poly_verts[poly] ||
+               memcmp(a.x + offset_a, b.x + offset_b, num_verts*sizeof(float)) != 0 ||
+               memcmp(a.y + offset_a, b.y + offset_b, num_verts*sizeof(float)) != 0;
+    }
+
+    // pixels store segment index in the same memory layout as rendered color.
+    inline unsigned int pixel_id(const unsigned char* pixels, int index)
+    {
+        const unsigned char* p = pixels + index*4;
+        return (unsigned int)(p[0]) << 24 |
+               (unsigned int)(p[1]) << 16 |
+               (unsigned int)(p[2]) << 8  |
+               (unsigned int)(p[3]) << 0  ;
+    }
+
+    // returns the window of pixels which differ between the images or belong to the cells of changed segments.
+    Grid_Window diff_obstacle_ids(const unsigned char* old_pixels, const unsigned char* new_pixels, int width, int height, const unsigned char* changed)
+    {
+        Grid_Window window = empty_window();
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                unsigned int old_id = pixel_id(old_pixels, y*width + x);
+                unsigned int new_id = pixel_id(new_pixels, y*width + x);
+
+                if (old_id != new_id || changed[old_id] || changed[new_id])
+                {
+                    include(window, x, y);
+                }
+            }
+        }
+
+        return window;
+    }
+
+    // detects features inside the window (inclusive, x >= 1, y >= 1). indices of the result are in the full grid.
+    Voronoi_Features detect_window(Memory* memory, Memory* scratch, const unsigned char* pixels, int width, int height,
+                                   const Grid_Window& window, Scheduler* scheduler)
+    {
+        // features at (x, y) depend on pixels (x-1, y-1) .. (x, y), window is extended by one pixel up and left.
+        const int sub_width = window.max_x - window.min_x + 2;
+        const int sub_height = window.max_y - window.min_y + 2;
+        const int x0 = window.min_x - 1;
+        const int y0 = window.min_y - 1;
+
+        Alloc_Scope<unsigned int> sub_pixels(scratch, sub_width*sub_height, 16);
+
+        for (int y = 0; y < sub_height; ++y)
+        {
+            memcpy(sub_pixels + y*sub_width, pixels + ((y0 + y)*width + x0)*4, sub_width*4);
+        }
+
+        Voronoi_Features result = detect_voronoi_features(memory, scratch, reinterpret_cast<unsigned char*>(sub_pixels.data), sub_width, sub_height, scheduler);
+
+        for (int i = 0; i < result.num_vert_points; ++i)
+        {
+            unsigned int idx = result.verts[i];
+            result.verts[i] = (y0 + idx/sub_width)*width + x0 + idx%sub_width;
+        }
+
+        for (int i = 0; i < result.num_edge_points; ++i)
+        {
+            unsigned int idx = result.edges[i];
+            result.edges[i] = (y0 + idx/sub_width)*width + x0 + idx%sub_width;
+        }
+
+        result.grid_width = width;
+        result.grid_height = height;
+
+        return result;
+    }
+
+    inline bool contains(const Grid_Window& window, unsigned int index, int width)
+    {
+        return contains(window, int(index%width), int(index/width));
+    }
+
+    // spans store normal indices, which shift when the number of vertices of preceding polygons changes.
+    inline int remap_span(int span, unsigned int id, const int* old_offsets, const int* new_offsets)
+    {
+        if (span == 0 || id == 0)
+        {
+            return span;
+        }
+
+        return span - old_offsets[id - 1] + new_offsets[id - 1];
+    }
+
+    // merges features outside of the window with features detected inside the window, keeping row-major order.
+    // sides of old points swapped by the last trace (odd owners) are swapped back, trace arranges them again.
+    // point_map receives the new index of each old point, -1 for points inside the window.
+    void merge_features(Memory* memory, const Voronoi_Features& old_features, const Voronoi_Edge_Spans& old_spans, const int* old_offsets,
+                        const int* old_owners, const Voronoi_Features& window_features, const Voronoi_Edge_Spans& window_spans,
+                        const int* new_offsets, const Grid_Window& window, Voronoi_Features& out_features, Voronoi_Edge_Spans& out_spans,
+                        int* point_map)
+    {
+        const int width = old_features.grid_width;
+
+        int num_verts = window_features.num_vert_points;
+        int num_edges = window_features.num_edge_points;
+
+        for (int i = 0; i < old_features.num_vert_points; ++i)
+        {
+            num_verts += !contains(window, old_features.verts[i], width);
+        }
+
+        for (int i = 0; i < old_features.num_edge_points; ++i)
+        {
+            num_edges += !contains(window, old_features.edges[i], width);
+        }
+
+        out_features = allocate_voronoi_features(memory, old_features.grid_width, old_features.grid_height, num_verts, num_edges);
+        out_spans = allocate_voronoi_edge_spans(memory, num_edges);
+        memset(point_map, 0xff, old_features.num_edge_points*sizeof(int));
+
+        for (int i = 0, j = 0, k = 0; k < num_verts; ++k)
+        {
+            while (i < old_features.num_vert_points && contains(window, old_features.verts[i], width))
+            {
+                ++i;
+            }
+
+            if (j < window_features.num_vert_points && (i == old_features.num_vert_points || window_features.verts[j] < old_features.verts[i]))
+            {
+                out_features.verts[k] = window_features.verts[j++];
+            }
+            else
+            {
+                out_features.verts[k] = old_features.verts[i++];
+            }
+        }
+
+        for (int i = 0, j = 0, k = 0; k < num_edges; ++k)
+        {
+            while (i < old_features.num_edge_points && contains(window, old_features.edges[i], width))
+            {
+                ++i;
+            }
+
+            if (j < window_features.num_edge_points && (i == old_features.num_edge_points || window_features.edges[j] < old_features.edges[i]))
+            {
+                out_features.edges[k] = window_features.edges[j];
+                out_features.edge_obstacle_ids_1[k] = window_features.edge_obstacle_ids_1[j];
+                out_features.edge_obstacle_ids_2[k] = window_features.edge_obstacle_ids_2[j];
+                out_spans.indices_1[k] = window_spans.indices_1[j];
+                out_spans.indices_2[k] = window_spans.indices_2[j];
+                ++j;
+            }
+            else
+            {
+                bool swapped = old_owners[i] >= 0 && (old_owners[i] & 1);
+                unsigned int id_1 = swapped ? old_features.edge_obstacle_ids_2[i] : old_features.edge_obstacle_ids_1[i];
+                unsigned int id_2 = swapped ? old_features.edge_obstacle_ids_1[i] : old_features.edge_obstacle_ids_2[i];
+                int span_1 = swapped ? old_spans.indices_2[i] : old_spans.indices_1[i];
+                int span_2 = swapped ? old_spans.indices_1[i] : old_spans.indices_2[i];
+                out_features.edges[k] = old_features.edges[i];
+                out_features.edge_obstacle_ids_1[k] = id_1;
+                out_features.edge_obstacle_ids_2[k] = id_2;
+                out_spans.indices_1[k] = remap_span(span_1, id_1, old_offsets, new_offsets);
+                out_spans.indices_2[k] = remap_span(span_2, id_2, old_offsets, new_offsets);
+                point_map[i++] = k;
+            }
+        }
+    }
+
+    // maps each old cell to the index of the same cell in new_cells, -1 if it's not there. both lists are sorted.
+    void map_cells(const unsigned int* old_cells, int num_old, const unsigned int* new_cells, int num_new, int* map)
+    {
+        for (int i = 0, j = 0; i < num_old; ++i)
+        {
+            while (j < num_new && new_cells[j] < old_cells[i])
+            {
+                ++j;
+            }
+
+            map[i] = (j < num_new && new_cells[j] == old_cells[i]) ? j : -1;
+        }
+    }
+
+    struct Vertex_Key
+    {
+        Vec2 pos;
+        int index;
+    };
+
+    inline bool operator<(const Vertex_Key& a, const Vertex_Key& b)
+    {
+        if (a.pos.x != b.pos.x) return a.pos.x < b.pos.x;
+        if (a.pos.y != b.pos.y) return a.pos.y < b.pos.y;
+        return a.index < b.index;
+    }
+
+    int sorted_vertex_keys(const Walkable_Space& space, Vertex_Key* keys)
+    {
+        int count = 0;
+
+        for (Vertex* v = first(space.vertices); v != 0; v = next(space.vertices, v))
+        {
+            keys[count].pos = v->pos;
+            keys[count].index = int(v - space.vertices.items);
+            count++;
+        }
+
+        std::sort(keys, keys + count);
+        return count;
+    }
+
+    inline bool equal(Vec2 a, Vec2 b)
+    {
+        return a.x == b.x && a.y == b.y;
+    }
+
+    // compares closest points and events of two half-edges along their direction.
+    bool same_half_edge(const Walkable_Space& space_a, const Half_Edge* a, const Walkable_Space& space_b, const Half_Edge* b)
+    {
+        if (!equal(a->sides[0], b->sides[0]) || !equal(a->sides[1], b->sides[1]))
+        {
+            return false;
+        }
+
+        const Event* ea = event(space_a, a);
+        const Event* eb = event(space_b, b);
+
+        for (; ea && eb; ea = next(space_a, a, ea), eb = next(space_b, b, eb))
+        {
+            if (!equal(ea->pos, eb->pos) ||
+                !equal(left_side(space_a, a, ea), left_side(space_b, b, eb)) ||
+                !equal(right_side(space_a, a, ea), right_side(space_b, b, eb)))
+            {
+                return false;
+            }
+        }
+
+        return ea == 0 && eb == 0;
+    }
+
+    struct Splice_Map
+    {
+        // src vertex -> dst vertex.
+        int* vertices;
+        // src edge -> dst edge.
+        int* edges;
+        // 1 if dst edge direction is opposite to src.
+        unsigned char* flips;
+    };
+
+    inline int map_half_edge(const Splice_Map& map, int half_edge)
+    {
+        int e = half_edge >> 1;
+        return map.edges[e]*2 + ((half_edge & 1) ^ map.flips[e]);
+    }
+
+    inline Half_Edge* half_edge_by_index(Walkable_Space& space, int half_edge)
+    {
+        return space.edges.items[half_edge >> 1].dir + (half_edge & 1);
+    }
+
+    // replaces contents of dst with src, keeping dst vertices and edges which are present in src. items of src are mapped to dst.
+    // returns false if dst pools don't have enough capacity, dst is not modified in this case.
+    bool splice_walkable_space(Memory* scratch, Walkable_Space& src, Walkable_Space& dst, Walkable_Space_Items& items, int num_edges, int num_verts)
+    {
+        corridormap_build_scope(build_stage_walkable_space);
+
+        if (src.vertices.num_items > dst.vertices.max_items ||
+            src.edges.num_items > dst.edges.max_items ||
+            src.events.num_items > dst.events.max_items)
+        {
+            return false;
+        }
+
+        Alloc_Scope<int> src_vertex_map(scratch, src.vertices.max_items);
+        Alloc_Scope<int> src_edge_map(scratch, src.edges.max_items);
+        Alloc_Scope<unsigned char> src_edge_flips(scratch, src.edges.max_items);
+        Alloc_Scope<unsigned char> dst_vertex_keep(scratch, dst.vertices.max_items);
+        Alloc_Scope<unsigned char> dst_edge_keep(scratch, dst.edges.max_items);
+
+        memset(src_vertex_map.data, 0xff, src.vertices.max_items*sizeof(int));
+        memset(src_edge_map.data, 0xff, src.edges.max_items*sizeof(int));
+        zero_mem(src_edge_flips);
+        zero_mem(dst_vertex_keep);
+        zero_mem(dst_edge_keep);
+
+        // match vertices by position.
+        {
+            Alloc_Scope<Vertex_Key> src_keys(scratch, src.vertices.num_items);
+            Alloc_Scope<Vertex_Key> dst_keys(scratch, dst.vertices.num_items);
+            int num_src_keys = sorted_vertex_keys(src, src_keys);
+            int num_dst_keys = sorted_vertex_keys(dst, dst_keys);
+
+            for (int i = 0, j = 0; i < num_src_keys && j < num_dst_keys;)
+            {
+                if (equal(src_keys[i].pos, dst_keys[j].pos))
+                {
+                    src_vertex_map[src_keys[i].index] = dst_keys[j].index;
+                    dst_vertex_keep[dst_keys[j].index] = 1;
+                    ++i;
+                    ++j;
+                }
+                else if (src_keys[i] < dst_keys[j])
+                {
+                    ++i;
+                }
+                else
+                {
+                    ++j;
+                }
+            }
+        }
+
+        // match edges between matched vertices by closest points and events.
+        for (Edge* e = first(src.edges); e != 0; e = next(src.edges, e))
+        {
+            int u = src_vertex_map[e->dir[1].target];
+            int v = src_vertex_map[e->dir[0].target];
+
+            if (u == int(null_idx) || v == int(null_idx))
+            {
+                continue;
+            }
+
+            Half_Edge* head = half_edge(dst, dst.vertices.items + u);
+
+            if (!head)
+            {
+                continue;
+            }
+
+            for (Half_Edge* h = head; ; h = next(dst, h))
+            {
+                Edge* dst_edge = edge(dst, h);
+                int dst_edge_idx = int(dst_edge - dst.edges.items);
+
+                if (h->target == v && !dst_edge_keep[dst_edge_idx] &&
+                    same_half_edge(src, e->dir + 0, dst, h) &&
+                    same_half_edge(src, e->dir + 1, dst, opposite(dst, h)))
+                {
+                    int src_edge_idx = int(e - src.edges.items);
+                    src_edge_map[src_edge_idx] = dst_edge_idx;
+                    src_edge_flips[src_edge_idx] = (unsigned char)(h - dst_edge->dir);
+                    dst_edge_keep[dst_edge_idx] = 1;
+                    break;
+                }
+
+                if (next(dst, h) == head)
+                {
+                    break;
+                }
+            }
+        }
+
+        // release what's gone.
+        for (Edge* e = first(dst.edges); e != 0;)
+        {
+            Edge* next_e = next(dst.edges, e);
+
+            if (!dst_edge_keep[e - dst.edges.items])
+            {
+                for (Event* evt = event(dst, e->dir + 0); evt != 0;)
+                {
+                    Event* next_evt = next(dst, e->dir + 0, evt);
+                    deallocate(dst.events, evt);
+                    evt = next_evt;
+                }
+
+                deallocate(dst.edges, e);
+            }
+
+            e = next_e;
+        }
+
+        for (Vertex* v = first(dst.vertices); v != 0;)
+        {
+            Vertex* next_v = next(dst.vertices, v);
+
+            if (!dst_vertex_keep[v - dst.vertices.items])
+            {
+                deallocate(dst.vertices, v);
+            }
+
+            v = next_v;
+        }
+
+        // allocate what's new.
+        for (Vertex* v = first(src.vertices); v != 0; v = next(src.vertices, v))
+        {
+            int src_idx = int(v - src.vertices.items);
+
+            if (src_vertex_map[src_idx] == int(null_idx))
+            {
+                Vertex* new_vertex = create_vertex(dst, v->pos);
+                src_vertex_map[src_idx] = int(new_vertex - dst.vertices.items);
+            }
+        }
+
+        for (Edge* e = first(src.edges); e != 0; e = next(src.edges, e))
+        {
+            int src_idx = int(e - src.edges.items);
+
+            if (src_edge_map[src_idx] != int(null_idx))
+            {
+                continue;
+            }
+
+            Edge* new_edge = allocate(dst.edges);
+            int new_edge_idx = int(new_edge - dst.edges.items);
+
+            for (int dir = 0; dir < 2; ++dir)
+            {
+                new_edge->dir[dir].target = src_vertex_map[e->dir[dir].target];
+                new_edge->dir[dir].event = null_idx;
+                new_edge->dir[dir].sides[0] = e->dir[dir].sides[0];
+                new_edge->dir[dir].sides[1] = e->dir[dir].sides[1];
+            }
+
+            for (Event* evt = event(src, e->dir + 0); evt != 0; evt = next(src, e->dir + 0, evt))
+            {
+                Event* new_event = create_event(dst, evt->pos, new_edge_idx);
+                new_event->sides[0] = evt->sides[0];
+                new_event->sides[1] = evt->sides[1];
+            }
+
+            src_edge_map[src_idx] = new_edge_idx;
+        }
+
+        // half-edge rings follow src.
+        Splice_Map map;
+        map.vertices = src_vertex_map;
+        map.edges = src_edge_map;
+        map.flips = src_edge_flips;
+
+        for (Vertex* v = first(src.vertices); v != 0; v = next(src.vertices, v))
+        {
+            Vertex* dst_vertex = dst.vertices.items + map.vertices[v - src.vertices.items];
+
+            if (v->half_edge == int(null_idx))
+            {
+                dst_vertex->half_edge = null_idx;
+                continue;
+            }
+
+            dst_vertex->half_edge = map_half_edge(map, v->half_edge);
+
+            int curr = v->half_edge;
+
+            do
+            {
+                int next_half_edge = half_edge_by_index(src, curr)->next;
+                half_edge_by_index(dst, map_half_edge(map, curr))->next = map_half_edge(map, next_half_edge);
+                curr = next_half_edge;
+            }
+            while (curr != v->half_edge);
+        }
+
+        for (int i = 0; i < num_edges; ++i)
+        {
+            items.edges[i] = items.edges[i] >= 0 ? map_half_edge(map, items.edges[i]) : -1;
+        }
+
+        for (int i = 0; i < num_verts; ++i)
+        {
+            items.vertices[i] = items.vertices[i] >= 0 ? map.vertices[items.vertices[i]] : -1;
+        }
+
+        return true;
+    }
+}
+
+void update_corridor_map(Build_Context& ctx, const Footprint& footprint, const int* changed_polys, int num_changed,
+                         const Build_Params& params, Walkable_Space& out)
+{
+    corridormap_assert(ctx.pixels != 0);
+    corridormap_assert(params.grid_width == ctx.grid_width && params.grid_height == ctx.grid_height);
+
+    // border segment indices follow the polygons, with a different number of polygons every pixel changes.
+    if (footprint.num_polys != ctx.footprint.num_polys)
+    {
+        const Bbox2 bounds = ctx.bounds;
+        Build_Params full_params = params;
+        full_params.bounds = &bounds;
+        build_corridor_map(ctx, footprint, full_params, out);
+        return;
+    }
+
+    Memory* frame = ctx.frames[ctx.frame^1];
+    Memory_Stack* scratch = ctx.scratch;
+    const int width = ctx.grid_width;
+    const int height = ctx.grid_height;
+
+    // intermediates of the last build stay in the current frame until the update is done.
+    ctx.frames[ctx.frame^1]->reset();
+    scratch->reset();
+
+    const Footprint old_footprint = ctx.footprint;
+    const Footprint_Normals old_normals = ctx.normals;
+    Voronoi_Features old_features = ctx.features;
+    Voronoi_Edge_Spans old_spans = ctx.spans;
+    CSR_Grid old_vertex_grid = ctx.vertex_grid;
+    CSR_Grid old_edge_grid = ctx.edge_grid;
+    Voronoi_Traced_Edges old_traced_edges = ctx.traced_edges;
+    Voronoi_Trace_State old_trace_state = ctx.trace_state;
+    const Walkable_Space_Items old_space_items = ctx.space_items;
+
+    ctx.footprint = copy_footprint(frame, footprint);
+
+    ctx.normals = allocate_foorprint_normals(frame, footprint.num_polys, footprint.num_verts);
+    build_footprint_normals(footprint, ctx.bounds, ctx.normals);
+
+    ctx.edge_tree = allocate_footprint_edge_tree(frame, footprint.num_polys, footprint_edge_tree_nodes(footprint));
+    build_footprint_edge_tree(footprint, ctx.edge_tree);
+
+    // obstacle ids of the changed polygons, edges along polygons listed but not moved are kept.
+    Alloc_Scope<unsigned char> changed(scratch, footprint.num_polys + num_border_segments + 1);
+    zero_mem(changed);
+
+    for (int i = 0; i < num_changed; ++i)
+    {
+        changed[changed_polys[i] + 1] = polygon_changed(old_footprint, footprint, changed_polys[i]);
+    }
+
+    Grid_Window window;
+
+    if (params.renderer)
+    {
+        // the renderer interface has no partial render: the whole mesh is rendered, only the rows which can change are read back.
+        // rendered distances are within max_error of the exact ones.
+        Grid_Window dirty = obstacle_id_update_window(scratch, old_footprint, footprint, changed_polys, num_changed,
+                                                      ctx.bounds, width, height, ctx.pixels, 2.f*params.max_error);
+
+        build_mesh(ctx, frame, params);
+        render_distance_mesh(params.renderer, ctx.mesh);
+
+        window = empty_window();
+
+        if (dirty.min_y <= dirty.max_y)
+        {
+            const int num_rows = dirty.max_y - dirty.min_y + 1;
+            const int row_offset = dirty.min_y*width*4;
+
+            Alloc_Scope<unsigned char> new_rows(scratch, num_rows*width*4, 16);
+
+            if (!params.renderer->read_rows(dirty.min_y, num_rows, new_rows))
+            {
+                Alloc_Scope<unsigned char> new_pixels(scratch, width*height*4, 16);
+                params.renderer->read_pixels(new_pixels);
+                memcpy(new_rows, new_pixels + row_offset, num_rows*width*4);
+            }
+
+            Grid_Window rows_window = diff_obstacle_ids(ctx.pixels + row_offset, new_rows, width, num_rows, changed);
+
+            for (int y = rows_window.min_y; y <= rows_window.max_y; ++y)
+            {
+                int offset = (y*width + rows_window.min_x)*4;
+                memcpy(ctx.pixels + row_offset + offset, new_rows + offset, (rows_window.max_x - rows_window.min_x + 1)*4);
+                include(window, rows_window.min_x, dirty.min_y + y);
+                include(window, rows_window.max_x, dirty.min_y + y);
+            }
+        }
+    }
+    else
+    {
+        window = update_obstacle_id_image(params.scheduler, scratch, old_footprint, footprint, changed_polys, num_changed,
+                                          ctx.bounds, width, height, ctx.pixels);
+    }
+
+    // features at (x, y) are computed from pixels (x-1, y-1) .. (x, y). first row and column have no features.
+    Grid_Window feature_window;
+    feature_window.min_x = std::max(window.min_x, 1);
+    feature_window.min_y = std::max(window.min_y, 1);
+    feature_window.max_x = std::min(window.max_x + 1, width - 1);
+    feature_window.max_y = std::min(window.max_y + 1, height - 1);
+
+    Voronoi_Features window_features;
+    memset(&window_features, 0, sizeof(window_features));
+
+    if (feature_window.min_x <= feature_window.max_x && feature_window.min_y <= feature_window.max_y)
+    {
+        window_features = detect_window(frame, scratch, ctx.pixels, width, height, feature_window, params.scheduler);
+    }
+    else
+    {
+        feature_window = empty_window();
+    }
+
+    Voronoi_Edge_Spans window_spans = allocate_voronoi_edge_spans(frame, window_features.num_edge_points);
+    build_edge_spans(window_features, footprint, ctx.normals, ctx.bounds, window_spans, params.scheduler);
+
+    Alloc_Scope<int> point_map(scratch, std::max(old_features.num_edge_points, 1));
+    merge_features(frame, old_features, old_spans, old_normals.obstacle_normal_offsets, old_trace_state.point_owners,
+                   window_features, window_spans, ctx.normals.obstacle_normal_offsets, feature_window, ctx.features, ctx.spans, point_map);
+
+    Alloc_Scope<int> vertex_map(scratch, std::max(old_features.num_vert_points, 1));
+    map_cells(old_features.verts, old_features.num_vert_points, ctx.features.verts, ctx.features.num_vert_points, vertex_map);
+
+    // only walks near the window are retraced.
+    prepare_trace(ctx, frame);
+
+    Trace_Update_Params trace_params;
+    trace_params.feature_window = feature_window;
+    trace_params.changed_ids = changed;
+    trace_params.vertex_grid = &old_vertex_grid;
+    trace_params.edge_grid = &old_edge_grid;
+    trace_params.features = &old_features;
+    trace_params.spans = &old_spans;
+    trace_params.traced_edges = &old_traced_edges;
+    trace_params.state = &old_trace_state;
+    trace_params.vertex_map = vertex_map;
+    trace_params.point_map = point_map;
+
+    const bool traced = update_traced_edges(scratch, params.scheduler, trace_params, ctx.vertex_grid, ctx.edge_grid,
+                                            ctx.spans, ctx.features, ctx.traced_edges, ctx.trace_state);
+
+    if (!traced)
+    {
+        trace(ctx, params);
+    }
+
+    // only edges which aren't the same as before are spliced.
+    Walkable_Space_Build_Params space_params = walkable_space_params(ctx);
+    ctx.space_items = allocate_walkable_space_items(frame, ctx.features.num_vert_points);
+
+    // out can hold any graph traced from the features, pools grow without moving unchanged items.
+    reserve(ctx.memory, out.vertices, std::max(ctx.features.num_vert_points, 1));
+    reserve(ctx.memory, out.edges, std::max(ctx.traced_edges.num_edges, 1));
+    reserve(ctx.memory, out.events, std::max(ctx.traced_edges.num_events, 1));
+
+    bool updated = false;
+
+    if (traced)
+    {
+        updated = update_walkable_space(scratch, space_params, ctx.trace_state, trace_params, old_space_items, out, ctx.space_items);
+    }
+    else
+    {
+        // after a full trace unchanged edges are found by position.
+        Walkable_Space space = create_walkable_space(frame, std::max(ctx.features.num_vert_points, 1),
+                                                     std::max(ctx.traced_edges.num_edges, 1), std::max(ctx.traced_edges.num_events, 1));
+        build_walkable_space(space_params, space);
+        walkable_space_items(scratch, space_params, ctx.space_items);
+        updated = splice_walkable_space(scratch, space, out, ctx.space_items, ctx.traced_edges.num_edges, ctx.features.num_vert_points);
+    }
+
+    corridormap_assert(updated);
+
+    ctx.frame ^= 1;
+}
+
+}
@@ -0,0 +1,1165 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <algorithm>
+#include "corridormap/assert.h"
+#include "corridormap/memory.h"
+#include "corridormap/parallel.h"
+#include "corridormap/vec2.h"
+#include "corridormap/build_stats.h"
+#include "corridormap/build_types.h"
+#include "corridormap/build.h"
+
+// nearest obstacle image is computed with the separable exact euclidean feature transform:
+// 1. obstacle boundaries are rasterized into the seed list, every seed pixel stores an index of the seed.
+// 2. column pass: every pixel gets the nearest seed in its column.
+// 3. row pass: lower envelope of parabolas gives the nearest seed in the row (Felzenszwalb & Huttenlocher, 2004).
+// the transform is exact with respect to the seeds, which are pixel centres, so distances to polygons are approximate.
+// distances to the bounding box sides (border segments) are computed analytically.
+// update_obstacle_id_image finds the pixels which can change when polygons move and transforms only the rows of their window.
+
+namespace corridormap {
+
+namespace
+{
+    // number of columns processed together by the column pass.
+    enum { column_band_size = 32 };
+    // number of row jobs per scheduler thread.
+    enum { row_jobs_per_thread = 8 };
+
+    struct Seeds
+    {
+        // seed pixel row.
+        int* row;
+        // id of the seed obstacle (segment index).
+        unsigned int* id;
+        // the number of seeds.
+        int count;
+    };
+
+    struct Transform_Context
+    {
+        const Footprint* obstacles;
+        // world size of a pixel.
+        float pixel_width;
+        float pixel_height;
+        float min_x;
+        float min_y;
+        int width;
+        int height;
+        int max_poly_verts;
+        // seeds are rasterized and propagated only inside the domain (inclusive), nearest stores seed index or -1 per domain pixel.
+        Grid_Window domain;
+        int domain_width;
+        int* nearest;
+        Seeds seeds;
+        // per row job storage.
+        int num_row_jobs;
+        int* envelope_cols;
+        int* envelope_seeds;
+        double* envelope_values;
+        double* envelope_bounds;
+        float* crossings;
+        // pixels of the output window (inclusive) are transformed, output pixel (x, y) is stored
+        // at (y - output.min_y)*output_width + x - output.min_x of pixels.
+        Grid_Window output;
+        int output_width;
+        unsigned char* pixels;
+    };
+
+    // converts segment index to the pixel word with the same memory layout as rendered color.
+    inline unsigned int id_to_pixel(unsigned int id)
+    {
+        unsigned char rgba[4] =
+        {
+            (unsigned char)((id >> 24) & 0xff),
+            (unsigned char)((id >> 16) & 0xff),
+            (unsigned char)((id >>  8) & 0xff),
+            (unsigned char)((id >>  0) & 0xff),
+        };
+
+        unsigned int result;
+        memcpy(&result, rgba, sizeof(result));
+        return result;
+    }
+
+    inline int clamp(int v, int lo, int hi)
+    {
+        return (v < lo) ? lo : ((v > hi) ? hi : v);
+    }
+
+    inline bool contains(const Grid_Window& window, int x, int y)
+    {
+        return x >= window.min_x && x <= window.max_x && y >= window.min_y && y <= window.max_y;
+    }
+
+    // visits every pixel crossed by the segment (u0, v0) -> (u1, v1) given in pixel units.
+    // pixels outside of the domain are skipped. if nearest is null only counts the pixels.
+    int rasterize_segment(float u0, float v0, float u1, float v1, const Transform_Context* ctx, unsigned int id, int* nearest, Seeds* seeds)
+    {
+        const Grid_Window& domain = ctx->domain;
+
+        int x = clamp(int(floorf(u0)), 0, ctx->width - 1);
+        int y = clamp(int(floorf(v0)), 0, ctx->height - 1);
+        int x_end = clamp(int(floorf(u1)), 0, ctx->width - 1);
+        int y_end = clamp(int(floorf(v1)), 0, ctx->height - 1);
+
+        // segments outside of the domain don't seed it.
+        if (std::max(x, x_end) < domain.min_x || std::min(x, x_end) > domain.max_x ||
+            std::max(y, y_end) < domain.min_y || std::min(y, y_end) > domain.max_y)
+        {
+            return 0;
+        }
+
+        float du = u1 - u0;
+        float dv = v1 - v0;
+
+        int step_x = (du > 0.f) ? 1 : -1;
+        int step_y = (dv > 0.f) ? 1 : -1;
+
+        // parametric distance along the segment to the next vertical and horizontal pixel boundaries.
+        float t_delta_x = (du != 0.f) ? fabsf(1.f/du) : FLT_MAX;
+        float t_delta_y = (dv != 0.f) ? fabsf(1.f/dv) : FLT_MAX;
+        float t_max_x = (du != 0.f) ? (float(x + (step_x > 0 ? 1 : 0)) - u0)/du : FLT_MAX;
+        float t_max_y = (dv != 0.f) ? (float(y + (step_y > 0 ? 1 : 0)) - v0)/dv : FLT_MAX;
+
+        int max_steps = abs(x_end - x) + abs(y_end - y) + 1;
+        int count = 0;
+
+        for (int i = 0; i < max_steps; ++i)
+        {
+            if (contains(domain, x, y))
+            {
+                if (nearest)
+                {
+                    int idx = (y - domain.min_y)*ctx->domain_width + x - domain.min_x;
+
+                    // pixel shared by several obstacles keeps the first one, as the lower segment index wins the depth tie.
+                    if (nearest[idx] < 0)
+                    {
+                        nearest[idx] = seeds->count;
+                        seeds->row[seeds->count] = y;
+                        seeds->id[seeds->count] = id;
+                        seeds->count++;
+                    }
+                }
+
+                count++;
+            }
+
+            if (x == x_end && y == y_end)
+            {
+                break;
+            }
+
+            if (t_max_x < t_max_y)
+            {
+                if (x == x_end) { break; }
+                x += step_x;
+                t_max_x += t_delta_x;
+            }
+            else
+            {
+                if (y == y_end) { break; }
+                y += step_y;
+                t_max_y += t_delta_y;
+            }
+        }
+
+        return count;
+    }
+
+    // if nearest is null returns an upper bound on the number of seeds.
+    int rasterize_boundaries(const Transform_Context* ctx, int* nearest, Seeds* seeds)
+    {
+        const Footprint& obstacles = *ctx->obstacles;
+        const float* poly_x = obstacles.x;
+        const float* poly_y = obstacles.y;
+        const float scale_x = 1.f/ctx->pixel_width;
+        const float scale_y = 1.f/ctx->pixel_height;
+
+        int count = 0;
+
+        for (int i = 0; i < obstacles.num_polys; ++i)
+        {
+            int num_verts = obstacles.num_poly_verts[i];
+
+            for (int curr = num_verts - 1, next = 0; next < num_verts; curr = next++)
+            {
+                float u0 = (poly_x[curr] - ctx->min_x)*scale_x;
+                float v0 = (poly_y[curr] - ctx->min_y)*scale_y;
+                float u1 = (poly_x[next] - ctx->min_x)*scale_x;
+                float v1 = (poly_y[next] - ctx->min_y)*scale_y;
+                count += rasterize_segment(u0, v0, u1, v1, ctx, i + 1, nearest, seeds);
+            }
+
+            poly_x += num_verts;
+            poly_y += num_verts;
+        }
+
+        return count;
+    }
+
+    void column_pass(void* context, int band_index)
+    {
+        const Transform_Context* ctx = static_cast<const Transform_Context*>(context);
+
+        const int width = ctx->domain_width;
+        const int y_min = ctx->domain.min_y;
+        const int y_max = ctx->domain.max_y;
+        const int* seed_row = ctx->seeds.row;
+        int* nearest = ctx->nearest;
+
+        const int x_begin = band_index*column_band_size;
+        const int x_end = (x_begin + column_band_size < width) ? x_begin + column_band_size : width;
+
+        int last[column_band_size];
+
+        // top to bottom: nearest seed above or at the pixel.
+        for (int x = x_begin; x < x_end; ++x)
+        {
+            last[x - x_begin] = -1;
+        }
+
+        for (int y = y_min; y <= y_max; ++y)
+        {
+            int* row = nearest + (y - y_min)*width;
+
+            for (int x = x_begin; x < x_end; ++x)
+            {
+                if (row[x] >= 0)
+                {
+                    last[x - x_begin] = row[x];
+                }
+                else
+                {
+                    row[x] = last[x - x_begin];
+                }
+            }
+        }
+
+        // bottom to top: pick the closer of the seed above and the seed below.
+        for (int x = x_begin; x < x_end; ++x)
+        {
+            last[x - x_begin] = -1;
+        }
+
+        for (int y = y_max; y >= y_min; --y)
+        {
+            int* row = nearest + (y - y_min)*width;
+
+            for (int x = x_begin; x < x_end; ++x)
+            {
+                int above = row[x];
+                int below = last[x - x_begin];
+
+                if (above >= 0 && seed_row[above] == y)
+                {
+                    last[x - x_begin] = above;
+                    continue;
+                }
+
+                if (below >= 0 && (above < 0 || seed_row[below] - y < y - seed_row[above]))
+                {
+                    row[x] = below;
+                }
+            }
+        }
+    }
+
+    // sorts the small array of scanline crossings.
+    void sort_crossings(float* values, int count)
+    {
+        for (int i = 1; i < count; ++i)
+        {
+            float v = values[i];
+            int j = i - 1;
+
+            for (; j >= 0 && values[j] > v; --j)
+            {
+                values[j + 1] = values[j];
+            }
+
+            values[j + 1] = v;
+        }
+    }
+
+    // marks pixels of the output row with centers inside obstacles. segment 0 (area inside obstacles) is drawn first in the distance mesh.
+    void fill_obstacles(const Transform_Context* ctx, int y, float* crossings, unsigned int* output)
+    {
+        const Footprint& obstacles = *ctx->obstacles;
+        const float* poly_x = obstacles.x;
+        const float* poly_y = obstacles.y;
+        const float yc = ctx->min_y + (float(y) + 0.5f)*ctx->pixel_height;
+        const unsigned int inside = id_to_pixel(0);
+        const int col_begin = ctx->output.min_x;
+        const int col_end = ctx->output.max_x + 1;
+
+        for (int i = 0; i < obstacles.num_polys; ++i)
+        {
+            int num_verts = obstacles.num_poly_verts[i];
+            int num_crossings = 0;
+
+            for (int curr = num_verts - 1, next = 0; next < num_verts; curr = next++)
+            {
+                float x0 = poly_x[curr];
+                float y0 = poly_y[curr];
+                float x1 = poly_x[next];
+                float y1 = poly_y[next];
+
+                if ((y0 <= yc) != (y1 <= yc))
+                {
+                    crossings[num_crossings++] = x0 + (yc - y0)*(x1 - x0)/(y1 - y0);
+                }
+            }
+
+            sort_crossings(crossings, num_crossings);
+
+            for (int k = 0; k + 1 < num_crossings; k += 2)
+            {
+                // pixels with centers in [a, b).
+                float a = (crossings[k + 0] - ctx->min_x)/ctx->pixel_width - 0.5f;
+                float b = (crossings[k + 1] - ctx->min_x)/ctx->pixel_width - 0.5f;
+                int x_begin = clamp(int(ceilf(a)), col_begin, col_end);
+                int x_end = clamp(int(ceilf(b)), col_begin, col_end);
+
+                for (int x = x_begin; x < x_end; ++x)
+                {
+                    output[x - col_begin] = inside;
+                }
+            }
+
+            poly_x += num_verts;
+            poly_y += num_verts;
+        }
+    }
+
+    void row_pass(void* context, int job_index)
+    {
+        const Transform_Context* ctx = static_cast<const Transform_Context*>(context);
+
+        const int width = ctx->width;
+        const int height = ctx->height;
+        const int domain_width = ctx->domain_width;
+        const int num_polys = ctx->obstacles->num_polys;
+        const int* seed_row = ctx->seeds.row;
+        const unsigned int* seed_id = ctx->seeds.id;
+
+        // squared pixel aspect: vertical distances are measured in pixel widths.
+        const double aspect = double(ctx->pixel_height)/double(ctx->pixel_width);
+        const double aspect_sq = aspect*aspect;
+
+        int* cols = ctx->envelope_cols + job_index*domain_width;
+        int* seeds = ctx->envelope_seeds + job_index*domain_width;
+        double* values = ctx->envelope_values + job_index*domain_width;
+        double* bounds = ctx->envelope_bounds + job_index*(domain_width + 1);
+        float* crossings = ctx->crossings + job_index*ctx->max_poly_verts;
+
+        const int row_begin = ctx->output.min_y;
+        const int row_end = ctx->output.max_y + 1;
+        int rows_per_job = (row_end - row_begin + ctx->num_row_jobs - 1)/ctx->num_row_jobs;
+        int y_begin = row_begin + job_index*rows_per_job;
+        int y_end = (y_begin + rows_per_job < row_end) ? y_begin + rows_per_job : row_end;
+
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            int* nearest = ctx->nearest + (y - ctx->domain.min_y)*domain_width;
+            unsigned int* output = reinterpret_cast<unsigned int*>(ctx->pixels) + (y - row_begin)*ctx->output_width;
+
+            // lower envelope of parabolas (x - q)^2 + f(q), f(q) is the squared distance to the nearest seed in column q.
+            // seeds of the envelope are kept aside, as the row is overwritten with the output.
+            int num_parabolas = 0;
+
+            for (int i = 0; i < domain_width; ++i)
+            {
+                if (nearest[i] < 0)
+                {
+                    continue;
+                }
+
+                int q = ctx->domain.min_x + i;
+                double dy = double(seed_row[nearest[i]] - y);
+                double fq = aspect_sq*dy*dy + double(q)*double(q);
+
+                for (; num_parabolas > 0; --num_parabolas)
+                {
+                    int v = cols[num_parabolas - 1];
+                    double s = (fq - values[num_parabolas - 1])/(2.0*double(q - v));
+
+                    if (s > bounds[num_parabolas - 1])
+                    {
+                        bounds[num_parabolas] = s;
+                        break;
+                    }
+                }
+
+                if (num_parabolas == 0)
+                {
+                    bounds[0] = -DBL_MAX;
+                }
+
+                cols[num_parabolas] = q;
+                seeds[num_parabolas] = nearest[i];
+                values[num_parabolas] = fq;
+                num_parabolas++;
+            }
+
+            bounds[num_parabolas] = DBL_MAX;
+
+            // distances to the bounding box sides in pixel widths.
+            const double dist_bottom = (double(y) + 0.5)*aspect;
+            const double dist_top = (double(height - y) - 0.5)*aspect;
+            const double dist_y = (dist_bottom <= dist_top) ? dist_bottom : dist_top;
+            const unsigned int border_y = (dist_bottom <= dist_top) ? num_polys + 1 : num_polys + 3;
+
+            for (int x = ctx->output.min_x, k = 0; x <= ctx->output.max_x; ++x)
+            {
+                double dist_left = double(x) + 0.5;
+                double dist_right = double(width - x) - 0.5;
+
+                // segment order is: polygons, bottom, right, top, left. on ties the lower index wins.
+                unsigned int id = border_y;
+                double dist = dist_y;
+
+                if (dist_right < dist || (dist_right == dist && unsigned(num_polys + 2) < id))
+                {
+                    id = num_polys + 2;
+                    dist = dist_right;
+                }
+
+                if (dist_left < dist)
+                {
+                    id = num_polys + 4;
+                    dist = dist_left;
+                }
+
+                if (num_parabolas > 0)
+                {
+                    while (bounds[k + 1] < double(x))
+                    {
+                        ++k;
+                    }
+
+                    int q = cols[k];
+                    int seed = seeds[k];
+                    double dx = double(x - q);
+                    double dy = double(seed_row[seed] - y);
+
+                    if (dx*dx + aspect_sq*dy*dy <= dist*dist)
+                    {
+                        id = seed_id[seed];
+                    }
+                }
+
+                output[x - ctx->output.min_x] = id_to_pixel(id);
+            }
+
+            fill_obstacles(ctx, y, crossings, output);
+        }
+    }
+
+    // transforms the output window of the image, seeds are taken from the domain window which contains it.
+    // the result matches the transform of the whole image if every output pixel is closer to the border
+    // or to a seed inside the domain than to the domain sides. nearest is the seed index buffer of the domain size,
+    // it can alias pixels when the whole image is transformed.
+    void feature_transform(Scheduler* scheduler, Memory* scratch, const Footprint& obstacles, Bbox2 bounds, int width, int height,
+                           const Grid_Window& domain, const Grid_Window& output, int* nearest, unsigned char* pixels)
+    {
+        corridormap_assert(domain.min_x <= output.min_x && domain.max_x >= output.max_x);
+        corridormap_assert(domain.min_y <= output.min_y && domain.max_y >= output.max_y);
+
+        Transform_Context ctx;
+        ctx.obstacles = &obstacles;
+        ctx.pixel_width = (bounds.max[0] - bounds.min[0])/float(width);
+        ctx.pixel_height = (bounds.max[1] - bounds.min[1])/float(height);
+        ctx.min_x = bounds.min[0];
+        ctx.min_y = bounds.min[1];
+        ctx.width = width;
+        ctx.height = height;
+        ctx.domain = domain;
+        ctx.domain_width = domain.max_x - domain.min_x + 1;
+        ctx.output = output;
+        ctx.output_width = output.max_x - output.min_x + 1;
+        ctx.pixels = pixels;
+        ctx.max_poly_verts = 1;
+
+        for (int i = 0; i < obstacles.num_polys; ++i)
+        {
+            ctx.max_poly_verts = (obstacles.num_poly_verts[i] > ctx.max_poly_verts) ? obstacles.num_poly_verts[i] : ctx.max_poly_verts;
+        }
+
+        const int domain_height = domain.max_y - domain.min_y + 1;
+        const int num_rows = output.max_y - output.min_y + 1;
+        int num_jobs = num_threads(scheduler)*row_jobs_per_thread;
+        ctx.num_row_jobs = (num_jobs < num_rows) ? num_jobs : num_rows;
+
+        int max_seeds = rasterize_boundaries(&ctx, 0, 0);
+
+        ctx.nearest = nearest;
+
+        Alloc_Scope<int> seed_row(scratch, max_seeds);
+        Alloc_Scope<unsigned int> seed_id(scratch, max_seeds);
+        Alloc_Scope<int> envelope_cols(scratch, ctx.num_row_jobs*ctx.domain_width);
+        Alloc_Scope<int> envelope_seeds(scratch, ctx.num_row_jobs*ctx.domain_width);
+        Alloc_Scope<double> envelope_values(scratch, ctx.num_row_jobs*ctx.domain_width);
+        Alloc_Scope<double> envelope_bounds(scratch, ctx.num_row_jobs*(ctx.domain_width + 1));
+        Alloc_Scope<float> crossings(scratch, ctx.num_row_jobs*ctx.max_poly_verts);
+
+        ctx.seeds.row = seed_row;
+        ctx.seeds.id = seed_id;
+        ctx.seeds.count = 0;
+        ctx.envelope_cols = envelope_cols;
+        ctx.envelope_seeds = envelope_seeds;
+        ctx.envelope_values = envelope_values;
+        ctx.envelope_bounds = envelope_bounds;
+        ctx.crossings = crossings;
+
+        memset(ctx.nearest, 0xff, ctx.domain_width*domain_height*sizeof(ctx.nearest[0]));
+        rasterize_boundaries(&ctx, ctx.nearest, &ctx.seeds);
+
+        parallel_for(scheduler, column_pass, &ctx, (ctx.domain_width + column_band_size - 1)/column_band_size);
+
+        // row pass reads the current row of nearest seeds into the envelope before overwriting it with ids.
+        parallel_for(scheduler, row_pass, &ctx, ctx.num_row_jobs);
+    }
+}
+
+void build_obstacle_id_image(Scheduler* scheduler, Memory* scratch, const Footprint& obstacles, Bbox2 bounds, int width, int height, unsigned char* pixels)
+{
+    corridormap_build_scope(build_stage_obstacle_id_image);
+
+    corridormap_assert(width > 0 && height > 0);
+    corridormap_assert((size_t(pixels) & (sizeof(unsigned int) - 1)) == 0);
+
+    Grid_Window image = { 0, 0, width - 1, height - 1 };
+
+    // nearest seed indices are stored in the output image.
+    feature_transform(scheduler, scratch, obstacles, bounds, width, height, image, image, reinterpret_cast<int*>(pixels), pixels);
+}
+
+namespace
+{
+    Grid_Window empty_window()
+    {
+        Grid_Window result = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        return result;
+    }
+
+    inline void include(Grid_Window& window, int x, int y)
+    {
+        window.min_x = std::min(window.min_x, x);
+        window.min_y = std::min(window.min_y, y);
+        window.max_x = std::max(window.max_x, x);
+        window.max_y = std::max(window.max_y, y);
+    }
+
+    inline void include(Grid_Window& window, const Grid_Window& other)
+    {
+        window.min_x = std::min(window.min_x, other.min_x);
+        window.min_y = std::min(window.min_y, other.min_y);
+        window.max_x = std::max(window.max_x, other.max_x);
+        window.max_y = std::max(window.max_y, other.max_y);
+    }
+
+    inline unsigned int pixel_to_id(const unsigned char* pixels, int index)
+    {
+        const unsigned char* p = pixels + index*4;
+        return (unsigned int)(p[0]) << 24 |
+               (unsigned int)(p[1]) << 16 |
+               (unsigned int)(p[2]) << 8  |
+               (unsigned int)(p[3]) << 0  ;
+    }
+
+    void vertex_offsets(const Footprint& obstacles, int* offsets)
+    {
+        for (int i = 0, offset = 0; i < obstacles.num_polys; ++i)
+        {
+            offsets[i] = offset;
+            offset += obstacles.num_poly_verts[i];
+        }
+    }
+
+    struct Image_Update_Context
+    {
+        const Footprint* old_obstacles;
+        const Footprint* obstacles;
+        // vertex offsets of footprint polygons.
+        const int* old_offsets;
+        const int* offsets;
+        const int* changed_polys;
+        int num_changed;
+        Bbox2 bounds;
+        int width;
+        int height;
+        float pixel_width;
+        float pixel_height;
+        // error of the distances the image was computed with.
+        float tolerance;
+        // image of old_obstacles.
+        const unsigned char* pixels;
+    };
+
+    inline Vec2 pixel_center(const Image_Update_Context& ctx, int x, int y)
+    {
+        return make_vec2(ctx.bounds.min[0] + (float(x) + 0.5f)*ctx.pixel_width, ctx.bounds.min[1] + (float(y) + 0.5f)*ctx.pixel_height);
+    }
+
+    // squared distance from point to the segment id (polygon or border side), the same metric as the feature transform.
+    float distance_sq(const Footprint& obstacles, const int* offsets, Bbox2 bounds, unsigned int id, Vec2 point)
+    {
+        int oid = int(id) - 1;
+
+        if (oid >= obstacles.num_polys)
+        {
+            float dist[] =
+            {
+                point.y - bounds.min[1],
+                bounds.max[0] - point.x,
+                bounds.max[1] - point.y,
+                point.x - bounds.min[0],
+            };
+
+            return sq(dist[oid - obstacles.num_polys]);
+        }
+
+        const float* x = obstacles.x + offsets[oid];
+        const float* y = obstacles.y + offsets[oid];
+        const int num_verts = obstacles.num_poly_verts[oid];
+
+        float result = FLT_MAX;
+
+        for (int curr = num_verts - 1, next = 0; next < num_verts; curr = next++)
+        {
+            Vec2 p0 = make_vec2(x[curr], y[curr]);
+            Vec2 seg = make_vec2(x[next], y[next]) - p0;
+            float len_sq = mag_sq(seg);
+            float t = (len_sq > 0.f) ? std::min(std::max(dot(point - p0, seg)/len_sq, 0.f), 1.f) : 0.f;
+            result = std::min(result, mag_sq(p0 + seg*t - point));
+        }
+
+        return result;
+    }
+
+    // distance from point to the closest side of the bounds.
+    inline float border_distance(Bbox2 bounds, Vec2 point)
+    {
+        return std::min(std::min(point.x - bounds.min[0], bounds.max[0] - point.x), std::min(point.y - bounds.min[1], bounds.max[1] - point.y));
+    }
+
+    // bounds of the segment id, degenerate for border sides.
+    Bbox2 site_bounds(const Footprint& obstacles, const int* offsets, Bbox2 bounds, unsigned int id)
+    {
+        int oid = int(id) - 1;
+        Bbox2 result = bounds;
+
+        if (oid >= obstacles.num_polys)
+        {
+            switch (oid - obstacles.num_polys)
+            {
+            case 0: result.max[1] = bounds.min[1]; break;
+            case 1: result.min[0] = bounds.max[0]; break;
+            case 2: result.min[1] = bounds.max[1]; break;
+            case 3: result.max[0] = bounds.min[0]; break;
+            }
+
+            return result;
+        }
+
+        const float* x = obstacles.x + offsets[oid];
+        const float* y = obstacles.y + offsets[oid];
+        const int num_verts = obstacles.num_poly_verts[oid];
+
+        result.min[0] = result.min[1] = FLT_MAX;
+        result.max[0] = result.max[1] = -FLT_MAX;
+
+        for (int i = 0; i < num_verts; ++i)
+        {
+            result.min[0] = std::min(result.min[0], x[i]);
+            result.min[1] = std::min(result.min[1], y[i]);
+            result.max[0] = std::max(result.max[0], x[i]);
+            result.max[1] = std::max(result.max[1], y[i]);
+        }
+
+        return result;
+    }
+
+    // squared distance from point to the box, zero inside.
+    inline float distance_sq(const Bbox2& box, Vec2 point)
+    {
+        float dx = std::max(std::max(box.min[0] - point.x, point.x - box.max[0]), 0.f);
+        float dy = std::max(std::max(box.min[1] - point.y, point.y - box.max[1]), 0.f);
+        return dx*dx + dy*dy;
+    }
+
+    // point in polygon test matching the fill rule of obstacle interiors in build_obstacle_id_image.
+    bool inside(const Footprint& obstacles, const int* offsets, int poly, Vec2 point)
+    {
+        const float* x = obstacles.x + offsets[poly];
+        const float* y = obstacles.y + offsets[poly];
+        const int num_verts = obstacles.num_poly_verts[poly];
+
+        bool result = false;
+
+        for (int curr = num_verts - 1, next = 0; next < num_verts; curr = next++)
+        {
+            if ((y[curr] <= point.y) != (y[next] <= point.y))
+            {
+                float crossing = x[curr] + (point.y - y[curr])*(x[next] - x[curr])/(y[next] - y[curr]);
+
+                if (crossing <= point.x)
+                {
+                    result = !result;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // pixel rectangle covering polygon bounds, clamped to the image.
+    Grid_Window poly_window(const Image_Update_Context& ctx, const Footprint& obstacles, const int* offsets, int poly)
+    {
+        Bbox2 box = site_bounds(obstacles, offsets, ctx.bounds, poly + 1);
+
+        Grid_Window result;
+        result.min_x = std::max(int((box.min[0] - ctx.bounds.min[0])/ctx.pixel_width) - 1, 0);
+        result.min_y = std::max(int((box.min[1] - ctx.bounds.min[1])/ctx.pixel_height) - 1, 0);
+        result.max_x = std::min(int((box.max[0] - ctx.bounds.min[0])/ctx.pixel_width) + 1, ctx.width - 1);
+        result.max_y = std::min(int((box.max[1] - ctx.bounds.min[1])/ctx.pixel_height) + 1, ctx.height - 1);
+        return result;
+    }
+
+    // true if the point is inside one of the changed polygons of the footprint.
+    bool inside_changed(const Image_Update_Context& ctx, const Footprint& obstacles, const int* offsets, Vec2 point)
+    {
+        for (int i = 0; i < ctx.num_changed; ++i)
+        {
+            if (inside(obstacles, offsets, ctx.changed_polys[i], point))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // true if the pixel can change after the changed polygons moved: it belongs to the old cell or interior
+    // of a changed polygon, it's inside a changed polygon at the new position, or one of the changed polygons
+    // can be the nearest to it. image distances are within tolerance of the exact ones, the test is loosened by it.
+    bool dirty(const Image_Update_Context& ctx, int x, int y)
+    {
+        unsigned int current = pixel_to_id(ctx.pixels, y*ctx.width + x);
+
+        for (int i = 0; i < ctx.num_changed; ++i)
+        {
+            if (current == unsigned(ctx.changed_polys[i] + 1))
+            {
+                return true;
+            }
+        }
+
+        Vec2 point = pixel_center(ctx, x, y);
+
+        if (inside_changed(ctx, *ctx.obstacles, ctx.offsets, point))
+        {
+            return true;
+        }
+
+        // pixel inside an obstacle stays inside unless the obstacle is a changed one.
+        if (current == 0)
+        {
+            return inside_changed(ctx, *ctx.old_obstacles, ctx.old_offsets, point);
+        }
+
+        float limit = sqrtf(distance_sq(*ctx.obstacles, ctx.offsets, ctx.bounds, current, point)) + ctx.tolerance;
+
+        for (int i = 0; i < ctx.num_changed; ++i)
+        {
+            if (distance_sq(*ctx.obstacles, ctx.offsets, ctx.bounds, ctx.changed_polys[i] + 1, point) <= sq(limit))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool dirty_span(const Image_Update_Context& ctx, int min_x, int min_y, int max_x, int max_y)
+    {
+        for (int y = min_y; y <= max_y; ++y)
+        {
+            for (int x = min_x; x <= max_x; ++x)
+            {
+                if (dirty(ctx, x, y))
+                {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    // window of the pixels which can change, without visiting the rest of the image.
+    // starts from the bounds of the changed polygons at the old and new positions, which contain the old and new interiors
+    // and the seeds of the cells, and grows a side while the pixel ring next to it has dirty pixels.
+    // cells are star-shaped around their segments, so a cell touching the window is contained when the ring is clean.
+    Grid_Window dirty_window(const Image_Update_Context& ctx)
+    {
+        Grid_Window window = empty_window();
+
+        for (int i = 0; i < ctx.num_changed; ++i)
+        {
+            include(window, poly_window(ctx, *ctx.old_obstacles, ctx.old_offsets, ctx.changed_polys[i]));
+            include(window, poly_window(ctx, *ctx.obstacles, ctx.offsets, ctx.changed_polys[i]));
+        }
+
+        if (window.min_x > window.max_x)
+        {
+            return window;
+        }
+
+        for (bool grown = true; grown;)
+        {
+            grown = false;
+
+            if (window.min_x > 0 && dirty_span(ctx, window.min_x - 1, window.min_y, window.min_x - 1, window.max_y))
+            {
+                window.min_x--;
+                grown = true;
+            }
+
+            if (window.max_x < ctx.width - 1 && dirty_span(ctx, window.max_x + 1, window.min_y, window.max_x + 1, window.max_y))
+            {
+                window.max_x++;
+                grown = true;
+            }
+
+            if (window.min_y > 0 && dirty_span(ctx, window.min_x, window.min_y - 1, window.max_x, window.min_y - 1))
+            {
+                window.min_y--;
+                grown = true;
+            }
+
+            if (window.max_y < ctx.height - 1 && dirty_span(ctx, window.min_x, window.max_y + 1, window.max_x, window.max_y + 1))
+            {
+                window.max_y++;
+                grown = true;
+            }
+        }
+
+        return window;
+    }
+
+    // upper bound on the distance from window pixels to the segment they are closest to in the new image.
+    // seeds of the transform are within the pixel diagonal of the segments, so the transform of the window
+    // only needs seeds within the bound (plus the diagonal) around it.
+    float influence_radius(const Image_Update_Context& ctx, const Grid_Window& window)
+    {
+        const float diagonal = sqrtf(sq(ctx.pixel_width) + sq(ctx.pixel_height));
+
+        float result = 0.f;
+
+        for (int y = window.min_y; y <= window.max_y; ++y)
+        {
+            for (int x = window.min_x; x <= window.max_x; ++x)
+            {
+                unsigned int current = pixel_to_id(ctx.pixels, y*ctx.width + x);
+                Vec2 point = pixel_center(ctx, x, y);
+                float dist_sq = FLT_MAX;
+
+                if (current != 0)
+                {
+                    // the closest segment of the old image is still there, possibly moved.
+                    dist_sq = distance_sq(*ctx.obstacles, ctx.offsets, ctx.bounds, current, point);
+                }
+                else if (inside_changed(ctx, *ctx.old_obstacles, ctx.old_offsets, point))
+                {
+                    for (int i = 0; i < ctx.num_changed; ++i)
+                    {
+                        dist_sq = std::min(dist_sq, distance_sq(*ctx.obstacles, ctx.offsets, ctx.bounds, ctx.changed_polys[i] + 1, point));
+                    }
+                }
+                else
+                {
+                    // inside an unchanged obstacle, the pixel is filled whatever its nearest seed is.
+                    continue;
+                }
+
+                // the border is computed analytically, seeds further than the border don't matter.
+                result = std::max(result, std::min(sqrtf(dist_sq) + diagonal, border_distance(ctx.bounds, point)));
+            }
+        }
+
+        return result;
+    }
+
+    void init_update_context(Image_Update_Context& ctx, const Footprint& old_obstacles, const Footprint& obstacles, const int* old_offsets, const int* offsets,
+                             const int* changed_polys, int num_changed, Bbox2 bounds, int width, int height, const unsigned char* pixels, float tolerance)
+    {
+        ctx.old_obstacles = &old_obstacles;
+        ctx.obstacles = &obstacles;
+        ctx.old_offsets = old_offsets;
+        ctx.offsets = offsets;
+        ctx.changed_polys = changed_polys;
+        ctx.num_changed = num_changed;
+        ctx.bounds = bounds;
+        ctx.width = width;
+        ctx.height = height;
+        ctx.pixel_width = (bounds.max[0] - bounds.min[0])/float(width);
+        ctx.pixel_height = (bounds.max[1] - bounds.min[1])/float(height);
+        ctx.tolerance = tolerance;
+        ctx.pixels = pixels;
+    }
+}
+
+Grid_Window obstacle_id_update_window(Memory* scratch, const Footprint& old_obstacles, const Footprint& obstacles, const int* changed_polys, int num_changed,
+                                      Bbox2 bounds, int width, int height, const unsigned char* pixels, float tolerance)
+{
+    corridormap_assert(old_obstacles.num_polys == obstacles.num_polys);
+
+    Alloc_Scope<int> old_offsets(scratch, obstacles.num_polys);
+    Alloc_Scope<int> offsets(scratch, obstacles.num_polys);
+    vertex_offsets(old_obstacles, old_offsets);
+    vertex_offsets(obstacles, offsets);
+
+    Image_Update_Context ctx;
+    init_update_context(ctx, old_obstacles, obstacles, old_offsets, offsets, changed_polys, num_changed, bounds, width, height, pixels, tolerance);
+
+    return dirty_window(ctx);
+}
+
+Grid_Window update_obstacle_id_image(Scheduler* scheduler, Memory* scratch, const Footprint& old_obstacles, const Footprint& obstacles,
+                                     const int* changed_polys, int num_changed, Bbox2 bounds, int width, int height, unsigned char* pixels)
+{
+    corridormap_build_scope(build_stage_obstacle_id_image);
+
+    corridormap_assert(old_obstacles.num_polys == obstacles.num_polys);
+    corridormap_assert((size_t(pixels) & (sizeof(unsigned int) - 1)) == 0);
+
+    Alloc_Scope<int> old_offsets(scratch, obstacles.num_polys);
+    Alloc_Scope<int> offsets(scratch, obstacles.num_polys);
+    vertex_offsets(old_obstacles, old_offsets);
+    vertex_offsets(obstacles, offsets);
+
+    // seeds are pixel centres, the transform distances are within the pixel diagonal of the exact ones.
+    const float pixel_width = (bounds.max[0] - bounds.min[0])/float(width);
+    const float pixel_height = (bounds.max[1] - bounds.min[1])/float(height);
+    const float diagonal = sqrtf(sq(pixel_width) + sq(pixel_height));
+
+    Image_Update_Context ctx;
+    init_update_context(ctx, old_obstacles, obstacles, old_offsets, offsets, changed_polys, num_changed, bounds, width, height, pixels, diagonal);
+
+    Grid_Window window = dirty_window(ctx);
+
+    if (window.min_x > window.max_x)
+    {
+        return window;
+    }
+
+    // window is transformed the same way as the whole image in build_obstacle_id_image, seeds are taken
+    // from the band around it which can hold the nearest segments, so the spliced pixels match a full build.
+    const float radius = influence_radius(ctx, window);
+
+    Grid_Window domain;
+    domain.min_x = std::max(window.min_x - int(ceilf(radius/pixel_width)) - 1, 0);
+    domain.min_y = std::max(window.min_y - int(ceilf(radius/pixel_height)) - 1, 0);
+    domain.max_x = std::min(window.max_x + int(ceilf(radius/pixel_width)) + 1, width - 1);
+    domain.max_y = std::min(window.max_y + int(ceilf(radius/pixel_height)) + 1, height - 1);
+
+    const int num_rows = window.max_y - window.min_y + 1;
+    const int num_cols = window.max_x - window.min_x + 1;
+
+    Alloc_Scope<int> nearest(scratch, (domain.max_x - domain.min_x + 1)*(domain.max_y - domain.min_y + 1));
+    Alloc_Scope<unsigned int> window_pixels(scratch, num_rows*num_cols);
+
+    feature_transform(scheduler, scratch, obstacles, bounds, width, height, domain, window, nearest, reinterpret_cast<unsigned char*>(window_pixels.data));
+
+    // window is tightened to the modified pixels and the cells of the changed polygons.
+    Alloc_Scope<unsigned char> changed(scratch, obstacles.num_polys + num_border_segments + 1);
+    zero_mem(changed);
+
+    for (int i = 0; i < num_changed; ++i)
+    {
+        changed[changed_polys[i] + 1] = 1;
+    }
+
+    Grid_Window result = empty_window();
+    unsigned int* words = reinterpret_cast<unsigned int*>(pixels);
+
+    for (int y = window.min_y; y <= window.max_y; ++y)
+    {
+        for (int x = window.min_x; x <= window.max_x; ++x)
+        {
+            int index = y*width + x;
+            int window_index = (y - window.min_y)*num_cols + x - window.min_x;
+            unsigned int old_id = pixel_to_id(pixels, index);
+            unsigned int new_id = pixel_to_id(reinterpret_cast<unsigned char*>(window_pixels.data), window_index);
+
+            if (old_id != new_id || changed[old_id] || changed[new_id])
+            {
+                include(result, x, y);
+            }
+
+            words[index] = window_pixels[window_index];
+        }
+    }
+
+    return result;
+}
+
+namespace
+{
+    // upper bound on the distance from the pixel center to the closest segment, zero inside obstacles.
+    inline float clearance(const Footprint& obstacles, const int* offsets, Bbox2 bounds, const unsigned char* pixels, int index, Vec2 center)
+    {
+        unsigned int id = pixel_to_id(pixels, index);
+        return (id == 0) ? 0.f : sqrtf(distance_sq(obstacles, offsets, bounds, id, center));
+    }
+}
+
+void build_distance_mesh_radii(Scheduler* scheduler, Memory* scratch, const Footprint& obstacles, Bbox2 bounds,
+                               float max_dist, float max_error, int width, int height, float* radii)
+{
+    corridormap_build_scope(build_stage_distance_mesh);
+
+    corridormap_assert(width > 0 && height > 0);
+    corridormap_assert(max_dist > 2.f*max_error);
+
+    const int num_cells = width*height;
+    const int num_segments = obstacles.num_polys + num_border_segments;
+
+    Alloc_Scope<unsigned int> pixels(scratch, num_cells);
+    Alloc_Scope<int> offsets(scratch, obstacles.num_polys);
+    Alloc_Scope<float> cell_clearance(scratch, num_cells);
+    Alloc_Scope<int> visited(scratch, num_cells);
+    Alloc_Scope<int> stack(scratch, num_cells);
+
+    unsigned char* ids = reinterpret_cast<unsigned char*>(static_cast<unsigned int*>(pixels));
+    build_obstacle_id_image(scheduler, scratch, obstacles, bounds, width, height, ids);
+    vertex_offsets(obstacles, offsets);
+
+    Image_Update_Context ctx;
+    init_update_context(ctx, obstacles, obstacles, offsets, offsets, 0, 0, bounds, width, height, ids, 0.f);
+
+    // any point of a cell is within half diagonal of its center.
+    const float half_diagonal = 0.5f*sqrtf(sq(ctx.pixel_width) + sq(ctx.pixel_height));
+
+    for (int y = 0, index = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x, ++index)
+        {
+            cell_clearance[index] = clearance(obstacles, offsets, bounds, ids, index, pixel_center(ctx, x, y));
+            visited[index] = -1;
+        }
+    }
+
+    // a point p closest to segment s lies in a cell c with dist(c, s) <= dist(p, s) + h = clearance(p) + h <= clearance(c) + 2h.
+    // cells passing the test are flood filled from the cells of the polygon vertices, they are connected as
+    // the region of s is connected to s. the radius of s is then bounded by max of clearance(c) + h over those cells.
+    for (int oid = 0; oid < obstacles.num_polys; ++oid)
+    {
+        const unsigned int id = oid + 1;
+        const int first_vertex = offsets[oid];
+        float radius = 0.f;
+        int stack_size = 0;
+
+        for (int i = 0; i < obstacles.num_poly_verts[oid]; ++i)
+        {
+            int x = std::min(std::max(int((obstacles.x[first_vertex + i] - bounds.min[0])/ctx.pixel_width), 0), width - 1);
+            int y = std::min(std::max(int((obstacles.y[first_vertex + i] - bounds.min[1])/ctx.pixel_height), 0), height - 1);
+            int index = y*width + x;
+
+            if (visited[index] != oid)
+            {
+                visited[index] = oid;
+                stack[stack_size++] = index;
+            }
+        }
+
+        while (stack_size > 0)
+        {
+            int index = stack[--stack_size];
+            int cell_x = index % width;
+            int cell_y = index / width;
+
+            radius = std::max(radius, cell_clearance[index] + half_diagonal);
+
+            for (int y = std::max(cell_y - 1, 0); y <= std::min(cell_y + 1, height - 1); ++y)
+            {
+                for (int x = std::max(cell_x - 1, 0); x <= std::min(cell_x + 1, width - 1); ++x)
+                {
+                    int nei = y*width + x;
+
+                    if (visited[nei] == oid)
+                    {
+                        continue;
+                    }
+
+                    float limit = cell_clearance[nei] + 2.f*half_diagonal;
+
+                    if (distance_sq(obstacles, offsets, bounds, id, pixel_center(ctx, x, y)) <= sq(limit))
+                    {
+                        visited[nei] = oid;
+                        stack[stack_size++] = nei;
+                    }
+                }
+            }
+        }
+
+        radii[oid] = radius;
+    }
+
+    // border sides are tested against all cells.
+    for (int side = 0; side < num_border_segments; ++side)
+    {
+        const unsigned int id = obstacles.num_polys + side + 1;
+        float radius = 0.f;
+
+        for (int y = 0, index = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x, ++index)
+            {
+                float limit = cell_clearance[index] + 2.f*half_diagonal;
+
+                if (distance_sq(obstacles, offsets, bounds, id, pixel_center(ctx, x, y)) <= sq(limit))
+                {
+                    radius = std::max(radius, cell_clearance[index] + half_diagonal);
+                }
+            }
+        }
+
+        radii[obstacles.num_polys + side] = radius;
+    }
+
+    // faceted cones reach radius - max_error, and need at least two triangles per half turn.
+    for (int i = 0; i < num_segments; ++i)
+    {
+        radii[i] = std::min(std::max(radii[i] + max_error, 2.f*max_error), max_dist);
+    }
+}
+
+}
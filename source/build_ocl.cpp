@@ -23,9 +23,13 @@
 #include <clew.h>
 #endif
 
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "corridormap/memory.h"
+#include "corridormap/build_alloc.h"
+#include "corridormap/build_stats.h"
 #include "corridormap/build_ocl.h"
 
 #define CORRIDORMAP_CHECK_OCL(error_code)   \
@@ -55,20 +59,152 @@ Opencl_Runtime init_opencl_runtime(const Renderer::Opencl_Shared& shared)
     return runtime;
 }
 
+namespace
+{
+    // max number of opencl platforms searched for a device.
+    enum { max_opencl_platforms = 16 };
+}
+
+Opencl_Runtime init_opencl_runtime(cl_device_type device_type)
+{
+    Opencl_Runtime runtime;
+    memset(&runtime, 0, sizeof(Opencl_Runtime));
+
+    cl_platform_id platforms[max_opencl_platforms];
+    cl_uint num_platforms = 0;
+
+    if (clGetPlatformIDs(max_opencl_platforms, platforms, &num_platforms) != CL_SUCCESS)
+    {
+        return runtime;
+    }
+
+    num_platforms = (num_platforms < max_opencl_platforms) ? num_platforms : cl_uint(max_opencl_platforms);
+
+    for (cl_uint i = 0; i < num_platforms; ++i)
+    {
+        cl_device_id device;
+
+        if (clGetDeviceIDs(platforms[i], device_type, 1, &device, 0) != CL_SUCCESS)
+        {
+            continue;
+        }
+
+        cl_context_properties properties[] =
+        {
+            CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(platforms[i]),
+            0,
+        };
+
+        cl_int error_code;
+        cl_context context = clCreateContext(properties, 1, &device, 0, 0, &error_code);
+
+        if (error_code != CL_SUCCESS)
+        {
+            continue;
+        }
+
+        cl_command_queue queue = clCreateCommandQueue(context, device, 0, &error_code);
+
+        if (error_code != CL_SUCCESS)
+        {
+            clReleaseContext(context);
+            continue;
+        }
+
+        runtime.context = context;
+        runtime.queue = queue;
+        runtime.device = device;
+        runtime.owns_context = true;
+        break;
+    }
+
+    return runtime;
+}
+
+namespace
+{
+    void release_mem_object(cl_mem& object)
+    {
+        if (object)
+        {
+            clReleaseMemObject(object);
+            object = 0;
+        }
+    }
+
+    void release_feature_storage(Opencl_Runtime& runtime)
+    {
+        release_mem_object(runtime.voronoi_marks_buf);
+        release_mem_object(runtime.voronoi_vertices_compacted_buf);
+        release_mem_object(runtime.voronoi_edges_compacted_buf);
+        release_mem_object(runtime.voronoi_edge_ids_1);
+        release_mem_object(runtime.voronoi_edge_ids_2);
+        release_mem_object(runtime.compaction_state_buf);
+        runtime.features_width = 0;
+        runtime.features_height = 0;
+    }
+
+    // replaces the tail of the feature chain with a newly enqueued command.
+    void chain_features_event(Opencl_Runtime& runtime, cl_event event)
+    {
+        if (runtime.features_event)
+        {
+            clReleaseEvent(runtime.features_event);
+        }
+
+        runtime.features_event = event;
+    }
+
+    cl_uint features_wait_count(const Opencl_Runtime& runtime)
+    {
+        return runtime.features_event ? 1 : 0;
+    }
+
+    const cl_event* features_wait_list(const Opencl_Runtime& runtime)
+    {
+        return runtime.features_event ? &runtime.features_event : 0;
+    }
+
+    // waits for the feature chain without opening a stage scope, callers are already inside one.
+    cl_int wait_features_event(Opencl_Runtime& runtime)
+    {
+        if (!runtime.features_event)
+        {
+            return CL_SUCCESS;
+        }
+
+        cl_int error_code = clWaitForEvents(1, &runtime.features_event);
+        chain_features_event(runtime, 0);
+
+        return error_code;
+    }
+}
+
 void term_opencl_runtime(Opencl_Runtime& runtime)
 {
-    clReleaseMemObject(runtime.voronoi_vertices_img);
-    clReleaseMemObject(runtime.voronoi_edges_img);
-    clReleaseMemObject(runtime.voronoi_vertices_compacted_buf);
-    clReleaseMemObject(runtime.voronoi_edges_compacted_buf);
-    clReleaseMemObject(runtime.compaction_sums_buf);
-    clReleaseMemObject(runtime.compaction_offsets_buf);
+    chain_features_event(runtime, 0);
+
+    release_feature_storage(runtime);
+    release_mem_object(runtime.compaction_counts_buf);
 
     clReleaseCommandQueue(runtime.queue);
 
     for (int i = 0; i < kernel_id_count; ++i)
     {
-        clReleaseKernel(runtime.kernels[i]);
+        if (runtime.kernels[i])
+        {
+            clReleaseKernel(runtime.kernels[i]);
+        }
+
+        if (runtime.programs[i])
+        {
+            clReleaseProgram(runtime.programs[i]);
+        }
+    }
+
+    if (runtime.owns_context)
+    {
+        clReleaseContext(runtime.context);
     }
 }
 
@@ -92,7 +228,178 @@ const char* get_kernel_source(Kernel_Id id)
     return kernel_source[id];
 }
 
+namespace
+{
+    const uint64_t fnv_offset = 0xcbf29ce484222325ull;
+    const uint64_t fnv_prime = 0x100000001b3ull;
+
+    uint64_t fnv1a(const void* data, size_t size, uint64_t hash=fnv_offset)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= fnv_prime;
+        }
+
+        return hash;
+    }
+
+    // cache key covers everything that can invalidate a device binary: device, driver, opencl version and source.
+    uint64_t program_cache_key(const Opencl_Runtime& runtime, Kernel_Id id)
+    {
+        const cl_device_info params[] = { CL_DEVICE_VENDOR, CL_DEVICE_NAME, CL_DRIVER_VERSION, CL_DEVICE_VERSION };
+
+        uint64_t hash = fnv_offset;
+
+        for (size_t i = 0; i < sizeof(params)/sizeof(params[0]); ++i)
+        {
+            char info[256];
+            size_t info_size = 0;
+
+            if (clGetDeviceInfo(runtime.device, params[i], sizeof(info), info, &info_size) != CL_SUCCESS)
+            {
+                info_size = 0;
+            }
+
+            hash = fnv1a(info, info_size, hash);
+        }
+
+        const char* source = get_kernel_source(id);
+        return fnv1a(source, strlen(source), hash);
+    }
+
+    // max length of a cache file path.
+    enum { max_cache_path = 1024 };
+
+    bool program_cache_path(const char* cache_dir, Kernel_Id id, uint64_t key, char* path)
+    {
+        // directory + separator + "corridormap_NN_" + 16 hex digits + ".bin" + terminator.
+        if (strlen(cache_dir) + 40 > max_cache_path)
+        {
+            return false;
+        }
+
+        sprintf(path, "%s/corridormap_%02d_%08x%08x.bin", cache_dir, int(id), unsigned(key >> 32), unsigned(key & 0xffffffff));
+        return true;
+    }
+
+    // cache file starts with this header, the payload is a CL_PROGRAM_BINARIES blob for one device.
+    struct Program_Binary_Header
+    {
+        uint32_t magic;
+        uint32_t size;
+        uint64_t hash;
+    };
+
+    const uint32_t program_binary_magic = 0x42504d43; // 'CMPB'.
+
+    // returns program binary read from path allocated in scratch, or null if the file is missing or damaged.
+    unsigned char* read_program_binary(Memory* scratch, const char* path, size_t* size)
+    {
+        FILE* file = fopen(path, "rb");
+
+        if (!file)
+        {
+            return 0;
+        }
+
+        unsigned char* binary = 0;
+
+        Program_Binary_Header header;
+
+        if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == program_binary_magic && header.size > 0)
+        {
+            binary = allocate<unsigned char>(scratch, header.size);
+
+            if (fread(binary, header.size, 1, file) != 1 || fnv1a(binary, header.size) != header.hash)
+            {
+                scratch->deallocate(binary);
+                binary = 0;
+            }
+        }
+
+        fclose(file);
+
+        *size = binary ? header.size : 0;
+        return binary;
+    }
+
+    void write_program_binary(Memory* scratch, cl_program program, const char* path)
+    {
+        size_t size = 0;
+
+        if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, 0) != CL_SUCCESS || size == 0 || size > 0xffffffffu)
+        {
+            return;
+        }
+
+        Alloc_Scope<unsigned char> binary(scratch, size);
+        unsigned char* binaries[] = { binary };
+
+        if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binaries), binaries, 0) != CL_SUCCESS)
+        {
+            return;
+        }
+
+        // cache is best effort, a failed or partial write is rejected by the hash on the next read.
+        FILE* file = fopen(path, "wb");
+
+        if (!file)
+        {
+            return;
+        }
+
+        Program_Binary_Header header;
+        header.magic = program_binary_magic;
+        header.size = static_cast<uint32_t>(size);
+        header.hash = fnv1a(binary, size);
+
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(binary, size, 1, file);
+        fclose(file);
+    }
+
+    // builds program from the cached binary. returns null if there's no binary or the driver rejects it.
+    cl_program build_program_from_cache(Opencl_Runtime& runtime, Memory* scratch, const char* path)
+    {
+        size_t size;
+        unsigned char* binary = read_program_binary(scratch, path, &size);
+
+        if (!binary)
+        {
+            return 0;
+        }
+
+        const unsigned char* binaries[] = { binary };
+        cl_int binary_status = CL_INVALID_BINARY;
+        cl_int error_code;
+
+        cl_program program = clCreateProgramWithBinary(runtime.context, 1, &runtime.device, &size, binaries, &binary_status, &error_code);
+        scratch->deallocate(binary);
+
+        if (error_code != CL_SUCCESS)
+        {
+            return 0;
+        }
+
+        if (binary_status != CL_SUCCESS || clBuildProgram(program, 1, &runtime.device, 0, 0, 0) != CL_SUCCESS)
+        {
+            clReleaseProgram(program);
+            return 0;
+        }
+
+        return program;
+    }
+}
+
 Compilation_Status build_kernels(Opencl_Runtime& runtime)
+{
+    return build_kernels(runtime, 0, 0);
+}
+
+Compilation_Status build_kernels(Opencl_Runtime& runtime, Memory* scratch, const char* cache_dir)
 {
     Compilation_Status status;
     status.code = CL_SUCCESS;
@@ -102,18 +409,32 @@ Compilation_Status build_kernels(Opencl_Runtime& runtime)
     {
         status.kernel = static_cast<Kernel_Id>(i);
 
-        runtime.programs[i] = clCreateProgramWithSource(runtime.context, 1, &kernel_source[i], 0, &status.code);
+        char path[max_cache_path];
+        bool cached = cache_dir && program_cache_path(cache_dir, status.kernel, program_cache_key(runtime, status.kernel), path);
 
-        if (status.code != CL_SUCCESS)
+        runtime.programs[i] = cached ? build_program_from_cache(runtime, scratch, path) : 0;
+
+        // fall back to compiling from source if there's no usable binary.
+        if (!runtime.programs[i])
         {
-            return status;
-        }
+            runtime.programs[i] = clCreateProgramWithSource(runtime.context, 1, &kernel_source[i], 0, &status.code);
 
-        status.code = clBuildProgram(runtime.programs[i], 1, &runtime.device, 0, 0, 0);
+            if (status.code != CL_SUCCESS)
+            {
+                return status;
+            }
 
-        if (status.code != CL_SUCCESS)
-        {
-            return status;
+            status.code = clBuildProgram(runtime.programs[i], 1, &runtime.device, 0, 0, 0);
+
+            if (status.code != CL_SUCCESS)
+            {
+                return status;
+            }
+
+            if (cached)
+            {
+                write_program_binary(scratch, runtime.programs[i], path);
+            }
         }
 
         runtime.kernels[i] = clCreateKernel(runtime.programs[i], "run", &status.code);
@@ -130,26 +451,71 @@ Compilation_Status build_kernels(Opencl_Runtime& runtime)
 
 namespace
 {
-    cl_int allocate_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image)
+    // must match ITEMS_PER_THREAD of kernel_compaction_fused.
+    const size_t compaction_items_per_thread = 8;
+
+    size_t get_compaction_wgsize(Opencl_Runtime& runtime)
     {
+        cl_kernel kernel = runtime.kernels[kernel_id_compaction_fused];
+
+        size_t max_wgsize = 0;
+        clGetKernelWorkGroupInfo(kernel, runtime.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &max_wgsize, 0);
+
+        size_t wg_size = (max_wgsize >= 128) ? 128 : max_wgsize;
+
+        return wg_size;
+    }
+
+    size_t get_compaction_tile_count(Opencl_Runtime& runtime, size_t pixel_count)
+    {
+        size_t tile_size = get_compaction_wgsize(runtime)*compaction_items_per_thread;
+        return (pixel_count + tile_size - 1)/tile_size;
+    }
+
+    // (re)creates feature images and buffers only when the voronoi image size changes.
+    cl_int allocate_voronoi_features(Opencl_Runtime& runtime, size_t width, size_t height)
+    {
+        if (runtime.voronoi_marks_buf && runtime.features_width == width && runtime.features_height == height)
+        {
+            return CL_SUCCESS;
+        }
+
+        release_feature_storage(runtime);
+
         cl_int error_code;
 
-        size_t width;
-        clGetImageInfo(voronoi_image, CL_IMAGE_WIDTH, sizeof(width), &width, 0);
+        runtime.voronoi_marks_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, width*height, 0, &error_code);
+        CORRIDORMAP_CHECK_OCL(error_code);
+
+        // every pixel can be a feature at most, so compaction never waits for the counts to size its output.
+        const size_t capacity = width*height*sizeof(cl_uint);
 
-        size_t height;
-        clGetImageInfo(voronoi_image, CL_IMAGE_HEIGHT, sizeof(height), &height, 0);
+        runtime.voronoi_vertices_compacted_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, capacity, 0, &error_code);
+        CORRIDORMAP_CHECK_OCL(error_code);
+        runtime.voronoi_edges_compacted_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, capacity, 0, &error_code);
+        CORRIDORMAP_CHECK_OCL(error_code);
+        runtime.voronoi_edge_ids_1 = clCreateBuffer(runtime.context, CL_MEM_WRITE_ONLY, capacity, 0, &error_code);
+        CORRIDORMAP_CHECK_OCL(error_code);
+        runtime.voronoi_edge_ids_2 = clCreateBuffer(runtime.context, CL_MEM_WRITE_ONLY, capacity, 0, &error_code);
+        CORRIDORMAP_CHECK_OCL(error_code);
 
-        // RGBA8 must be supported by all implementations according to OpenCL 1.1 specification.
-        cl_image_format format;
-        format.image_channel_order = CL_RGBA;
-        format.image_channel_data_type = CL_UNSIGNED_INT8;
+        // both sets of [tile counter, vertex tile states, edge tile states] start cleared,
+        // afterwards each compaction clears the set the next one uses.
+        const size_t state_size = 2*(1 + 2*get_compaction_tile_count(runtime, width*height))*sizeof(cl_uint);
 
-        runtime.voronoi_vertices_img = clCreateImage2D(runtime.context, CL_MEM_READ_WRITE, &format, width, height, 0, 0, &error_code);
+        runtime.compaction_state_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, state_size, 0, &error_code);
         CORRIDORMAP_CHECK_OCL(error_code);
 
-        runtime.voronoi_edges_img = clCreateImage2D(runtime.context, CL_MEM_READ_WRITE, &format, width, height, 0, 0, &error_code);
+        void* state = clEnqueueMapBuffer(runtime.queue, runtime.compaction_state_buf, CL_TRUE, CL_MAP_WRITE, 0, state_size, 0, 0, 0, &error_code);
         CORRIDORMAP_CHECK_OCL(error_code);
+        memset(state, 0, state_size);
+        error_code = clEnqueueUnmapMemObject(runtime.queue, runtime.compaction_state_buf, state, 0, 0, 0);
+        CORRIDORMAP_CHECK_OCL(error_code);
+
+        runtime.compaction_parity = 0;
+
+        runtime.features_width = width;
+        runtime.features_height = height;
 
         return CL_SUCCESS;
     }
@@ -157,8 +523,7 @@ namespace
 
 cl_int mark_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image)
 {
-    cl_int error_code = allocate_voronoi_features(runtime, voronoi_image);
-    CORRIDORMAP_CHECK_OCL(error_code);
+    corridormap_build_scope(build_stage_opencl_kernels);
 
     size_t width;
     clGetImageInfo(voronoi_image, CL_IMAGE_WIDTH, sizeof(width), &width, 0);
@@ -166,18 +531,34 @@ cl_int mark_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image)
     size_t height;
     clGetImageInfo(voronoi_image, CL_IMAGE_HEIGHT, sizeof(height), &height, 0);
 
+    // previous build must be done with the feature storage before it's reused or resized.
+    if (runtime.features_event)
+    {
+        cl_int error_code = clWaitForEvents(1, &runtime.features_event);
+        chain_features_event(runtime, 0);
+        CORRIDORMAP_CHECK_OCL(error_code);
+    }
+
+    cl_int error_code = allocate_voronoi_features(runtime, width, height);
+    CORRIDORMAP_CHECK_OCL(error_code);
+
     size_t global_work_size[] = { width, height };
 
     cl_kernel kernel = runtime.kernels[kernel_id_mark_features];
 
     clSetKernelArg(kernel, 0, sizeof(cl_mem), &voronoi_image);
-    clSetKernelArg(kernel, 1, sizeof(cl_mem), &runtime.voronoi_vertices_img);
-    clSetKernelArg(kernel, 2, sizeof(cl_mem), &runtime.voronoi_edges_img);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &runtime.voronoi_marks_buf);
 
-    return clEnqueueNDRangeKernel(runtime.queue, kernel, 2, 0, global_work_size, 0, 0, 0, 0);
+    cl_event event;
+    error_code = clEnqueueNDRangeKernel(runtime.queue, kernel, 2, 0, global_work_size, 0, 0, 0, &event);
+    CORRIDORMAP_CHECK_OCL(error_code);
+
+    chain_features_event(runtime, event);
+
+    return error_code;
 }
 
-cl_int debug_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image, cl_mem marks_image, unsigned int color, unsigned int border)
+cl_int debug_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image, unsigned int mark, unsigned int color, unsigned int border)
 {
     size_t width;
     clGetImageInfo(voronoi_image, CL_IMAGE_WIDTH, sizeof(width), &width, 0);
@@ -189,180 +570,201 @@ cl_int debug_voronoi_features(Opencl_Runtime& runtime, cl_mem voronoi_image, cl_
 
     cl_kernel kernel = runtime.kernels[kernel_id_mark_features_debug];
 
+    cl_uint mark_value = static_cast<cl_uint>(mark);
     cl_uint color_value = static_cast<cl_uint>(color);
     cl_int border_value = static_cast<cl_int>(border);
     cl_uint width_value = static_cast<cl_uint>(width);
     cl_uint height_value = static_cast<cl_uint>(height);
 
-    clSetKernelArg(kernel, 0, sizeof(cl_mem), &marks_image);
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &runtime.voronoi_marks_buf);
     clSetKernelArg(kernel, 1, sizeof(cl_mem), &voronoi_image);
-    clSetKernelArg(kernel, 2, sizeof(cl_uint), &color_value);
-    clSetKernelArg(kernel, 3, sizeof(cl_int), &border_value);
-    clSetKernelArg(kernel, 4, sizeof(cl_uint), &width_value);
-    clSetKernelArg(kernel, 5, sizeof(cl_uint), &height_value);
+    clSetKernelArg(kernel, 2, sizeof(cl_uint), &mark_value);
+    clSetKernelArg(kernel, 3, sizeof(cl_uint), &color_value);
+    clSetKernelArg(kernel, 4, sizeof(cl_int), &border_value);
+    clSetKernelArg(kernel, 5, sizeof(cl_uint), &width_value);
+    clSetKernelArg(kernel, 6, sizeof(cl_uint), &height_value);
 
     return clEnqueueNDRangeKernel(runtime.queue, kernel, 2, 0, global_work_size, 0, 0, 0, 0);
 }
 
-namespace
+cl_int compact_voronoi_features(Opencl_Runtime& runtime)
 {
-    size_t get_compaction_wgsize(Opencl_Runtime& runtime)
+    corridormap_build_scope(build_stage_opencl_kernels);
+
+    cl_int error_code;
+
+    if (!runtime.compaction_counts_buf)
     {
-        cl_kernel kernel_reduce = runtime.kernels[kernel_id_compaction_reduce];
+        runtime.compaction_counts_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, 2*sizeof(cl_uint), 0, &error_code);
+        CORRIDORMAP_CHECK_OCL(error_code);
+    }
 
-        size_t max_wgsize = 0;
-        clGetKernelWorkGroupInfo(kernel_reduce, runtime.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &max_wgsize, 0);
+    cl_uint pixel_count = static_cast<cl_uint>(runtime.features_width*runtime.features_height);
 
-        size_t wg_size = (max_wgsize >= 128) ? 128 : max_wgsize;
+    cl_kernel kernel = runtime.kernels[kernel_id_compaction_fused];
 
-        return wg_size;
-    }
+    size_t wg_size = get_compaction_wgsize(runtime);
+    size_t global_work_size = get_compaction_tile_count(runtime, pixel_count)*wg_size;
+
+    const size_t local_mem_size = (2*wg_size + 3)*sizeof(cl_uint);
+
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &runtime.voronoi_marks_buf);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &runtime.voronoi_vertices_compacted_buf);
+    clSetKernelArg(kernel, 2, sizeof(cl_mem), &runtime.voronoi_edges_compacted_buf);
+    clSetKernelArg(kernel, 3, sizeof(cl_mem), &runtime.compaction_state_buf);
+    clSetKernelArg(kernel, 4, sizeof(cl_mem), &runtime.compaction_counts_buf);
+    clSetKernelArg(kernel, 5, local_mem_size, 0);
+    clSetKernelArg(kernel, 6, sizeof(cl_uint), &pixel_count);
+    clSetKernelArg(kernel, 7, sizeof(cl_uint), &runtime.compaction_parity);
+
+    cl_event event;
+    error_code = clEnqueueNDRangeKernel(runtime.queue, kernel, 1, 0, &global_work_size, &wg_size, features_wait_count(runtime), features_wait_list(runtime), &event);
+    CORRIDORMAP_CHECK_OCL(error_code);
+    chain_features_event(runtime, event);
+
+    runtime.compaction_parity ^= 1;
+
+    // counts are valid once the chain tail completes.
+    error_code = clEnqueueReadBuffer(runtime.queue, runtime.compaction_counts_buf, CL_FALSE, 0, sizeof(cl_uint), &runtime.voronoi_vertex_mark_count, features_wait_count(runtime), features_wait_list(runtime), &event);
+    CORRIDORMAP_CHECK_OCL(error_code);
+    chain_features_event(runtime, event);
+
+    error_code = clEnqueueReadBuffer(runtime.queue, runtime.compaction_counts_buf, CL_FALSE, sizeof(cl_uint), sizeof(cl_uint), &runtime.voronoi_edge_mark_count, features_wait_count(runtime), features_wait_list(runtime), &event);
+    CORRIDORMAP_CHECK_OCL(error_code);
+    chain_features_event(runtime, event);
+
+    return error_code;
 }
 
-namespace
+cl_int store_obstacle_ids(Opencl_Runtime& runtime, cl_mem voronoi_image)
 {
-    cl_int compact_features(Opencl_Runtime& runtime, cl_mem image, cl_mem sums_buf, cl_mem offsets_buf, cl_mem* compacted_buf, cl_uint* count)
-    {
-        cl_int error_code;
+    corridormap_build_scope(build_stage_opencl_kernels);
 
-        size_t width;
-        clGetImageInfo(image, CL_IMAGE_WIDTH, sizeof(width), &width, 0);
+    cl_int error_code;
 
-        size_t height;
-        clGetImageInfo(image, CL_IMAGE_HEIGHT, sizeof(height), &height, 0);
+    cl_kernel kernel_edge = runtime.kernels[kernel_id_store_edge_obstacle_ids];
+    {
+        cl_uint count_offset = 1;
 
-        cl_uint pixel_count = static_cast<cl_uint>(width * height);
+        clSetKernelArg(kernel_edge, 0, sizeof(cl_mem), &voronoi_image);
+        clSetKernelArg(kernel_edge, 1, sizeof(cl_mem), &runtime.voronoi_edges_compacted_buf);
+        clSetKernelArg(kernel_edge, 2, sizeof(cl_mem), &runtime.voronoi_edge_ids_1);
+        clSetKernelArg(kernel_edge, 3, sizeof(cl_mem), &runtime.voronoi_edge_ids_2);
+        clSetKernelArg(kernel_edge, 4, sizeof(cl_mem), &runtime.compaction_counts_buf);
+        clSetKernelArg(kernel_edge, 5, sizeof(cl_uint), &count_offset);
 
-        cl_kernel kernel_reduce = runtime.kernels[kernel_id_compaction_reduce];
-        cl_kernel kernel_scan = runtime.kernels[kernel_id_compaction_scan_partials];
-        cl_kernel kernel_output = runtime.kernels[kernel_id_compaction_output];
+        // edge count is not known on the host yet, the kernel skips work items past it.
+        size_t global_work_size = runtime.features_width*runtime.features_height;
 
-        size_t wg_size = get_compaction_wgsize(runtime);
+        cl_event event;
+        error_code = clEnqueueNDRangeKernel(runtime.queue, kernel_edge, 1, 0, &global_work_size, 0, features_wait_count(runtime), features_wait_list(runtime), &event);
+        CORRIDORMAP_CHECK_OCL(error_code);
+        chain_features_event(runtime, event);
+    }
 
-        const size_t simd_size = 32;
-        const size_t local_mem_size = 2*wg_size*sizeof(cl_uint);
+    return error_code;
+}
 
-        cl_event event_reduce;
-        cl_event event_scan;
-        cl_event event_read;
-        cl_event event_output;
+cl_int wait_voronoi_features(Opencl_Runtime& runtime)
+{
+    corridormap_build_scope(build_stage_opencl_kernels);
 
-        // 1. reduce.
+    return wait_features_event(runtime);
+}
 
-        clSetKernelArg(kernel_reduce, 0, sizeof(cl_mem), &image);
-        clSetKernelArg(kernel_reduce, 1, sizeof(cl_mem), &sums_buf);
-        clSetKernelArg(kernel_reduce, 2, local_mem_size, 0);
-        clSetKernelArg(kernel_reduce, 3, sizeof(cl_uint), &pixel_count);
+cl_int transfer_voronoi_features(Opencl_Runtime& runtime, Voronoi_Features& features)
+{
+    corridormap_build_scope(build_stage_opencl_kernels);
 
-        size_t reduce_global_work_size = 2*wg_size*simd_size;
-        error_code = clEnqueueNDRangeKernel(runtime.queue, kernel_reduce, 1, 0, &reduce_global_work_size, &wg_size, 0, 0, &event_reduce);
-        CORRIDORMAP_CHECK_OCL(error_code);
+    // counts are read asynchronously by compaction.
+    cl_int error_code = wait_features_event(runtime);
+    CORRIDORMAP_CHECK_OCL(error_code);
 
-        // 2. scan partials.
+    const size_t vert_size = runtime.voronoi_vertex_mark_count*sizeof(cl_uint);
+    const size_t edge_size = runtime.voronoi_edge_mark_count*sizeof(cl_uint);
 
-        clSetKernelArg(kernel_scan, 0, sizeof(cl_mem), &sums_buf);
-        clSetKernelArg(kernel_scan, 1, sizeof(cl_mem), &offsets_buf);
-        clSetKernelArg(kernel_scan, 2, local_mem_size, 0);
+    cl_event events[4];
+    cl_uint num_events = 0;
 
-        size_t scan_global_work_size = wg_size;
-        error_code = clEnqueueNDRangeKernel(runtime.queue, kernel_scan, 1, 0, &scan_global_work_size, &wg_size, 1, &event_reduce, &event_scan);
+    // zero sized reads are invalid.
+    if (vert_size > 0)
+    {
+        error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_vertices_compacted_buf, CL_FALSE, 0, vert_size, features.verts, 0, 0, &events[num_events++]);
         CORRIDORMAP_CHECK_OCL(error_code);
+    }
 
-        const size_t result_offset = 2*wg_size*sizeof(cl_uint);
-        error_code = clEnqueueReadBuffer(runtime.queue, offsets_buf, CL_FALSE, result_offset, sizeof(cl_uint), count, 1, &event_scan, &event_read);
+    if (edge_size > 0)
+    {
+        error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_edges_compacted_buf, CL_FALSE, 0, edge_size, features.edges, 0, 0, &events[num_events++]);
+        CORRIDORMAP_CHECK_OCL(error_code);
+        error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_edge_ids_1, CL_FALSE, 0, edge_size, features.edge_obstacle_ids_1, 0, 0, &events[num_events++]);
         CORRIDORMAP_CHECK_OCL(error_code);
+        error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_edge_ids_2, CL_FALSE, 0, edge_size, features.edge_obstacle_ids_2, 0, 0, &events[num_events++]);
+        CORRIDORMAP_CHECK_OCL(error_code);
+    }
 
-        clWaitForEvents(1, &event_read);
+    if (num_events > 0)
+    {
+        error_code = clWaitForEvents(num_events, events);
 
-        if (*count == 0)
+        for (cl_uint i = 0; i < num_events; ++i)
         {
-            compacted_buf = 0;
-            return error_code;
+            clReleaseEvent(events[i]);
         }
 
-        *compacted_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, (*count)*sizeof(cl_uint), 0, &error_code);
-
-        // 3. compacted output.
-
-        clSetKernelArg(kernel_output, 0, sizeof(cl_mem), &image);
-        clSetKernelArg(kernel_output, 1, sizeof(cl_mem), compacted_buf);
-        clSetKernelArg(kernel_output, 2, sizeof(cl_mem), &sums_buf);
-        clSetKernelArg(kernel_output, 3, sizeof(cl_mem), &offsets_buf);
-        clSetKernelArg(kernel_output, 4, local_mem_size, 0);
-        clSetKernelArg(kernel_output, 5, sizeof(cl_uint), &pixel_count);
-
-        size_t output_global_work_size = 2*wg_size*simd_size;
-        error_code = clEnqueueNDRangeKernel(runtime.queue, kernel_output, 1, 0, &output_global_work_size, &wg_size, 0, 0, &event_output);
         CORRIDORMAP_CHECK_OCL(error_code);
+    }
 
-        clWaitForEvents(1, &event_output);
+    corridormap_build_count(num_vert_points, int(runtime.voronoi_vertex_mark_count));
+    corridormap_build_count(num_edge_points, int(runtime.voronoi_edge_mark_count));
 
-        return error_code;
-    }
+    return error_code;
 }
 
-cl_int compact_voronoi_features(Opencl_Runtime& runtime)
+cl_mem create_voronoi_image(Opencl_Runtime& runtime, const unsigned char* pixels, int width, int height, cl_int* error_code)
 {
-    cl_int error_code;
-
-    size_t wg_size = get_compaction_wgsize(runtime);
+    // normalized RGBA8 matches the shared render target, kernels read it with read_imagef.
+    cl_image_format format;
+    format.image_channel_order = CL_RGBA;
+    format.image_channel_data_type = CL_UNORM_INT8;
 
-    runtime.compaction_sums_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, 2*wg_size*sizeof(cl_uint), 0, &error_code);
-    CORRIDORMAP_CHECK_OCL(error_code);
-    runtime.compaction_offsets_buf = clCreateBuffer(runtime.context, CL_MEM_READ_WRITE, (1 + 2*wg_size) * sizeof(cl_uint), 0, &error_code);
-    CORRIDORMAP_CHECK_OCL(error_code);
+    // the host pointer is only read with CL_MEM_COPY_HOST_PTR.
+    void* host_ptr = const_cast<unsigned char*>(pixels);
 
-    error_code = compact_features(runtime, runtime.voronoi_vertices_img, runtime.compaction_sums_buf, runtime.compaction_offsets_buf, &runtime.voronoi_vertices_compacted_buf, &runtime.voronoi_vertex_mark_count);
-    CORRIDORMAP_CHECK_OCL(error_code);
-
-    error_code = compact_features(runtime, runtime.voronoi_edges_img, runtime.compaction_sums_buf, runtime.compaction_offsets_buf, &runtime.voronoi_edges_compacted_buf, &runtime.voronoi_edge_mark_count);
-    CORRIDORMAP_CHECK_OCL(error_code);
-
-    return error_code;
+    return clCreateImage2D(runtime.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &format, width, height, width*4, host_ptr, error_code);
 }
 
-cl_int store_obstacle_ids(Opencl_Runtime& runtime, cl_mem voronoi_image)
+cl_int detect_voronoi_features(Opencl_Runtime& runtime, Memory* memory, const unsigned char* pixels, int width, int height, Voronoi_Features& out)
 {
     cl_int error_code;
 
-    runtime.voronoi_edge_ids_1 = clCreateBuffer(runtime.context, CL_MEM_WRITE_ONLY, runtime.voronoi_edge_mark_count*sizeof(cl_uint), 0, &error_code);
-    CORRIDORMAP_CHECK_OCL(error_code);
-    runtime.voronoi_edge_ids_2 = clCreateBuffer(runtime.context, CL_MEM_WRITE_ONLY, runtime.voronoi_edge_mark_count*sizeof(cl_uint), 0, &error_code);
+    cl_mem voronoi_image = create_voronoi_image(runtime, pixels, width, height, &error_code);
     CORRIDORMAP_CHECK_OCL(error_code);
 
-    cl_kernel kernel_edge = runtime.kernels[kernel_id_store_edge_obstacle_ids];
-    {
-        clSetKernelArg(kernel_edge, 0, sizeof(cl_mem), &voronoi_image);
-        clSetKernelArg(kernel_edge, 1, sizeof(cl_mem), &runtime.voronoi_edges_img);
-        clSetKernelArg(kernel_edge, 2, sizeof(cl_mem), &runtime.voronoi_edges_compacted_buf);
-        clSetKernelArg(kernel_edge, 3, sizeof(cl_mem), &runtime.voronoi_edge_ids_1);
-        clSetKernelArg(kernel_edge, 4, sizeof(cl_mem), &runtime.voronoi_edge_ids_2);
+    error_code = mark_voronoi_features(runtime, voronoi_image);
 
-        size_t global_work_size = runtime.voronoi_edge_mark_count;
-        error_code = clEnqueueNDRangeKernel(runtime.queue, kernel_edge, 1, 0, &global_work_size, 0, 0, 0, 0);
-        CORRIDORMAP_CHECK_OCL(error_code);
+    if (error_code == CL_SUCCESS)
+    {
+        error_code = compact_voronoi_features(runtime);
     }
 
-    return error_code;
-}
-
-cl_int transfer_voronoi_features(Opencl_Runtime& runtime, Voronoi_Features& features)
-{
-    cl_int error_code;
+    if (error_code == CL_SUCCESS)
+    {
+        error_code = store_obstacle_ids(runtime, voronoi_image);
+    }
 
-    cl_event events[4];
+    if (error_code == CL_SUCCESS)
+    {
+        error_code = wait_voronoi_features(runtime);
+    }
 
-    error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_vertices_compacted_buf, CL_FALSE, 0, runtime.voronoi_vertex_mark_count*sizeof(cl_uint), features.verts, 0, 0, &events[0]);
-    CORRIDORMAP_CHECK_OCL(error_code);
-    error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_edges_compacted_buf, CL_FALSE, 0, runtime.voronoi_edge_mark_count*sizeof(cl_uint), features.edges, 0, 0, &events[1]);
-    CORRIDORMAP_CHECK_OCL(error_code);
-    error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_edge_ids_1, CL_FALSE, 0, runtime.voronoi_edge_mark_count*sizeof(cl_uint), features.edge_obstacle_ids_1, 0, 0, &events[2]);
-    CORRIDORMAP_CHECK_OCL(error_code);
-    error_code = clEnqueueReadBuffer(runtime.queue, runtime.voronoi_edge_ids_2, CL_FALSE, 0, runtime.voronoi_edge_mark_count*sizeof(cl_uint), features.edge_obstacle_ids_2, 0, 0, &events[3]);
-    CORRIDORMAP_CHECK_OCL(error_code);
+    if (error_code == CL_SUCCESS)
+    {
+        out = allocate_voronoi_features(memory, width, height, int(runtime.voronoi_vertex_mark_count), int(runtime.voronoi_edge_mark_count));
+        error_code = transfer_voronoi_features(runtime, out);
+    }
 
-    error_code = clWaitForEvents(sizeof(events)/sizeof(events[0]), events);
-    CORRIDORMAP_CHECK_OCL(error_code);
+    clReleaseMemObject(voronoi_image);
 
     return error_code;
 }
@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <chrono>
+#include <string.h>
+#include "corridormap/assert.h"
+#include "corridormap/build_stats.h"
+
+#if defined _MSC_VER
+    #define CORRIDORMAP_THREAD_LOCAL __declspec(thread)
+#else
+    #define CORRIDORMAP_THREAD_LOCAL __thread
+#endif
+
+namespace corridormap {
+
+namespace
+{
+    CORRIDORMAP_THREAD_LOCAL Build_Stats* thread_stats = 0;
+
+    double seconds()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const char* stage_names[num_build_stages] =
+    {
+        "distance_mesh",
+        "render_distance_mesh",
+        "obstacle_id_image",
+        "detect_features",
+        "opencl_kernels",
+        "edge_spans",
+        "csr",
+        "trace_edges",
+        "walkable_space",
+        "stitch_tiles",
+    };
+}
+
+void reset(Build_Stats& stats)
+{
+    Build_Scope_Begin scope_begin = stats.scope_begin;
+    Build_Scope_End scope_end = stats.scope_end;
+    void* user_data = stats.user_data;
+
+    memset(&stats, 0, sizeof(stats));
+
+    stats.scope_begin = scope_begin;
+    stats.scope_end = scope_end;
+    stats.user_data = user_data;
+}
+
+void set_build_stats(Build_Stats* stats)
+{
+    thread_stats = stats;
+}
+
+Build_Stats* get_build_stats()
+{
+    return thread_stats;
+}
+
+const char* stage_name(Build_Stage stage)
+{
+    corridormap_assert(stage >= 0 && stage < num_build_stages);
+    return stage_names[stage];
+}
+
+Memory_Tracking::Memory_Tracking(Memory* parent, Build_Stats* stats)
+    : _parent(parent)
+    , _stats(stats)
+{
+}
+
+void* Memory_Tracking::allocate(size_t size, size_t align)
+{
+    // prefix holds its own size and the allocation size right before the returned pointer.
+    size_t prefix = align < 2*sizeof(size_t) ? 2*sizeof(size_t) : align;
+    char* p = static_cast<char*>(_parent->allocate(size + prefix, prefix));
+
+    if (!p)
+    {
+        return 0;
+    }
+
+    size_t* header = reinterpret_cast<size_t*>(p + prefix) - 2;
+    header[0] = prefix;
+    header[1] = size;
+
+    _stats->current_bytes += size;
+    _stats->peak_bytes = _stats->current_bytes > _stats->peak_bytes ? _stats->current_bytes : _stats->peak_bytes;
+    _stats->scope_peak_bytes = _stats->current_bytes > _stats->scope_peak_bytes ? _stats->current_bytes : _stats->scope_peak_bytes;
+
+    return p + prefix;
+}
+
+void Memory_Tracking::deallocate(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    size_t* header = static_cast<size_t*>(ptr) - 2;
+    _stats->current_bytes -= header[1];
+    _parent->deallocate(static_cast<char*>(ptr) - header[0]);
+}
+
+Build_Scope::Build_Scope(Build_Stage stage)
+    : _stats(thread_stats)
+    , _stage(stage)
+    , _start(0.0)
+    , _outer_peak_bytes(0)
+{
+    if (!_stats)
+    {
+        return;
+    }
+
+    if (_stats->scope_begin)
+    {
+        _stats->scope_begin(_stats->user_data, stage, stage_name(stage));
+    }
+
+    _outer_peak_bytes = _stats->scope_peak_bytes;
+    _stats->scope_peak_bytes = _stats->current_bytes;
+    _start = seconds();
+}
+
+Build_Scope::~Build_Scope()
+{
+    if (!_stats)
+    {
+        return;
+    }
+
+    double elapsed = seconds() - _start;
+    size_t peak = _stats->scope_peak_bytes;
+
+    _stats->stage_time[_stage] += elapsed;
+    _stats->stage_calls[_stage]++;
+    _stats->stage_peak_bytes[_stage] = peak > _stats->stage_peak_bytes[_stage] ? peak : _stats->stage_peak_bytes[_stage];
+    _stats->scope_peak_bytes = peak > _outer_peak_bytes ? peak : _outer_peak_bytes;
+
+    if (_stats->scope_end)
+    {
+        _stats->scope_end(_stats->user_data, _stage, stage_name(_stage), elapsed);
+    }
+}
+
+}
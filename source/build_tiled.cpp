@@ -0,0 +1,1035 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "corridormap/assert.h"
+#include "corridormap/memory.h"
+#include "corridormap/vec2.h"
+#include "corridormap/parallel.h"
+#include "corridormap/runtime.h"
+#include "corridormap/build_stats.h"
+#include "corridormap/build.h"
+
+namespace corridormap {
+
+namespace
+{
+    // serializes allocations of the tile builds running concurrently.
+    class Memory_Locked : public Memory
+    {
+    public:
+        explicit Memory_Locked(Memory* parent)
+            : _parent(parent)
+        {
+        }
+
+        virtual void* allocate(size_t size, size_t align)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _parent->allocate(size, align);
+        }
+
+        virtual void deallocate(void* ptr)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _parent->deallocate(ptr);
+        }
+
+    private:
+        Memory_Locked(const Memory_Locked&);
+        Memory_Locked& operator=(const Memory_Locked&);
+
+        Memory* _parent;
+        std::mutex _mutex;
+    };
+
+    // medial axis point with the closest obstacle points on the left and right along the edge direction.
+    struct Axis_Point
+    {
+        Vec2 pos;
+        Vec2 left;
+        Vec2 right;
+    };
+
+    // medial axis of a single tile clipped to the tile rectangle.
+    // arrays are null while counting, only the counters are updated then.
+    struct Tile_Graph
+    {
+        int num_verts;
+        int num_edges;
+        int num_events;
+        Vec2* vert_pos;
+        // seam line of the vertex: 2*k for the vertical line k, 2*k+1 for the horizontal one. -1 for medial axis vertices.
+        int* vert_seam;
+        // edge end points.
+        int* edge_u;
+        int* edge_v;
+        // left and right closest points at u and v along u->v.
+        Vec2* edge_sides_u;
+        Vec2* edge_sides_v;
+        // offsets of the edge events ordered from u to v, num_edges+1 items.
+        int* edge_events;
+        Vec2* event_pos;
+        // left and right closest points along u->v.
+        Vec2* event_sides;
+    };
+
+    void allocate_tile_graph(Memory* mem, Tile_Graph& graph)
+    {
+        graph.vert_pos = allocate<Vec2>(mem, graph.num_verts);
+        graph.vert_seam = allocate<int>(mem, graph.num_verts);
+        graph.edge_u = allocate<int>(mem, graph.num_edges);
+        graph.edge_v = allocate<int>(mem, graph.num_edges);
+        graph.edge_sides_u = allocate<Vec2>(mem, graph.num_edges*2);
+        graph.edge_sides_v = allocate<Vec2>(mem, graph.num_edges*2);
+        graph.edge_events = allocate<int>(mem, graph.num_edges + 1);
+        graph.event_pos = allocate<Vec2>(mem, graph.num_events);
+        graph.event_sides = allocate<Vec2>(mem, graph.num_events*2);
+        graph.num_verts = 0;
+        graph.num_edges = 0;
+        graph.num_events = 0;
+        graph.edge_events[0] = 0;
+    }
+
+    void deallocate_tile_graph(Memory* mem, Tile_Graph& graph)
+    {
+        mem->deallocate(graph.event_sides);
+        mem->deallocate(graph.event_pos);
+        mem->deallocate(graph.edge_events);
+        mem->deallocate(graph.edge_sides_v);
+        mem->deallocate(graph.edge_sides_u);
+        mem->deallocate(graph.edge_v);
+        mem->deallocate(graph.edge_u);
+        mem->deallocate(graph.vert_seam);
+        mem->deallocate(graph.vert_pos);
+    }
+
+    int add_vertex(Tile_Graph& graph, Vec2 pos, int seam)
+    {
+        if (graph.vert_pos)
+        {
+            graph.vert_pos[graph.num_verts] = pos;
+            graph.vert_seam[graph.num_verts] = seam;
+        }
+
+        return graph.num_verts++;
+    }
+
+    void begin_edge(Tile_Graph& graph, int u, const Axis_Point& p)
+    {
+        if (graph.edge_u)
+        {
+            graph.edge_u[graph.num_edges] = u;
+            graph.edge_sides_u[graph.num_edges*2 + 0] = p.left;
+            graph.edge_sides_u[graph.num_edges*2 + 1] = p.right;
+        }
+    }
+
+    void add_event(Tile_Graph& graph, const Axis_Point& p)
+    {
+        if (graph.event_pos)
+        {
+            graph.event_pos[graph.num_events] = p.pos;
+            graph.event_sides[graph.num_events*2 + 0] = p.left;
+            graph.event_sides[graph.num_events*2 + 1] = p.right;
+        }
+
+        graph.num_events++;
+    }
+
+    void end_edge(Tile_Graph& graph, int v, const Axis_Point& p)
+    {
+        if (graph.edge_v)
+        {
+            graph.edge_v[graph.num_edges] = v;
+            graph.edge_sides_v[graph.num_edges*2 + 0] = p.left;
+            graph.edge_sides_v[graph.num_edges*2 + 1] = p.right;
+            graph.edge_events[graph.num_edges + 1] = graph.num_events;
+        }
+
+        graph.num_edges++;
+    }
+
+    // half-open test, so points on a seam belong to exactly one tile.
+    inline bool contains(const Bbox2& rect, Vec2 p)
+    {
+        return p.x >= rect.min[0] && p.x < rect.max[0] && p.y >= rect.min[1] && p.y < rect.max[1];
+    }
+
+    // liang-barsky clipping of the segment a->b by the closed rectangle, returns false if they don't intersect.
+    bool clip_segment(const Bbox2& rect, Vec2 a, Vec2 b, float& t0, float& t1)
+    {
+        const Vec2 d = b - a;
+        const float p[] = { -d.x, d.x, -d.y, d.y };
+        const float q[] = { a.x - rect.min[0], rect.max[0] - a.x, a.y - rect.min[1], rect.max[1] - a.y };
+
+        t0 = 0.f;
+        t1 = 1.f;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (p[i] == 0.f)
+            {
+                if (q[i] < 0.f)
+                {
+                    return false;
+                }
+
+                continue;
+            }
+
+            const float r = q[i]/p[i];
+
+            if (p[i] < 0.f)
+            {
+                t0 = std::max(t0, r);
+            }
+            else
+            {
+                t1 = std::min(t1, r);
+            }
+        }
+
+        return t0 <= t1;
+    }
+
+    // Clips medial axis edges of a tile build to the tile, streaming the pieces inside to the tile graph.
+    struct Tile_Clip
+    {
+        Tile_Graph* graph;
+        // the tile.
+        Bbox2 rect;
+        int col;
+        int row;
+        // tile graph vertex for each walkable space vertex inside the tile, indexed by pool index.
+        int* vert_map;
+        // the last clipped point and whether it's inside the tile.
+        Axis_Point prev;
+        bool inside;
+    };
+
+    // point at parameter t of the segment a->b snapped to the closest side of the tile. creates a seam vertex for it.
+    int cut(Tile_Clip& clip, const Axis_Point& a, const Axis_Point& b, float t, Axis_Point& out)
+    {
+        const Bbox2& rect = clip.rect;
+
+        out.pos = a.pos + (b.pos - a.pos)*t;
+        out.left = a.left + (b.left - a.left)*t;
+        out.right = a.right + (b.right - a.right)*t;
+
+        const float dist[] =
+        {
+            fabsf(out.pos.x - rect.min[0]),
+            fabsf(out.pos.x - rect.max[0]),
+            fabsf(out.pos.y - rect.min[1]),
+            fabsf(out.pos.y - rect.max[1]),
+        };
+
+        const int side = int(std::min_element(dist, dist + 4) - dist);
+        int seam = 0;
+
+        switch (side)
+        {
+        case 0: out.pos.x = rect.min[0]; seam = 2*clip.col; break;
+        case 1: out.pos.x = rect.max[0]; seam = 2*(clip.col + 1); break;
+        case 2: out.pos.y = rect.min[1]; seam = 2*clip.row + 1; break;
+        case 3: out.pos.y = rect.max[1]; seam = 2*(clip.row + 1) + 1; break;
+        }
+
+        return add_vertex(*clip.graph, out.pos, seam);
+    }
+
+    void clip_begin(Tile_Clip& clip, const Axis_Point& p, int vertex)
+    {
+        clip.prev = p;
+        clip.inside = clip.vert_map[vertex] >= 0;
+
+        if (clip.inside)
+        {
+            begin_edge(*clip.graph, clip.vert_map[vertex], p);
+        }
+    }
+
+    // clips the segment from the previous point to p. an edge piece is started where the segment enters the tile and ended where it leaves.
+    void clip_to(Tile_Clip& clip, const Axis_Point& p)
+    {
+        const Axis_Point a = clip.prev;
+        const bool a_inside = clip.inside;
+        const bool b_inside = contains(clip.rect, p.pos);
+        clip.prev = p;
+
+        if (a_inside && b_inside)
+        {
+            return;
+        }
+
+        float t0;
+        float t1;
+
+        if (!clip_segment(clip.rect, a.pos, p.pos, t0, t1))
+        {
+            // numerical disagreement with the half-open test, cut at the end point which is inside.
+            t0 = 1.f;
+            t1 = 0.f;
+
+            if (!a_inside && !b_inside)
+            {
+                return;
+            }
+        }
+
+        if (!a_inside)
+        {
+            // segment only touching the max sides, which belong to the neighbour tiles.
+            if (!b_inside && (t0 >= t1 || !contains(clip.rect, a.pos + (p.pos - a.pos)*(0.5f*(t0 + t1)))))
+            {
+                return;
+            }
+
+            Axis_Point x;
+            const int u = cut(clip, a, p, t0, x);
+            begin_edge(*clip.graph, u, x);
+            clip.inside = true;
+        }
+
+        if (!b_inside)
+        {
+            Axis_Point x;
+            const int v = cut(clip, a, p, t1, x);
+            end_edge(*clip.graph, v, x);
+            clip.inside = false;
+        }
+    }
+
+    void clip_end(Tile_Clip& clip, const Axis_Point& p, int vertex)
+    {
+        clip_to(clip, p);
+
+        if (clip.inside)
+        {
+            end_edge(*clip.graph, clip.vert_map[vertex], p);
+        }
+    }
+
+    void clip_walkable_space(const Walkable_Space& space, Tile_Clip& clip)
+    {
+        for (Vertex* v = first(space.vertices); v != 0; v = next(space.vertices, v))
+        {
+            const int vertex = int(v - space.vertices.items);
+            clip.vert_map[vertex] = contains(clip.rect, v->pos) ? add_vertex(*clip.graph, v->pos, -1) : -1;
+        }
+
+        for (Edge* e = first(space.edges); e != 0; e = next(space.edges, e))
+        {
+            const Half_Edge* uv = &e->dir[0];
+            const Half_Edge* vu = &e->dir[1];
+
+            Axis_Point p;
+            p.pos = source(space, e)->pos;
+            p.left = right_side(space, vu);
+            p.right = left_side(space, vu);
+            clip_begin(clip, p, vu->target);
+
+            for (Event* evt = event(space, uv); evt != 0; evt = next(space, uv, evt))
+            {
+                p.pos = evt->pos;
+                p.left = left_side(space, uv, evt);
+                p.right = right_side(space, uv, evt);
+                clip_to(clip, p);
+
+                if (clip.inside)
+                {
+                    add_event(*clip.graph, p);
+                }
+            }
+
+            p.pos = target(space, e)->pos;
+            p.left = left_side(space, uv);
+            p.right = right_side(space, uv);
+            clip_end(clip, p, uv->target);
+        }
+    }
+
+    // Build context and output of a tile build, reused by the tiles built on the same thread.
+    struct Tile_Worker
+    {
+        Build_Context ctx;
+        Walkable_Space space;
+    };
+
+    struct Tiled_Build
+    {
+        const Footprint* footprint;
+        const Tiled_Build_Params* params;
+        int num_cols;
+        int num_rows;
+        // first vertex of each polygon.
+        const int* poly_offsets;
+        // overlap of each tile, doubled while the tile has seam vertices without a pair.
+        float* tile_overlaps;
+        // polygons overlapping each tile expanded by its overlap, csr.
+        const int* tile_poly_offsets;
+        const int* tile_polys;
+        // tiles built by the current pass.
+        const int* pass_tiles;
+        // thread safe memory for the tile builds.
+        Memory* memory;
+        Tile_Worker* workers;
+        std::atomic<unsigned char>* busy;
+        int num_workers;
+        Tile_Graph* tiles;
+    };
+
+    inline float seam_coord(float min, float max, float tile_size, int k)
+    {
+        return std::min(min + float(k)*tile_size, max);
+    }
+
+    // number of tiles covering [min, max), the last tile is never empty.
+    int num_tiles_along(float min, float max, float tile_size)
+    {
+        int result = std::max(int(ceilf((max - min)/tile_size)), 1);
+
+        while (result > 1 && seam_coord(min, max, tile_size, result - 1) >= max)
+        {
+            --result;
+        }
+
+        return result;
+    }
+
+    Bbox2 tile_rect(const Tiled_Build& build, int col, int row)
+    {
+        const Bbox2& world = build.params->bounds;
+        const float tile_size = build.params->tile_size;
+        Bbox2 result;
+        result.min[0] = seam_coord(world.min[0], world.max[0], tile_size, col);
+        result.min[1] = seam_coord(world.min[1], world.max[1], tile_size, row);
+        result.max[0] = seam_coord(world.min[0], world.max[0], tile_size, col + 1);
+        result.max[1] = seam_coord(world.min[1], world.max[1], tile_size, row + 1);
+        return result;
+    }
+
+    // tile range overlapped by the rectangle.
+    void tile_range(const Tiled_Build& build, float min_x, float min_y, float max_x, float max_y, int range[4])
+    {
+        const Bbox2& world = build.params->bounds;
+        const float tile_size = build.params->tile_size;
+        range[0] = std::max(int(floorf((min_x - world.min[0])/tile_size)), 0);
+        range[1] = std::max(int(floorf((min_y - world.min[1])/tile_size)), 0);
+        range[2] = std::min(int(floorf((max_x - world.min[0])/tile_size)), build.num_cols - 1);
+        range[3] = std::min(int(floorf((max_y - world.min[1])/tile_size)), build.num_rows - 1);
+    }
+
+    // counts (tile_polys is null) or stores polygons overlapping each tile expanded by its overlap.
+    void bin_polys(const Tiled_Build& build, int* tile_counts, int* tile_polys)
+    {
+        const Footprint& footprint = *build.footprint;
+        const int num_tiles = build.num_cols*build.num_rows;
+
+        float overlap = 0.f;
+
+        for (int i = 0; i < num_tiles; ++i)
+        {
+            overlap = std::max(overlap, build.tile_overlaps[i]);
+        }
+
+        for (int poly = 0; poly < footprint.num_polys; ++poly)
+        {
+            const int first_vert = build.poly_offsets[poly];
+            const int last_vert = build.poly_offsets[poly + 1];
+
+            float min_x = footprint.x[first_vert];
+            float min_y = footprint.y[first_vert];
+            float max_x = min_x;
+            float max_y = min_y;
+
+            for (int i = first_vert + 1; i < last_vert; ++i)
+            {
+                min_x = std::min(min_x, footprint.x[i]);
+                min_y = std::min(min_y, footprint.y[i]);
+                max_x = std::max(max_x, footprint.x[i]);
+                max_y = std::max(max_y, footprint.y[i]);
+            }
+
+            int range[4];
+            tile_range(build, min_x - overlap, min_y - overlap, max_x + overlap, max_y + overlap, range);
+
+            for (int row = range[1]; row <= range[3]; ++row)
+            {
+                for (int col = range[0]; col <= range[2]; ++col)
+                {
+                    const int tile = row*build.num_cols + col;
+                    const Bbox2 rect = tile_rect(build, col, row);
+                    const float tile_overlap = build.tile_overlaps[tile];
+
+                    if (min_x > rect.max[0] + tile_overlap || max_x < rect.min[0] - tile_overlap ||
+                        min_y > rect.max[1] + tile_overlap || max_y < rect.min[1] - tile_overlap)
+                    {
+                        continue;
+                    }
+
+                    if (tile_polys)
+                    {
+                        tile_polys[tile_counts[tile]] = poly;
+                    }
+
+                    tile_counts[tile]++;
+                }
+            }
+        }
+    }
+
+    void build_tile(void* context, int pass_index)
+    {
+        Tiled_Build* build = static_cast<Tiled_Build*>(context);
+        const Footprint& footprint = *build->footprint;
+        const Tiled_Build_Params& params = *build->params;
+        const int index = build->pass_tiles[pass_index];
+        const float overlap = build->tile_overlaps[index];
+
+        const int first_poly = build->tile_poly_offsets[index];
+        const int last_poly = build->tile_poly_offsets[index + 1];
+
+        // empty tiles are skipped, seam vertices of the neighbours are left unmatched until the overlap grows.
+        if (first_poly == last_poly)
+        {
+            return;
+        }
+
+        // at most num_threads jobs run at the same time, so a free worker is always found.
+        int worker_index = 0;
+
+        for (;; worker_index = (worker_index + 1) % build->num_workers)
+        {
+            unsigned char expected = 0;
+
+            if (build->busy[worker_index].compare_exchange_strong(expected, 1, std::memory_order_acquire))
+            {
+                break;
+            }
+        }
+
+        Tile_Worker& worker = build->workers[worker_index];
+        Memory* mem = build->memory;
+
+        int num_verts = 0;
+
+        for (int i = first_poly; i < last_poly; ++i)
+        {
+            const int poly = build->tile_polys[i];
+            num_verts += build->poly_offsets[poly + 1] - build->poly_offsets[poly];
+        }
+
+        Alloc_Scope<float> x(mem, num_verts);
+        Alloc_Scope<float> y(mem, num_verts);
+        Alloc_Scope<int> num_poly_verts(mem, last_poly - first_poly);
+
+        Footprint tile_footprint;
+        tile_footprint.num_polys = last_poly - first_poly;
+        tile_footprint.num_verts = num_verts;
+        tile_footprint.x = x;
+        tile_footprint.y = y;
+        tile_footprint.num_poly_verts = num_poly_verts;
+
+        for (int i = first_poly, offset = 0; i < last_poly; ++i)
+        {
+            const int poly = build->tile_polys[i];
+            const int first_vert = build->poly_offsets[poly];
+            const int count = build->poly_offsets[poly + 1] - first_vert;
+            memcpy(tile_footprint.x + offset, footprint.x + first_vert, count*sizeof(float));
+            memcpy(tile_footprint.y + offset, footprint.y + first_vert, count*sizeof(float));
+            tile_footprint.num_poly_verts[i - first_poly] = count;
+            offset += count;
+        }
+
+        const int col = index % build->num_cols;
+        const int row = index / build->num_cols;
+        const Bbox2 rect = tile_rect(*build, col, row);
+
+        // tile expanded by the overlap and clipped to the world, extended to whole cells.
+        Bbox2 bounds;
+        bounds.min[0] = std::max(rect.min[0] - overlap, params.bounds.min[0]);
+        bounds.min[1] = std::max(rect.min[1] - overlap, params.bounds.min[1]);
+        bounds.max[0] = std::min(rect.max[0] + overlap, params.bounds.max[0]);
+        bounds.max[1] = std::min(rect.max[1] + overlap, params.bounds.max[1]);
+
+        Build_Params build_params;
+        memset(&build_params, 0, sizeof(build_params));
+        build_params.grid_width = std::max(int(ceilf((bounds.max[0] - bounds.min[0])/params.cell_size)), 1);
+        build_params.grid_height = std::max(int(ceilf((bounds.max[1] - bounds.min[1])/params.cell_size)), 1);
+        build_params.bounds = &bounds;
+
+        bounds.max[0] = bounds.min[0] + float(build_params.grid_width)*params.cell_size;
+        bounds.max[1] = bounds.min[1] + float(build_params.grid_height)*params.cell_size;
+
+        build_corridor_map(worker.ctx, tile_footprint, build_params, worker.space);
+
+        Alloc_Scope<int> vert_map(worker.ctx.scratch, worker.space.vertices.max_items);
+
+        Tile_Graph& graph = build->tiles[index];
+
+        Tile_Clip clip;
+        clip.graph = &graph;
+        clip.rect = rect;
+        clip.col = col;
+        clip.row = row;
+        clip.vert_map = vert_map;
+
+        // count, then store.
+        clip_walkable_space(worker.space, clip);
+        allocate_tile_graph(mem, graph);
+        clip_walkable_space(worker.space, clip);
+
+        build->busy[worker_index].store(0, std::memory_order_release);
+    }
+
+    // Vertex created where an edge crosses a seam.
+    struct Seam_Vertex
+    {
+        // seam line.
+        int line;
+        // coordinate along the line.
+        float coord;
+        // 0 if the tile is before the line, 1 after.
+        int side;
+        // tile the vertex was clipped by.
+        int tile;
+        // index in the concatenated tile vertices.
+        int vertex;
+    };
+
+    inline bool operator<(const Seam_Vertex& a, const Seam_Vertex& b)
+    {
+        if (a.line != b.line) return a.line < b.line;
+        if (a.coord != b.coord) return a.coord < b.coord;
+        return a.vertex < b.vertex;
+    }
+
+    // offsets of the tile vertices in the concatenated vertex array, returns the total.
+    int tile_vertex_offsets(const Tiled_Build& build, int* vert_offsets)
+    {
+        const int num_tiles = build.num_cols*build.num_rows;
+        int num_verts = 0;
+
+        for (int i = 0; i < num_tiles; ++i)
+        {
+            vert_offsets[i] = num_verts;
+            num_verts += build.tiles[i].num_verts;
+        }
+
+        vert_offsets[num_tiles] = num_verts;
+        return num_verts;
+    }
+
+    // pairs seam vertices of the neighbour tiles within tolerance, partner is -1 for vertices left without a pair.
+    // when grow is not null, the tiles on both sides of the seam of an unmatched vertex are marked in it.
+    // returns the number of unmatched seam vertices.
+    int match_seams(Memory* memory, const Tiled_Build& build, float tolerance, const int* vert_offsets, int* partner, unsigned char* grow)
+    {
+        const int num_tiles = build.num_cols*build.num_rows;
+        int num_seam_verts = 0;
+
+        for (int i = 0; i < num_tiles; ++i)
+        {
+            const Tile_Graph& graph = build.tiles[i];
+
+            for (int j = 0; j < graph.num_verts; ++j)
+            {
+                num_seam_verts += (graph.vert_seam[j] >= 0) ? 1 : 0;
+            }
+        }
+
+        Alloc_Scope<Seam_Vertex> seam_verts(memory, std::max(num_seam_verts, 1));
+
+        for (int i = 0, count = 0; i < num_tiles; ++i)
+        {
+            const Tile_Graph& graph = build.tiles[i];
+            const int col = i % build.num_cols;
+            const int row = i / build.num_cols;
+
+            for (int j = 0; j < graph.num_verts; ++j)
+            {
+                const int line = graph.vert_seam[j];
+
+                if (line < 0)
+                {
+                    continue;
+                }
+
+                Seam_Vertex& s = seam_verts[count++];
+                s.line = line;
+                s.coord = (line & 1) ? graph.vert_pos[j].x : graph.vert_pos[j].y;
+                s.side = (line >> 1) == ((line & 1) ? row : col) ? 1 : 0;
+                s.tile = i;
+                s.vertex = vert_offsets[i] + j;
+            }
+        }
+
+        std::sort(seam_verts.data, seam_verts.data + num_seam_verts);
+
+        for (int i = 0; i < vert_offsets[num_tiles]; ++i)
+        {
+            partner[i] = -1;
+        }
+
+        int num_pairs = 0;
+
+        for (int i = 0; i + 1 < num_seam_verts; ++i)
+        {
+            const Seam_Vertex& a = seam_verts[i];
+            const Seam_Vertex& b = seam_verts[i + 1];
+
+            if (a.line == b.line && a.side != b.side && b.coord - a.coord <= tolerance)
+            {
+                partner[a.vertex] = b.vertex;
+                partner[b.vertex] = a.vertex;
+                ++num_pairs;
+                ++i;
+            }
+        }
+
+        if (grow)
+        {
+            for (int i = 0; i < num_seam_verts; ++i)
+            {
+                const Seam_Vertex& s = seam_verts[i];
+
+                if (partner[s.vertex] >= 0)
+                {
+                    continue;
+                }
+
+                // the neighbour is the previous column or row for the tile after the line, the next one otherwise.
+                const int step = (s.line & 1) ? build.num_cols : 1;
+                const int neighbour = s.side ? s.tile - step : s.tile + step;
+
+                grow[s.tile] = 1;
+                grow[neighbour] = 1;
+            }
+        }
+
+        return num_seam_verts - 2*num_pairs;
+    }
+
+    // joins the tile graphs, seam vertices of the neighbour tiles within tolerance are merged.
+    Walkable_Space stitch_tiles(Memory* memory, const Tiled_Build& build, float tolerance)
+    {
+        corridormap_build_scope(build_stage_stitch_tiles);
+
+        const int num_tiles = build.num_cols*build.num_rows;
+
+        Alloc_Scope<int> vert_offsets(memory, num_tiles + 1);
+        const int num_verts = tile_vertex_offsets(build, vert_offsets);
+        int num_edges = 0;
+        int num_events = 0;
+        int num_seam_verts = 0;
+
+        for (int tile = 0; tile < num_tiles; ++tile)
+        {
+            const Tile_Graph& graph = build.tiles[tile];
+            num_edges += graph.num_edges;
+            num_events += graph.num_events;
+
+            for (int i = 0; i < graph.num_verts; ++i)
+            {
+                num_seam_verts += (graph.vert_seam[i] >= 0) ? 1 : 0;
+            }
+        }
+
+        Alloc_Scope<int> partner(memory, std::max(num_verts, 1));
+        Alloc_Scope<int> vert_map(memory, std::max(num_verts, 1));
+
+        const int num_unmatched = match_seams(memory, build, tolerance, vert_offsets, partner, 0);
+
+        corridormap_build_count(num_seam_verts, num_seam_verts);
+        corridormap_build_count(num_unmatched_seam_verts, num_unmatched);
+        // overlaps grow until the seams match, a seam left unmatched with the overlaps covering the world is a dead end in the graph.
+        corridormap_assert(num_unmatched == 0);
+
+        for (int i = 0; i < num_verts; ++i)
+        {
+            vert_map[i] = -1;
+        }
+
+        // stitched vertex ids, the vertices of a pair share one id.
+        int num_stitched = 0;
+
+        for (int i = 0; i < num_verts; ++i)
+        {
+            if (vert_map[i] < 0)
+            {
+                vert_map[i] = num_stitched;
+
+                if (partner[i] >= 0)
+                {
+                    vert_map[partner[i]] = num_stitched;
+                }
+
+                ++num_stitched;
+            }
+        }
+
+        Walkable_Space out = create_walkable_space(memory, std::max(num_stitched, 1), std::max(num_edges, 1), std::max(num_events, 1));
+
+        for (int tile = 0; tile < num_tiles; ++tile)
+        {
+            const Tile_Graph& graph = build.tiles[tile];
+
+            for (int i = 0; i < graph.num_verts; ++i)
+            {
+                const int vertex = vert_offsets[tile] + i;
+                const int p = partner[vertex];
+
+                // the pair is created once, by the vertex seen first.
+                if (p >= 0 && p < vertex)
+                {
+                    continue;
+                }
+
+                Vec2 pos = graph.vert_pos[i];
+
+                // partner vertex is on the same line, merged vertex is placed in the middle.
+                if (p >= 0)
+                {
+                    const int* partner_tile = std::upper_bound(vert_offsets.data, vert_offsets.data + num_tiles + 1, p) - 1;
+                    const Tile_Graph& partner_graph = build.tiles[partner_tile - vert_offsets.data];
+                    pos = (pos + partner_graph.vert_pos[p - *partner_tile])*0.5f;
+                }
+
+                create_vertex(out, pos);
+            }
+        }
+
+        for (int tile = 0; tile < num_tiles; ++tile)
+        {
+            const Tile_Graph& graph = build.tiles[tile];
+
+            for (int i = 0; i < graph.num_edges; ++i)
+            {
+                const int u = vert_map[vert_offsets[tile] + graph.edge_u[i]];
+                const int v = vert_map[vert_offsets[tile] + graph.edge_v[i]];
+
+                Edge* e = create_edge(out, u, v);
+                const int out_edge = int(e - out.edges.items);
+
+                e->dir[0].sides[0] = graph.edge_sides_v[i*2 + 0];
+                e->dir[0].sides[1] = graph.edge_sides_v[i*2 + 1];
+                e->dir[1].sides[0] = graph.edge_sides_u[i*2 + 1];
+                e->dir[1].sides[1] = graph.edge_sides_u[i*2 + 0];
+
+                for (int j = graph.edge_events[i]; j < graph.edge_events[i + 1]; ++j)
+                {
+                    Event* evt = create_event(out, graph.event_pos[j], out_edge);
+                    evt->sides[0] = graph.event_sides[j*2 + 0];
+                    evt->sides[1] = graph.event_sides[j*2 + 1];
+                }
+            }
+        }
+
+        return out;
+    }
+
+    // tiles with unmatched seam vertices and their neighbours across the seam get a doubled overlap.
+    // returns the number of tiles to rebuild, stored in pass_tiles.
+    int grow_unmatched_tiles(Memory* memory, Tiled_Build& build, float tolerance, float max_overlap, int* pass_tiles)
+    {
+        const int num_tiles = build.num_cols*build.num_rows;
+
+        Alloc_Scope<int> vert_offsets(memory, num_tiles + 1);
+        const int num_verts = tile_vertex_offsets(build, vert_offsets);
+        Alloc_Scope<int> partner(memory, std::max(num_verts, 1));
+        Alloc_Scope<unsigned char> grow(memory, num_tiles);
+        zero_mem(grow);
+
+        if (match_seams(memory, build, tolerance, vert_offsets, partner, grow) == 0)
+        {
+            return 0;
+        }
+
+        int num_pass_tiles = 0;
+
+        for (int i = 0; i < num_tiles; ++i)
+        {
+            // a tile with the overlap covering the world has nothing more to see.
+            if (grow[i] && build.tile_overlaps[i] < max_overlap)
+            {
+                build.tile_overlaps[i] = std::min(2.f*build.tile_overlaps[i], max_overlap);
+                pass_tiles[num_pass_tiles++] = i;
+            }
+        }
+
+        return num_pass_tiles;
+    }
+
+    // bins polygons by the current tile overlaps.
+    void bin_tile_polys(Tiled_Build& build, int* tile_poly_offsets, int* tile_polys)
+    {
+        const int num_tiles = build.num_cols*build.num_rows;
+
+        if (!tile_polys)
+        {
+            for (int i = 0; i <= num_tiles; ++i)
+            {
+                tile_poly_offsets[i] = 0;
+            }
+
+            bin_polys(build, tile_poly_offsets + 1, 0);
+
+            for (int i = 0; i < num_tiles; ++i)
+            {
+                tile_poly_offsets[i + 1] += tile_poly_offsets[i];
+            }
+
+            return;
+        }
+
+        // cursors are kept in the offsets shifted by one, after the store they are the offsets again.
+        for (int i = num_tiles; i > 0; --i)
+        {
+            tile_poly_offsets[i] = tile_poly_offsets[i - 1];
+        }
+
+        bin_polys(build, tile_poly_offsets + 1, tile_polys);
+        tile_poly_offsets[0] = 0;
+    }
+}
+
+Walkable_Space build_tiled_corridor_map(Memory* memory, const Footprint& footprint, const Tiled_Build_Params& params)
+{
+    // seam vertices of the neighbour tiles are matched within a few cells.
+    const float seam_tolerance = 4.f*params.cell_size;
+
+    corridormap_assert(params.tile_size > 0.f && params.cell_size > 0.f);
+    // the medial axis doesn't cross a seam with a smaller overlap, as the tile sides are obstacles.
+    corridormap_assert(params.overlap > seam_tolerance);
+
+    const Bbox2& world = params.bounds;
+
+    // with this overlap a tile is built with all of the world's obstacles.
+    const float max_overlap = std::max(std::max(world.max[0] - world.min[0], world.max[1] - world.min[1]), params.overlap);
+
+    Tiled_Build build;
+    build.footprint = &footprint;
+    build.params = &params;
+    build.num_cols = num_tiles_along(world.min[0], world.max[0], params.tile_size);
+    build.num_rows = num_tiles_along(world.min[1], world.max[1], params.tile_size);
+
+    const int num_tiles = build.num_cols*build.num_rows;
+
+    Alloc_Scope<int> poly_offsets(memory, footprint.num_polys + 1);
+    poly_offsets[0] = 0;
+
+    for (int i = 0; i < footprint.num_polys; ++i)
+    {
+        poly_offsets[i + 1] = poly_offsets[i] + footprint.num_poly_verts[i];
+    }
+
+    build.poly_offsets = poly_offsets;
+
+    Alloc_Scope<float> tile_overlaps(memory, num_tiles);
+    Alloc_Scope<int> tile_poly_offsets(memory, num_tiles + 1);
+    Alloc_Scope<int> pass_tiles(memory, num_tiles);
+
+    for (int i = 0; i < num_tiles; ++i)
+    {
+        tile_overlaps[i] = params.overlap;
+        pass_tiles[i] = i;
+    }
+
+    build.tile_overlaps = tile_overlaps;
+    build.tile_poly_offsets = tile_poly_offsets;
+    build.pass_tiles = pass_tiles;
+
+    Memory_Locked locked(memory);
+    build.memory = &locked;
+
+    build.num_workers = num_threads(params.scheduler);
+
+    Alloc_Scope<Tile_Worker> workers(memory, build.num_workers);
+    Alloc_Scope<std::atomic<unsigned char> > busy(memory, build.num_workers);
+
+    for (int i = 0; i < build.num_workers; ++i)
+    {
+        new (&busy[i]) std::atomic<unsigned char>(0);
+        workers[i].ctx = create_build_context(&locked);
+        memset(&workers[i].space, 0, sizeof(workers[i].space));
+    }
+
+    Alloc_Scope<Tile_Graph> tiles(memory, num_tiles);
+    zero_mem(tiles);
+
+    build.workers = workers;
+    build.busy = busy;
+    build.tiles = tiles;
+
+    // tiles with seam vertices left without a pair are rebuilt with a doubled overlap,
+    // until every seam matches or the overlaps cover the world.
+    for (int num_pass_tiles = num_tiles; num_pass_tiles > 0;)
+    {
+        for (int i = 0; i < num_pass_tiles; ++i)
+        {
+            Tile_Graph& graph = tiles[pass_tiles[i]];
+
+            if (graph.edge_events)
+            {
+                deallocate_tile_graph(memory, graph);
+            }
+
+            memset(&graph, 0, sizeof(graph));
+        }
+
+        bin_tile_polys(build, tile_poly_offsets, 0);
+        Alloc_Scope<int> tile_polys(memory, std::max(tile_poly_offsets[num_tiles], 1));
+        bin_tile_polys(build, tile_poly_offsets, tile_polys);
+        build.tile_polys = tile_polys;
+
+        parallel_for(params.scheduler, build_tile, &build, num_pass_tiles);
+
+        num_pass_tiles = grow_unmatched_tiles(memory, build, seam_tolerance, max_overlap, pass_tiles);
+    }
+
+    for (int i = 0; i < build.num_workers; ++i)
+    {
+        destroy(&locked, workers[i].space);
+        destroy(workers[i].ctx);
+    }
+
+    Walkable_Space result = stitch_tiles(memory, build, seam_tolerance);
+
+    for (int i = 0; i < num_tiles; ++i)
+    {
+        if (tiles[i].edge_events)
+        {
+            deallocate_tile_graph(memory, tiles[i]);
+        }
+    }
+
+    return result;
+}
+
+}
@@ -21,195 +21,138 @@
 
 namespace corridormap {
 
-const char* kernel_compaction_reduce_source = \
+const char* kernel_compaction_fused_source = \
 
-"const sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE|CLK_ADDRESS_CLAMP_TO_EDGE|CLK_FILTER_NEAREST;                        \n"
-"                                                                                                                           \n"
-"inline uint value1d(read_only image2d_t img, uint idx)                                                                     \n"
-"{                                                                                                                          \n"
-"    size_t w = get_image_width(img);                                                                                       \n"
-"    int2 uv = (int2)(idx % w, idx / w);                                                                                    \n"
-"    return read_imageui(img, sampler, uv).s0 > 0 ? 1 : 0;                                                                  \n"
-"}                                                                                                                          \n"
-"                                                                                                                           \n"
-"#define WARP_SIZE 32                                                                                                       \n"
-"                                                                                                                           \n"
-"inline uint scan_warp(local uint* data, uint lane)                                                                         \n"
-"{                                                                                                                          \n"
-"    for (uint offset = 1; offset <= WARP_SIZE >> 1; offset <<= 1)                                                          \n"
-"    {                                                                                                                      \n"
-"        data[lane] += data[lane - offset];                                                                                 \n"
-"        barrier(CLK_LOCAL_MEM_FENCE);                                                                                      \n"
-"    }                                                                                                                      \n"
-"                                                                                                                           \n"
-"    return data[lane];                                                                                                     \n"
-"}                                                                                                                          \n"
-"                                                                                                                           \n"
-"kernel void run(read_only image2d_t image, global uint* global_sums, local uint* block_data, const uint pixel_count)       \n"
-"{                                                                                                                          \n"
-"    size_t gid = get_global_id(0);                                                                                         \n"
-"    size_t lid = get_local_id(0);                                                                                          \n"
-"    size_t gwid = gid / WARP_SIZE;                                                                                         \n"
-"    size_t lwid = lid / WARP_SIZE;                                                                                         \n"
-"    size_t lane = lid & (WARP_SIZE - 1);                                                                                   \n"
-"    size_t block_size = get_local_size(0);                                                                                 \n"
-"    size_t elements_per_warp = pixel_count / (2 * block_size);                                                             \n"
-"                                                                                                                           \n"
-"    uint global_base = gwid * elements_per_warp;                                                                           \n"
-"    local uint* warp_data = block_data + lwid * WARP_SIZE * 2;                                                             \n"
-"                                                                                                                           \n"
-"    uint sum = 0;                                                                                                          \n"
-"                                                                                                                           \n"
-"    for (uint i = 0; i < elements_per_warp; i += WARP_SIZE)                                                                \n"
-"    {                                                                                                                      \n"
-"        sum += value1d(image, global_base + i + lane);                                                                     \n"
-"    }                                                                                                                      \n"
-"                                                                                                                           \n"
-"    warp_data[lane] = 0;                                                                                                   \n"
-"    warp_data[lane+WARP_SIZE] = sum;                                                                                       \n"
-"                                                                                                                           \n"
-"    barrier(CLK_LOCAL_MEM_FENCE);                                                                                          \n"
-"                                                                                                                           \n"
-"    sum = scan_warp(warp_data, lane + WARP_SIZE);                                                                          \n"
-"                                                                                                                           \n"
-"    if (lane == WARP_SIZE-1)                                                                                               \n"
-"    {                                                                                                                      \n"
-"        global_sums[gwid] = sum;                                                                                           \n"
-"    }                                                                                                                      \n"
-"}                                                                                                                          \n";
-
-const char* kernel_compaction_scan_partials_source = \
-
-"uint scan_block(local uint* data, uint n, int lid, int block_size)                                                         \n"
-"{                                                                                                                          \n"
-"    uint sum = 0;                                                                                                          \n"
-"                                                                                                                           \n"
-"    int offset = 1;                                                                                                        \n"
-"                                                                                                                           \n"
-"    for (int level=n>>1; level>0; level>>=1, offset<<=1)                                                                   \n"
-"    {                                                                                                                      \n"
-"        barrier(CLK_LOCAL_MEM_FENCE);                                                                                      \n"
-"                                                                                                                           \n"
-"        if (lid < level)                                                                                                   \n"
-"        {                                                                                                                  \n"
-"            int ai = offset*(2*lid+1)-1;                                                                                   \n"
-"            int bi = offset*(2*lid+2)-1;                                                                                   \n"
-"            data[bi] += data[ai];                                                                                          \n"
-"        }                                                                                                                  \n"
-"    }                                                                                                                      \n"
-"                                                                                                                           \n"
-"    barrier(CLK_LOCAL_MEM_FENCE);                                                                                          \n"
-"                                                                                                                           \n"
-"    if (lid == 0)                                                                                                          \n"
-"    {                                                                                                                      \n"
-"        sum = data[n-1];                                                                                                   \n"
-"        data[n-1] = 0;                                                                                                     \n"
-"    }                                                                                                                      \n"
-"                                                                                                                           \n"
-"    barrier(CLK_LOCAL_MEM_FENCE);                                                                                          \n"
-"                                                                                                                           \n"
-"    offset >>= 1;                                                                                                          \n"
-"                                                                                                                           \n"
-"    for(int level=1; level<n; level<<=1, offset>>=1)                                                                       \n"
-"    {                                                                                                                      \n"
-"        barrier(CLK_LOCAL_MEM_FENCE);                                                                                      \n"
-"                                                                                                                           \n"
-"        if (lid < level)                                                                                                   \n"
-"        {                                                                                                                  \n"
-"            int ai = offset*(2*lid+1)-1;                                                                                   \n"
-"            int bi = offset*(2*lid+2)-1;                                                                                   \n"
-"                                                                                                                           \n"
-"            uint temp = data[ai];                                                                                          \n"
-"            data[ai] = data[bi];                                                                                           \n"
-"            data[bi] += temp;                                                                                              \n"
-"        }                                                                                                                  \n"
-"    }                                                                                                                      \n"
-"                                                                                                                           \n"
-"    barrier(CLK_LOCAL_MEM_FENCE);                                                                                          \n"
-"                                                                                                                           \n"
-"    return sum;                                                                                                            \n"
-"}                                                                                                                          \n"
-"                                                                                                                           \n"
-"kernel void run(global uint* sums, global uint* offsets, local uint* block_data)                                           \n"
-"{                                                                                                                          \n"
-"    size_t lid = get_local_id(0);                                                                                          \n"
-"    size_t block_size = get_local_size(0);                                                                                 \n"
-"                                                                                                                           \n"
-"    block_data[lid + 0] = sums[lid + 0];                                                                                   \n"
-"    block_data[lid + block_size] = sums[lid + block_size];                                                                 \n"
-"                                                                                                                           \n"
-"    uint sum = scan_block(block_data, block_size*2, lid, block_size);                                                      \n"
-"                                                                                                                           \n"
-"    offsets[lid + 0] = block_data[lid + 0];                                                                                \n"
-"    offsets[lid + block_size] = block_data[lid + block_size];                                                              \n"
-"                                                                                                                           \n"
-"    if (lid == 0)                                                                                                          \n"
-"    {                                                                                                                      \n"
-"        offsets[2 * block_size] = sum;                                                                                     \n"
-"    }                                                                                                                      \n"
-"}                                                                                                                          \n";
-
-const char* kernel_compaction_output_source = \
-
-"const sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE|CLK_ADDRESS_CLAMP_TO_EDGE|CLK_FILTER_NEAREST;                                                                \n"
-"                                                                                                                                                                   \n"
-"inline uint value1d(read_only image2d_t img, uint idx)                                                                                                             \n"
-"{                                                                                                                                                                  \n"
-"    size_t w = get_image_width(img);                                                                                                                               \n"
-"    int2 uv = (int2)(idx % w, idx / w);                                                                                                                            \n"
-"    return read_imageui(img, sampler, uv).s0 > 0 ? 1 : 0;                                                                                                          \n"
-"}                                                                                                                                                                  \n"
-"                                                                                                                                                                   \n"
-"#define WARP_SIZE 32                                                                                                                                               \n"
-"                                                                                                                                                                   \n"
-"inline uint scan_warp(local uint* data, uint lane)                                                                                                                 \n"
-"{                                                                                                                                                                  \n"
-"    for (uint offset = 1; offset <= WARP_SIZE >> 1; offset <<= 1)                                                                                                  \n"
-"    {                                                                                                                                                              \n"
-"        data[lane] += data[lane - offset];                                                                                                                         \n"
-"        barrier(CLK_LOCAL_MEM_FENCE);                                                                                                                              \n"
-"    }                                                                                                                                                              \n"
-"                                                                                                                                                                   \n"
-"    return data[lane];                                                                                                                                             \n"
-"}                                                                                                                                                                  \n"
-"                                                                                                                                                                   \n"
-"kernel void run(read_only image2d_t image, global uint* compacted, global uint* sums, global uint* offsets, local uint* block_data, const uint pixel_count)        \n"
-"{                                                                                                                                                                  \n"
-"    size_t gid = get_global_id(0);                                                                                                                                 \n"
-"    size_t lid = get_local_id(0);                                                                                                                                  \n"
-"    size_t gwid = gid / WARP_SIZE;                                                                                                                                 \n"
-"    size_t lwid = lid / WARP_SIZE;                                                                                                                                 \n"
-"    size_t lane = lid & (WARP_SIZE - 1);                                                                                                                           \n"
-"    size_t block_size = get_local_size(0);                                                                                                                         \n"
-"    size_t elements_per_warp = pixel_count / (2 * block_size);                                                                                                     \n"
-"                                                                                                                                                                   \n"
-"    if (sums[gwid] > 0)                                                                                                                                            \n"
-"    {                                                                                                                                                              \n"
-"        uint global_offset = offsets[gwid];                                                                                                                        \n"
-"        uint local_offset = 0;                                                                                                                                     \n"
-"                                                                                                                                                                   \n"
-"        uint global_base = gwid * elements_per_warp;                                                                                                               \n"
-"        local uint* warp_data = block_data + lwid * WARP_SIZE * 2;                                                                                                 \n"
-"                                                                                                                                                                   \n"
-"        for (uint i = 0; i < elements_per_warp; i += WARP_SIZE)                                                                                                    \n"
-"        {                                                                                                                                                          \n"
-"            uint idx = global_base + i + lane;                                                                                                                     \n"
-"            uint val = value1d(image, idx);                                                                                                                        \n"
-"            warp_data[lane] = 0;                                                                                                                                   \n"
-"            warp_data[WARP_SIZE + lane] = val;                                                                                                                     \n"
-"            barrier(CLK_LOCAL_MEM_FENCE);                                                                                                                          \n"
-"            scan_warp(warp_data, lane + WARP_SIZE);                                                                                                                \n"
-"            uint lane_offset = warp_data[WARP_SIZE+lane-1];                                                                                                        \n"
-"                                                                                                                                                                   \n"
-"            if (val > 0)                                                                                                                                           \n"
-"            {                                                                                                                                                      \n"
-"                compacted[global_offset + local_offset + lane_offset] = idx;                                                                                       \n"
-"            }                                                                                                                                                      \n"
-"                                                                                                                                                                   \n"
-"            local_offset += warp_data[2*WARP_SIZE-1];                                                                                                              \n"
-"            barrier(CLK_LOCAL_MEM_FENCE);                                                                                                                          \n"
-"        }                                                                                                                                                          \n"
-"    }                                                                                                                                                              \n"
-"}                                                                                                                                                                  \n";
+"#define ITEMS_PER_THREAD 8                                                                                                       \n"
+"#define FLAG_AGGREGATE 0x40000000u                                                                                               \n"
+"#define FLAG_PREFIX    0x80000000u                                                                                               \n"
+"#define VALUE_MASK     0x3fffffffu                                                                                               \n"
+"                                                                                                                                 \n"
+"// exclusive prefix of the tile from published states of preceding tiles.                                                        \n"
+"inline uint look_back(global uint* state, uint tile_id)                                                                          \n"
+"{                                                                                                                                \n"
+"    uint prefix = 0;                                                                                                             \n"
+"    int i = (int)tile_id - 1;                                                                                                    \n"
+"    while (i >= 0)                                                                                                               \n"
+"    {                                                                                                                            \n"
+"        uint s = atomic_or(state + i, 0u);                                                                                       \n"
+"        if (s & FLAG_PREFIX)                                                                                                     \n"
+"        {                                                                                                                        \n"
+"            prefix += s & VALUE_MASK;                                                                                            \n"
+"            break;                                                                                                               \n"
+"        }                                                                                                                        \n"
+"        if (s & FLAG_AGGREGATE)                                                                                                  \n"
+"        {                                                                                                                        \n"
+"            prefix += s & VALUE_MASK;                                                                                            \n"
+"            --i;                                                                                                                 \n"
+"        }                                                                                                                        \n"
+"    }                                                                                                                            \n"
+"    return prefix;                                                                                                               \n"
+"}                                                                                                                                \n"
+"                                                                                                                                 \n"
+"// tile_state holds two sets of [tile counter, vertex states, edge states], parity selects the set used by this dispatch,        \n"
+"// the other one is cleared for the next dispatch. scan_data must hold 2*local_size + 3 elements.                                \n"
+"// marks hold bit 0 for vertices and bit 1 for edges, one byte per pixel.                                                        \n"
+"kernel void run(global const uchar* marks, global uint* vertices, global uint* edges,                                            \n"
+"                global uint* tile_state, global uint* counts,                                                                    \n"
+"                local uint* scan_data, const uint pixel_count, const uint parity)                                                \n"
+"{                                                                                                                                \n"
+"    size_t lid = get_local_id(0);                                                                                                \n"
+"    size_t block_size = get_local_size(0);                                                                                       \n"
+"    uint num_tiles = get_num_groups(0);                                                                                          \n"
+"                                                                                                                                 \n"
+"    global uint* set = tile_state + parity * (1 + 2 * num_tiles);                                                                \n"
+"    global uint* other = tile_state + (1 - parity) * (1 + 2 * num_tiles);                                                        \n"
+"    local uint* tile_data = scan_data + 2 * block_size;                                                                          \n"
+"                                                                                                                                 \n"
+"    // tiles are numbered in the order they start, so the ones looked back at are running or done.                               \n"
+"    if (lid == 0)                                                                                                                \n"
+"    {                                                                                                                            \n"
+"        tile_data[0] = atomic_inc(set);                                                                                          \n"
+"    }                                                                                                                            \n"
+"    barrier(CLK_LOCAL_MEM_FENCE);                                                                                                \n"
+"                                                                                                                                 \n"
+"    uint tile_id = tile_data[0];                                                                                                 \n"
+"    uint base = (tile_id * block_size + lid) * ITEMS_PER_THREAD;                                                                 \n"
+"                                                                                                                                 \n"
+"    uchar item_marks[ITEMS_PER_THREAD];                                                                                          \n"
+"    if (base + ITEMS_PER_THREAD <= pixel_count)                                                                                  \n"
+"    {                                                                                                                            \n"
+"        vstore8(vload8(0, marks + base), 0, item_marks);                                                                         \n"
+"    }                                                                                                                            \n"
+"    else                                                                                                                         \n"
+"    {                                                                                                                            \n"
+"        for (uint k = 0; k < ITEMS_PER_THREAD; ++k)                                                                              \n"
+"        {                                                                                                                        \n"
+"            item_marks[k] = (base + k < pixel_count) ? marks[base + k] : 0;                                                      \n"
+"        }                                                                                                                        \n"
+"    }                                                                                                                            \n"
+"                                                                                                                                 \n"
+"    uint2 count = (uint2)(0, 0);                                                                                                 \n"
+"    for (uint k = 0; k < ITEMS_PER_THREAD; ++k)                                                                                  \n"
+"    {                                                                                                                            \n"
+"        count.x += item_marks[k] & 1;                                                                                            \n"
+"        count.y += item_marks[k] >> 1;                                                                                           \n"
+"    }                                                                                                                            \n"
+"                                                                                                                                 \n"
+"    // inclusive scan of per item counts in the tile.                                                                            \n"
+"    scan_data[lid] = count.x;                                                                                                    \n"
+"    scan_data[block_size + lid] = count.y;                                                                                       \n"
+"    barrier(CLK_LOCAL_MEM_FENCE);                                                                                                \n"
+"    for (uint offset = 1; offset < block_size; offset <<= 1)                                                                     \n"
+"    {                                                                                                                            \n"
+"        uint v = (lid >= offset) ? scan_data[lid - offset] : 0;                                                                  \n"
+"        uint e = (lid >= offset) ? scan_data[block_size + lid - offset] : 0;                                                     \n"
+"        barrier(CLK_LOCAL_MEM_FENCE);                                                                                            \n"
+"        scan_data[lid] += v;                                                                                                     \n"
+"        scan_data[block_size + lid] += e;                                                                                        \n"
+"        barrier(CLK_LOCAL_MEM_FENCE);                                                                                            \n"
+"    }                                                                                                                            \n"
+"                                                                                                                                 \n"
+"    if (lid == 0)                                                                                                                \n"
+"    {                                                                                                                            \n"
+"        global uint* vertex_state = set + 1;                                                                                     \n"
+"        global uint* edge_state = set + 1 + num_tiles;                                                                           \n"
+"        uint2 aggregate = (uint2)(scan_data[block_size - 1], scan_data[2 * block_size - 1]);                                     \n"
+"        uint2 prefix = (uint2)(0, 0);                                                                                            \n"
+"        if (tile_id > 0)                                                                                                         \n"
+"        {                                                                                                                        \n"
+"            atomic_xchg(vertex_state + tile_id, FLAG_AGGREGATE | aggregate.x);                                                   \n"
+"            atomic_xchg(edge_state + tile_id, FLAG_AGGREGATE | aggregate.y);                                                     \n"
+"            prefix.x = look_back(vertex_state, tile_id);                                                                         \n"
+"            prefix.y = look_back(edge_state, tile_id);                                                                           \n"
+"        }                                                                                                                        \n"
+"        atomic_xchg(vertex_state + tile_id, FLAG_PREFIX | (prefix.x + aggregate.x));                                             \n"
+"        atomic_xchg(edge_state + tile_id, FLAG_PREFIX | (prefix.y + aggregate.y));                                               \n"
+"        if (tile_id == num_tiles - 1)                                                                                            \n"
+"        {                                                                                                                        \n"
+"            counts[0] = prefix.x + aggregate.x;                                                                                  \n"
+"            counts[1] = prefix.y + aggregate.y;                                                                                  \n"
+"        }                                                                                                                        \n"
+"        other[1 + tile_id] = 0;                                                                                                  \n"
+"        other[1 + num_tiles + tile_id] = 0;                                                                                      \n"
+"        if (tile_id == 0)                                                                                                        \n"
+"        {                                                                                                                        \n"
+"            other[0] = 0;                                                                                                        \n"
+"        }                                                                                                                        \n"
+"        tile_data[1] = prefix.x;                                                                                                 \n"
+"        tile_data[2] = prefix.y;                                                                                                 \n"
+"    }                                                                                                                            \n"
+"    barrier(CLK_LOCAL_MEM_FENCE);                                                                                                \n"
+"                                                                                                                                 \n"
+"    uint vertex_offset = tile_data[1] + scan_data[lid] - count.x;                                                                \n"
+"    uint edge_offset = tile_data[2] + scan_data[block_size + lid] - count.y;                                                     \n"
+"    for (uint k = 0; k < ITEMS_PER_THREAD; ++k)                                                                                  \n"
+"    {                                                                                                                            \n"
+"        if (item_marks[k] & 1)                                                                                                   \n"
+"        {                                                                                                                        \n"
+"            vertices[vertex_offset++] = base + k;                                                                                \n"
+"        }                                                                                                                        \n"
+"        if (item_marks[k] & 2)                                                                                                   \n"
+"        {                                                                                                                        \n"
+"            edges[edge_offset++] = base + k;                                                                                     \n"
+"        }                                                                                                                        \n"
+"    }                                                                                                                            \n"
+"}                                                                                                                                \n";
 
 }
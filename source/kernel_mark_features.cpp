@@ -27,16 +27,15 @@ const char* kernel_mark_features_source = \
 "                                                                                                       \n"
 "uint pack_color(float4 color)                                                                          \n"
 "{                                                                                                      \n"
-"    return (uint)(255.f * color.s0) << 24 |                                                            \n"
-"           (uint)(255.f * color.s1) << 16 |                                                            \n"
-"           (uint)(255.f * color.s2) << 8  |                                                            \n"
-"           (uint)(255.f * color.s3) << 0  ;                                                            \n"
+"    return (uint)(255.f * color.s0 + .5f) << 24 |                                                      \n"
+"           (uint)(255.f * color.s1 + .5f) << 16 |                                                      \n"
+"           (uint)(255.f * color.s2 + .5f) << 8  |                                                      \n"
+"           (uint)(255.f * color.s3 + .5f) << 0  ;                                                      \n"
 "}                                                                                                      \n"
 "                                                                                                       \n"
 "kernel void run(                                                                                       \n"
-"    read_only  image2d_t voronoi,                                                                      \n"
-"    write_only image2d_t vertex_marks,                                                                 \n"
-"    write_only image2d_t edge_marks)                                                                   \n"
+"    read_only image2d_t voronoi,                                                                       \n"
+"    global uchar*       marks)                                                                         \n"
 "{                                                                                                      \n"
 "    size_t gid0 = get_global_id(0);                                                                    \n"
 "    size_t gid1 = get_global_id(1);                                                                    \n"
@@ -59,20 +58,18 @@ const char* kernel_mark_features_source = \
 "    if (c == 0) { num_zero++; }                                                                        \n"
 "    if (d == 0) { num_zero++; }                                                                        \n"
 "                                                                                                       \n"
-"    uint4 vmark = (diff >  2) ?            (uint4)(1, 1, 1, 1) : (uint4)(0, 0, 0, 0);                  \n"
-"    uint4 emark = (diff - num_zero == 2) ? (uint4)(1, 1, 1, 1) : (uint4)(0, 0, 0, 0);                  \n"
+"    uchar vmark = (diff >  2) ?            1 : 0;                                                      \n"
+"    uchar emark = (diff - num_zero == 2) ? 2 : 0;                                                      \n"
 "                                                                                                       \n"
-"    write_imageui(vertex_marks, (int2)(gid0, gid1), vmark);                                            \n"
-"    write_imageui(edge_marks,   (int2)(gid0, gid1), emark);                                            \n"
+"    marks[gid1 * get_image_width(voronoi) + gid0] = vmark | emark;                                     \n"
 "}                                                                                                      \n";
 
 const char* kernel_mark_features_debug_source = \
 
-"const sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE|CLK_ADDRESS_CLAMP|CLK_FILTER_NEAREST;            \n"
-"                                                                                                       \n"
 "kernel void run(                                                                                       \n"
-"    read_only  image2d_t marks,                                                                        \n"
+"    global const uchar*  marks,                                                                        \n"
 "    write_only image2d_t voronoi,                                                                      \n"
+"    const uint mask,                                                                                   \n"
 "    const uint color,                                                                                  \n"
 "    const int  border,                                                                                 \n"
 "    const uint width,                                                                                  \n"
@@ -83,7 +80,7 @@ const char* kernel_mark_features_debug_source = \
 "                                                                                                       \n"
 "    int2 coords = (int2)(gid0, gid1);                                                                  \n"
 "                                                                                                       \n"
-"    uint m = read_imageui(marks, sampler, coords).s0;                                                  \n"
+"    uint m = marks[gid1 * width + gid0] & mask;                                                        \n"
 "                                                                                                       \n"
 "    float4 out_color;                                                                                  \n"
 "    out_color.s0 = (color & 0x00ff0000) / 255.0;                                                       \n"
@@ -27,16 +27,23 @@ const char* kernel_store_edge_obstacle_ids_source = \
 "                                                                                                        \n"
 "uint pack_color(float4 color)                                                                           \n"
 "{                                                                                                       \n"
-"    return (uint)(255.f * color.s0) << 24 |                                                             \n"
-"           (uint)(255.f * color.s1) << 16 |                                                             \n"
-"           (uint)(255.f * color.s2) << 8  |                                                             \n"
-"           (uint)(255.f * color.s3) << 0  ;                                                             \n"
+"    return (uint)(255.f * color.s0 + .5f) << 24 |                                                       \n"
+"           (uint)(255.f * color.s1 + .5f) << 16 |                                                       \n"
+"           (uint)(255.f * color.s2 + .5f) << 8  |                                                       \n"
+"           (uint)(255.f * color.s3 + .5f) << 0  ;                                                       \n"
 "}                                                                                                       \n"
 "                                                                                                        \n"
-"kernel void run(read_only image2d_t voronoi, read_only image2d_t edge_marks,                            \n"
-"                global uint* indices, global uint* side_1_ids, global uint* side_2_ids)                 \n"
+"kernel void run(read_only image2d_t voronoi,                                                            \n"
+"                global uint* indices, global uint* side_1_ids, global uint* side_2_ids,                 \n"
+"                global const uint* count, const uint count_offset)                                      \n"
 "{                                                                                                       \n"
 "    size_t gid = get_global_id(0);                                                                      \n"
+"                                                                                                        \n"
+"    if (gid >= count[count_offset])                                                                     \n"
+"    {                                                                                                   \n"
+"        return;                                                                                         \n"
+"    }                                                                                                   \n"
+"                                                                                                        \n"
 "    size_t width = get_image_width(voronoi);                                                            \n"
 "                                                                                                        \n"
 "    uint idx = indices[gid];                                                                            \n"
@@ -47,11 +54,6 @@ const char* kernel_store_edge_obstacle_ids_source = \
 "    uint c = pack_color(read_imagef(voronoi, sampler, uv + (int2)(-1, +0)));                            \n"
 "    uint d = pack_color(read_imagef(voronoi, sampler, uv + (int2)(+0, +0)));                            \n"
 "                                                                                                        \n"
-"    uint ma = read_imageui(edge_marks, sampler, uv + (int2)(-1, -1)).s0 > 0 ? 1 : 0;                    \n"
-"    uint mb = read_imageui(edge_marks, sampler, uv + (int2)(+0, -1)).s0 > 0 ? 1 : 0;                    \n"
-"    uint mc = read_imageui(edge_marks, sampler, uv + (int2)(-1, +0)).s0 > 0 ? 1 : 0;                    \n"
-"    uint md = read_imageui(edge_marks, sampler, uv + (int2)(+0, +0)).s0 > 0 ? 1 : 0;                    \n"
-"                                                                                                        \n"
 "    side_1_ids[gid] = a;                                                                                \n"
 "    side_2_ids[gid] = (a != b) ? b : ((a != c) ? c : d);                                                \n"
 "}                                                                                                       \n";
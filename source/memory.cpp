@@ -68,4 +68,219 @@ void Memory_Malloc::deallocate(void* ptr)
     free(p);
 }
 
+struct Memory_Block
+{
+    // next block in the chain.
+    Memory_Block* next;
+    // usable size in bytes (excluding the header).
+    size_t size;
+    // bytes used from the beginning of the block.
+    size_t used;
+};
+
+namespace
+{
+    enum { block_header_size = (sizeof(Memory_Block) + 15) & ~15 };
+
+    char* block_data(Memory_Block* block)
+    {
+        return reinterpret_cast<char*>(block) + block_header_size;
+    }
+
+    // tries to fit an allocation with the prefix of prefix_size bytes into the block. returns aligned data pointer or null.
+    char* block_fit(Memory_Block* block, size_t size, size_t align, size_t prefix_size)
+    {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block_data(block));
+        uintptr_t data = (base + block->used + prefix_size + (align - 1)) & ~uintptr_t(align - 1);
+
+        if (data + size > base + block->size)
+        {
+            return 0;
+        }
+
+        return reinterpret_cast<char*>(data);
+    }
+
+    // finds the first block after current which fits the allocation, appending a new block from parent if needed.
+    Memory_Block* next_block(Memory* parent, Memory_Block* current, size_t block_size, size_t size, size_t align, size_t prefix_size)
+    {
+        Memory_Block* last = current;
+
+        for (Memory_Block* block = current->next; block != 0; block = block->next)
+        {
+            block->used = 0;
+
+            if (block_fit(block, size, align, prefix_size))
+            {
+                return block;
+            }
+
+            last = block;
+        }
+
+        size_t required = prefix_size + align + size;
+        size_t new_size = required > block_size ? required : block_size;
+        Memory_Block* block = static_cast<Memory_Block*>(parent->allocate(block_header_size + new_size, 16));
+        corridormap_assert(block);
+        block->next = last->next;
+        block->size = new_size;
+        block->used = 0;
+        last->next = block;
+        return block;
+    }
+
+    Memory_Block* create_block(Memory* parent, size_t size)
+    {
+        Memory_Block* block = static_cast<Memory_Block*>(parent->allocate(block_header_size + size, 16));
+        corridormap_assert(block);
+        block->next = 0;
+        block->size = size;
+        block->used = 0;
+        return block;
+    }
+
+    void destroy_blocks(Memory* parent, Memory_Block* first)
+    {
+        while (first)
+        {
+            Memory_Block* next = first->next;
+            parent->deallocate(first);
+            first = next;
+        }
+    }
+
+    // precedes each stack allocation.
+    struct Stack_Header
+    {
+        // header of the previous allocation.
+        Stack_Header* prev;
+        // block and its used size before this allocation.
+        Memory_Block* block;
+        size_t used;
+        // set when deallocated out of order.
+        size_t freed;
+    };
+}
+
+Memory_Arena::Memory_Arena(Memory* parent, size_t block_size)
+    : _parent(parent)
+    , _block_size(block_size)
+{
+    _first = create_block(parent, block_size);
+    _current = _first;
+}
+
+Memory_Arena::~Memory_Arena()
+{
+    destroy_blocks(_parent, _first);
+}
+
+void* Memory_Arena::allocate(size_t size, size_t align)
+{
+    align = align < sizeof(uint32_t) ? sizeof(uint32_t) : align;
+    char* data = block_fit(_current, size, align, 0);
+
+    if (!data)
+    {
+        _current = next_block(_parent, _current, _block_size, size, align, 0);
+        data = block_fit(_current, size, align, 0);
+    }
+
+    _current->used = size_t(data + size - block_data(_current));
+    return data;
+}
+
+void Memory_Arena::deallocate(void*)
+{
+}
+
+void Memory_Arena::reset()
+{
+    _current = _first;
+    _current->used = 0;
+}
+
+Memory_Stack::Memory_Stack(Memory* parent, size_t block_size)
+    : _parent(parent)
+    , _block_size(block_size)
+    , _top(0)
+{
+    _first = create_block(parent, block_size);
+    _current = _first;
+}
+
+Memory_Stack::~Memory_Stack()
+{
+    destroy_blocks(_parent, _first);
+}
+
+void* Memory_Stack::allocate(size_t size, size_t align)
+{
+    align = align < sizeof(Stack_Header*) ? sizeof(Stack_Header*) : align;
+    Memory_Block* block = _current;
+    char* data = block_fit(block, size, align, sizeof(Stack_Header));
+
+    if (!data)
+    {
+        block = next_block(_parent, _current, _block_size, size, align, sizeof(Stack_Header));
+        data = block_fit(block, size, align, sizeof(Stack_Header));
+    }
+
+    // header remembers the state before this allocation.
+    Stack_Header* header = reinterpret_cast<Stack_Header*>(data) - 1;
+    header->prev = static_cast<Stack_Header*>(_top);
+    header->block = _current;
+    header->used = _current->used;
+    header->freed = 0;
+
+    block->used = size_t(data + size - block_data(block));
+    _current = block;
+    _top = header;
+    return data;
+}
+
+void Memory_Stack::deallocate(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    Stack_Header* header = static_cast<Stack_Header*>(ptr) - 1;
+    corridormap_assert(!header->freed);
+    header->freed = 1;
+
+    // pop all freed allocations from the top.
+    while (_top && static_cast<Stack_Header*>(_top)->freed)
+    {
+        Stack_Header* top = static_cast<Stack_Header*>(_top);
+        _current = top->block;
+        _current->used = top->used;
+        _top = top->prev;
+    }
+}
+
+Memory_Stack::Marker Memory_Stack::marker() const
+{
+    Marker result;
+    result.top = _top;
+    result.block = _current;
+    result.used = _current->used;
+    return result;
+}
+
+void Memory_Stack::rewind(const Marker& marker)
+{
+    _top = marker.top;
+    _current = marker.block;
+    _current->used = marker.used;
+}
+
+void Memory_Stack::reset()
+{
+    _top = 0;
+    _current = _first;
+    _current->used = 0;
+}
+
 }
@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <new>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "corridormap/assert.h"
+#include "corridormap/memory.h"
+#include "corridormap/parallel.h"
+
+namespace corridormap {
+
+int Scheduler_Serial::num_threads()
+{
+    return 1;
+}
+
+void Scheduler_Serial::run(Job job, void* context, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        job(context, i);
+    }
+}
+
+struct Scheduler_Threads::State
+{
+    std::mutex mutex;
+    // signaled when a new batch of work is available or on shutdown.
+    std::condition_variable wake;
+    // signaled when the last busy worker finishes the batch.
+    std::condition_variable done;
+
+    int num_workers;
+    std::thread* workers;
+
+    // current batch.
+    Job job;
+    void* context;
+    int count;
+    std::atomic<int> next;
+
+    // number of workers still processing the current batch.
+    int num_busy;
+    // incremented for every new batch.
+    unsigned generation;
+    bool quit;
+};
+
+namespace
+{
+    typedef Scheduler_Threads::Job Job;
+
+    template <typename State>
+    void process_batch(State* state)
+    {
+        for (;;)
+        {
+            int index = state->next.fetch_add(1);
+
+            if (index >= state->count)
+            {
+                break;
+            }
+
+            state->job(state->context, index);
+        }
+    }
+
+    template <typename State>
+    void worker_main(State* state)
+    {
+        unsigned seen_generation = 0;
+
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+
+                while (!state->quit && state->generation == seen_generation)
+                {
+                    state->wake.wait(lock);
+                }
+
+                if (state->quit)
+                {
+                    return;
+                }
+
+                seen_generation = state->generation;
+            }
+
+            process_batch(state);
+
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+
+                if (--state->num_busy == 0)
+                {
+                    state->done.notify_one();
+                }
+            }
+        }
+    }
+}
+
+Scheduler_Threads::Scheduler_Threads(Memory* mem, int num_threads)
+    : _mem(mem)
+    , _state(0)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = int(std::thread::hardware_concurrency());
+        num_threads = (num_threads > 0) ? num_threads : 1;
+    }
+
+    void* state_memory = mem->allocate(sizeof(State), alignof(State));
+    corridormap_assert(state_memory != 0);
+
+    _state = new (state_memory) State;
+    _state->num_workers = num_threads - 1;
+    _state->workers = 0;
+    _state->job = 0;
+    _state->context = 0;
+    _state->count = 0;
+    _state->next = 0;
+    _state->num_busy = 0;
+    _state->generation = 0;
+    _state->quit = false;
+
+    if (_state->num_workers > 0)
+    {
+        _state->workers = allocate<std::thread>(mem, _state->num_workers, alignof(std::thread));
+        corridormap_assert(_state->workers != 0);
+
+        for (int i = 0; i < _state->num_workers; ++i)
+        {
+            new (_state->workers + i) std::thread(worker_main<State>, _state);
+        }
+    }
+}
+
+Scheduler_Threads::~Scheduler_Threads()
+{
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        _state->quit = true;
+    }
+
+    _state->wake.notify_all();
+
+    for (int i = 0; i < _state->num_workers; ++i)
+    {
+        _state->workers[i].join();
+        _state->workers[i].~thread();
+    }
+
+    _mem->deallocate(_state->workers);
+    _state->~State();
+    _mem->deallocate(_state);
+}
+
+int Scheduler_Threads::num_threads()
+{
+    return _state->num_workers + 1;
+}
+
+void Scheduler_Threads::run(Job job, void* context, int count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    if (_state->num_workers == 0 || count == 1)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            job(context, i);
+        }
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        _state->job = job;
+        _state->context = context;
+        _state->count = count;
+        _state->next = 0;
+        _state->num_busy = _state->num_workers;
+        _state->generation++;
+    }
+
+    _state->wake.notify_all();
+
+    // calling thread takes part in the batch too.
+    process_batch(_state);
+
+    {
+        std::unique_lock<std::mutex> lock(_state->mutex);
+
+        while (_state->num_busy > 0)
+        {
+            _state->done.wait(lock);
+        }
+    }
+}
+
+void parallel_for(Scheduler* scheduler, Scheduler::Job job, void* context, int count)
+{
+    if (scheduler)
+    {
+        scheduler->run(job, context, count);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        job(context, i);
+    }
+}
+
+int num_threads(Scheduler* scheduler)
+{
+    return scheduler ? scheduler->num_threads() : 1;
+}
+
+}
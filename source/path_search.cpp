@@ -0,0 +1,389 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <float.h>
+#include <string.h>
+#include "corridormap/assert.h"
+#include "corridormap/memory.h"
+#include "corridormap/vec2.h"
+#include "corridormap/runtime.h"
+
+namespace corridormap {
+
+Path_Search create_path_search(Memory* mem, int max_vertices)
+{
+    Path_Search result;
+    memset(&result, 0, sizeof(result));
+    result.max_vertices = max_vertices;
+    result.stamp = allocate<unsigned int>(mem, max_vertices);
+    result.cost = allocate<float>(mem, max_vertices);
+    result.estimate = allocate<float>(mem, max_vertices);
+    result.parent = allocate<int>(mem, max_vertices);
+    result.heap_index = allocate<int>(mem, max_vertices);
+    result.open = allocate<int>(mem, max_vertices);
+    memset(result.stamp, 0, sizeof(unsigned int)*max_vertices);
+    return result;
+}
+
+void destroy(Memory* mem, Path_Search& search)
+{
+    mem->deallocate(search.stamp);
+    mem->deallocate(search.cost);
+    mem->deallocate(search.estimate);
+    mem->deallocate(search.parent);
+    mem->deallocate(search.heap_index);
+    mem->deallocate(search.open);
+    memset(&search, 0, sizeof(search));
+}
+
+namespace
+{
+    // distance to obstacles at the target vertex of the half-edge.
+    float target_clearance(const Walkable_Space& space, const Half_Edge* e)
+    {
+        Vec2 p = target(space, e)->pos;
+        return std::min(mag(left_side(space, e) - p), mag(right_side(space, e) - p));
+    }
+
+    // min clearance and polyline length of the half-edge.
+    void measure(const Walkable_Space& space, const Half_Edge* e, float& min_clearance, float& length)
+    {
+        const Half_Edge* o = opposite(space, e);
+        Vec2 prev = target(space, o)->pos;
+        min_clearance = std::min(target_clearance(space, o), target_clearance(space, e));
+        length = 0.f;
+
+        for (Event* evt = event(space, e); evt != 0; evt = next(space, e, evt))
+        {
+            min_clearance = std::min(min_clearance, std::min(mag(left_side(space, e, evt) - evt->pos), mag(right_side(space, e, evt) - evt->pos)));
+            length += mag(evt->pos - prev);
+            prev = evt->pos;
+        }
+
+        length += mag(target(space, e)->pos - prev);
+    }
+
+    float vertex_clearance(const Walkable_Space& space, const Vertex* v)
+    {
+        Half_Edge* head = half_edge(space, v);
+        float result = FLT_MAX;
+
+        for (Half_Edge* e = head; e != 0; e = next(space, e))
+        {
+            result = std::min(result, target_clearance(space, opposite(space, e)));
+
+            if (next(space, e) == head)
+            {
+                break;
+            }
+        }
+
+        return result;
+    }
+
+    int half_edge_index(const Walkable_Space& space, const Half_Edge* e)
+    {
+        Edge* owner = edge(space, e);
+        return int(owner - space.edges.items)*2 + int(e - owner->dir);
+    }
+
+    Half_Edge* half_edge_ptr(const Walkable_Space& space, int index)
+    {
+        return space.edges.items[index >> 1].dir + (index & 1);
+    }
+
+    // source vertex of the half-edge (target of the opposite direction).
+    int source_index(const Walkable_Space& space, int index)
+    {
+        return space.edges.items[index >> 1].dir[(index & 1) ^ 1].target;
+    }
+
+    void heap_swap(Path_Search& search, int a, int b)
+    {
+        int va = search.open[a];
+        int vb = search.open[b];
+        search.open[a] = vb;
+        search.open[b] = va;
+        search.heap_index[vb] = a;
+        search.heap_index[va] = b;
+    }
+
+    void sift_up(Path_Search& search, int i)
+    {
+        while (i > 0)
+        {
+            int parent = (i - 1)/2;
+
+            if (search.estimate[search.open[parent]] <= search.estimate[search.open[i]])
+            {
+                break;
+            }
+
+            heap_swap(search, i, parent);
+            i = parent;
+        }
+    }
+
+    void sift_down(Path_Search& search, int i)
+    {
+        for (;;)
+        {
+            int l = 2*i + 1;
+            int r = l + 1;
+            int smallest = i;
+
+            if (l < search.num_open && search.estimate[search.open[l]] < search.estimate[search.open[smallest]])
+            {
+                smallest = l;
+            }
+
+            if (r < search.num_open && search.estimate[search.open[r]] < search.estimate[search.open[smallest]])
+            {
+                smallest = r;
+            }
+
+            if (smallest == i)
+            {
+                break;
+            }
+
+            heap_swap(search, i, smallest);
+            i = smallest;
+        }
+    }
+
+    void push(Path_Search& search, int v)
+    {
+        int i = search.num_open++;
+        search.open[i] = v;
+        search.heap_index[v] = i;
+        sift_up(search, i);
+    }
+
+    int pop(Path_Search& search)
+    {
+        int v = search.open[0];
+        heap_swap(search, 0, --search.num_open);
+        search.heap_index[v] = null_idx;
+        sift_down(search, 0);
+        return v;
+    }
+
+    // starts a new query, all per-vertex state becomes invalid.
+    void reset(Path_Search& search)
+    {
+        search.num_open = 0;
+
+        if (++search.query == 0)
+        {
+            memset(search.stamp, 0, sizeof(unsigned int)*search.max_vertices);
+            search.query = 1;
+        }
+    }
+}
+
+Vertex* find_closest_vertex(const Walkable_Space& space, Vec2 point, float agent_radius)
+{
+    Vertex* result = 0;
+    float min_dist_sq = FLT_MAX;
+
+    for (Vertex* v = first(space.vertices); v != 0; v = next(space.vertices, v))
+    {
+        float dist_sq = mag_sq(v->pos - point);
+
+        if (dist_sq < min_dist_sq && vertex_clearance(space, v) >= agent_radius)
+        {
+            min_dist_sq = dist_sq;
+            result = v;
+        }
+    }
+
+    return result;
+}
+
+float clearance(const Walkable_Space& space, const Half_Edge* e)
+{
+    float min_clearance;
+    float length;
+    measure(space, e, min_clearance, length);
+    return min_clearance;
+}
+
+namespace
+{
+    int search_vertex_path(const Walkable_Space& space, Path_Search& search, Vertex* start_vertex, Vertex* goal_vertex, float agent_radius, Half_Edge** path, int max_path_size)
+    {
+        corridormap_assert(space.vertices.max_items <= search.max_vertices);
+
+        if (!start_vertex || !goal_vertex)
+        {
+            return -1;
+        }
+
+        // start and goal snapped to the same vertex: empty path.
+        if (start_vertex == goal_vertex)
+        {
+            return 0;
+        }
+
+        reset(search);
+
+        int s = int(start_vertex - space.vertices.items);
+        int g = int(goal_vertex - space.vertices.items);
+        Vec2 goal_pos = goal_vertex->pos;
+
+        search.stamp[s] = search.query;
+        search.cost[s] = 0.f;
+        search.estimate[s] = mag(goal_pos - start_vertex->pos);
+        search.parent[s] = null_idx;
+        push(search, s);
+
+        bool found = false;
+
+        while (search.num_open > 0)
+        {
+            int u = pop(search);
+
+            if (u == g)
+            {
+                found = true;
+                break;
+            }
+
+            Half_Edge* head = half_edge(space, space.vertices.items + u);
+
+            for (Half_Edge* e = head; e != 0; e = next(space, e))
+            {
+                int v = e->target;
+                bool visited = search.stamp[v] == search.query;
+
+                // skip closed vertices. heuristic is consistent, so they can't be improved.
+                if (!visited || search.heap_index[v] != int(null_idx))
+                {
+                    float min_clearance;
+                    float length;
+                    measure(space, e, min_clearance, length);
+
+                    float cost = search.cost[u] + length;
+
+                    if (min_clearance >= agent_radius && (!visited || cost < search.cost[v]))
+                    {
+                        search.cost[v] = cost;
+                        search.estimate[v] = cost + mag(goal_pos - space.vertices.items[v].pos);
+                        search.parent[v] = half_edge_index(space, e);
+
+                        if (!visited)
+                        {
+                            search.stamp[v] = search.query;
+                            push(search, v);
+                        }
+                        else
+                        {
+                            sift_up(search, search.heap_index[v]);
+                        }
+                    }
+                }
+
+                if (next(space, e) == head)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (!found)
+        {
+            return -1;
+        }
+
+        int path_size = 0;
+
+        for (int v = g; v != s; v = source_index(space, search.parent[v]))
+        {
+            path_size++;
+        }
+
+        if (path_size > max_path_size)
+        {
+            return -1;
+        }
+
+        int i = path_size;
+
+        for (int v = g; v != s; v = source_index(space, search.parent[v]))
+        {
+            path[--i] = half_edge_ptr(space, search.parent[v]);
+        }
+
+        return path_size;
+    }
+
+    // end point of the closest edge (nearer one along the edge first) with enough clearance.
+    Vertex* snap_to_vertex(const Walkable_Space& space, const Space_Index& index, Vec2 point, float agent_radius)
+    {
+        Edge_Location location = locate(index, point);
+
+        if (location.edge == int(null_idx))
+        {
+            return 0;
+        }
+
+        Edge* e = space.edges.items + location.edge;
+        Vertex* u = source(space, e);
+        Vertex* v = target(space, e);
+
+        if (location.t > 0.5f)
+        {
+            std::swap(u, v);
+        }
+
+        if (vertex_clearance(space, u) >= agent_radius)
+        {
+            return u;
+        }
+
+        if (vertex_clearance(space, v) >= agent_radius)
+        {
+            return v;
+        }
+
+        // both end points are too narrow, fall back to the search over all vertices.
+        return find_closest_vertex(space, point, agent_radius);
+    }
+}
+
+int find_path(const Walkable_Space& space, Path_Search& search, Vec2 start, Vec2 goal, float agent_radius, Half_Edge** path, int max_path_size)
+{
+    Vertex* start_vertex = find_closest_vertex(space, start, agent_radius);
+    Vertex* goal_vertex = find_closest_vertex(space, goal, agent_radius);
+    return search_vertex_path(space, search, start_vertex, goal_vertex, agent_radius, path, max_path_size);
+}
+
+int find_path(const Walkable_Space& space, const Space_Index& index, Path_Search& search, Vec2 start, Vec2 goal, float agent_radius, Half_Edge** path, int max_path_size)
+{
+    Vertex* start_vertex = snap_to_vertex(space, index, start, agent_radius);
+    Vertex* goal_vertex = snap_to_vertex(space, index, goal, agent_radius);
+    return search_vertex_path(space, search, start_vertex, goal_vertex, agent_radius, path, max_path_size);
+}
+
+}
@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include "corridormap/build_types.h"
+#include "corridormap/render_interface.h"
+
+namespace corridormap {
+
+namespace
+{
+    // triangles expanded on the stack per draw call of the default draw_mesh.
+    enum { draw_batch_triangles = 256 };
+}
+
+void Renderer::draw_mesh(const Distance_Mesh_Indexed& mesh)
+{
+    // triangles of every segment are expanded and drawn in batches with the segment color.
+    Render_Vertex verts[draw_batch_triangles*3];
+
+    const unsigned int* indices = mesh.indices;
+    const Cone_Instance* instances = mesh.instances;
+
+    for (int i = 0; i < mesh.num_segments; ++i)
+    {
+        const unsigned int color = mesh.segment_colors[i];
+        unsigned num_tris = 0;
+
+        for (int j = 0; j < mesh.num_segment_indices[i]; j += 3, indices += 3)
+        {
+            if (num_tris == draw_batch_triangles)
+            {
+                draw(verts, num_tris, color);
+                num_tris = 0;
+            }
+
+            verts[num_tris*3 + 0] = mesh.verts[indices[0]];
+            verts[num_tris*3 + 1] = mesh.verts[indices[1]];
+            verts[num_tris*3 + 2] = mesh.verts[indices[2]];
+            num_tris++;
+        }
+
+        for (int j = 0; j < mesh.num_segment_instances[i]; ++j, ++instances)
+        {
+            const Cone_Instance& cone = *instances;
+
+            for (int k = cone.first_tri; k < cone.first_tri + cone.num_tris; ++k)
+            {
+                if (num_tris == draw_batch_triangles)
+                {
+                    draw(verts, num_tris, color);
+                    num_tris = 0;
+                }
+
+                for (int v = 0; v < 3; ++v)
+                {
+                    const Render_Vertex& t = mesh.cone_verts[k*3 + v];
+                    Render_Vertex& o = verts[num_tris*3 + v];
+                    o.x = cone.x + t.x*cone.radius;
+                    o.y = cone.y + t.y*cone.radius;
+                    o.z = t.z*cone.radius;
+                }
+
+                num_tris++;
+            }
+        }
+
+        if (num_tris > 0)
+        {
+            draw(verts, num_tris, color);
+        }
+    }
+}
+
+}
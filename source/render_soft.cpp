@@ -0,0 +1,702 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <string.h>
+#include <math.h>
+#include "corridormap/assert.h"
+#include "corridormap/memory.h"
+#include "corridormap/simd.h"
+#include "corridormap/parallel.h"
+#include "corridormap/build_types.h"
+#include "corridormap/render_soft.h"
+
+namespace corridormap {
+
+namespace
+{
+    // tile dimensions in pixels, must be a multiple of 4 (vector width).
+    enum { tile_size = 64 };
+    // max number of triangles set up and rasterized in one pass.
+    enum { max_batch_triangles = 4096 };
+    // number of triangles per setup job.
+    enum { setup_job_triangles = 256 };
+    // number of rows per clear job.
+    enum { clear_job_rows = 64 };
+}
+
+struct Renderer_Soft::Triangle
+{
+    // pixel bounds [min, max). empty for culled triangles.
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+    // edge functions e(x, y) = a*(x - ox) + b*(y - oy).
+    // origin is the same endpoint for both triangles sharing an edge, so shared edges are evaluated exactly (with opposite signs).
+    float a[3];
+    float b[3];
+    float ox[3];
+    float oy[3];
+    // edge owns pixels lying exactly on it (top-left fill rule).
+    bool top_left[3];
+    // depth plane z(x, y) = z0 + dzdx*(x - x0) + dzdy*(y - y0).
+    float x0;
+    float y0;
+    float z0;
+    float dzdx;
+    float dzdy;
+    // pixel word of the triangle color.
+    unsigned int color;
+};
+
+namespace
+{
+    typedef Renderer_Soft::Triangle Triangle;
+
+    struct Setup_Context
+    {
+        const Render_Vertex* vertices;
+        // per triangle pixel words, if null all triangles get color.
+        const unsigned int* colors;
+        unsigned int color;
+        Triangle* triangles;
+        int num_triangles;
+        int width;
+        int height;
+        float min_x;
+        float min_y;
+        float scale_x;
+        float scale_y;
+        float inv_far_plane;
+    };
+
+    struct Raster_Context
+    {
+        const Triangle* triangles;
+        int num_triangles;
+        unsigned int* color_buffer;
+        float* depth_buffer;
+        float* tile_depth;
+        int stride;
+        int width;
+        int height;
+        int num_tiles_x;
+    };
+
+    struct Clear_Context
+    {
+        unsigned int* color_buffer;
+        float* depth_buffer;
+        int stride;
+        int height;
+    };
+
+    inline int clamp_to_int(float v, int lo, int hi)
+    {
+        return (v <= float(lo)) ? lo : ((v >= float(hi)) ? hi : int(v));
+    }
+
+    void setup_edge(Triangle& t, int i, float x0, float y0, float x1, float y1)
+    {
+        float dx = x1 - x0;
+        float dy = y1 - y0;
+
+        // top edge goes right to left, left edge goes down (ccw triangles, y axis is up).
+        t.top_left[i] = (dy < 0.f) || (dy == 0.f && dx < 0.f);
+
+        t.a[i] = -dy;
+        t.b[i] = +dx;
+
+        // origin is the lexicographically smaller endpoint, so both orientations of the edge produce exactly negated values.
+        bool forward = x0 < x1 || (x0 == x1 && y0 < y1);
+        t.ox[i] = forward ? x0 : x1;
+        t.oy[i] = forward ? y0 : y1;
+    }
+
+    void setup_triangles(void* context, int job_index)
+    {
+        const Setup_Context* ctx = static_cast<const Setup_Context*>(context);
+
+        int first = job_index*setup_job_triangles;
+        int last = first + setup_job_triangles;
+        last = (last < ctx->num_triangles) ? last : ctx->num_triangles;
+
+        for (int i = first; i < last; ++i)
+        {
+            const Render_Vertex* v = ctx->vertices + i*3;
+            Triangle& t = ctx->triangles[i];
+            t.color = ctx->colors ? ctx->colors[i] : ctx->color;
+
+            float x[3];
+            float y[3];
+            float z[3];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                x[k] = (v[k].x - ctx->min_x)*ctx->scale_x;
+                y[k] = (v[k].y - ctx->min_y)*ctx->scale_y;
+                z[k] = v[k].z*ctx->inv_far_plane;
+            }
+
+            float area = (x[1] - x[0])*(y[2] - y[0]) - (x[2] - x[0])*(y[1] - y[0]);
+
+            // back-facing or degenerate.
+            if (!(area > 0.f))
+            {
+                t.min_x = t.max_x = 0;
+                t.min_y = t.max_y = 0;
+                continue;
+            }
+
+            float min_x = x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]);
+            float min_y = y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]);
+            float max_x = x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]);
+            float max_y = y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]);
+
+            // conservative pixel bounds, exact coverage is decided by the edge functions.
+            t.min_x = clamp_to_int(floorf(min_x), 0, ctx->width);
+            t.min_y = clamp_to_int(floorf(min_y), 0, ctx->height);
+            t.max_x = clamp_to_int(ceilf(max_x) + 1.f, 0, ctx->width);
+            t.max_y = clamp_to_int(ceilf(max_y) + 1.f, 0, ctx->height);
+
+            setup_edge(t, 0, x[0], y[0], x[1], y[1]);
+            setup_edge(t, 1, x[1], y[1], x[2], y[2]);
+            setup_edge(t, 2, x[2], y[2], x[0], y[0]);
+
+            float inv_area = 1.f/area;
+            t.x0 = x[0];
+            t.y0 = y[0];
+            t.z0 = z[0];
+            t.dzdx = ((z[1] - z[0])*(y[2] - y[0]) - (z[2] - z[0])*(y[1] - y[0]))*inv_area;
+            t.dzdy = ((z[2] - z[0])*(x[1] - x[0]) - (z[1] - z[0])*(x[2] - x[0]))*inv_area;
+        }
+    }
+
+#if CORRIDORMAP_SSE2
+    // rasterizes span of pixels [x_begin, x_end) of the row y. vector groups are aligned to 4 pixels and never cross tiles.
+    // edge tests are skipped when span is known to be covered by the triangle.
+    template <bool test_edges>
+    inline void raster_span(const Triangle& t, unsigned int color, unsigned int* color_row, float* depth_row, int x_begin, int x_end, int y)
+    {
+        const float py = float(y) + 0.5f;
+
+        __m128 e_row[3];
+        __m128 a[3];
+        __m128 ox[3];
+        __m128 tl[3];
+
+        for (int i = 0; i < 3; ++i)
+        {
+            e_row[i] = _mm_set1_ps(t.b[i]*(py - t.oy[i]));
+            a[i] = _mm_set1_ps(t.a[i]);
+            ox[i] = _mm_set1_ps(t.ox[i]);
+            tl[i] = t.top_left[i] ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : _mm_setzero_ps();
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 z_row = _mm_set1_ps(t.z0 + t.dzdy*(py - t.y0));
+        const __m128 dzdx = _mm_set1_ps(t.dzdx);
+        const __m128 x0 = _mm_set1_ps(t.x0);
+        const __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128i lane_index = _mm_set_epi32(3, 2, 1, 0);
+        const __m128i first = _mm_set1_epi32(x_begin);
+        const __m128i last = _mm_set1_epi32(x_end);
+        const __m128i color_value = _mm_set1_epi32(int(color));
+
+        for (int x = x_begin & ~3; x < x_end; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), lane_offsets);
+            __m128i lx = _mm_add_epi32(_mm_set1_epi32(x), lane_index);
+
+            // lanes inside [x_begin, x_end).
+            __m128 mask = _mm_castsi128_ps(_mm_andnot_si128(_mm_cmplt_epi32(lx, first), _mm_cmplt_epi32(lx, last)));
+
+            for (int i = 0; test_edges && i < 3; ++i)
+            {
+                __m128 e = _mm_add_ps(_mm_mul_ps(a[i], _mm_sub_ps(px, ox[i])), e_row[i]);
+                __m128 inside = _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(_mm_cmpeq_ps(e, zero), tl[i]));
+                mask = _mm_and_ps(mask, inside);
+            }
+
+            if (_mm_movemask_ps(mask) == 0)
+            {
+                continue;
+            }
+
+            __m128 z = _mm_add_ps(z_row, _mm_mul_ps(dzdx, _mm_sub_ps(px, x0)));
+            __m128 d = _mm_loadu_ps(depth_row + x);
+            __m128 pass = _mm_and_ps(mask, _mm_cmplt_ps(z, d));
+
+            if (_mm_movemask_ps(pass) == 0)
+            {
+                continue;
+            }
+
+            __m128i pass_i = _mm_castps_si128(pass);
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(color_row + x));
+
+            _mm_storeu_ps(depth_row + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, d)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(color_row + x), _mm_or_si128(_mm_and_si128(pass_i, color_value), _mm_andnot_si128(pass_i, c)));
+        }
+    }
+#else
+    template <bool test_edges>
+    inline void raster_span(const Triangle& t, unsigned int color, unsigned int* color_row, float* depth_row, int x_begin, int x_end, int y)
+    {
+        const float py = float(y) + 0.5f;
+
+        float e_row[3];
+
+        for (int i = 0; i < 3; ++i)
+        {
+            e_row[i] = t.b[i]*(py - t.oy[i]);
+        }
+
+        const float z_row = t.z0 + t.dzdy*(py - t.y0);
+
+        for (int x = x_begin; x < x_end; ++x)
+        {
+            float px = float(x) + 0.5f;
+            bool inside = true;
+
+            for (int i = 0; test_edges && i < 3; ++i)
+            {
+                float e = t.a[i]*(px - t.ox[i]) + e_row[i];
+                inside = inside && (e > 0.f || (e == 0.f && t.top_left[i]));
+            }
+
+            if (!inside)
+            {
+                continue;
+            }
+
+            float z = z_row + t.dzdx*(px - t.x0);
+
+            if (z < depth_row[x])
+            {
+                depth_row[x] = z;
+                color_row[x] = color;
+            }
+        }
+    }
+#endif
+
+    inline float min_value(float a, float b)
+    {
+        return (a < b) ? a : b;
+    }
+
+    inline float max_value(float a, float b)
+    {
+        return (a > b) ? a : b;
+    }
+
+    void raster_tile(void* context, int tile_index)
+    {
+        const Raster_Context* ctx = static_cast<const Raster_Context*>(context);
+
+        int tile_min_x = (tile_index % ctx->num_tiles_x)*tile_size;
+        int tile_min_y = (tile_index / ctx->num_tiles_x)*tile_size;
+        int tile_max_x = tile_min_x + tile_size;
+        int tile_max_y = tile_min_y + tile_size;
+        tile_max_x = (tile_max_x < ctx->width) ? tile_max_x : ctx->width;
+        tile_max_y = (tile_max_y < ctx->height) ? tile_max_y : ctx->height;
+
+        // conservative max depth of the tile.
+        float tile_depth = ctx->tile_depth[tile_index];
+
+        // triangles are processed in submission order, so results match serial rendering.
+        for (int i = 0; i < ctx->num_triangles; ++i)
+        {
+            const Triangle& t = ctx->triangles[i];
+
+            int min_x = (t.min_x > tile_min_x) ? t.min_x : tile_min_x;
+            int min_y = (t.min_y > tile_min_y) ? t.min_y : tile_min_y;
+            int max_x = (t.max_x < tile_max_x) ? t.max_x : tile_max_x;
+            int max_y = (t.max_y < tile_max_y) ? t.max_y : tile_max_y;
+
+            if (min_x >= max_x || min_y >= max_y)
+            {
+                continue;
+            }
+
+            // pixel centers of the rectangle corners.
+            float x_lo = float(min_x) + 0.5f;
+            float y_lo = float(min_y) + 0.5f;
+            float x_hi = float(max_x - 1) + 0.5f;
+            float y_hi = float(max_y - 1) + 0.5f;
+
+            // edge and depth functions are evaluated the same way as per pixel, so the corner values are exact bounds.
+            bool rejected = false;
+            bool covered = true;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                float e_x_max = t.a[k]*(((t.a[k] > 0.f) ? x_hi : x_lo) - t.ox[k]);
+                float e_x_min = t.a[k]*(((t.a[k] > 0.f) ? x_lo : x_hi) - t.ox[k]);
+                float e_y_max = t.b[k]*(((t.b[k] > 0.f) ? y_hi : y_lo) - t.oy[k]);
+                float e_y_min = t.b[k]*(((t.b[k] > 0.f) ? y_lo : y_hi) - t.oy[k]);
+                float e_max = e_x_max + e_y_max;
+                float e_min = e_x_min + e_y_min;
+
+                rejected = rejected || e_max < 0.f || (e_max == 0.f && !t.top_left[k]);
+                covered = covered && (e_min > 0.f || (e_min == 0.f && t.top_left[k]));
+            }
+
+            if (rejected)
+            {
+                continue;
+            }
+
+            float z_row_min = t.z0 + t.dzdy*(((t.dzdy > 0.f) ? y_lo : y_hi) - t.y0);
+            float z_row_max = t.z0 + t.dzdy*(((t.dzdy > 0.f) ? y_hi : y_lo) - t.y0);
+            float z_min = z_row_min + t.dzdx*(((t.dzdx > 0.f) ? x_lo : x_hi) - t.x0);
+            float z_max = z_row_max + t.dzdx*(((t.dzdx > 0.f) ? x_hi : x_lo) - t.x0);
+
+            // every pixel of the rectangle fails the depth test.
+            if (z_min >= tile_depth)
+            {
+                continue;
+            }
+
+            for (int y = min_y; y < max_y; ++y)
+            {
+                unsigned int* color_row = ctx->color_buffer + y*ctx->stride;
+                float* depth_row = ctx->depth_buffer + y*ctx->stride;
+
+                if (covered)
+                {
+                    raster_span<false>(t, t.color, color_row, depth_row, min_x, max_x, y);
+                }
+                else
+                {
+                    raster_span<true>(t, t.color, color_row, depth_row, min_x, max_x, y);
+                }
+            }
+
+            // whole tile is covered, every pixel now has depth <= z_max.
+            if (covered && min_x == tile_min_x && min_y == tile_min_y && max_x == tile_max_x && max_y == tile_max_y)
+            {
+                tile_depth = min_value(tile_depth, max_value(z_max, z_min));
+            }
+        }
+
+        ctx->tile_depth[tile_index] = tile_depth;
+    }
+
+    void clear_rows(void* context, int job_index)
+    {
+        const Clear_Context* ctx = static_cast<const Clear_Context*>(context);
+
+        int first = job_index*clear_job_rows;
+        int last = first + clear_job_rows;
+        last = (last < ctx->height) ? last : ctx->height;
+
+        int count = (last - first)*ctx->stride;
+        unsigned int* color = ctx->color_buffer + first*ctx->stride;
+        float* depth = ctx->depth_buffer + first*ctx->stride;
+
+        memset(color, 0xff, count*sizeof(color[0]));
+
+        for (int i = 0; i < count; ++i)
+        {
+            depth[i] = 1.f;
+        }
+    }
+
+    // converts 0xRRGGBBAA color to the pixel word with R, G, B, A byte order in memory.
+    unsigned int to_pixel(unsigned int color)
+    {
+        unsigned char rgba[4] =
+        {
+            (unsigned char)((color >> 24) & 0xff),
+            (unsigned char)((color >> 16) & 0xff),
+            (unsigned char)((color >>  8) & 0xff),
+            (unsigned char)((color >>  0) & 0xff),
+        };
+
+        unsigned int result;
+        memcpy(&result, rgba, sizeof(result));
+        return result;
+    }
+}
+
+Renderer_Soft::Renderer_Soft(Scheduler* scheduler)
+    : _scheduler(scheduler)
+    , _memory(0)
+    , _stride(0)
+    , _color(0)
+    , _depth(0)
+    , _num_tiles_x(0)
+    , _num_tiles_y(0)
+    , _tile_depth(0)
+    , _triangles(0)
+    , _batch_vertices(0)
+    , _batch_colors(0)
+{
+    memset(&params, 0, sizeof(params));
+}
+
+Renderer_Soft::~Renderer_Soft()
+{
+    release();
+}
+
+void Renderer_Soft::release()
+{
+    if (_memory)
+    {
+        _memory->deallocate(_batch_colors);
+        _memory->deallocate(_batch_vertices);
+        _memory->deallocate(_triangles);
+        _memory->deallocate(_tile_depth);
+        _memory->deallocate(_depth);
+        _memory->deallocate(_color);
+    }
+
+    _color = 0;
+    _depth = 0;
+    _tile_depth = 0;
+    _triangles = 0;
+    _batch_vertices = 0;
+    _batch_colors = 0;
+}
+
+bool Renderer_Soft::initialize(Renderer::Parameters params_, Memory* memory)
+{
+    release();
+
+    params = params_;
+    _memory = memory;
+
+    int width = int(params.render_target_width);
+    int height = int(params.render_target_height);
+
+    if (width <= 0 || height <= 0 || !(params.far_plane > 0.f))
+    {
+        return false;
+    }
+
+    _stride = (width + 3) & ~3;
+    _num_tiles_x = (width + tile_size - 1)/tile_size;
+    _num_tiles_y = (height + tile_size - 1)/tile_size;
+
+    _color = allocate<unsigned int>(memory, _stride*height, 16);
+    _depth = allocate<float>(memory, _stride*height, 16);
+    _tile_depth = allocate<float>(memory, _num_tiles_x*_num_tiles_y);
+    _triangles = allocate<Triangle>(memory, max_batch_triangles);
+    _batch_vertices = allocate<Render_Vertex>(memory, max_batch_triangles*3);
+    _batch_colors = allocate<unsigned int>(memory, max_batch_triangles);
+
+    if (!_color || !_depth || !_tile_depth || !_triangles || !_batch_vertices || !_batch_colors)
+    {
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+void Renderer_Soft::begin()
+{
+    Clear_Context ctx;
+    ctx.color_buffer = _color;
+    ctx.depth_buffer = _depth;
+    ctx.stride = _stride;
+    ctx.height = int(params.render_target_height);
+
+    parallel_for(_scheduler, clear_rows, &ctx, (ctx.height + clear_job_rows - 1)/clear_job_rows);
+
+    for (int i = 0; i < _num_tiles_x*_num_tiles_y; ++i)
+    {
+        _tile_depth[i] = 1.f;
+    }
+}
+
+void Renderer_Soft::draw(const Render_Vertex* vertices, unsigned tri_count, unsigned color)
+{
+    rasterize(vertices, 0, tri_count, to_pixel(color));
+}
+
+void Renderer_Soft::draw_mesh(const Distance_Mesh_Indexed& mesh)
+{
+    // triangles are expanded into batches in segment order: indexed triangles of a segment, then its cones.
+    Render_Vertex* verts = _batch_vertices;
+    unsigned int* colors = _batch_colors;
+    int num_tris = 0;
+
+    const unsigned int* indices = mesh.indices;
+    const Cone_Instance* instances = mesh.instances;
+
+    for (int i = 0; i < mesh.num_segments; ++i)
+    {
+        const unsigned int color = to_pixel(mesh.segment_colors[i]);
+
+        for (int j = 0; j < mesh.num_segment_indices[i]; j += 3, indices += 3)
+        {
+            if (num_tris == max_batch_triangles)
+            {
+                rasterize(verts, colors, num_tris, 0);
+                num_tris = 0;
+            }
+
+            verts[num_tris*3 + 0] = mesh.verts[indices[0]];
+            verts[num_tris*3 + 1] = mesh.verts[indices[1]];
+            verts[num_tris*3 + 2] = mesh.verts[indices[2]];
+            colors[num_tris++] = color;
+        }
+
+        for (int j = 0; j < mesh.num_segment_instances[i]; ++j, ++instances)
+        {
+            const Cone_Instance& cone = *instances;
+
+            for (int k = cone.first_tri; k < cone.first_tri + cone.num_tris; ++k)
+            {
+                if (num_tris == max_batch_triangles)
+                {
+                    rasterize(verts, colors, num_tris, 0);
+                    num_tris = 0;
+                }
+
+                for (int v = 0; v < 3; ++v)
+                {
+                    const Render_Vertex& t = mesh.cone_verts[k*3 + v];
+                    Render_Vertex& o = verts[num_tris*3 + v];
+                    o.x = cone.x + t.x*cone.radius;
+                    o.y = cone.y + t.y*cone.radius;
+                    o.z = t.z*cone.radius;
+                }
+
+                colors[num_tris++] = color;
+            }
+        }
+    }
+
+    rasterize(verts, colors, num_tris, 0);
+}
+
+void Renderer_Soft::rasterize(const Render_Vertex* vertices, const unsigned int* colors, unsigned tri_count, unsigned int color)
+{
+    int width = int(params.render_target_width);
+    int height = int(params.render_target_height);
+
+    Setup_Context setup;
+    setup.vertices = vertices;
+    setup.colors = colors;
+    setup.color = color;
+    setup.triangles = _triangles;
+    setup.width = width;
+    setup.height = height;
+    setup.min_x = params.min[0];
+    setup.min_y = params.min[1];
+    setup.scale_x = float(width)/(params.max[0] - params.min[0]);
+    setup.scale_y = float(height)/(params.max[1] - params.min[1]);
+    setup.inv_far_plane = 1.f/params.far_plane;
+
+    Raster_Context raster;
+    raster.triangles = _triangles;
+    raster.color_buffer = _color;
+    raster.depth_buffer = _depth;
+    raster.tile_depth = _tile_depth;
+    raster.stride = _stride;
+    raster.width = width;
+    raster.height = height;
+    raster.num_tiles_x = _num_tiles_x;
+
+    for (unsigned offset = 0; offset < tri_count; offset += max_batch_triangles)
+    {
+        int batch_size = int(tri_count - offset);
+        batch_size = (batch_size < max_batch_triangles) ? batch_size : max_batch_triangles;
+
+        setup.vertices = vertices + offset*3;
+        setup.colors = colors ? colors + offset : 0;
+        setup.num_triangles = batch_size;
+        parallel_for(_scheduler, setup_triangles, &setup, (batch_size + setup_job_triangles - 1)/setup_job_triangles);
+
+        raster.num_triangles = batch_size;
+        parallel_for(_scheduler, raster_tile, &raster, _num_tiles_x*_num_tiles_y);
+    }
+}
+
+void Renderer_Soft::end()
+{
+}
+
+void Renderer_Soft::read_pixels(unsigned char* destination)
+{
+    int width = int(params.render_target_width);
+    int height = int(params.render_target_height);
+
+    if (_stride == width)
+    {
+        memcpy(destination, _color, width*height*sizeof(_color[0]));
+        return;
+    }
+
+    for (int y = 0; y < height; ++y)
+    {
+        memcpy(destination + y*width*4, _color + y*_stride, width*sizeof(_color[0]));
+    }
+}
+
+bool Renderer_Soft::read_rows(int first_row, int num_rows, unsigned char* destination)
+{
+    int width = int(params.render_target_width);
+
+    corridormap_assert(first_row >= 0 && first_row + num_rows <= int(params.render_target_height));
+
+    for (int y = 0; y < num_rows; ++y)
+    {
+        memcpy(destination + y*width*4, _color + (first_row + y)*_stride, width*sizeof(_color[0]));
+    }
+
+    return true;
+}
+
+Renderer::Opencl_Shared Renderer_Soft::create_opencl_shared()
+{
+    Opencl_Shared result;
+    memset(&result, 0, sizeof(result));
+    return result;
+}
+
+cl_mem Renderer_Soft::share_pixels(cl_context, cl_mem_flags, cl_int* error_code)
+{
+    if (error_code)
+    {
+        *error_code = CL_INVALID_OPERATION;
+    }
+
+    return 0;
+}
+
+cl_int Renderer_Soft::acquire_shared(cl_command_queue, cl_mem)
+{
+    return CL_INVALID_OPERATION;
+}
+
+cl_int Renderer_Soft::release_shared(cl_command_queue, cl_mem)
+{
+    return CL_INVALID_OPERATION;
+}
+
+}
@@ -44,6 +44,10 @@ Walkable_Space create_walkable_space(Memory* mem, int max_vertices, int max_edge
     result.edges.items = allocate<Edge>(mem, max_edges);
     result.events.items = allocate<Event>(mem, max_events);
 
+    result.vertices.prev = allocate<int>(mem, max_vertices);
+    result.edges.prev = allocate<int>(mem, max_edges);
+    result.events.prev = allocate<int>(mem, max_events);
+
     result.vertices.max_items = max_vertices;
     result.edges.max_items = max_edges;
     result.events.max_items = max_events;
@@ -60,6 +64,9 @@ void destroy(Memory* mem, Walkable_Space& d)
     mem->deallocate(d.vertices.items);
     mem->deallocate(d.edges.items);
     mem->deallocate(d.events.items);
+    mem->deallocate(d.vertices.prev);
+    mem->deallocate(d.edges.prev);
+    mem->deallocate(d.events.prev);
     memset(&d, 0, sizeof(d));
 }
 
@@ -222,6 +229,470 @@ int degree(const Walkable_Space& space, const Vertex* vertex)
     return result;
 }
 
+namespace
+{
+    // offsets of baked space arrays in a single memory block.
+    struct Baked_Layout
+    {
+        size_t vertex_pos;
+        size_t vertex_half_edges;
+        size_t target;
+        size_t opposite;
+        size_t side_l;
+        size_t side_r;
+        size_t half_edge_events;
+        size_t event_pos;
+        size_t event_l;
+        size_t event_r;
+        size_t size;
+    };
+
+    enum { baked_array_align = 16 };
+
+    size_t append_array(size_t& offset, size_t size)
+    {
+        size_t result = (offset + baked_array_align - 1) & ~size_t(baked_array_align - 1);
+        offset = result + size;
+        return result;
+    }
+
+    Baked_Layout baked_layout(int num_vertices, int num_half_edges, int num_events)
+    {
+        Baked_Layout l;
+        size_t offset = 0;
+        l.vertex_pos = append_array(offset, sizeof(Vec2)*num_vertices);
+        l.vertex_half_edges = append_array(offset, sizeof(int)*(num_vertices + 1));
+        l.target = append_array(offset, sizeof(int)*num_half_edges);
+        l.opposite = append_array(offset, sizeof(int)*num_half_edges);
+        l.side_l = append_array(offset, sizeof(Vec2)*num_half_edges);
+        l.side_r = append_array(offset, sizeof(Vec2)*num_half_edges);
+        l.half_edge_events = append_array(offset, sizeof(int)*(num_half_edges + 1));
+        l.event_pos = append_array(offset, sizeof(Vec2)*num_events);
+        l.event_l = append_array(offset, sizeof(Vec2)*num_events);
+        l.event_r = append_array(offset, sizeof(Vec2)*num_events);
+        l.size = append_array(offset, 0);
+        return l;
+    }
+
+    // writable arrays of the baked space while it's being filled.
+    struct Baked_Arrays
+    {
+        Vec2* vertex_pos;
+        int* vertex_half_edges;
+        int* target;
+        int* opposite;
+        Vec2* side_l;
+        Vec2* side_r;
+        int* half_edge_events;
+        Vec2* event_pos;
+        Vec2* event_l;
+        Vec2* event_r;
+    };
+
+    Baked_Arrays baked_arrays(char* base, const Baked_Layout& l)
+    {
+        Baked_Arrays a;
+        a.vertex_pos = reinterpret_cast<Vec2*>(base + l.vertex_pos);
+        a.vertex_half_edges = reinterpret_cast<int*>(base + l.vertex_half_edges);
+        a.target = reinterpret_cast<int*>(base + l.target);
+        a.opposite = reinterpret_cast<int*>(base + l.opposite);
+        a.side_l = reinterpret_cast<Vec2*>(base + l.side_l);
+        a.side_r = reinterpret_cast<Vec2*>(base + l.side_r);
+        a.half_edge_events = reinterpret_cast<int*>(base + l.half_edge_events);
+        a.event_pos = reinterpret_cast<Vec2*>(base + l.event_pos);
+        a.event_l = reinterpret_cast<Vec2*>(base + l.event_l);
+        a.event_r = reinterpret_cast<Vec2*>(base + l.event_r);
+        return a;
+    }
+
+    void set_baked_arrays(Baked_Space& space, const Baked_Arrays& a)
+    {
+        space.vertex_pos = a.vertex_pos;
+        space.vertex_half_edges = a.vertex_half_edges;
+        space.target = a.target;
+        space.opposite = a.opposite;
+        space.side_l = a.side_l;
+        space.side_r = a.side_r;
+        space.half_edge_events = a.half_edge_events;
+        space.event_pos = a.event_pos;
+        space.event_l = a.event_l;
+        space.event_r = a.event_r;
+    }
+}
+
+Baked_Space bake(Memory* mem, Memory* scratch, const Walkable_Space& space)
+{
+    Baked_Space result;
+    memset(&result, 0, sizeof(result));
+
+    // compact indices of pool vertices and half-edges (edge_index*2 + dir).
+    Alloc_Scope<int> vertex_map(scratch, space.vertices.max_items);
+    Alloc_Scope<int> half_edge_map(scratch, space.edges.max_items*2);
+
+    int num_vertices = 0;
+    int num_half_edges = 0;
+    int num_events = 0;
+
+    for (Vertex* v = first(space.vertices); v != 0; v = next(space.vertices, v))
+    {
+        vertex_map[int(v - space.vertices.items)] = num_vertices++;
+        Half_Edge* head = half_edge(space, v);
+
+        for (Half_Edge* e = head; e != 0; e = next(space, e))
+        {
+            Edge* owner = edge(space, e);
+            half_edge_map[int(owner - space.edges.items)*2 + int(e - owner->dir)] = num_half_edges++;
+
+            for (Event* evt = event(space, e); evt != 0; evt = next(space, e, evt))
+            {
+                num_events++;
+            }
+
+            if (next(space, e) == head)
+            {
+                break;
+            }
+        }
+    }
+
+    Baked_Layout layout = baked_layout(num_vertices, num_half_edges, num_events);
+    char* data = static_cast<char*>(mem->allocate(layout.size, baked_array_align));
+    corridormap_assert(data);
+
+    result.num_vertices = num_vertices;
+    result.num_half_edges = num_half_edges;
+    result.num_events = num_events;
+    result.data = data;
+
+    Baked_Arrays out = baked_arrays(data, layout);
+    set_baked_arrays(result, out);
+
+    int vertex_index = 0;
+    int half_edge_index = 0;
+    int event_index = 0;
+
+    for (Vertex* v = first(space.vertices); v != 0; v = next(space.vertices, v), ++vertex_index)
+    {
+        out.vertex_pos[vertex_index] = v->pos;
+        out.vertex_half_edges[vertex_index] = half_edge_index;
+
+        Half_Edge* head = half_edge(space, v);
+
+        for (Half_Edge* e = head; e != 0; e = next(space, e), ++half_edge_index)
+        {
+            Half_Edge* opp = opposite(space, e);
+            Edge* opp_owner = edge(space, opp);
+
+            out.target[half_edge_index] = vertex_map[e->target];
+            out.opposite[half_edge_index] = half_edge_map[int(opp_owner - space.edges.items)*2 + int(opp - opp_owner->dir)];
+            out.side_l[half_edge_index] = left_side(space, e);
+            out.side_r[half_edge_index] = right_side(space, e);
+            out.half_edge_events[half_edge_index] = event_index;
+
+            for (Event* evt = event(space, e); evt != 0; evt = next(space, e, evt), ++event_index)
+            {
+                out.event_pos[event_index] = evt->pos;
+                out.event_l[event_index] = left_side(space, e, evt);
+                out.event_r[event_index] = right_side(space, e, evt);
+            }
+
+            if (next(space, e) == head)
+            {
+                ++half_edge_index;
+                break;
+            }
+        }
+    }
+
+    out.vertex_half_edges[num_vertices] = num_half_edges;
+    out.half_edge_events[num_half_edges] = num_events;
+
+    return result;
+}
+
+void destroy(Memory* mem, Baked_Space& space)
+{
+    if (space.data)
+    {
+        mem->deallocate(space.data);
+    }
+
+    memset(&space, 0, sizeof(space));
+}
+
+namespace
+{
+    enum { baked_file_version = 1 };
+    enum { baked_num_arrays = 10 };
+
+    const unsigned char baked_file_magic[4] = { 'C', 'M', 'B', 'S' };
+
+    // file starts with the header, all fields after magic are little-endian 32-bit words.
+    // array offsets are relative to the beginning of the file.
+    struct Baked_File_Header
+    {
+        unsigned char magic[4];
+        unsigned int version;
+        unsigned int size;
+        unsigned int num_vertices;
+        unsigned int num_half_edges;
+        unsigned int num_events;
+        unsigned int offsets[baked_num_arrays];
+    };
+
+    bool host_little_endian()
+    {
+        const unsigned int one = 1;
+        return *reinterpret_cast<const unsigned char*>(&one) == 1;
+    }
+
+    // copies 32-bit words converting from host to little-endian byte order.
+    void store_le32(void* dst, const void* src, size_t num_words)
+    {
+        if (host_little_endian())
+        {
+            memcpy(dst, src, num_words*4);
+            return;
+        }
+
+        const unsigned char* s = static_cast<const unsigned char*>(src);
+        unsigned char* d = static_cast<unsigned char*>(dst);
+
+        for (size_t i = 0; i < num_words; ++i, s += 4, d += 4)
+        {
+            d[0] = s[3];
+            d[1] = s[2];
+            d[2] = s[1];
+            d[3] = s[0];
+        }
+    }
+
+    size_t baked_header_size()
+    {
+        size_t offset = 0;
+        append_array(offset, sizeof(Baked_File_Header));
+        return append_array(offset, 0);
+    }
+
+    // array sizes in 32-bit words, in the order of Baked_Layout fields.
+    void baked_array_words(unsigned int num_vertices, unsigned int num_half_edges, unsigned int num_events, size_t* words)
+    {
+        words[0] = size_t(num_vertices)*2;
+        words[1] = size_t(num_vertices) + 1;
+        words[2] = num_half_edges;
+        words[3] = num_half_edges;
+        words[4] = size_t(num_half_edges)*2;
+        words[5] = size_t(num_half_edges)*2;
+        words[6] = size_t(num_half_edges) + 1;
+        words[7] = size_t(num_events)*2;
+        words[8] = size_t(num_events)*2;
+        words[9] = size_t(num_events)*2;
+    }
+
+    void baked_array_offsets(const Baked_Layout& l, size_t base, size_t* offsets)
+    {
+        offsets[0] = base + l.vertex_pos;
+        offsets[1] = base + l.vertex_half_edges;
+        offsets[2] = base + l.target;
+        offsets[3] = base + l.opposite;
+        offsets[4] = base + l.side_l;
+        offsets[5] = base + l.side_r;
+        offsets[6] = base + l.half_edge_events;
+        offsets[7] = base + l.event_pos;
+        offsets[8] = base + l.event_l;
+        offsets[9] = base + l.event_r;
+    }
+}
+
+size_t serialized_size(const Baked_Space& space)
+{
+    return baked_header_size() + baked_layout(space.num_vertices, space.num_half_edges, space.num_events).size;
+}
+
+size_t serialize(const Baked_Space& space, void* buffer, size_t buffer_size)
+{
+    size_t size = serialized_size(space);
+
+    if (buffer_size < size)
+    {
+        return 0;
+    }
+
+    unsigned char* output = static_cast<unsigned char*>(buffer);
+    memset(output, 0, size);
+
+    Baked_Layout layout = baked_layout(space.num_vertices, space.num_half_edges, space.num_events);
+    size_t offsets[baked_num_arrays];
+    size_t words[baked_num_arrays];
+    baked_array_offsets(layout, baked_header_size(), offsets);
+    baked_array_words(space.num_vertices, space.num_half_edges, space.num_events, words);
+
+    Baked_File_Header header;
+    memcpy(header.magic, baked_file_magic, sizeof(header.magic));
+    header.version = baked_file_version;
+    header.size = static_cast<unsigned int>(size);
+    header.num_vertices = space.num_vertices;
+    header.num_half_edges = space.num_half_edges;
+    header.num_events = space.num_events;
+
+    for (int i = 0; i < baked_num_arrays; ++i)
+    {
+        header.offsets[i] = static_cast<unsigned int>(offsets[i]);
+    }
+
+    memcpy(output, header.magic, sizeof(header.magic));
+    store_le32(output + sizeof(header.magic), &header.version, (sizeof(header) - sizeof(header.magic))/4);
+
+    const void* arrays[baked_num_arrays] =
+    {
+        space.vertex_pos, space.vertex_half_edges, space.target, space.opposite, space.side_l,
+        space.side_r, space.half_edge_events, space.event_pos, space.event_l, space.event_r,
+    };
+
+    for (int i = 0; i < baked_num_arrays; ++i)
+    {
+        store_le32(output + offsets[i], arrays[i], words[i]);
+    }
+
+    return size;
+}
+
+void* serialize(Memory* mem, Memory* scratch, const Walkable_Space& space, size_t& size)
+{
+    Baked_Space baked = bake(mem, scratch, space);
+    size = serialized_size(baked);
+
+    void* result = mem->allocate(size, baked_array_align);
+    corridormap_assert(result);
+    serialize(baked, result, size);
+
+    destroy(mem, baked);
+    return result;
+}
+
+namespace
+{
+    // csr offsets start at zero, don't decrease and end with the item count.
+    bool valid_offsets(const int* offsets, int count, int num_items)
+    {
+        if (offsets[0] != 0 || offsets[count] != num_items)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (offsets[i + 1] < offsets[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // checks every index of the view, so traversal of a corrupt or stale file can't read out of bounds.
+    bool valid_topology(const Baked_Space& space)
+    {
+        if (!valid_offsets(space.vertex_half_edges, space.num_vertices, space.num_half_edges) ||
+            !valid_offsets(space.half_edge_events, space.num_half_edges, space.num_events))
+        {
+            return false;
+        }
+
+        for (int h = 0; h < space.num_half_edges; ++h)
+        {
+            int t = space.target[h];
+            int o = space.opposite[h];
+
+            if (t < 0 || t >= space.num_vertices || o < 0 || o >= space.num_half_edges || o == h || space.opposite[o] != h)
+            {
+                return false;
+            }
+        }
+
+        // the opposite half-edge must point back to the vertex the half-edge is stored at.
+        for (int v = 0; v < space.num_vertices; ++v)
+        {
+            for (int h = space.vertex_half_edges[v]; h < space.vertex_half_edges[v + 1]; ++h)
+            {
+                if (space.target[space.opposite[h]] != v)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+bool load_view(const void* data, size_t size, Baked_Space& out)
+{
+    memset(&out, 0, sizeof(out));
+
+    // zero-copy view requires host byte order to match the file.
+    if (!host_little_endian())
+    {
+        return false;
+    }
+
+    if (!data || size < sizeof(Baked_File_Header) || (reinterpret_cast<size_t>(data) & 3) != 0)
+    {
+        return false;
+    }
+
+    const unsigned char* input = static_cast<const unsigned char*>(data);
+    Baked_File_Header header;
+    memcpy(&header, input, sizeof(header));
+
+    if (memcmp(header.magic, baked_file_magic, sizeof(header.magic)) != 0 || header.version != baked_file_version || header.size > size)
+    {
+        return false;
+    }
+
+    if (int(header.num_vertices) < 0 || int(header.num_half_edges) < 0 || int(header.num_events) < 0)
+    {
+        return false;
+    }
+
+    size_t words[baked_num_arrays];
+    baked_array_words(header.num_vertices, header.num_half_edges, header.num_events, words);
+
+    for (int i = 0; i < baked_num_arrays; ++i)
+    {
+        size_t offset = header.offsets[i];
+
+        if ((offset & 3) != 0 || offset < sizeof(header) || offset > header.size || words[i] > (header.size - offset)/4)
+        {
+            return false;
+        }
+    }
+
+    out.num_vertices = int(header.num_vertices);
+    out.num_half_edges = int(header.num_half_edges);
+    out.num_events = int(header.num_events);
+    out.vertex_pos = reinterpret_cast<const Vec2*>(input + header.offsets[0]);
+    out.vertex_half_edges = reinterpret_cast<const int*>(input + header.offsets[1]);
+    out.target = reinterpret_cast<const int*>(input + header.offsets[2]);
+    out.opposite = reinterpret_cast<const int*>(input + header.offsets[3]);
+    out.side_l = reinterpret_cast<const Vec2*>(input + header.offsets[4]);
+    out.side_r = reinterpret_cast<const Vec2*>(input + header.offsets[5]);
+    out.half_edge_events = reinterpret_cast<const int*>(input + header.offsets[6]);
+    out.event_pos = reinterpret_cast<const Vec2*>(input + header.offsets[7]);
+    out.event_l = reinterpret_cast<const Vec2*>(input + header.offsets[8]);
+    out.event_r = reinterpret_cast<const Vec2*>(input + header.offsets[9]);
+    out.data = 0;
+
+    if (!valid_topology(out))
+    {
+        memset(&out, 0, sizeof(out));
+        return false;
+    }
+
+    return true;
+}
+
 int num_path_discs(const Walkable_Space& space, Half_Edge** path, int path_size)
 {
     int result = 0;
@@ -243,6 +714,22 @@ int num_path_discs(const Walkable_Space& space, Half_Edge** path, int path_size)
     return result;
 }
 
+int num_path_discs(const Baked_Space& space, const int* path, int path_size)
+{
+    int result = 0;
+
+    for (int i = 0; i < path_size; ++i)
+    {
+        int e = path[i];
+        // assert subsequent edges in the path share a vertex.
+        corridormap_assert((i + 1 == path_size) || (space.target[e] == source(space, path[i+1])));
+        // events plus two vertices per edge.
+        result += space.half_edge_events[e + 1] - space.half_edge_events[e] + 2;
+    }
+
+    return result;
+}
+
 Corridor create_corridor(Memory* mem, int max_disks, int max_portals)
 {
     Corridor result;
@@ -307,26 +794,32 @@ void vertex_to_edge_path(const Walkable_Space& space, Vertex** path, int path_si
     }
 }
 
-namespace
+void vertex_to_edge_path(const Baked_Space& space, const int* path, int path_size, int* out)
 {
-    void extract_vertex(const Walkable_Space& space, const Half_Edge* edge, Vec2*& out_origin, float*& out_radius, Vec2*& out_obstacle_l, Vec2*& out_obstacle_r)
+    for (int i = 0; i < path_size-1; ++i)
     {
-        Vec2 p = target(space, edge)->pos;
-        Vec2 l = left_side(space, edge);
-        Vec2 r = right_side(space, edge);
-        float radius = std::min(mag(l - p), mag(r - p));
+        int u = path[i+0];
+        int v = path[i+1];
+        int edge = -1;
 
-        *out_origin++ = p;
-        *out_radius++ = radius;
-        *out_obstacle_l++ = l;
-        *out_obstacle_r++ = r;
+        for (int e = space.vertex_half_edges[u]; e < space.vertex_half_edges[u + 1]; ++e)
+        {
+            if (space.target[e] == v)
+            {
+                edge = e;
+                break;
+            }
+        }
+
+        corridormap_assert(edge >= 0);
+        out[i] = edge;
     }
+}
 
-    void extract_event(const Walkable_Space& space, const Half_Edge* edge, const Event* event, Vec2*& out_origin, float*& out_radius, Vec2*& out_obstacle_l, Vec2*& out_obstacle_r)
+namespace
+{
+    void extract_disk(Vec2 p, Vec2 l, Vec2 r, Vec2*& out_origin, float*& out_radius, Vec2*& out_obstacle_l, Vec2*& out_obstacle_r)
     {
-        Vec2 p = event->pos;
-        Vec2 l = left_side(space, edge, event);
-        Vec2 r = right_side(space, edge, event);
         float radius = std::min(mag(l - p), mag(r - p));
 
         *out_origin++ = p;
@@ -335,96 +828,70 @@ namespace
         *out_obstacle_r++ = r;
     }
 
-    void extract_events(const Walkable_Space& space, const Half_Edge* edge, Vec2*& out_origin, float*& out_radius, Vec2*& out_obstacle_l, Vec2*& out_obstacle_r)
+    void extract_vertex(const Walkable_Space& space, const Half_Edge* edge, Vec2*& out_origin, float*& out_radius, Vec2*& out_obstacle_l, Vec2*& out_obstacle_r)
     {
-        for (Event* evt = event(space, edge); evt != 0; evt = next(space, edge, evt))
-        {
-            extract_event(space, edge, evt, out_origin, out_radius, out_obstacle_l, out_obstacle_r);
-        }
+        extract_disk(target(space, edge)->pos, left_side(space, edge), right_side(space, edge), out_origin, out_radius, out_obstacle_l, out_obstacle_r);
     }
 
-    void set_event_curves(Vec2 prev_l, Vec2 prev_r, Vec2 curr_l, Vec2 curr_r, float epsilon, unsigned char*& out_curves)
+    void extract_events(const Walkable_Space& space, const Half_Edge* edge, Vec2*& out_origin, float*& out_radius, Vec2*& out_obstacle_l, Vec2*& out_obstacle_r)
     {
-        *out_curves = curve_point << 0 | curve_point << 4;
-
-        if (!equal(prev_l, curr_l, epsilon))
-        {
-            *out_curves = (*out_curves & 0xf0) | (curve_line << 0);
-        }
-
-        if (!equal(prev_r, curr_r, epsilon))
+        for (Event* evt = event(space, edge); evt != 0; evt = next(space, edge, evt))
         {
-            *out_curves = (*out_curves & 0x0f) | (curve_line << 4);
+            extract_disk(evt->pos, left_side(space, edge, evt), right_side(space, edge, evt), out_origin, out_radius, out_obstacle_l, out_obstacle_r);
         }
-
-        out_curves++;
     }
 
-    void set_vertex_curves(Vec2 prev_l, Vec2 prev_r, Vec2 curr_l, Vec2 curr_r, float epsilon, unsigned char*& out_curves)
+    // sets the connection type for the disks [first_disk, last_disk) extracted from the path edge:
+    // the first disk (source vertex) connects with arc to the target vertex of the previous edge, others connect with lines.
+    void mark_edge_curves(Corridor& out, int path_index, int first_disk, int last_disk)
     {
-        *out_curves = curve_point << 0 | curve_point << 4;
+        out.curves[first_disk] = static_cast<unsigned char>((path_index == 0) ? curve_point : curve_reflex_arc);
 
-        if (!equal(prev_l, curr_l, epsilon))
+        for (int i = first_disk + 1; i < last_disk; ++i)
         {
-            *out_curves = (*out_curves & 0xf0) | (curve_reflex_arc << 0);
+            out.curves[i] = curve_line;
         }
-
-        if (!equal(prev_r, curr_r, epsilon))
-        {
-            *out_curves = (*out_curves & 0x0f) | (curve_reflex_arc << 4);
-        }
-
-        out_curves++;
-    }
-
-    void init_event_curves(const Walkable_Space& space, const Half_Edge* edge, Vec2& prev_l, Vec2& prev_r, unsigned char*& out_curves, float epsilon)
-    {
-        for (Event* evt = event(space, edge); evt != 0; evt = next(space, edge, evt))
-        {
-            Vec2 curr_l = left_side(space, edge, evt);
-            Vec2 curr_r = right_side(space, edge, evt);
-            set_event_curves(prev_l, prev_r, curr_l, curr_r, epsilon, out_curves);
-            prev_l = curr_l;
-            prev_r = curr_r;
-        }
-
-        Vec2 curr_l = left_side(space, edge);
-        Vec2 curr_r = right_side(space, edge);
-        set_event_curves(prev_l, prev_r, curr_l, curr_r, epsilon, out_curves);
-        prev_l = curr_l;
-        prev_r = curr_r;
     }
 
     // non-shrunk corridor border curves could be:
     // - points = subsequent closest points are equal,
     // - lines = subsequent closest points are not equal,
     // - arcs around voronoi vertices = non-equal closest points between arriving half-edge and outgoing half-edge.
-    void init_curves(const Walkable_Space& space, Half_Edge** path, int path_size, Corridor& out, float epsilon)
+    // curves array holds connection types set by mark_edge_curves, they are kept for sides with non-equal closest points.
+    void init_curves(Corridor& out, int num_disks, float epsilon)
     {
-        corridormap_assert(path_size > 0);
-        unsigned char* out_curves = out.curves;
-
-        const Half_Edge* edge = path[0];
-        *out_curves++ = curve_point << 0 | curve_point << 4;
-
-        Vec2 prev_l = right_side(space, opposite(space, edge));
-        Vec2 prev_r = left_side(space, opposite(space, edge));
+        for (int i = 0; i < num_disks; ++i)
+        {
+            unsigned char type = out.curves[i];
+            unsigned char l = curve_point;
+            unsigned char r = curve_point;
 
-        init_event_curves(space, edge, prev_l, prev_r, out_curves, epsilon);
+            if (i > 0 && !equal(out.obstacle_l[i - 1], out.obstacle_l[i], epsilon))
+            {
+                l = type;
+            }
 
-        for (int i = 1; i < path_size; ++i)
-        {
-            edge = path[i];
-            Vec2 curr_l = right_side(space, opposite(space, edge));
-            Vec2 curr_r = left_side(space, opposite(space, edge));
-            set_vertex_curves(prev_l, prev_r, curr_l, curr_r, epsilon, out_curves);
-            prev_l = curr_l;
-            prev_r = curr_r;
+            if (i > 0 && !equal(out.obstacle_r[i - 1], out.obstacle_r[i], epsilon))
+            {
+                r = type;
+            }
 
-            init_event_curves(space, edge, prev_l, prev_r, out_curves, epsilon);
+            out.curves[i] = static_cast<unsigned char>(l << 0 | r << 4);
         }
     }
 
+    void finish_extract(Corridor& out, int num_disks, float epsilon)
+    {
+        init_curves(out, num_disks, epsilon);
+
+        out.num_disks = num_disks;
+        out.clearance = 0.f;
+        out.epsilon = epsilon;
+        // initialize shrunk borders to the obstacle closest points.
+        memcpy(out.border_l, out.obstacle_l, out.num_disks*sizeof(Vec2));
+        memcpy(out.border_r, out.obstacle_r, out.num_disks*sizeof(Vec2));
+    }
+
     // when shrinking, some points could become arcs.
     void update_curves(Corridor& corridor, float epsilon)
     {
@@ -491,23 +958,45 @@ void extract(const Walkable_Space& space, Half_Edge** path, int path_size, Corri
 
     for (int i = 0; i < path_size; ++i)
     {
+        int first_disk = int(out_origin - out.origin);
         // swap left and right since the source vertex is extracted through opposite direction edge.
         extract_vertex(space, opposite(space, path[i]), out_origin, out_radius, out_obstacle_r, out_obstacle_l);
         extract_events(space, path[i], out_origin, out_radius, out_obstacle_l, out_obstacle_r);
         extract_vertex(space, path[i], out_origin, out_radius, out_obstacle_l, out_obstacle_r);
+        mark_edge_curves(out, i, first_disk, int(out_origin - out.origin));
     }
 
-    if (path_size > 0)
+    finish_extract(out, int(out_origin - out.origin), epsilon);
+}
+
+void extract(const Baked_Space& space, const int* path, int path_size, Corridor& out, float epsilon)
+{
+    corridormap_assert(num_path_discs(space, path, path_size) <= out.max_disks);
+
+    Vec2* out_origin = out.origin;
+    float* out_radius = out.radius;
+    Vec2* out_obstacle_l = out.obstacle_l;
+    Vec2* out_obstacle_r = out.obstacle_r;
+
+    for (int i = 0; i < path_size; ++i)
     {
-        init_curves(space, path, path_size, out, epsilon);
+        int first_disk = int(out_origin - out.origin);
+        int e = path[i];
+        int o = space.opposite[e];
+
+        // swap left and right since the source vertex is extracted through opposite direction edge.
+        extract_disk(space.vertex_pos[space.target[o]], space.side_l[o], space.side_r[o], out_origin, out_radius, out_obstacle_r, out_obstacle_l);
+
+        for (int evt = space.half_edge_events[e]; evt < space.half_edge_events[e + 1]; ++evt)
+        {
+            extract_disk(space.event_pos[evt], space.event_l[evt], space.event_r[evt], out_origin, out_radius, out_obstacle_l, out_obstacle_r);
+        }
+
+        extract_disk(space.vertex_pos[space.target[e]], space.side_l[e], space.side_r[e], out_origin, out_radius, out_obstacle_l, out_obstacle_r);
+        mark_edge_curves(out, i, first_disk, int(out_origin - out.origin));
     }
 
-    out.num_disks = int(out_origin - out.origin);
-    out.clearance = 0.f;
-    out.epsilon = epsilon;
-    // initialize shrunk borders to the obstacle closest points.
-    memcpy(out.border_l, out.obstacle_l, out.num_disks*sizeof(Vec2));
-    memcpy(out.border_r, out.obstacle_r, out.num_disks*sizeof(Vec2));
+    finish_extract(out, int(out_origin - out.origin), epsilon);
 }
 
 void shrink(Corridor& corridor, float clearance)
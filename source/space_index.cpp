@@ -0,0 +1,268 @@
+//
+// Copyright (c) 2014 Alexander Shafranov <shafranov@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "corridormap/assert.h"
+#include "corridormap/memory.h"
+#include "corridormap/vec2.h"
+#include "corridormap/runtime.h"
+
+namespace corridormap {
+
+namespace
+{
+    int cell_coord(float v, float origin, float cell_size, int num_cells)
+    {
+        int c = int(floorf((v - origin)/cell_size));
+        return (c < 0) ? 0 : (c >= num_cells ? num_cells - 1 : c);
+    }
+
+    // range of cells overlapped by the segment bounds.
+    void segment_cells(const Space_Index& index, int segment, int& x_min, int& y_min, int& x_max, int& y_max)
+    {
+        Vec2 a = index.segment_a[segment];
+        Vec2 b = index.segment_b[segment];
+        x_min = cell_coord(std::min(a.x, b.x), index.origin.x, index.cell_size, index.num_cols);
+        x_max = cell_coord(std::max(a.x, b.x), index.origin.x, index.cell_size, index.num_cols);
+        y_min = cell_coord(std::min(a.y, b.y), index.origin.y, index.cell_size, index.num_rows);
+        y_max = cell_coord(std::max(a.y, b.y), index.origin.y, index.cell_size, index.num_rows);
+    }
+
+    void test_cell(const Space_Index& index, int cell, Vec2 point, Edge_Location& best)
+    {
+        for (int i = index.cell_offsets[cell]; i < index.cell_offsets[cell + 1]; ++i)
+        {
+            int segment = index.cell_segments[i];
+            Vec2 a = index.segment_a[segment];
+            Vec2 ab = index.segment_b[segment] - a;
+            float len_sq = mag_sq(ab);
+            float s = (len_sq > 0.f) ? clamp(dot(point - a, ab)/len_sq, 0.f, 1.f) : 0.f;
+            Vec2 closest = a + ab*s;
+            float dist = mag(point - closest);
+
+            if (dist < best.distance)
+            {
+                best.edge = index.segment_edge[segment];
+                best.t = index.segment_t0[segment] + (index.segment_t1[segment] - index.segment_t0[segment])*s;
+                best.point = closest;
+                best.distance = dist;
+            }
+        }
+    }
+}
+
+Space_Index create_space_index(Memory* mem, Memory* scratch, const Walkable_Space& space)
+{
+    Space_Index result;
+    memset(&result, 0, sizeof(result));
+
+    Vec2 lo = make_vec2(+FLT_MAX, +FLT_MAX);
+    Vec2 hi = make_vec2(-FLT_MAX, -FLT_MAX);
+    int num_segments = 0;
+
+    for (Vertex* v = first(space.vertices); v != 0; v = next(space.vertices, v))
+    {
+        lo = make_vec2(std::min(lo.x, v->pos.x), std::min(lo.y, v->pos.y));
+        hi = make_vec2(std::max(hi.x, v->pos.x), std::max(hi.y, v->pos.y));
+    }
+
+    for (Edge* e = first(space.edges); e != 0; e = next(space.edges, e))
+    {
+        num_segments++;
+
+        for (Event* evt = event(space, e->dir); evt != 0; evt = next(space, e->dir, evt))
+        {
+            lo = make_vec2(std::min(lo.x, evt->pos.x), std::min(lo.y, evt->pos.y));
+            hi = make_vec2(std::max(hi.x, evt->pos.x), std::max(hi.y, evt->pos.y));
+            num_segments++;
+        }
+    }
+
+    if (num_segments == 0)
+    {
+        lo = make_vec2(0.f, 0.f);
+        hi = make_vec2(0.f, 0.f);
+    }
+
+    // aim for about one segment per cell.
+    float width = std::max(hi.x - lo.x, 1.f);
+    float height = std::max(hi.y - lo.y, 1.f);
+    float cell_size = sqrtf(width*height/float(std::max(num_segments, 1)));
+
+    result.origin = lo;
+    result.cell_size = cell_size;
+    result.num_cols = std::max(int(ceilf(width/cell_size)), 1);
+    result.num_rows = std::max(int(ceilf(height/cell_size)), 1);
+    result.num_segments = num_segments;
+
+    int num_cells = result.num_cols*result.num_rows;
+    result.cell_offsets = allocate<int>(mem, num_cells + 1);
+    result.segment_a = allocate<Vec2>(mem, num_segments);
+    result.segment_b = allocate<Vec2>(mem, num_segments);
+    result.segment_edge = allocate<int>(mem, num_segments);
+    result.segment_t0 = allocate<float>(mem, num_segments);
+    result.segment_t1 = allocate<float>(mem, num_segments);
+
+    // polyline segments with arc length parameters.
+    int segment = 0;
+
+    for (Edge* e = first(space.edges); e != 0; e = next(space.edges, e))
+    {
+        int first_segment = segment;
+        int edge_index = int(e - space.edges.items);
+        Vec2 prev = source(space, e)->pos;
+        float length = 0.f;
+
+        for (Event* evt = event(space, e->dir); evt != 0; evt = next(space, e->dir, evt), ++segment)
+        {
+            result.segment_a[segment] = prev;
+            result.segment_b[segment] = evt->pos;
+            result.segment_edge[segment] = edge_index;
+            result.segment_t0[segment] = length;
+            length += mag(evt->pos - prev);
+            result.segment_t1[segment] = length;
+            prev = evt->pos;
+        }
+
+        result.segment_a[segment] = prev;
+        result.segment_b[segment] = target(space, e)->pos;
+        result.segment_edge[segment] = edge_index;
+        result.segment_t0[segment] = length;
+        length += mag(target(space, e)->pos - prev);
+        result.segment_t1[segment] = length;
+        ++segment;
+
+        float inv_length = (length > 0.f) ? 1.f/length : 0.f;
+
+        for (int i = first_segment; i < segment; ++i)
+        {
+            result.segment_t0[i] *= inv_length;
+            result.segment_t1[i] *= inv_length;
+        }
+    }
+
+    // bin segments by the cells overlapped by their bounds.
+    memset(result.cell_offsets, 0, sizeof(int)*(num_cells + 1));
+    int num_entries = 0;
+
+    for (int i = 0; i < num_segments; ++i)
+    {
+        int x_min, y_min, x_max, y_max;
+        segment_cells(result, i, x_min, y_min, x_max, y_max);
+
+        for (int y = y_min; y <= y_max; ++y)
+        {
+            for (int x = x_min; x <= x_max; ++x)
+            {
+                result.cell_offsets[y*result.num_cols + x + 1]++;
+                num_entries++;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_cells; ++i)
+    {
+        result.cell_offsets[i + 1] += result.cell_offsets[i];
+    }
+
+    result.cell_segments = allocate<int>(mem, num_entries);
+    Alloc_Scope<int> cursor(scratch, num_cells);
+    memcpy(cursor.data, result.cell_offsets, sizeof(int)*num_cells);
+
+    for (int i = 0; i < num_segments; ++i)
+    {
+        int x_min, y_min, x_max, y_max;
+        segment_cells(result, i, x_min, y_min, x_max, y_max);
+
+        for (int y = y_min; y <= y_max; ++y)
+        {
+            for (int x = x_min; x <= x_max; ++x)
+            {
+                result.cell_segments[cursor[y*result.num_cols + x]++] = i;
+            }
+        }
+    }
+
+    return result;
+}
+
+void destroy(Memory* mem, Space_Index& index)
+{
+    mem->deallocate(index.cell_offsets);
+    mem->deallocate(index.cell_segments);
+    mem->deallocate(index.segment_a);
+    mem->deallocate(index.segment_b);
+    mem->deallocate(index.segment_edge);
+    mem->deallocate(index.segment_t0);
+    mem->deallocate(index.segment_t1);
+    memset(&index, 0, sizeof(index));
+}
+
+Edge_Location locate(const Space_Index& index, Vec2 point)
+{
+    int cx = cell_coord(point.x, index.origin.x, index.cell_size, index.num_cols);
+    int cy = cell_coord(point.y, index.origin.y, index.cell_size, index.num_rows);
+
+    Edge_Location result;
+    result.edge = null_idx;
+    result.t = 0.f;
+    result.point = point;
+    result.distance = FLT_MAX;
+    result.cell = cy*index.num_cols + cx;
+
+    int max_ring = std::max(index.num_cols, index.num_rows);
+
+    for (int r = 0; r <= max_ring; ++r)
+    {
+        int x0 = cx - r;
+        int x1 = cx + r;
+        int y0 = cy - r;
+        int y1 = cy + r;
+
+        for (int y = std::max(y0, 0); y <= std::min(y1, index.num_rows - 1); ++y)
+        {
+            // interior rows of the ring only have the two side cells.
+            int step = (y == y0 || y == y1) ? 1 : (x1 - x0);
+
+            for (int x = x0; x <= x1; x += std::max(step, 1))
+            {
+                if (x >= 0 && x < index.num_cols)
+                {
+                    test_cell(index, y*index.num_cols + x, point, result);
+                }
+            }
+        }
+
+        // cells outside of the ring are at least r cells away from the (clamped) point.
+        if (result.distance <= float(r)*index.cell_size)
+        {
+            break;
+        }
+    }
+
+    return result;
+}
+
+}